@@ -0,0 +1,258 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Flora License, Version 1.1 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://floralicense.org/license/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Checks that the preview and the face detection paths do not allocate once
+ * they are warmed up. The frames of a session, replayed as many times as
+ * needed, or of the synthetic camera are filtered with the allocations
+ * counted by alloc_trace.c, and the program fails if any allocation or free
+ * happened in the preview or detection stage after the warm-up.
+ *
+ * usage: facecamera_alloc_check [-n frames] [-w warmup] [-f config] [-s uri]
+ *                               [-x name] [-v] [session.ffs]
+ *
+ *   -n  frames to filter (default 10000)
+ *   -w  frames before the counting starts (default 100)
+ *   -f  configuration file, for the filter settings and the outputs
+ *   -s  stream the filtered frames, see stream_create_from_uri()
+ *   -x  export the frames to a shared memory ring
+ *   -v  report the allocations of every thread and stage
+ */
+
+#include "alloc_trace.h"
+#include "hal_linux.h"
+#include "facefilter.h"
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+static struct {
+    facefilter_s filter;
+    unsigned long limit;
+    unsigned long warmup;
+    unsigned long frames;  /* Written by the camera thread only */
+    unsigned long face_events;
+    bool done;
+} s_check;
+
+static void _filter(frame_s *frame)
+{
+    if (__atomic_load_n(&s_check.done, __ATOMIC_ACQUIRE))
+        return;
+
+    /* Count from a frame boundary, after the buffers have been sized. */
+    if (s_check.frames == s_check.warmup)
+        alloc_trace_reset();
+
+    alloc_stage_e previous = alloc_trace_enter(ALLOC_STAGE_PREVIEW);
+    facefilter_preview(&s_check.filter, frame);
+    alloc_trace_leave(previous);
+
+    if (++s_check.frames >= s_check.limit)
+        __atomic_store_n(&s_check.done, true, __ATOMIC_RELEASE);
+}
+
+static void _preview_cb(frame_s *frame, void *user_data)
+{
+    _filter(frame);
+}
+
+static void _frame_cb(hal_frame_h frame, void *user_data)
+{
+    _filter(hal_frame_get(frame));
+    hal_frame_unref(frame);
+}
+
+static void _face_detected_cb(face_s *faces, int count, void *user_data)
+{
+    alloc_stage_e previous = alloc_trace_enter(ALLOC_STAGE_DETECTION);
+    facefilter_faces_detected(&s_check.filter, faces, count);
+    alloc_trace_leave(previous);
+
+    __atomic_add_fetch(&s_check.face_events, 1, __ATOMIC_RELAXED);
+}
+
+static void _usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [-n frames] [-w warmup] [-f config] [-s uri] "
+            "[-x name] [-v] [session.ffs]\n", name);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *config_path = NULL;
+    const char *stream_uri = NULL;
+    const char *export_name = NULL;
+    bool verbose = false;
+    int opt;
+
+    s_check.limit = 10000;
+    s_check.warmup = 100;
+
+    while ((opt = getopt(argc, argv, "n:w:f:s:x:vh")) != -1) {
+        switch (opt) {
+        case 'n':
+            s_check.limit = strtoul(optarg, NULL, 10);
+            break;
+        case 'w':
+            s_check.warmup = strtoul(optarg, NULL, 10);
+            break;
+        case 'f':
+            config_path = optarg;
+            break;
+        case 's':
+            stream_uri = optarg;
+            break;
+        case 'x':
+            export_name = optarg;
+            break;
+        case 'v':
+            verbose = true;
+            break;
+        default:
+            _usage(argv[0]);
+            return 2;
+        }
+    }
+
+    if (s_check.warmup >= s_check.limit) {
+        _usage(argv[0]);
+        return 2;
+    }
+
+    config_s config;
+    config_default(&config);
+    config.log_level = HAL_LOG_WARN;
+    if (NULL != config_path) {
+        int error = config_load(config_path, &config);
+        if (0 != error) {
+            fprintf(stderr, "config_load() failed: %s\n", hal_error_message(error));
+            return 1;
+        }
+        if (NULL == stream_uri && '\0' != config.stream_uri[0])
+            stream_uri = config.stream_uri;
+        if (NULL == export_name && '\0' != config.export_name[0])
+            export_name = config.export_name;
+    }
+    hal_set_log_priority(config.log_level);
+
+    const char *session = (optind < argc) ? argv[optind] : NULL;
+    hal_linux_set_session(session, SESSION_REPLAY_MAX_SPEED);
+    hal_linux_set_frame_interval(0);
+
+    if (0 != facefilter_init(&s_check.filter))
+        return 1;
+    facefilter_set_max_faces(&s_check.filter, config.max_faces);
+    facefilter_set_motion(&s_check.filter, config.motion);
+    facefilter_set_zones(&s_check.filter, config.zones, config.zone_num);
+    facefilter_set_running(&s_check.filter, true);
+
+    stream_h stream = NULL;
+    if (NULL != stream_uri) {
+        int error = stream_create_from_uri(stream_uri, config.stream_queue_length,
+                STREAM_DROP_OLDEST, &stream);
+        if (0 != error) {
+            fprintf(stderr, "stream_create_from_uri() failed: %s\n",
+                    hal_error_message(error));
+            return 1;
+        }
+        facefilter_set_stream(&s_check.filter, stream);
+    }
+
+    shmring_h ring = NULL;
+    if (NULL != export_name) {
+        int error = shmring_create(export_name, config.export_slots,
+                config.export_slot_size, &ring);
+        if (0 != error) {
+            fprintf(stderr, "shmring_create() failed: %s\n",
+                    hal_error_message(error));
+            return 1;
+        }
+        facefilter_set_export(&s_check.filter, ring, config.export_raw);
+    }
+
+    hal_camera_h camera = NULL;
+    int error = hal_camera_create(config.camera_device, &camera);
+    if (HAL_ERROR_NONE != error) {
+        fprintf(stderr, "hal_camera_create() failed: %s\n", hal_error_message(error));
+        return 1;
+    }
+
+    if (config.frame_refs)
+        hal_camera_set_frame_cb(camera, _frame_cb, NULL);
+    else
+        hal_camera_set_preview_cb(camera, _preview_cb, NULL);
+    hal_camera_start_face_detection(camera, _face_detected_cb, NULL);
+
+    /* A session is replayed again until enough frames were filtered. */
+    while (!__atomic_load_n(&s_check.done, __ATOMIC_ACQUIRE)) {
+        unsigned long before = __atomic_load_n(&s_check.frames, __ATOMIC_RELAXED);
+
+        error = hal_camera_start_preview(camera);
+        if (HAL_ERROR_NONE != error) {
+            fprintf(stderr, "hal_camera_start_preview() failed: %s\n",
+                    hal_error_message(error));
+            return 1;
+        }
+
+        if (NULL != session) {
+            hal_linux_wait_preview_end(camera);
+            if (__atomic_load_n(&s_check.frames, __ATOMIC_RELAXED) == before) {
+                fprintf(stderr, "%s has no frames\n", session);
+                return 1;
+            }
+        } else {
+            while (!__atomic_load_n(&s_check.done, __ATOMIC_ACQUIRE))
+                usleep(10000);
+        }
+        hal_camera_stop_preview(camera);
+    }
+    hal_camera_stop_face_detection(camera);
+
+    /* The counts of the steady state, before tearing the pipeline down. */
+    alloc_counts_s preview, detection;
+    alloc_trace_get(ALLOC_STAGE_PREVIEW, &preview);
+    alloc_trace_get(ALLOC_STAGE_DETECTION, &detection);
+    if (verbose)
+        alloc_trace_report(stdout);
+
+    hal_camera_destroy(camera);
+    if (NULL != stream) {
+        facefilter_set_stream(&s_check.filter, NULL);
+        stream_destroy(stream);
+    }
+    if (NULL != ring) {
+        facefilter_set_export(&s_check.filter, NULL, false);
+        shmring_destroy(ring);
+    }
+    facefilter_deinit(&s_check.filter);
+
+    printf("frames:        %lu (%lu warm-up)\n", s_check.frames, s_check.warmup);
+    printf("face events:   %lu\n", s_check.face_events);
+    printf("preview:       %lu allocs, %lu frees, %llu bytes\n",
+            preview.allocs, preview.frees, preview.bytes);
+    printf("detection:     %lu allocs, %lu frees, %llu bytes\n",
+            detection.allocs, detection.frees, detection.bytes);
+
+    if (0 != preview.allocs + preview.frees + detection.allocs + detection.frees) {
+        printf("FAIL: the steady state allocates\n");
+        return 1;
+    }
+    printf("PASS\n");
+
+    return 0;
+}
@@ -0,0 +1,250 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Flora License, Version 1.1 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://floralicense.org/license/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "alloc_trace.h"
+#include <errno.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+
+/* The allocator of glibc under the public names replaced below. */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void *__libc_memalign(size_t alignment, size_t size);
+extern void __libc_free(void *ptr);
+
+typedef struct _alloc_thread {
+    long tid;
+    char name[16];
+    alloc_counts_s counts[ALLOC_STAGE_NUMBER];
+} alloc_thread_s;
+
+static alloc_thread_s s_threads[ALLOC_TRACE_THREADS];
+static int s_thread_count;
+
+static __thread alloc_thread_s *t_thread;
+static __thread alloc_stage_e t_stage;
+
+static const char *const s_stage_names[ALLOC_STAGE_NUMBER] = {
+    [ALLOC_STAGE_OTHER] = "other",
+    [ALLOC_STAGE_PREVIEW] = "preview",
+    [ALLOC_STAGE_DETECTION] = "detection",
+};
+
+/**
+ * @brief Returns the record of the calling thread, claiming one on first use.
+ * @details Only system calls are used here, as the allocator is not to be
+ *          entered again.
+ */
+static alloc_thread_s *_thread(void)
+{
+    if (NULL != t_thread)
+        return t_thread;
+
+    int index = __atomic_fetch_add(&s_thread_count, 1, __ATOMIC_RELAXED);
+    if (index >= ALLOC_TRACE_THREADS) {
+        t_thread = &s_threads[ALLOC_TRACE_THREADS - 1];
+        return t_thread;
+    }
+
+    alloc_thread_s *thread = &s_threads[index];
+    thread->tid = syscall(SYS_gettid);
+    prctl(PR_GET_NAME, thread->name, 0, 0, 0);
+    t_thread = thread;
+
+    return thread;
+}
+
+static void _count_alloc(size_t size)
+{
+    alloc_counts_s *counts = &_thread()->counts[t_stage];
+
+    __atomic_add_fetch(&counts->allocs, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&counts->bytes, size, __ATOMIC_RELAXED);
+}
+
+static void _count_free(void)
+{
+    __atomic_add_fetch(&_thread()->counts[t_stage].frees, 1, __ATOMIC_RELAXED);
+}
+
+void *malloc(size_t size)
+{
+    _count_alloc(size);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size)
+{
+    _count_alloc(count * size);
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    /* Growing or shrinking a buffer is an allocation as well. */
+    _count_alloc(size);
+    if (NULL != ptr && 0 == size)
+        _count_free();
+    return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr)
+{
+    if (NULL == ptr)
+        return;
+
+    _count_free();
+    __libc_free(ptr);
+}
+
+void *memalign(size_t alignment, size_t size)
+{
+    _count_alloc(size);
+    return __libc_memalign(alignment, size);
+}
+
+void *aligned_alloc(size_t alignment, size_t size)
+{
+    return memalign(alignment, size);
+}
+
+int posix_memalign(void **ptr, size_t alignment, size_t size)
+{
+    if (0 == alignment || (alignment & (alignment - 1)) != 0
+            || alignment % sizeof(void *) != 0)
+        return EINVAL;
+
+    void *memory = memalign(alignment, size);
+    if (NULL == memory)
+        return ENOMEM;
+
+    *ptr = memory;
+
+    return 0;
+}
+
+/**
+ * @brief Counts the allocations of the calling thread into a stage.
+ *
+ * @param stage  The stage being entered
+ *
+ * @return The stage to pass to alloc_trace_leave()
+ */
+alloc_stage_e alloc_trace_enter(alloc_stage_e stage)
+{
+    alloc_stage_e previous = t_stage;
+
+    if ((int) stage >= 0 && stage < ALLOC_STAGE_NUMBER)
+        t_stage = stage;
+
+    return previous;
+}
+
+/**
+ * @brief Returns to the stage the calling thread was in before
+ *        alloc_trace_enter().
+ */
+void alloc_trace_leave(alloc_stage_e previous)
+{
+    t_stage = previous;
+}
+
+/**
+ * @brief Clears the counts of all the threads, e.g. after a warm-up.
+ */
+void alloc_trace_reset(void)
+{
+    int count = __atomic_load_n(&s_thread_count, __ATOMIC_RELAXED);
+
+    if (count > ALLOC_TRACE_THREADS)
+        count = ALLOC_TRACE_THREADS;
+
+    for (int i = 0; i < count; i++) {
+        for (int stage = 0; stage < ALLOC_STAGE_NUMBER; stage++) {
+            alloc_counts_s *counts = &s_threads[i].counts[stage];
+
+            __atomic_store_n(&counts->allocs, 0, __ATOMIC_RELAXED);
+            __atomic_store_n(&counts->frees, 0, __ATOMIC_RELAXED);
+            __atomic_store_n(&counts->bytes, 0, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+/**
+ * @brief Sums the counts of a stage over all the threads.
+ */
+void alloc_trace_get(alloc_stage_e stage, alloc_counts_s *counts)
+{
+    int count = __atomic_load_n(&s_thread_count, __ATOMIC_RELAXED);
+
+    memset(counts, 0, sizeof(*counts));
+    if ((int) stage < 0 || stage >= ALLOC_STAGE_NUMBER)
+        return;
+    if (count > ALLOC_TRACE_THREADS)
+        count = ALLOC_TRACE_THREADS;
+
+    for (int i = 0; i < count; i++) {
+        const alloc_counts_s *c = &s_threads[i].counts[stage];
+
+        counts->allocs += __atomic_load_n(&c->allocs, __ATOMIC_RELAXED);
+        counts->frees += __atomic_load_n(&c->frees, __ATOMIC_RELAXED);
+        counts->bytes += __atomic_load_n(&c->bytes, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * @brief Prints the counts of every thread and stage which allocated or
+ *        freed since the last reset.
+ */
+void alloc_trace_report(FILE *out)
+{
+    int count = __atomic_load_n(&s_thread_count, __ATOMIC_RELAXED);
+
+    if (count > ALLOC_TRACE_THREADS)
+        count = ALLOC_TRACE_THREADS;
+
+    fprintf(out, "%-8s %-16s %-10s %10s %10s %14s\n", "thread", "name", "stage",
+            "allocs", "frees", "bytes");
+    for (int i = 0; i < count; i++) {
+        const alloc_thread_s *thread = &s_threads[i];
+
+        for (int stage = 0; stage < ALLOC_STAGE_NUMBER; stage++) {
+            alloc_counts_s c = {
+                __atomic_load_n(&thread->counts[stage].allocs, __ATOMIC_RELAXED),
+                __atomic_load_n(&thread->counts[stage].frees, __ATOMIC_RELAXED),
+                __atomic_load_n(&thread->counts[stage].bytes, __ATOMIC_RELAXED),
+            };
+
+            if (0 == c.allocs && 0 == c.frees)
+                continue;
+            fprintf(out, "%-8ld %-16.16s %-10s %10lu %10lu %14llu\n",
+                    thread->tid, thread->name, s_stage_names[stage],
+                    c.allocs, c.frees, c.bytes);
+        }
+    }
+}
+
+const char *alloc_trace_stage_name(alloc_stage_e stage)
+{
+    if ((int) stage < 0 || stage >= ALLOC_STAGE_NUMBER)
+        return "?";
+
+    return s_stage_names[stage];
+}
@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Flora License, Version 1.1 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://floralicense.org/license/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#if !defined(_ALLOC_TRACE_H)
+#define _ALLOC_TRACE_H
+
+#include <stdio.h>
+
+/*
+ * Allocation counting for host builds. Linking alloc_trace.c into a program
+ * replaces malloc(), calloc(), realloc(), free() and the aligned allocators
+ * with wrappers around the glibc allocator which count the calls of every
+ * thread, split by the pipeline stage the thread is in. The stages are
+ * entered around the calls into the core, typically in the camera callbacks.
+ *
+ * Not to be combined with a sanitizer, which replaces the allocator itself.
+ */
+
+/* Threads told apart, later threads share the last record. */
+#define ALLOC_TRACE_THREADS 32
+
+typedef enum {
+    ALLOC_STAGE_OTHER,     /* Outside of any stage */
+    ALLOC_STAGE_PREVIEW,   /* facefilter_preview() and the outputs */
+    ALLOC_STAGE_DETECTION, /* facefilter_faces_detected() */
+    ALLOC_STAGE_NUMBER,
+} alloc_stage_e;
+
+typedef struct _alloc_counts {
+    unsigned long allocs; /* malloc(), calloc(), realloc() and the like */
+    unsigned long frees;
+    unsigned long long bytes;
+} alloc_counts_s;
+
+alloc_stage_e alloc_trace_enter(alloc_stage_e stage);
+void alloc_trace_leave(alloc_stage_e previous);
+void alloc_trace_reset(void);
+void alloc_trace_get(alloc_stage_e stage, alloc_counts_s *counts);
+void alloc_trace_report(FILE *out);
+const char *alloc_trace_stage_name(alloc_stage_e stage);
+
+#endif
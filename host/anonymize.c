@@ -0,0 +1,511 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Flora License, Version 1.1 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://floralicense.org/license/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Masks the faces of the photos of a directory tree with the preview filter
+ * of the camera, for photos taken before the application or elsewhere.
+ *
+ * usage: facecamera_anonymize [-j threads] [-q quality] input_dir output_dir
+ *
+ *   -j  threads per stage, the number of processors by default
+ *   -q  JPEG quality of the written photos (90)
+ *
+ * The faces of a photo come from the sidecar file next to it, the photo name
+ * with .faces appended, one face per line as "x y width height" in pixels;
+ * lines starting with # are comments. There is no face detector on a host,
+ * the detection of the device works on the camera preview only, so a photo
+ * without a sidecar file is skipped rather than written unmasked. An empty
+ * sidecar file marks a photo without faces. Every face of the file is
+ * masked: a photo with more faces than the filter takes from one detection
+ * (MAXIMUM_FACE_NUMBER) goes through the filter once per group of faces.
+ *
+ * The photos go through a pipeline of three stages with their own threads:
+ * decode (and read the faces), filter, encode. The stages are connected by
+ * queues of a few photos per thread, so the memory stays bounded however
+ * large the tree is. The masked photos are written to the same relative
+ * path below the output directory, in the format of the original. At the
+ * end the tool reports the photos per second and how busy every stage was,
+ * which shows the stage to give more threads.
+ */
+
+#include "facefilter.h"
+#include "hal.h"
+#include "image_io.h"
+#include "work_queue.h"
+#include <errno.h>
+#include <dirent.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SIDECAR_SUFFIX ".faces"
+/* Photos waiting between two stages, per thread of the stage. */
+#define QUEUE_PER_THREAD 2
+
+typedef enum {
+    STAGE_DECODE,
+    STAGE_FILTER,
+    STAGE_ENCODE,
+    STAGE_NUMBER,
+} stage_e;
+
+static const char *const s_stage_names[STAGE_NUMBER] = {
+    "decode",
+    "filter",
+    "encode",
+};
+
+typedef struct _photo {
+    const char *path; /* Relative to the input directory */
+    image_s image;
+    face_s *faces;
+    int face_num;
+    int face_capacity;
+} photo_s;
+
+static struct {
+    const char *input;
+    const char *output;
+    int threads;
+    int quality;
+    char **paths;
+    int path_num;
+    int path_capacity;
+    int next;                  /* Next path to decode, accessed atomically */
+    work_queue_s decoded;
+    work_queue_s filtered;
+    unsigned long long busy_ns[STAGE_NUMBER]; /* Accessed atomically */
+    int written;               /* Counters, accessed atomically */
+    int masked_faces;
+    int skipped;
+    int failed;
+} s_anon = {
+    .quality = 90,
+};
+
+static unsigned long long _now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void _photo_free(photo_s *photo)
+{
+    if (NULL == photo)
+        return;
+
+    image_free(&photo->image);
+    free(photo->faces);
+    free(photo);
+}
+
+static void _fail(const char *path, const char *what, int error)
+{
+    fprintf(stderr, "%s: %s: %s\n", path, what, hal_error_message(error));
+    __atomic_add_fetch(&s_anon.failed, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Reads the faces of a photo from its sidecar file.
+ *
+ * @return 0 on success, -ENOENT without a sidecar file, -EINVAL for a line
+ *         that is not a face, -ENOMEM if the faces do not fit in memory
+ */
+static int _read_faces(const char *image_path, photo_s *photo)
+{
+    char path[PATH_MAX];
+    char line[256];
+
+    if (snprintf(path, sizeof(path), "%s%s", image_path, SIDECAR_SUFFIX)
+            >= (int) sizeof(path))
+        return -ENAMETOOLONG;
+    FILE *file = fopen(path, "r");
+    if (NULL == file)
+        return -errno;
+
+    int error = 0;
+    photo->face_num = 0;
+    while (0 == error && NULL != fgets(line, sizeof(line), file)) {
+        face_s face = { .id = photo->face_num, .score = 100 };
+        char *text = line + strspn(line, " \t");
+
+        if ('#' == *text || '\n' == *text || '\0' == *text)
+            continue;
+        if (4 != sscanf(text, "%d %d %d %d", &face.x, &face.y, &face.width,
+                &face.height) || face.width <= 0 || face.height <= 0)
+            error = -EINVAL;
+        else if (photo->face_num < photo->face_capacity)
+            photo->faces[photo->face_num++] = face;
+        else {
+            int capacity = (photo->face_capacity > 0)
+                    ? 2 * photo->face_capacity : MAXIMUM_FACE_NUMBER;
+            face_s *faces = (face_s *) realloc(photo->faces,
+                    capacity * sizeof(face_s));
+            if (NULL == faces) {
+                error = -ENOMEM;
+                break;
+            }
+            photo->faces = faces;
+            photo->face_capacity = capacity;
+            photo->faces[photo->face_num++] = face;
+        }
+    }
+    fclose(file);
+
+    return error;
+}
+
+static void *_decode_thread(void *user_data)
+{
+    char path[PATH_MAX];
+
+    for (;;) {
+        int index = __atomic_fetch_add(&s_anon.next, 1, __ATOMIC_RELAXED);
+        if (index >= s_anon.path_num)
+            break;
+
+        unsigned long long start = _now_ns();
+        const char *relative = s_anon.paths[index];
+        photo_s *photo = (photo_s *) calloc(1, sizeof(photo_s));
+        if (NULL == photo) {
+            _fail(relative, "decode", -ENOMEM);
+            continue;
+        }
+        photo->path = relative;
+
+        int error = -ENAMETOOLONG;
+        if (snprintf(path, sizeof(path), "%s/%s", s_anon.input, relative)
+                < (int) sizeof(path))
+            error = _read_faces(path, photo);
+        if (-ENOENT == error) {
+            fprintf(stderr, "%s: no %s file, skipped\n", relative, SIDECAR_SUFFIX);
+            __atomic_add_fetch(&s_anon.skipped, 1, __ATOMIC_RELAXED);
+        } else if (0 != error) {
+            _fail(relative, "faces", error);
+        } else if (0 != (error = image_read(path, &photo->image))) {
+            _fail(relative, "decode", error);
+        }
+
+        __atomic_add_fetch(&s_anon.busy_ns[STAGE_DECODE], _now_ns() - start,
+                __ATOMIC_RELAXED);
+        if (0 == error)
+            work_queue_push(&s_anon.decoded, photo);
+        else
+            _photo_free(photo);
+    }
+
+    work_queue_leave(&s_anon.decoded);
+
+    return NULL;
+}
+
+/**
+ * @brief Masks the faces of the photos with the preview filter: the photo
+ *        is converted to a frame, the faces are reported like a detection
+ *        and the masked parts of the frame go back into the photo.
+ * @details A detection holds MAXIMUM_FACE_NUMBER faces at most, so the
+ *          faces are reported in groups of that size, each followed by a
+ *          pass of the filter over the same frame.
+ */
+static void *_filter_thread(void *user_data)
+{
+    facefilter_s filter;
+    unsigned char *buffer = NULL;
+    unsigned int capacity = 0;
+
+    if (0 != facefilter_init(&filter)) {
+        work_queue_leave(&s_anon.filtered);
+        return NULL;
+    }
+    /* Stills have no motion to follow. */
+    facefilter_set_motion(&filter, false);
+    facefilter_set_running(&filter, true);
+
+    photo_s *photo;
+    while (NULL != (photo = (photo_s *) work_queue_pop(&s_anon.decoded))) {
+        unsigned long long start = _now_ns();
+        unsigned int size = image_nv12_size(&photo->image);
+
+        if (size > capacity) {
+            unsigned char *grown = (unsigned char *) realloc(buffer, size);
+            if (NULL == grown) {
+                _fail(photo->path, "filter", -ENOMEM);
+                _photo_free(photo);
+                continue;
+            }
+            buffer = grown;
+            capacity = size;
+        }
+
+        frame_s frame;
+        image_to_nv12(&photo->image, buffer, &frame);
+        facefilter_set_geometry(&filter, frame.width, frame.height);
+
+        for (int first = 0; first < photo->face_num; first += MAXIMUM_FACE_NUMBER) {
+            int count = photo->face_num - first;
+            if (count > MAXIMUM_FACE_NUMBER)
+                count = MAXIMUM_FACE_NUMBER;
+
+            facefilter_faces_detected(&filter, photo->faces + first, count);
+            facefilter_preview(&filter, &frame);
+
+            /* The filter is private to the thread, its spans are stable. */
+            for (int i = 0; i < filter.span_num; i++) {
+                const face_span_s *span = &filter.spans[i];
+
+                image_from_nv12(&photo->image, &frame, span->offset % frame.width,
+                        span->offset / frame.width, span->width, span->height);
+            }
+            __atomic_add_fetch(&s_anon.masked_faces, filter.visible_num,
+                    __ATOMIC_RELAXED);
+        }
+
+        __atomic_add_fetch(&s_anon.busy_ns[STAGE_FILTER], _now_ns() - start,
+                __ATOMIC_RELAXED);
+        work_queue_push(&s_anon.filtered, photo);
+    }
+
+    free(buffer);
+    facefilter_deinit(&filter);
+    work_queue_leave(&s_anon.filtered);
+
+    return NULL;
+}
+
+/* Creates the directories of a path below the output directory. */
+static int _make_parents(char *path)
+{
+    size_t base = strlen(s_anon.output);
+
+    for (char *slash = strchr(path + base + 1, '/'); NULL != slash;
+            slash = strchr(slash + 1, '/')) {
+        *slash = '\0';
+        int error = (0 != mkdir(path, 0755) && EEXIST != errno) ? -errno : 0;
+        *slash = '/';
+        if (0 != error)
+            return error;
+    }
+
+    return 0;
+}
+
+static void *_encode_thread(void *user_data)
+{
+    char path[PATH_MAX];
+    photo_s *photo;
+
+    while (NULL != (photo = (photo_s *) work_queue_pop(&s_anon.filtered))) {
+        unsigned long long start = _now_ns();
+
+        int error = -ENAMETOOLONG;
+        if (snprintf(path, sizeof(path), "%s/%s", s_anon.output, photo->path)
+                < (int) sizeof(path))
+            error = _make_parents(path);
+        if (0 == error)
+            error = image_write(path, &photo->image, s_anon.quality);
+        if (0 != error)
+            _fail(photo->path, "encode", error);
+        else
+            __atomic_add_fetch(&s_anon.written, 1, __ATOMIC_RELAXED);
+        _photo_free(photo);
+
+        __atomic_add_fetch(&s_anon.busy_ns[STAGE_ENCODE], _now_ns() - start,
+                __ATOMIC_RELAXED);
+    }
+
+    return NULL;
+}
+
+static int _add_path(const char *relative)
+{
+    if (s_anon.path_num == s_anon.path_capacity) {
+        int capacity = (s_anon.path_capacity > 0) ? 2 * s_anon.path_capacity : 256;
+        char **paths = (char **) realloc(s_anon.paths, capacity * sizeof(char *));
+        if (NULL == paths)
+            return -ENOMEM;
+        s_anon.paths = paths;
+        s_anon.path_capacity = capacity;
+    }
+
+    s_anon.paths[s_anon.path_num] = strdup(relative);
+    if (NULL == s_anon.paths[s_anon.path_num])
+        return -ENOMEM;
+    s_anon.path_num++;
+
+    return 0;
+}
+
+/**
+ * @brief Collects the photos of a directory of the input tree and of its
+ *        subdirectories. Symbolic links are not followed.
+ *
+ * @param relative  The directory relative to the input directory, "" for
+ *                  the input directory itself
+ */
+static int _collect(const char *relative)
+{
+    char path[PATH_MAX];
+
+    if (snprintf(path, sizeof(path), "%s/%s", s_anon.input, relative)
+            >= (int) sizeof(path))
+        return -ENAMETOOLONG;
+    DIR *directory = opendir(path);
+    if (NULL == directory)
+        return -errno;
+
+    int error = 0;
+    struct dirent *entry;
+    while (0 == error && NULL != (entry = readdir(directory))) {
+        char child[PATH_MAX];
+        struct stat st;
+
+        if ('.' == entry->d_name[0])
+            continue;
+        if (snprintf(child, sizeof(child), "%s%s%s", relative,
+                ('\0' != relative[0]) ? "/" : "", entry->d_name) >= (int) sizeof(child)
+                || snprintf(path, sizeof(path), "%s/%s", s_anon.input, child)
+                >= (int) sizeof(path)) {
+            error = -ENAMETOOLONG;
+            break;
+        }
+        if (0 != lstat(path, &st))
+            continue;
+
+        if (S_ISDIR(st.st_mode))
+            error = _collect(child);
+        else if (S_ISREG(st.st_mode)
+                && IMAGE_FORMAT_UNKNOWN != image_format_from_path(child))
+            error = _add_path(child);
+    }
+    closedir(directory);
+
+    return error;
+}
+
+static void _usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [-j threads] [-q quality] input_dir output_dir\n",
+            name);
+}
+
+int main(int argc, char *argv[])
+{
+    long processors = sysconf(_SC_NPROCESSORS_ONLN);
+    int opt;
+
+    s_anon.threads = (processors > 0) ? (int) processors : 1;
+    while ((opt = getopt(argc, argv, "j:q:h")) != -1) {
+        switch (opt) {
+        case 'j':
+            s_anon.threads = atoi(optarg);
+            break;
+        case 'q':
+            s_anon.quality = atoi(optarg);
+            break;
+        default:
+            _usage(argv[0]);
+            return 2;
+        }
+    }
+
+    if (argc - optind != 2 || s_anon.threads < 1 || s_anon.quality < 1
+            || s_anon.quality > 100) {
+        _usage(argv[0]);
+        return 2;
+    }
+    s_anon.input = argv[optind];
+    s_anon.output = argv[optind + 1];
+
+    /* Writing over the originals would lose them on any error. */
+    char input[PATH_MAX];
+    char output[PATH_MAX];
+    if (0 != mkdir(s_anon.output, 0755) && EEXIST != errno) {
+        perror(s_anon.output);
+        return 1;
+    }
+    if (NULL == realpath(s_anon.input, input)
+            || NULL == realpath(s_anon.output, output)) {
+        perror("realpath");
+        return 1;
+    }
+    if (0 == strcmp(input, output)) {
+        fprintf(stderr, "The output directory must differ from the input directory.\n");
+        return 1;
+    }
+
+    int error = _collect("");
+    if (0 != error) {
+        fprintf(stderr, "%s: %s\n", s_anon.input, hal_error_message(error));
+        return 1;
+    }
+
+    int threads = s_anon.threads;
+    int length = QUEUE_PER_THREAD * threads;
+    if (0 != work_queue_init(&s_anon.decoded, length, threads)
+            || 0 != work_queue_init(&s_anon.filtered, length, threads)) {
+        fprintf(stderr, "Out of memory.\n");
+        return 1;
+    }
+
+    pthread_t *ids = (pthread_t *) calloc(STAGE_NUMBER * threads, sizeof(pthread_t));
+    if (NULL == ids)
+        return 1;
+
+    void *(*const functions[STAGE_NUMBER])(void *) = {
+        _decode_thread,
+        _filter_thread,
+        _encode_thread,
+    };
+    unsigned long long start = _now_ns();
+    for (int stage = 0; stage < STAGE_NUMBER; stage++)
+        for (int i = 0; i < threads; i++)
+            if (0 != pthread_create(&ids[stage * threads + i], NULL, functions[stage],
+                    NULL)) {
+                /* The queues count on every thread, there is no way back. */
+                fprintf(stderr, "Could not start the %s threads.\n",
+                        s_stage_names[stage]);
+                return 1;
+            }
+    for (int i = 0; i < STAGE_NUMBER * threads; i++)
+        pthread_join(ids[i], NULL);
+    double seconds = (_now_ns() - start) / 1e9;
+
+    printf("%d photos: %d written with %d faces masked, %d skipped, %d failed\n",
+            s_anon.path_num, s_anon.written, s_anon.masked_faces, s_anon.skipped,
+            s_anon.failed);
+    printf("%.2f s, %.1f photos/s with %d threads per stage\n", seconds,
+            (seconds > 0) ? s_anon.written / seconds : 0.0, threads);
+    for (int stage = 0; stage < STAGE_NUMBER; stage++)
+        printf("%-7s %5.1f%% busy\n", s_stage_names[stage], (seconds > 0)
+                ? 100.0 * s_anon.busy_ns[stage] / 1e9 / seconds / threads : 0.0);
+
+    free(ids);
+    work_queue_deinit(&s_anon.filtered);
+    work_queue_deinit(&s_anon.decoded);
+    for (int i = 0; i < s_anon.path_num; i++)
+        free(s_anon.paths[i]);
+    free(s_anon.paths);
+
+    return (0 == s_anon.failed) ? 0 : 1;
+}
@@ -0,0 +1,321 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Flora License, Version 1.1 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://floralicense.org/license/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Compares the two ways of taking the preview frames off the camera when
+ * they are filtered on a worker thread instead of in the camera callback.
+ *
+ * usage: bench_ingest [-m copy|ref] [-t seconds] [-w width] [-H height]
+ *                     [-i frame_us] [-T trace.json]
+ *
+ *   copy  the preview callback copies every frame into a buffer of the
+ *         application, as needed when the camera owns the buffer only for
+ *         the duration of the callback
+ *   ref   the frame callback keeps a reference on the camera buffer and the
+ *         worker releases it once the frame is filtered
+ *
+ * The synthetic camera of the Linux backend runs unpaced by default, so the
+ * frame rate shows how many frames the path can take in. -T writes a trace
+ * of the camera and worker threads.
+ */
+
+#include "hal_linux.h"
+#include "facefilter.h"
+#include "trace.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Frames waiting for the worker, a few like a real consumer would allow. */
+#define QUEUE_LENGTH 3
+/* One more buffer for the frame being filtered. */
+#define BUFFER_NUMBER (QUEUE_LENGTH + 1)
+
+typedef struct _item {
+    frame_s frame;     /* Copy mode: the copy of the frame */
+    hal_frame_h ref;   /* Reference mode: the camera frame */
+} item_s;
+
+typedef struct _bench {
+    bool copy;
+    facefilter_s filter;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    item_s queue[QUEUE_LENGTH];
+    int head;
+    int count;
+    bool done;
+    /* Copy mode buffers not in use */
+    unsigned char *free_buffers[BUFFER_NUMBER];
+    int free_count;
+    /* Statistics */
+    unsigned long received;
+    unsigned long processed;
+    unsigned long queue_drops;
+    unsigned long long callback_ns;
+} bench_s;
+
+static unsigned long long _now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Queues an item, the lock is held. */
+static void _push(bench_s *bench, const item_s *item)
+{
+    bench->queue[(bench->head + bench->count) % QUEUE_LENGTH] = *item;
+    bench->count++;
+    pthread_cond_signal(&bench->cond);
+}
+
+static void _copy_preview_cb(frame_s *frame, void *user_data)
+{
+    bench_s *bench = (bench_s *) user_data;
+    unsigned long long start = _now_ns();
+    unsigned char *buffer = NULL;
+
+    pthread_mutex_lock(&bench->lock);
+    bench->received++;
+    if (bench->count < QUEUE_LENGTH && bench->free_count > 0)
+        buffer = bench->free_buffers[--bench->free_count];
+    else
+        bench->queue_drops++;
+    pthread_mutex_unlock(&bench->lock);
+
+    if (NULL == buffer)
+        TRACE_INSTANT("queue full");
+
+    if (NULL != buffer) {
+        item_s item = { .frame = *frame };
+
+        /* The camera reuses its buffer once the callback returns. */
+        item.frame.y = buffer;
+        item.frame.uv = buffer + frame->y_size;
+        memcpy(item.frame.y, frame->y, frame->y_size);
+        memcpy(item.frame.uv, frame->uv, frame->uv_size);
+
+        pthread_mutex_lock(&bench->lock);
+        _push(bench, &item);
+        pthread_mutex_unlock(&bench->lock);
+    }
+
+    pthread_mutex_lock(&bench->lock);
+    bench->callback_ns += _now_ns() - start;
+    pthread_mutex_unlock(&bench->lock);
+}
+
+static void _ref_frame_cb(hal_frame_h frame, void *user_data)
+{
+    bench_s *bench = (bench_s *) user_data;
+    unsigned long long start = _now_ns();
+
+    pthread_mutex_lock(&bench->lock);
+    bench->received++;
+    if (bench->count < QUEUE_LENGTH) {
+        item_s item = { .ref = frame };
+        _push(bench, &item);
+        frame = NULL;
+    } else {
+        bench->queue_drops++;
+    }
+    bench->callback_ns += _now_ns() - start;
+    pthread_mutex_unlock(&bench->lock);
+
+    if (NULL != frame)
+        TRACE_INSTANT("queue full");
+
+    /* The reference passed to the callback is released if not queued. */
+    if (NULL != frame)
+        hal_frame_unref(frame);
+}
+
+static void _faces_cb(face_s *faces, int count, void *user_data)
+{
+    bench_s *bench = (bench_s *) user_data;
+
+    facefilter_faces_detected(&bench->filter, faces, count);
+}
+
+static void *_worker(void *user_data)
+{
+    bench_s *bench = (bench_s *) user_data;
+
+    trace_set_thread_name("worker");
+    for (;;) {
+        pthread_mutex_lock(&bench->lock);
+        while (0 == bench->count && !bench->done)
+            pthread_cond_wait(&bench->cond, &bench->lock);
+        if (0 == bench->count) {
+            pthread_mutex_unlock(&bench->lock);
+            break;
+        }
+        item_s item = bench->queue[bench->head];
+        bench->head = (bench->head + 1) % QUEUE_LENGTH;
+        bench->count--;
+        pthread_mutex_unlock(&bench->lock);
+
+        if (bench->copy) {
+            facefilter_preview(&bench->filter, &item.frame);
+
+            pthread_mutex_lock(&bench->lock);
+            bench->free_buffers[bench->free_count++] = item.frame.y;
+            bench->processed++;
+            pthread_mutex_unlock(&bench->lock);
+        } else {
+            facefilter_preview(&bench->filter, hal_frame_get(item.ref));
+            hal_frame_unref(item.ref);
+
+            pthread_mutex_lock(&bench->lock);
+            bench->processed++;
+            pthread_mutex_unlock(&bench->lock);
+        }
+    }
+
+    return NULL;
+}
+
+static void _usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [-m copy|ref] [-t seconds] [-w width] "
+            "[-H height] [-i frame_us] [-T trace.json]\n", name);
+}
+
+int main(int argc, char *argv[])
+{
+    bench_s bench;
+    int seconds = 3;
+    int width = 1280;
+    int height = 720;
+    unsigned int frame_us = 0;
+    const char *trace_path = NULL;
+    int opt;
+
+    memset(&bench, 0, sizeof(bench));
+
+    while ((opt = getopt(argc, argv, "m:t:w:H:i:T:h")) != -1) {
+        switch (opt) {
+        case 'm':
+            if (0 == strcmp(optarg, "copy"))
+                bench.copy = true;
+            else if (0 == strcmp(optarg, "ref"))
+                bench.copy = false;
+            else {
+                _usage(argv[0]);
+                return 2;
+            }
+            break;
+        case 't':
+            seconds = atoi(optarg);
+            break;
+        case 'w':
+            width = atoi(optarg);
+            break;
+        case 'H':
+            height = atoi(optarg);
+            break;
+        case 'i':
+            frame_us = strtoul(optarg, NULL, 10);
+            break;
+        case 'T':
+            trace_path = optarg;
+            break;
+        default:
+            _usage(argv[0]);
+            return 2;
+        }
+    }
+
+    if (seconds < 1 || width < 16 || height < 16 || (width | height) & 1) {
+        _usage(argv[0]);
+        return 2;
+    }
+
+    hal_set_log_priority(HAL_LOG_WARN);
+    hal_linux_set_frame_interval(frame_us);
+
+    unsigned int frame_size = width * height * 3 / 2;
+    for (int i = 0; i < BUFFER_NUMBER && bench.copy; i++) {
+        bench.free_buffers[i] = (unsigned char *) malloc(frame_size);
+        if (NULL == bench.free_buffers[i])
+            return 1;
+        bench.free_count++;
+    }
+
+    hal_camera_h camera = NULL;
+    pthread_t worker;
+
+    if (0 != facefilter_init(&bench.filter)
+            || 0 != hal_camera_create(HAL_CAMERA_DEVICE_FRONT, &camera))
+        return 1;
+    facefilter_set_running(&bench.filter, true);
+    pthread_mutex_init(&bench.lock, NULL);
+    pthread_cond_init(&bench.cond, NULL);
+    pthread_create(&worker, NULL, _worker, &bench);
+
+    hal_camera_set_preview_resolution(camera, width, height);
+    if (bench.copy)
+        hal_camera_set_preview_cb(camera, _copy_preview_cb, &bench);
+    else
+        hal_camera_set_frame_cb(camera, _ref_frame_cb, &bench);
+
+    if (NULL != trace_path)
+        trace_start();
+
+    unsigned long long start = _now_ns();
+    hal_camera_start_preview(camera);
+    hal_camera_start_face_detection(camera, _faces_cb, &bench);
+    sleep(seconds);
+    hal_camera_stop_face_detection(camera);
+    hal_camera_stop_preview(camera);
+    double elapsed = (_now_ns() - start) / 1e9;
+
+    pthread_mutex_lock(&bench.lock);
+    bench.done = true;
+    pthread_cond_signal(&bench.cond);
+    pthread_mutex_unlock(&bench.lock);
+    pthread_join(worker, NULL);
+
+    if (NULL != trace_path) {
+        trace_stop();
+        if (0 != trace_write(trace_path))
+            fprintf(stderr, "could not write %s\n", trace_path);
+        trace_release();
+    }
+
+    printf("%s path, %dx%d, %d s\n", bench.copy ? "copy" : "reference",
+            width, height, seconds);
+    printf("filtered:      %lu frames (%.1f fps)\n", bench.processed,
+            bench.processed / elapsed);
+    printf("received:      %lu frames\n", bench.received);
+    printf("camera drops:  %lu\n", hal_linux_get_dropped_frames(camera));
+    printf("queue drops:   %lu\n", bench.queue_drops);
+    printf("callback:      %.0f ns/frame\n",
+            bench.received ? (double) bench.callback_ns / bench.received : 0.0);
+
+    hal_camera_destroy(camera);
+    facefilter_deinit(&bench.filter);
+    pthread_cond_destroy(&bench.cond);
+    pthread_mutex_destroy(&bench.lock);
+    for (int i = 0; i < BUFFER_NUMBER && bench.copy; i++)
+        free(bench.free_buffers[i]);
+
+    return 0;
+}
@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Flora License, Version 1.1 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://floralicense.org/license/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Measures what a hal_log() call costs the calling thread when the message
+ * is formatted right away, deferred to the drain thread, or written to a
+ * binary log (inc/binlog.h).
+ *
+ * usage: bench_log [-n bursts] [-b burst_length] [-o file.blog]
+ *
+ * The messages are logged in bursts with pauses in between, like the camera
+ * threads log, so the drain thread keeps up. The direct messages go to
+ * /dev/null, which is cheaper than dlog on the device.
+ */
+
+#include "binlog.h"
+#include "hal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+static unsigned long long _now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Messages like the ones of the pipeline. */
+static void _log_burst(int length)
+{
+    for (int i = 0; i < length; i++) {
+        switch (i % 3) {
+        case 0:
+            hal_log(HAL_LOG_DEBUG, "detected: (%d, %d)", i, 2 * i);
+            break;
+        case 1:
+            hal_log(HAL_LOG_INFO, "camctl: %s took %llu us, queued for %llu us, "
+                    "error %d", "start preview", 1234ULL + i, 56ULL, 0);
+            break;
+        default:
+            hal_log(HAL_LOG_WARN, "stream: %lu frames dropped, %.1f%% of %zu",
+                    (unsigned long) i, 100.0 * i / length, (size_t) length);
+            break;
+        }
+    }
+}
+
+static double _measure(int bursts, int length)
+{
+    struct timespec pause = { 0, 5 * 1000000L };
+    unsigned long long total = 0;
+
+    for (int i = 0; i < bursts; i++) {
+        unsigned long long start = _now_ns();
+        _log_burst(length);
+        total += _now_ns() - start;
+        nanosleep(&pause, NULL);
+    }
+
+    return (double) total / ((double) bursts * length);
+}
+
+static void _usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [-n bursts] [-b burst_length] [-o file.blog]\n",
+            name);
+}
+
+int main(int argc, char *argv[])
+{
+    int bursts = 100;
+    int length = 300;
+    const char *path = "bench_log.blog";
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:b:o:h")) != -1) {
+        switch (opt) {
+        case 'n':
+            bursts = atoi(optarg);
+            break;
+        case 'b':
+            length = atoi(optarg);
+            break;
+        case 'o':
+            path = optarg;
+            break;
+        default:
+            _usage(argv[0]);
+            return 2;
+        }
+    }
+
+    if (bursts < 1 || length < 1) {
+        _usage(argv[0]);
+        return 2;
+    }
+
+    if (NULL == freopen("/dev/null", "w", stderr))
+        return 1;
+    hal_set_log_priority(HAL_LOG_DEBUG);
+
+    double direct = _measure(bursts, length);
+
+    if (0 != binlog_start(NULL))
+        return 1;
+    double deferred = _measure(bursts, length);
+    binlog_stop();
+
+    if (0 != binlog_start(path))
+        return 1;
+    double binary = _measure(bursts, length);
+    binlog_stop();
+
+    printf("%d bursts of %d messages\n", bursts, length);
+    printf("direct:    %6.0f ns/message\n", direct);
+    printf("deferred:  %6.0f ns/message\n", deferred);
+    printf("binary:    %6.0f ns/message (%s)\n", binary, path);
+
+    return 0;
+}
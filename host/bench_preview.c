@@ -0,0 +1,189 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Flora License, Version 1.1 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://floralicense.org/license/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Measures the preview callback path (facefilter_preview) on 640x480 frames.
+ *
+ * usage: bench_preview [-i iterations] [-r rounds] [-f faces] [-s size] [-a]
+ *
+ * Every round runs the given number of iterations and the median round is
+ * reported, which keeps the result stable against scheduling noise.
+ *
+ * -a runs the suite of the on-device Benchmark view (inc/bench.h) instead
+ * and writes its report to the data directory (FACECAMERA_DATA_DIR, /tmp by
+ * default), for comparison with the reports of the devices.
+ */
+
+#include "facefilter.h"
+#include "bench.h"
+#include "hal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define FRAME_WIDTH 640
+#define FRAME_HEIGHT 480
+
+static unsigned long long _now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int _compare(const void *a, const void *b)
+{
+    double x = *(const double *) a;
+    double y = *(const double *) b;
+
+    return (x > y) - (x < y);
+}
+
+static int _run_suite(void)
+{
+    frame_s frame;
+    bench_result_s results[BENCH_CASES];
+
+    char *directory = hal_get_data_path();
+    if (NULL == directory || 0 != bench_frame_create(FRAME_WIDTH, FRAME_HEIGHT,
+            &frame)) {
+        free(directory);
+        return 1;
+    }
+
+    int count = bench_run(&frame, directory, results, BENCH_CASES);
+    if (count < 0) {
+        fprintf(stderr, "bench_run() failed: %s\n", hal_error_message(count));
+        bench_frame_free(&frame);
+        free(directory);
+        return 1;
+    }
+
+    printf("synthetic frame %dx%d\n", FRAME_WIDTH, FRAME_HEIGHT);
+    for (int i = 0; i < count; i++) {
+        if (0 != results[i].error)
+            printf("%-20s %s\n", results[i].name,
+                    hal_error_message(results[i].error));
+        else
+            printf("%-20s %10.0f ns/frame %10.1f fps\n", results[i].name,
+                    results[i].ns_per_frame, results[i].fps);
+    }
+
+    char path[512];
+    snprintf(path, sizeof(path), "%s%s", directory, BENCH_REPORT_FILE_NAME);
+    int error = bench_write_report(path, "synthetic", &frame, results, count);
+    if (0 != error)
+        fprintf(stderr, "bench_write_report() failed: %s\n", hal_error_message(error));
+    else
+        printf("report: %s\n", path);
+
+    bench_frame_free(&frame);
+    free(directory);
+
+    return (0 == error) ? 0 : 1;
+}
+
+int main(int argc, char *argv[])
+{
+    int iterations = 2000;
+    int rounds = 7;
+    int face_count = 1;
+    int face_size = 120;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "i:r:f:s:ah")) != -1) {
+        switch (opt) {
+        case 'i':
+            iterations = atoi(optarg);
+            break;
+        case 'r':
+            rounds = atoi(optarg);
+            break;
+        case 'f':
+            face_count = atoi(optarg);
+            break;
+        case 's':
+            face_size = atoi(optarg);
+            break;
+        case 'a':
+            return _run_suite();
+        default:
+            fprintf(stderr, "usage: %s [-i iterations] [-r rounds] [-f faces] "
+                    "[-s size] [-a]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if (iterations < 1 || rounds < 1 || face_count < 0
+            || face_count > MAXIMUM_FACE_NUMBER || face_size < 1
+            || face_size >= FRAME_HEIGHT)
+        return 2;
+
+    unsigned int y_size = FRAME_WIDTH * FRAME_HEIGHT;
+    unsigned char *buffer = (unsigned char *) malloc(y_size * 3 / 2);
+    double *results = (double *) malloc(sizeof(double) * rounds);
+    if (NULL == buffer || NULL == results)
+        return 1;
+    memset(buffer, 128, y_size * 3 / 2);
+
+    frame_s frame = {
+        .width = FRAME_WIDTH,
+        .height = FRAME_HEIGHT,
+        .y = buffer,
+        .uv = buffer + y_size,
+        .y_size = y_size,
+        .uv_size = y_size / 2,
+    };
+
+    face_s faces[MAXIMUM_FACE_NUMBER];
+    for (int i = 0; i < face_count; i++) {
+        faces[i].id = i;
+        faces[i].score = 100;
+        faces[i].width = face_size;
+        faces[i].height = face_size;
+        faces[i].x = (i * 83) % (FRAME_WIDTH - face_size);
+        faces[i].y = (i * 59) % (FRAME_HEIGHT - face_size);
+    }
+
+    facefilter_s filter;
+    if (0 != facefilter_init(&filter))
+        return 1;
+    facefilter_set_running(&filter, true);
+    facefilter_faces_detected(&filter, faces, face_count);
+
+    for (int r = 0; r < rounds; r++) {
+        unsigned long long start = _now_ns();
+        for (int i = 0; i < iterations; i++)
+            facefilter_preview(&filter, &frame);
+        results[r] = (double) (_now_ns() - start) / iterations;
+    }
+
+    qsort(results, rounds, sizeof(double), _compare);
+    double median = results[rounds / 2];
+
+    printf("preview %dx%d, %d face(s) of %dx%d\n", FRAME_WIDTH, FRAME_HEIGHT,
+            face_count, face_size, face_size);
+    printf("median: %.0f ns/frame (%.0f fps), min %.0f, max %.0f\n", median,
+            (median > 0) ? 1e9 / median : 0.0, results[0], results[rounds - 1]);
+
+    facefilter_deinit(&filter);
+    free(results);
+    free(buffer);
+
+    return 0;
+}
@@ -0,0 +1,203 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Flora License, Version 1.1 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://floralicense.org/license/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Fuzz harness feeding arbitrary face lists, zones and frame geometries into
+ * the face store and the preview filter. Built as a libFuzzer target with clang; otherwise (GCC,
+ * afl-cc) FACECAMERA_FUZZ_STANDALONE adds a main() which runs every file
+ * given on the command line, or stdin, once.
+ *
+ * Input layout (little endian):
+ *   u16 width, u16 height   taken modulo 1025
+ *   u8 flags                bit 0: detection running, bit 1: short Y plane
+ *   u8 shortfall            bytes missing from the Y plane when bit 1 is set
+ *   i32 count               number of faces passed to the face store
+ *   count * 6 * i32         id, score, x, y, width, height (zero padded)
+ *   u8 zones                number of static zones, taken modulo
+ *                           MAXIMUM_ZONE_NUMBER + 2 so too many are tried
+ *   zones * 4 * i32         x, y, width, height (zero padded)
+ *
+ * The zones are set before the faces are stored, so the faces and the zones
+ * go through the clipping and the span merging together. The Y and UV planes
+ * are allocated with their exact sizes, so any access outside of them is
+ * reported by AddressSanitizer. Two frames are filtered per input so the
+ * motion tracking of the faces runs as well.
+ */
+
+#include "facefilter.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FUZZ_MAX_SIDE 1025
+#define FUZZ_MAX_FACES 64
+
+static uint8_t _get_u8(const uint8_t **data, size_t *size)
+{
+    if (0 == *size)
+        return 0;
+
+    (*size)--;
+
+    return *(*data)++;
+}
+
+static int32_t _get_i32(const uint8_t **data, size_t *size)
+{
+    uint8_t bytes[4] = { 0, };
+
+    for (int i = 0; i < 4 && *size > 0; i++, (*data)++, (*size)--)
+        bytes[i] = **data;
+
+    return (int32_t) ((uint32_t) bytes[0] | (uint32_t) bytes[1] << 8
+            | (uint32_t) bytes[2] << 16 | (uint32_t) bytes[3] << 24);
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    static facefilter_s filter;
+    static int initialized = 0;
+
+    if (size < 6)
+        return 0;
+
+    if (!initialized) {
+        facefilter_init(&filter);
+        initialized = 1;
+    }
+
+    int width = (data[0] | data[1] << 8) % FUZZ_MAX_SIDE;
+    int height = (data[2] | data[3] << 8) % FUZZ_MAX_SIDE;
+    int flags = data[4];
+    unsigned int shortfall = data[5];
+    data += 6;
+    size -= 6;
+
+    unsigned int y_size = width * height;
+    if ((flags & 2) && shortfall <= y_size)
+        y_size -= shortfall;
+
+    int count = _get_i32(&data, &size);
+    face_s faces[FUZZ_MAX_FACES];
+    int stored = (count < 0) ? 0 : (count > FUZZ_MAX_FACES) ? FUZZ_MAX_FACES : count;
+
+    for (int i = 0; i < stored; i++) {
+        faces[i].id = _get_i32(&data, &size);
+        faces[i].score = _get_i32(&data, &size);
+        faces[i].x = _get_i32(&data, &size);
+        faces[i].y = _get_i32(&data, &size);
+        faces[i].width = _get_i32(&data, &size);
+        faces[i].height = _get_i32(&data, &size);
+    }
+
+    zone_s zones[MAXIMUM_ZONE_NUMBER + 1];
+    int zone_num = _get_u8(&data, &size) % (MAXIMUM_ZONE_NUMBER + 2);
+
+    for (int i = 0; i < zone_num; i++) {
+        zones[i].x = _get_i32(&data, &size);
+        zones[i].y = _get_i32(&data, &size);
+        zones[i].width = _get_i32(&data, &size);
+        zones[i].height = _get_i32(&data, &size);
+    }
+    facefilter_set_zones(&filter, zones, zone_num);
+
+    /* Negative counts go through as they are, like from a broken driver. */
+    facefilter_faces_detected(&filter, faces, (count < 0) ? count : stored);
+    facefilter_set_running(&filter, flags & 1);
+
+    unsigned char *y = (unsigned char *) malloc(y_size);
+    unsigned char *uv = (unsigned char *) malloc(y_size / 2);
+    /* An empty plane may come back as NULL, the filter checks for it. */
+    if ((NULL != y || 0 == y_size) && (NULL != uv || 0 == y_size / 2)) {
+        int move = (flags & 4) ? 8 : 0;
+
+        for (int pass = 0; pass < 2; pass++) {
+            /* A texture the motion search can lock on. */
+            for (unsigned int i = 0; i < y_size; i++) {
+                unsigned int px = i % width + pass * move;
+                unsigned int py = i / width;
+                y[i] = ((px / 8) ^ (py / 8)) * 37;
+            }
+
+            frame_s frame = {
+                .width = width,
+                .height = height,
+                .y = y,
+                .uv = uv,
+                .y_size = y_size,
+                .uv_size = y_size / 2,
+            };
+            facefilter_preview(&filter, &frame);
+        }
+    }
+
+    free(uv);
+    free(y);
+
+    return 0;
+}
+
+#if defined(FACECAMERA_FUZZ_STANDALONE)
+static int _run_file(FILE *file)
+{
+    size_t capacity = 4096, size = 0;
+    uint8_t *buffer = (uint8_t *) malloc(capacity);
+
+    while (NULL != buffer) {
+        size += fread(buffer + size, 1, capacity - size, file);
+        if (size < capacity)
+            break;
+
+        uint8_t *grown = (uint8_t *) realloc(buffer, capacity * 2);
+        if (NULL == grown) {
+            free(buffer);
+            buffer = NULL;
+            break;
+        }
+        buffer = grown;
+        capacity *= 2;
+    }
+
+    if (NULL == buffer)
+        return 1;
+
+    LLVMFuzzerTestOneInput(buffer, size);
+    free(buffer);
+
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+        return _run_file(stdin);
+
+    for (int i = 1; i < argc; i++) {
+        FILE *file = fopen(argv[i], "rb");
+        if (NULL == file) {
+            perror(argv[i]);
+            return 1;
+        }
+        int error = _run_file(file);
+        fclose(file);
+        if (error)
+            return error;
+    }
+
+    return 0;
+}
+#endif
@@ -0,0 +1,477 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Flora License, Version 1.1 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://floralicense.org/license/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Checks the filter output against golden images and the stage times
+ * against a stored baseline, so an optimized or parallel filter path can
+ * neither change the output nor slow down unnoticed.
+ *
+ * usage: facecamera_golden [-u] [-d dir] [-s session.ffs] [-n frames]
+ *                          [-t tolerance] [-p percent] [-b percent] [-T]
+ *
+ *   -u  update: write the golden images and the baseline instead of
+ *       checking them
+ *   -d  directory of the golden images and the baseline (golden)
+ *   -s  take the frames and faces of a recorded session instead of the
+ *       synthetic scene
+ *   -n  frames checked per filter setup (16)
+ *   -t  largest difference of a sample that still matches (0)
+ *   -p  percentage of the samples of a frame that may differ (0)
+ *   -b  time budget: largest regression of a median stage time against the
+ *       baseline in percent (20)
+ *   -T  skip the time budget, e.g. in sanitizer builds
+ *
+ * Every filter setup below runs over the frames and face lists. The output
+ * frames are stored as <setup>-<frame>.pgm, the NV12 planes stacked as one
+ * gray image. The stage times are those of the Benchmark view suite
+ * (inc/bench.h) on a synthetic frame, without the writers whose time
+ * depends on the storage. The exit status is 1 if anything fails.
+ */
+
+#include "facefilter.h"
+#include "session.h"
+#include "bench.h"
+#include "hal.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define SCENE_WIDTH 320
+#define SCENE_HEIGHT 240
+#define SCENE_SPEED 4 /* Pixels per frame the scene moves */
+#define BASELINE_FILE_NAME "baseline.txt"
+#define GOLDEN_PATH_MAX 512
+
+typedef struct _golden_setup {
+    const char *name;
+    bool motion;
+    int detection_interval;
+    int max_faces;
+} golden_setup_s;
+
+static const golden_setup_s s_setups[] = {
+    { "mask", false, 1, MAXIMUM_FACE_NUMBER },
+    { "track", true, 1, MAXIMUM_FACE_NUMBER },
+    { "interval", true, 3, MAXIMUM_FACE_NUMBER },
+    { "one-face", false, 1, 1 },
+};
+
+#define SETUP_NUMBER ((int) (sizeof(s_setups) / sizeof(s_setups[0])))
+
+static struct {
+    const char *directory;
+    bool update;
+    int max_frames;
+    int tolerance;
+    double percent;
+    facefilter_s filters[SETUP_NUMBER];
+    frame_s output;
+    unsigned int output_capacity;
+    int frames;
+    int failures;
+} s_golden = {
+    .directory = "golden",
+    .max_frames = 16,
+};
+
+/* Writes a NV12 frame as a gray image, the UV rows below the Y rows. */
+static int _write_pgm(const char *path, const frame_s *frame)
+{
+    FILE *file = fopen(path, "wb");
+    if (NULL == file)
+        return -errno;
+
+    int rows = frame->height + (int) (frame->uv_size / frame->width);
+    fprintf(file, "P5\n%d %d\n255\n", frame->width, rows);
+    fwrite(frame->y, 1, frame->y_size, file);
+    fwrite(frame->uv, 1, frame->uv_size, file);
+
+    int error = ferror(file) ? -EIO : 0;
+    if (0 != fclose(file) && 0 == error)
+        error = -errno;
+
+    return error;
+}
+
+/**
+ * @brief Reads an image written by _write_pgm().
+ *
+ * @return The samples, to be freed by the caller, NULL if the file is
+ *         missing or invalid
+ */
+static unsigned char *_read_pgm(const char *path, int *width, int *rows)
+{
+    FILE *file = fopen(path, "rb");
+    if (NULL == file)
+        return NULL;
+
+    int max = 0;
+    unsigned char *data = NULL;
+    if (3 == fscanf(file, "P5 %d %d %d", width, rows, &max) && 255 == max
+            && *width > 0 && *rows > 0 && '\n' == fgetc(file)) {
+        size_t size = (size_t) *width * *rows;
+        data = (unsigned char *) malloc(size);
+        if (NULL != data && size != fread(data, 1, size, file)) {
+            free(data);
+            data = NULL;
+        }
+    }
+    fclose(file);
+
+    return data;
+}
+
+/* Compares an output frame with its golden image. */
+static void _check_frame(const char *path, const char *name, const frame_s *frame)
+{
+    int width = 0;
+    int rows = 0;
+    unsigned char *golden = _read_pgm(path, &width, &rows);
+
+    if (NULL == golden) {
+        printf("FAIL %s: no golden image %s\n", name, path);
+        s_golden.failures++;
+        return;
+    }
+
+    unsigned int size = frame->y_size + frame->uv_size;
+    if (width != frame->width || (size_t) width * rows != size) {
+        printf("FAIL %s: %dx%d frame, the golden image has %dx%d samples\n",
+                name, frame->width, frame->height, width, rows);
+        s_golden.failures++;
+        free(golden);
+        return;
+    }
+
+    unsigned int differ = 0;
+    int max_diff = 0;
+    for (unsigned int i = 0; i < size; i++) {
+        int sample = (i < frame->y_size) ? frame->y[i] : frame->uv[i - frame->y_size];
+        int diff = abs(sample - golden[i]);
+
+        if (diff > s_golden.tolerance)
+            differ++;
+        if (diff > max_diff)
+            max_diff = diff;
+    }
+    free(golden);
+
+    if (differ > s_golden.percent / 100.0 * size) {
+        printf("FAIL %s: %u of %u samples differ, by up to %d\n", name, differ,
+                size, max_diff);
+        s_golden.failures++;
+    }
+}
+
+/* Filters a copy of the frame with every setup and checks the outputs. */
+static void _preview(frame_s *frame, void *user_data)
+{
+    unsigned int uv_size = (NULL != frame->uv) ? frame->uv_size : 0;
+    unsigned int size = frame->y_size + uv_size;
+
+    if (s_golden.frames >= s_golden.max_frames)
+        return;
+
+    if (size > s_golden.output_capacity) {
+        unsigned char *buffer = (unsigned char *) realloc(s_golden.output.y, size);
+        if (NULL == buffer)
+            return;
+        s_golden.output.y = buffer;
+        s_golden.output_capacity = size;
+    }
+
+    for (int i = 0; i < SETUP_NUMBER; i++) {
+        frame_s *output = &s_golden.output;
+        unsigned char *buffer = output->y;
+        char name[64];
+        char path[GOLDEN_PATH_MAX];
+
+        *output = *frame;
+        output->y = buffer;
+        output->uv = (0 != uv_size) ? buffer + frame->y_size : NULL;
+        output->uv_size = uv_size;
+        memcpy(output->y, frame->y, frame->y_size);
+        if (0 != uv_size)
+            memcpy(output->uv, frame->uv, uv_size);
+
+        facefilter_preview(&s_golden.filters[i], output);
+
+        snprintf(name, sizeof(name), "%s-%03d", s_setups[i].name, s_golden.frames);
+        snprintf(path, sizeof(path), "%s/%s.pgm", s_golden.directory, name);
+        if (s_golden.update) {
+            int error = _write_pgm(path, output);
+            if (0 != error) {
+                printf("FAIL %s: %s\n", path, hal_error_message(error));
+                s_golden.failures++;
+            }
+        } else {
+            _check_frame(path, name, output);
+        }
+    }
+
+    s_golden.frames++;
+}
+
+static void _faces(face_s *faces, int count, void *user_data)
+{
+    for (int i = 0; i < SETUP_NUMBER; i++)
+        facefilter_faces_detected(&s_golden.filters[i], faces, count);
+}
+
+static bool _keep_going(void *user_data)
+{
+    return s_golden.frames < s_golden.max_frames;
+}
+
+/* How far the scene has panned at a frame, back again after the turn. */
+static int _scene_pan(int n, int turn)
+{
+    if (n < 0)
+        return 0;
+
+    return SCENE_SPEED * ((n < turn) ? n : 2 * turn - n);
+}
+
+/*
+ * A textured scene panning to the right and halfway turning back, with a
+ * face moving along, another one standing still and a detection every
+ * second frame, one frame late. The motion tracking runs between the
+ * detections and follows the face as it turns back, while the mask of the
+ * interval setup is still widened from the way there. Near the end the
+ * faces are lost.
+ */
+static int _run_scene(void)
+{
+    frame_s frame;
+
+    int turn = s_golden.max_frames / 2;
+    int error = bench_frame_create(SCENE_WIDTH + SCENE_SPEED * turn, SCENE_HEIGHT,
+            &frame);
+    if (0 != error)
+        return error;
+
+    unsigned char *scene = frame.y;
+    int scene_width = frame.width;
+    unsigned char *buffer = (unsigned char *) malloc(SCENE_WIDTH * SCENE_HEIGHT * 3 / 2);
+    if (NULL == buffer) {
+        bench_frame_free(&frame);
+        return -ENOMEM;
+    }
+
+    for (int n = 0; n < s_golden.max_frames; n++) {
+        int pan = _scene_pan(n, turn);
+        int shift = SCENE_SPEED * turn - pan;
+        frame_s view = {
+            .width = SCENE_WIDTH,
+            .height = SCENE_HEIGHT,
+            .y = buffer,
+            .uv = buffer + SCENE_WIDTH * SCENE_HEIGHT,
+            .y_size = SCENE_WIDTH * SCENE_HEIGHT,
+            .uv_size = SCENE_WIDTH * SCENE_HEIGHT / 2,
+            .timestamp_us = n * 33333ULL,
+        };
+
+        for (int y = 0; y < SCENE_HEIGHT; y++)
+            memcpy(view.y + y * SCENE_WIDTH, scene + y * scene_width + shift,
+                    SCENE_WIDTH);
+        memset(view.uv, 128, view.uv_size);
+
+        /* Like on the device, a detection finds the face of an earlier frame. */
+        if (0 == n % 2) {
+            face_s faces[2] = {
+                { 0, 90, 40 + _scene_pan(n - 1, turn), 60, 64, 72 },
+                { 1, 80, 220, 130, 48, 48 },
+            };
+            _faces(faces, (n >= s_golden.max_frames - 3) ? 0 : 2, NULL);
+        }
+        _preview(&view, NULL);
+    }
+
+    free(buffer);
+    bench_frame_free(&frame);
+
+    return 0;
+}
+
+/* Runs the stage times against the baseline, or stores them as such. */
+static void _check_times(double budget)
+{
+    frame_s frame;
+    bench_result_s results[BENCH_CASES];
+    char path[GOLDEN_PATH_MAX];
+    char directory[GOLDEN_PATH_MAX];
+
+    snprintf(path, sizeof(path), "%s/%s", s_golden.directory, BASELINE_FILE_NAME);
+    snprintf(directory, sizeof(directory), "%s/", s_golden.directory);
+
+    if (0 != bench_frame_create(640, 480, &frame)) {
+        s_golden.failures++;
+        return;
+    }
+    int count = bench_run(&frame, directory, results, BENCH_CASES);
+    bench_frame_free(&frame);
+    if (count < 0) {
+        printf("FAIL bench_run(): %s\n", hal_error_message(count));
+        s_golden.failures++;
+        return;
+    }
+
+    if (s_golden.update) {
+        FILE *file = fopen(path, "w");
+        if (NULL == file) {
+            printf("FAIL %s: %s\n", path, hal_error_message(-errno));
+            s_golden.failures++;
+            return;
+        }
+        for (int i = 0; i < count; i++)
+            if (0 == results[i].error && !results[i].storage)
+                fprintf(file, "%.0f %s\n", results[i].ns_per_frame, results[i].name);
+        fclose(file);
+        return;
+    }
+
+    FILE *file = fopen(path, "r");
+    if (NULL == file) {
+        printf("FAIL no baseline %s\n", path);
+        s_golden.failures++;
+        return;
+    }
+
+    double baseline;
+    char name[64];
+    while (2 == fscanf(file, "%lf %63[^\n]", &baseline, name)) {
+        const bench_result_s *result = NULL;
+        for (int i = 0; i < count; i++)
+            if (0 == strcmp(results[i].name, name))
+                result = &results[i];
+
+        if (NULL == result || 0 != result->error) {
+            printf("FAIL %s: not measured\n", name);
+            s_golden.failures++;
+            continue;
+        }
+
+        double change = (baseline > 0)
+                ? (result->ns_per_frame / baseline - 1.0) * 100.0 : 0.0;
+        bool over = change > budget;
+        printf("%s %-20s %10.0f ns, baseline %10.0f ns, %+6.1f%%\n",
+                over ? "FAIL" : "ok  ", name, result->ns_per_frame, baseline, change);
+        if (over)
+            s_golden.failures++;
+    }
+    fclose(file);
+}
+
+static void _usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [-u] [-d dir] [-s session.ffs] [-n frames] "
+            "[-t tolerance] [-p percent] [-b percent] [-T]\n", name);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *session = NULL;
+    double budget = 20.0;
+    bool times = true;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "ud:s:n:t:p:b:Th")) != -1) {
+        switch (opt) {
+        case 'u':
+            s_golden.update = true;
+            break;
+        case 'd':
+            s_golden.directory = optarg;
+            break;
+        case 's':
+            session = optarg;
+            break;
+        case 'n':
+            s_golden.max_frames = atoi(optarg);
+            break;
+        case 't':
+            s_golden.tolerance = atoi(optarg);
+            break;
+        case 'p':
+            s_golden.percent = atof(optarg);
+            break;
+        case 'b':
+            budget = atof(optarg);
+            break;
+        case 'T':
+            times = false;
+            break;
+        default:
+            _usage(argv[0]);
+            return 2;
+        }
+    }
+
+    if (s_golden.max_frames < 1 || s_golden.tolerance < 0 || s_golden.percent < 0
+            || budget < 0) {
+        _usage(argv[0]);
+        return 2;
+    }
+    if (s_golden.update)
+        mkdir(s_golden.directory, 0755);
+
+    for (int i = 0; i < SETUP_NUMBER; i++) {
+        facefilter_s *filter = &s_golden.filters[i];
+
+        if (0 != facefilter_init(filter))
+            return 1;
+        facefilter_set_motion(filter, s_setups[i].motion);
+        facefilter_set_detection_interval(filter, s_setups[i].detection_interval);
+        facefilter_set_max_faces(filter, s_setups[i].max_faces);
+        facefilter_set_running(filter, true);
+    }
+
+    int error;
+    if (NULL != session) {
+        /* Returns the number of replayed events. */
+        session_callbacks_s callbacks = {
+            .preview = _preview,
+            .faces = _faces,
+            .keep_going = _keep_going,
+        };
+        error = session_replay(session, SESSION_REPLAY_MAX_SPEED, &callbacks, NULL);
+    } else {
+        error = _run_scene();
+    }
+    if (error < 0) {
+        fprintf(stderr, "reading the frames failed: %s\n", hal_error_message(error));
+        return 1;
+    }
+
+    for (int i = 0; i < SETUP_NUMBER; i++)
+        facefilter_deinit(&s_golden.filters[i]);
+    free(s_golden.output.y);
+
+    printf("%d frames, %d filter setups %s\n", s_golden.frames, SETUP_NUMBER,
+            s_golden.update ? "stored" : "checked");
+    if (0 == s_golden.frames)
+        s_golden.failures++;
+
+    if (times)
+        _check_times(budget);
+
+    printf("%s\n", (0 == s_golden.failures) ? "PASS" : "FAIL");
+
+    return (0 == s_golden.failures) ? 0 : 1;
+}
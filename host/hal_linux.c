@@ -0,0 +1,878 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Flora License, Version 1.1 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://floralicense.org/license/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "hal_linux.h"
+#include "trace.h"
+#include "binlog.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/utsname.h>
+
+#define SYNTHETIC_WIDTH 640
+#define SYNTHETIC_HEIGHT 480
+#define SYNTHETIC_FRAME_US 33333
+#define SYNTHETIC_FACE_INTERVAL 3
+#define PGM_HEADER_SIZE 32
+/* Frame buffers of the camera, like the buffer pool of a camera driver. */
+#define HAL_LINUX_FRAME_POOL 4
+
+struct _hal_frame {
+    frame_s frame;
+    int refs;
+    unsigned char *buffer;
+    unsigned int capacity;
+};
+
+struct _hal_camera {
+    pthread_mutex_t lock;
+    pthread_t thread;
+    bool thread_running;
+    pthread_t face_thread;
+    bool face_thread_running;
+    bool stop;            /* Accessed atomically */
+    unsigned int frame_n; /* Latest synthetic frame, accessed atomically */
+    hal_preview_cb preview_cb;
+    void *preview_data;
+    hal_frame_cb frame_cb;
+    void *frame_data;
+    struct _hal_frame pool[HAL_LINUX_FRAME_POOL];
+    unsigned long dropped;
+    hal_face_detected_cb face_cb;
+    void *face_data;
+    int width;
+    int height;
+    unsigned char *last_y;
+    unsigned int last_y_size;
+    int last_width;
+    int last_height;
+};
+
+typedef struct _dispatch_job {
+    hal_dispatch_cb callback;
+    void *data;
+    struct _dispatch_job *next;
+} dispatch_job_s;
+
+static struct {
+    char *session_path;
+    session_replay_speed_e speed;
+    hal_log_priority_e log_priority;
+    unsigned int frame_us;
+    unsigned int face_us;
+    unsigned int jitter_us;
+} s_config = {
+    .session_path = NULL,
+    .speed = SESSION_REPLAY_REALTIME,
+    .frame_us = SYNTHETIC_FRAME_US,
+    .log_priority = HAL_LOG_INFO,
+};
+
+static struct {
+    pthread_once_t once;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_t thread;
+    dispatch_job_s *head;
+    dispatch_job_s *tail;
+    bool busy;
+} s_loop = {
+    .once = PTHREAD_ONCE_INIT,
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+};
+
+static const int supported_resolutions[][2] = {
+    { 320, 240 },
+    { 640, 480 },
+    { 1280, 720 },
+};
+
+/**
+ * @brief Selects the session file replayed by the cameras started afterwards.
+ *
+ * @param path   The session file, @c NULL for synthetic frames
+ * @param speed  Whether to keep the recorded timing
+ */
+void hal_linux_set_session(const char *path, session_replay_speed_e speed)
+{
+    free(s_config.session_path);
+    s_config.session_path = (NULL != path) ? strdup(path) : NULL;
+    s_config.speed = speed;
+}
+
+/**
+ * @brief Sets the time between two synthetic frames, 0 to produce them as
+ *        fast as they are consumed.
+ */
+void hal_linux_set_frame_interval(unsigned int frame_us)
+{
+    s_config.frame_us = frame_us;
+}
+
+/**
+ * @brief Sets the time between two synthetic face detections. With 0 the
+ *        faces are reported by the preview thread with every third frame,
+ *        otherwise by a thread of their own, like the detection of a device.
+ */
+void hal_linux_set_face_interval(unsigned int face_us)
+{
+    s_config.face_us = face_us;
+}
+
+/**
+ * @brief Varies every synthetic frame and face interval randomly by up to
+ *        @p jitter_us in both directions.
+ */
+void hal_linux_set_jitter(unsigned int jitter_us)
+{
+    s_config.jitter_us = jitter_us;
+}
+
+/**
+ * @brief Returns the number of frames dropped as all the frame buffers of the
+ *        camera were held.
+ */
+unsigned long hal_linux_get_dropped_frames(hal_camera_h camera)
+{
+    return __atomic_load_n(&camera->dropped, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Takes a free frame buffer of the camera for the next frame.
+ *
+ * @return The frame with one reference, @c NULL if all the buffers are held
+ */
+static hal_frame_h _acquire_frame(hal_camera_h camera, unsigned int size)
+{
+    for (int i = 0; i < HAL_LINUX_FRAME_POOL; i++) {
+        hal_frame_h frame = &camera->pool[i];
+        int expected = 0;
+
+        if (!__atomic_compare_exchange_n(&frame->refs, &expected, 1, false,
+                __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            continue;
+
+        if (frame->capacity < size) {
+            unsigned char *buffer = (unsigned char *) realloc(frame->buffer, size);
+            if (NULL == buffer) {
+                __atomic_store_n(&frame->refs, 0, __ATOMIC_RELEASE);
+                return NULL;
+            }
+            frame->buffer = buffer;
+            frame->capacity = size;
+        }
+
+        return frame;
+    }
+
+    __atomic_add_fetch(&camera->dropped, 1, __ATOMIC_RELAXED);
+
+    return NULL;
+}
+
+frame_s *hal_frame_get(hal_frame_h frame)
+{
+    return &frame->frame;
+}
+
+hal_frame_h hal_frame_ref(hal_frame_h frame)
+{
+    __atomic_add_fetch(&frame->refs, 1, __ATOMIC_RELAXED);
+
+    return frame;
+}
+
+/**
+ * @brief Releases a frame, its buffer goes back to the camera with the last
+ *        reference.
+ */
+void hal_frame_unref(hal_frame_h frame)
+{
+    if (NULL != frame)
+        __atomic_sub_fetch(&frame->refs, 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Keeps a copy of the latest preview frame for the capture.
+ *        Must be called with the camera lock held.
+ */
+static void _keep_frame(hal_camera_h camera, const frame_s *frame)
+{
+    unsigned int size = frame->width * frame->height;
+
+    if (camera->last_y_size < size) {
+        free(camera->last_y);
+        camera->last_y = (unsigned char *) malloc(size);
+        camera->last_y_size = (NULL != camera->last_y) ? size : 0;
+    }
+    if (NULL == camera->last_y || frame->y_size < size)
+        return;
+
+    memcpy(camera->last_y, frame->y, size);
+    camera->last_width = frame->width;
+    camera->last_height = frame->height;
+}
+
+/**
+ * @brief Hands a frame filled by the camera to the preview callbacks. The
+ *        frame callback gets the reference of the caller.
+ */
+static void _deliver(hal_camera_h camera, hal_frame_h frame)
+{
+    pthread_mutex_lock(&camera->lock);
+    hal_preview_cb preview_cb = camera->preview_cb;
+    void *preview_data = camera->preview_data;
+    hal_frame_cb frame_cb = camera->frame_cb;
+    void *frame_data = camera->frame_data;
+    _keep_frame(camera, &frame->frame);
+    pthread_mutex_unlock(&camera->lock);
+
+    if (NULL != preview_cb)
+        preview_cb(&frame->frame, preview_data);
+
+    if (NULL != frame_cb)
+        frame_cb(frame, frame_data);
+    else
+        hal_frame_unref(frame);
+}
+
+static void _replay_preview_cb(frame_s *frame, void *user_data)
+{
+    hal_camera_h camera = (hal_camera_h) user_data;
+    unsigned int uv_size = (NULL != frame->uv) ? frame->uv_size : 0;
+
+    /* The camera writes every frame into one of its own buffers. */
+    hal_frame_h held = _acquire_frame(camera, frame->y_size + uv_size);
+    if (NULL == held)
+        return;
+
+    held->frame = *frame;
+    held->frame.y = held->buffer;
+    held->frame.uv = (uv_size > 0) ? held->buffer + frame->y_size : NULL;
+    held->frame.uv_size = uv_size;
+    memcpy(held->frame.y, frame->y, frame->y_size);
+    if (uv_size > 0)
+        memcpy(held->frame.uv, frame->uv, uv_size);
+
+    _deliver(camera, held);
+}
+
+static void _replay_faces_cb(face_s *faces, int count, void *user_data)
+{
+    hal_camera_h camera = (hal_camera_h) user_data;
+
+    pthread_mutex_lock(&camera->lock);
+    hal_face_detected_cb callback = camera->face_cb;
+    void *data = camera->face_data;
+    pthread_mutex_unlock(&camera->lock);
+
+    if (NULL != callback)
+        callback(faces, count, data);
+}
+
+static bool _stopped(hal_camera_h camera)
+{
+    return __atomic_load_n(&camera->stop, __ATOMIC_ACQUIRE);
+}
+
+static bool _replay_keep_going(void *user_data)
+{
+    return !_stopped((hal_camera_h) user_data);
+}
+
+/**
+ * @brief Sleeps for an interval of the synthetic camera, varied by the
+ *        configured jitter.
+ *
+ * @param interval_us  The interval, 0 returns at once
+ * @param seed         The random state of the calling thread
+ */
+static void _pace(unsigned int interval_us, unsigned int *seed)
+{
+    long long us = interval_us;
+
+    if (0 == interval_us)
+        return;
+    if (s_config.jitter_us > 0)
+        us += (long long) (rand_r(seed) % (2 * s_config.jitter_us + 1))
+                - s_config.jitter_us;
+    if (us <= 0)
+        return;
+
+    struct timespec period = { us / 1000000, (us % 1000000) * 1000 };
+    nanosleep(&period, NULL);
+}
+
+static void _synthetic_size(hal_camera_h camera, int *width, int *height)
+{
+    *width = (camera->width > 0) ? camera->width : SYNTHETIC_WIDTH;
+    *height = (camera->height > 0) ? camera->height : SYNTHETIC_HEIGHT;
+}
+
+/* The bright square of the synthetic frame @p n. */
+static face_s _synthetic_face(int width, int height, unsigned int n)
+{
+    face_s face = {
+        .id = 1,
+        .score = 100,
+        .width = height / 4,
+        .height = height / 4,
+    };
+    face.x = (n * 4) % (width - face.width);
+    face.y = height / 2 - face.height / 2;
+
+    return face;
+}
+
+/**
+ * @brief Produces synthetic frames: a horizontal gradient with a bright
+ *        square moving across it, reported as a face. The frames are drawn
+ *        right into the frame buffers of the camera.
+ */
+static void _synthesize(hal_camera_h camera)
+{
+    int width;
+    int height;
+    _synthetic_size(camera, &width, &height);
+    unsigned int y_size = width * height;
+    unsigned int uv_size = y_size / 2;
+    unsigned char *gradient = (unsigned char *) malloc(width);
+    unsigned int seed = 1;
+
+    if (NULL == gradient)
+        return;
+
+    for (int i = 0; i < width; i++)
+        gradient[i] = (i * 255) / width;
+
+    for (unsigned int n = 0; !_stopped(camera); n++) {
+        face_s face = _synthetic_face(width, height, n);
+
+        __atomic_store_n(&camera->frame_n, n, __ATOMIC_RELAXED);
+        if (0 == s_config.face_us && n % SYNTHETIC_FACE_INTERVAL == 0)
+            _replay_faces_cb(&face, 1, camera);
+
+        hal_frame_h frame = _acquire_frame(camera, y_size + uv_size);
+        if (NULL != frame) {
+            unsigned char *buffer = frame->buffer;
+
+            for (int j = 0; j < height; j++)
+                memcpy(buffer + j * width, gradient, width);
+            for (int j = face.y; j < face.y + face.height; j++)
+                memset(buffer + j * width + face.x, 235, face.width);
+            memset(buffer + y_size, 128, uv_size);
+
+            frame_s f = {
+                .width = width,
+                .height = height,
+                .y = buffer,
+                .uv = buffer + y_size,
+                .y_size = y_size,
+                .uv_size = uv_size,
+                .timestamp_us = (unsigned long long) n * SYNTHETIC_FRAME_US,
+            };
+            frame->frame = f;
+
+            _deliver(camera, frame);
+        }
+
+        _pace(s_config.frame_us, &seed);
+    }
+
+    free(gradient);
+}
+
+/**
+ * @brief Reports the square of the latest synthetic frame as a face at the
+ *        face interval, independently of the frames. Every eighth detection
+ *        finds no face, the face is lost and found again.
+ */
+static void *_face_thread(void *user_data)
+{
+    hal_camera_h camera = (hal_camera_h) user_data;
+    unsigned int seed = 2;
+    int width;
+    int height;
+
+    trace_set_thread_name("face detection");
+    _synthetic_size(camera, &width, &height);
+
+    for (unsigned int n = 0; !_stopped(camera); n++) {
+        unsigned int frame_n = __atomic_load_n(&camera->frame_n, __ATOMIC_RELAXED);
+        face_s face = _synthetic_face(width, height, frame_n);
+
+        _replay_faces_cb(&face, (7 == n % 8) ? 0 : 1, camera);
+        _pace(s_config.face_us, &seed);
+    }
+
+    return NULL;
+}
+
+static void *_preview_thread(void *user_data)
+{
+    hal_camera_h camera = (hal_camera_h) user_data;
+
+    trace_set_thread_name("camera");
+    if (NULL != s_config.session_path) {
+        session_callbacks_s callbacks = {
+            .preview = _replay_preview_cb,
+            .faces = _replay_faces_cb,
+            .keep_going = _replay_keep_going,
+        };
+        int events = session_replay(s_config.session_path, s_config.speed,
+                &callbacks, camera);
+        if (events < 0)
+            hal_log(HAL_LOG_ERROR, "session_replay() failed! Error code = %d",
+                    events);
+    } else {
+        _synthesize(camera);
+    }
+
+    return NULL;
+}
+
+int hal_camera_create(hal_camera_device_e device, hal_camera_h *camera)
+{
+    if (NULL == camera)
+        return -EINVAL;
+
+    hal_camera_h cam = (hal_camera_h) calloc(1, sizeof(*cam));
+    if (NULL == cam)
+        return -ENOMEM;
+
+    pthread_mutex_init(&cam->lock, NULL);
+    *camera = cam;
+
+    return HAL_ERROR_NONE;
+}
+
+void hal_camera_destroy(hal_camera_h camera)
+{
+    if (NULL == camera)
+        return;
+
+    hal_camera_stop_preview(camera);
+    pthread_mutex_destroy(&camera->lock);
+    for (int i = 0; i < HAL_LINUX_FRAME_POOL; i++)
+        free(camera->pool[i].buffer);
+    free(camera->last_y);
+    free(camera);
+}
+
+void *hal_camera_get_native(hal_camera_h camera)
+{
+    return NULL;
+}
+
+int hal_camera_start_preview(hal_camera_h camera)
+{
+    if (NULL == camera)
+        return -EINVAL;
+    if (camera->thread_running)
+        return -EBUSY;
+
+    __atomic_store_n(&camera->stop, false, __ATOMIC_RELEASE);
+    __atomic_store_n(&camera->frame_n, 0, __ATOMIC_RELAXED);
+    int error = pthread_create(&camera->thread, NULL, _preview_thread, camera);
+    if (0 != error)
+        return -error;
+
+    camera->thread_running = true;
+
+    if (NULL == s_config.session_path && s_config.face_us > 0) {
+        error = pthread_create(&camera->face_thread, NULL, _face_thread, camera);
+        if (0 != error) {
+            hal_camera_stop_preview(camera);
+            return -error;
+        }
+        camera->face_thread_running = true;
+    }
+
+    return HAL_ERROR_NONE;
+}
+
+int hal_camera_stop_preview(hal_camera_h camera)
+{
+    if (NULL == camera)
+        return -EINVAL;
+    if (!camera->thread_running)
+        return HAL_ERROR_NONE;
+
+    __atomic_store_n(&camera->stop, true, __ATOMIC_RELEASE);
+    pthread_join(camera->thread, NULL);
+    camera->thread_running = false;
+    if (camera->face_thread_running) {
+        pthread_join(camera->face_thread, NULL);
+        camera->face_thread_running = false;
+    }
+
+    return HAL_ERROR_NONE;
+}
+
+/**
+ * @brief Waits until the replayed session has been delivered completely.
+ *
+ * @param camera  The camera handle
+ */
+void hal_linux_wait_preview_end(hal_camera_h camera)
+{
+    if (NULL == camera || !camera->thread_running)
+        return;
+
+    pthread_join(camera->thread, NULL);
+    camera->thread_running = false;
+    if (camera->face_thread_running) {
+        __atomic_store_n(&camera->stop, true, __ATOMIC_RELEASE);
+        pthread_join(camera->face_thread, NULL);
+        camera->face_thread_running = false;
+    }
+}
+
+int hal_camera_set_preview_cb(hal_camera_h camera, hal_preview_cb callback,
+                              void *user_data)
+{
+    if (NULL == camera || NULL == callback)
+        return -EINVAL;
+
+    pthread_mutex_lock(&camera->lock);
+    camera->preview_cb = callback;
+    camera->preview_data = user_data;
+    pthread_mutex_unlock(&camera->lock);
+
+    return HAL_ERROR_NONE;
+}
+
+int hal_camera_unset_preview_cb(hal_camera_h camera)
+{
+    if (NULL == camera)
+        return -EINVAL;
+
+    pthread_mutex_lock(&camera->lock);
+    camera->preview_cb = NULL;
+    camera->preview_data = NULL;
+    pthread_mutex_unlock(&camera->lock);
+
+    return HAL_ERROR_NONE;
+}
+
+/**
+ * @brief Sets the callback receiving the frames by reference, the stand-in
+ *        of the media packet preview callback of the device.
+ */
+int hal_camera_set_frame_cb(hal_camera_h camera, hal_frame_cb callback,
+                            void *user_data)
+{
+    if (NULL == camera || NULL == callback)
+        return -EINVAL;
+
+    pthread_mutex_lock(&camera->lock);
+    camera->frame_cb = callback;
+    camera->frame_data = user_data;
+    pthread_mutex_unlock(&camera->lock);
+
+    return HAL_ERROR_NONE;
+}
+
+int hal_camera_unset_frame_cb(hal_camera_h camera)
+{
+    if (NULL == camera)
+        return -EINVAL;
+
+    pthread_mutex_lock(&camera->lock);
+    camera->frame_cb = NULL;
+    camera->frame_data = NULL;
+    pthread_mutex_unlock(&camera->lock);
+
+    return HAL_ERROR_NONE;
+}
+
+int hal_camera_foreach_supported_preview_resolution(hal_camera_h camera,
+        hal_preview_resolution_cb callback, void *user_data)
+{
+    if (NULL == camera || NULL == callback)
+        return -EINVAL;
+
+    for (unsigned int i = 0; i < sizeof(supported_resolutions) / sizeof(supported_resolutions[0]); i++)
+        if (!callback(supported_resolutions[i][0], supported_resolutions[i][1],
+                user_data))
+            break;
+
+    return HAL_ERROR_NONE;
+}
+
+int hal_camera_set_preview_resolution(hal_camera_h camera, int width, int height)
+{
+    if (NULL == camera || width <= 0 || height <= 0)
+        return -EINVAL;
+
+    camera->width = width;
+    camera->height = height;
+
+    return HAL_ERROR_NONE;
+}
+
+bool hal_camera_is_supported_face_detection(hal_camera_h camera)
+{
+    return true;
+}
+
+int hal_camera_start_face_detection(hal_camera_h camera,
+        hal_face_detected_cb callback, void *user_data)
+{
+    if (NULL == camera || NULL == callback)
+        return -EINVAL;
+
+    pthread_mutex_lock(&camera->lock);
+    camera->face_cb = callback;
+    camera->face_data = user_data;
+    pthread_mutex_unlock(&camera->lock);
+
+    return HAL_ERROR_NONE;
+}
+
+int hal_camera_stop_face_detection(hal_camera_h camera)
+{
+    if (NULL == camera)
+        return -EINVAL;
+
+    pthread_mutex_lock(&camera->lock);
+    camera->face_cb = NULL;
+    camera->face_data = NULL;
+    pthread_mutex_unlock(&camera->lock);
+
+    return HAL_ERROR_NONE;
+}
+
+/**
+ * @brief Captures the latest preview frame as a grayscale PGM image.
+ * @details The callbacks are invoked on the calling thread, the image is
+ *          not JPEG encoded as there is no encoder on the host.
+ */
+int hal_camera_start_capture(hal_camera_h camera, hal_capturing_cb capturing,
+                             hal_capture_completed_cb completed, void *user_data)
+{
+    if (NULL == camera)
+        return -EINVAL;
+
+    pthread_mutex_lock(&camera->lock);
+
+    if (NULL == camera->last_y || 0 == camera->last_width) {
+        pthread_mutex_unlock(&camera->lock);
+        return -EAGAIN;
+    }
+
+    unsigned int pixels = camera->last_width * camera->last_height;
+    unsigned char *image = (unsigned char *) malloc(PGM_HEADER_SIZE + pixels);
+    if (NULL == image) {
+        pthread_mutex_unlock(&camera->lock);
+        return -ENOMEM;
+    }
+
+    int header = snprintf((char *) image, PGM_HEADER_SIZE, "P5\n%d %d\n255\n",
+            camera->last_width, camera->last_height);
+    memcpy(image + header, camera->last_y, pixels);
+
+    pthread_mutex_unlock(&camera->lock);
+
+    if (NULL != capturing)
+        capturing(image, header + pixels, user_data);
+    if (NULL != completed)
+        completed(user_data);
+
+    free(image);
+
+    return HAL_ERROR_NONE;
+}
+
+static char *_env_directory(const char *name, const char *fallback)
+{
+    const char *value = getenv(name);
+
+    return strdup((NULL != value && '\0' != value[0]) ? value : fallback);
+}
+
+int hal_storage_get_camera_directory(char **path)
+{
+    if (NULL == path)
+        return -EINVAL;
+
+    *path = _env_directory("FACECAMERA_CAMERA_DIR", "/tmp");
+
+    return (NULL != *path) ? HAL_ERROR_NONE : -ENOMEM;
+}
+
+/**
+ * @brief Gets the data directory. Like on the device, the path ends with
+ *        a slash.
+ */
+char *hal_get_data_path(void)
+{
+    char *directory = _env_directory("FACECAMERA_DATA_DIR", "/tmp");
+    if (NULL == directory)
+        return NULL;
+
+    size_t len = strlen(directory);
+    if (len > 0 && '/' == directory[len - 1])
+        return directory;
+
+    char *path = (char *) realloc(directory, len + 2);
+    if (NULL == path) {
+        free(directory);
+        return NULL;
+    }
+    path[len] = '/';
+    path[len + 1] = '\0';
+
+    return path;
+}
+
+/**
+ * @brief Returns the system and machine of the host, to be freed by the
+ *        caller.
+ */
+char *hal_get_device_model(void)
+{
+    struct utsname name;
+
+    if (0 != uname(&name))
+        return NULL;
+
+    char *model = (char *) malloc(strlen(name.sysname) + strlen(name.machine) + 2);
+    if (NULL != model)
+        sprintf(model, "%s %s", name.sysname, name.machine);
+
+    return model;
+}
+
+/**
+ * @brief Sets the lowest priority of the messages written by hal_log().
+ */
+void hal_set_log_priority(hal_log_priority_e priority)
+{
+    s_config.log_priority = priority;
+}
+
+static const char s_letters[] = { 'D', 'I', 'W', 'E' };
+
+void hal_log(hal_log_priority_e priority, const char *fmt, ...)
+{
+    va_list ap;
+
+    if (priority < s_config.log_priority)
+        return;
+
+    va_start(ap, fmt);
+    va_list args;
+    va_copy(args, ap);
+    bool deferred = binlog_vrecord(priority, fmt, args);
+    va_end(args);
+    if (!deferred) {
+        fprintf(stderr, "%c/facecamera: ", s_letters[priority]);
+        vfprintf(stderr, fmt, ap);
+        fputc('\n', stderr);
+    }
+    va_end(ap);
+}
+
+void hal_log_text(hal_log_priority_e priority, const char *text)
+{
+    fprintf(stderr, "%c/facecamera: %s\n", s_letters[priority], text);
+}
+
+const char *hal_error_message(int error_code)
+{
+    return strerror(-error_code);
+}
+
+/**
+ * @brief Runs the dispatched jobs one after another, like the main loop of
+ *        the application does on the device.
+ */
+static void *_main_loop_thread(void *user_data)
+{
+    trace_set_thread_name("main loop");
+    pthread_mutex_lock(&s_loop.lock);
+
+    for (;;) {
+        while (NULL == s_loop.head)
+            pthread_cond_wait(&s_loop.cond, &s_loop.lock);
+
+        dispatch_job_s *job = s_loop.head;
+        s_loop.head = job->next;
+        if (NULL == s_loop.head)
+            s_loop.tail = NULL;
+        s_loop.busy = true;
+
+        pthread_mutex_unlock(&s_loop.lock);
+        job->callback(job->data);
+        free(job);
+        pthread_mutex_lock(&s_loop.lock);
+
+        s_loop.busy = false;
+        pthread_cond_broadcast(&s_loop.cond);
+    }
+
+    return NULL;
+}
+
+static void _main_loop_start(void)
+{
+    if (0 == pthread_create(&s_loop.thread, NULL, _main_loop_thread, NULL))
+        pthread_detach(s_loop.thread);
+}
+
+int hal_dispatch(hal_dispatch_cb callback, void *data)
+{
+    if (NULL == callback)
+        return -EINVAL;
+
+    dispatch_job_s *job = (dispatch_job_s *) malloc(sizeof(*job));
+    if (NULL == job)
+        return -ENOMEM;
+
+    job->callback = callback;
+    job->data = data;
+    job->next = NULL;
+
+    pthread_once(&s_loop.once, _main_loop_start);
+
+    pthread_mutex_lock(&s_loop.lock);
+    if (NULL != s_loop.tail)
+        s_loop.tail->next = job;
+    else
+        s_loop.head = job;
+    s_loop.tail = job;
+    pthread_cond_broadcast(&s_loop.cond);
+    pthread_mutex_unlock(&s_loop.lock);
+
+    return HAL_ERROR_NONE;
+}
+
+/**
+ * @brief Waits until all dispatched jobs have run.
+ */
+void hal_linux_dispatch_flush(void)
+{
+    pthread_mutex_lock(&s_loop.lock);
+    while (NULL != s_loop.head || s_loop.busy)
+        pthread_cond_wait(&s_loop.cond, &s_loop.lock);
+    pthread_mutex_unlock(&s_loop.lock);
+}
@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Flora License, Version 1.1 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://floralicense.org/license/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#if !defined(_HAL_LINUX_H)
+#define _HAL_LINUX_H
+
+#include "hal.h"
+#include "session.h"
+
+/*
+ * Controls of the Linux backend which have no counterpart on the device.
+ *
+ * Without a session the camera produces synthetic 640x480 frames at 30 fps
+ * with one face moving across the picture; hal_linux_set_frame_interval(0)
+ * produces them without pacing, hal_linux_set_face_interval() reports the
+ * faces from a thread of their own and hal_linux_set_jitter() varies the
+ * intervals. Frames come from a small pool
+ * like the media packets of the device, so a consumer holding them too long
+ * makes the camera drop frames. The directories default to /tmp
+ * and can be overridden with the FACECAMERA_CAMERA_DIR and FACECAMERA_DATA_DIR
+ * environment variables.
+ */
+
+void hal_linux_set_session(const char *path, session_replay_speed_e speed);
+void hal_linux_set_frame_interval(unsigned int frame_us);
+void hal_linux_set_face_interval(unsigned int face_us);
+void hal_linux_set_jitter(unsigned int jitter_us);
+unsigned long hal_linux_get_dropped_frames(hal_camera_h camera);
+void hal_linux_wait_preview_end(hal_camera_h camera);
+void hal_linux_dispatch_flush(void);
+
+#endif
@@ -0,0 +1,464 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Flora License, Version 1.1 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://floralicense.org/license/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "image_io.h"
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#if defined(FACECAMERA_HAVE_JPEG)
+#include <setjmp.h>
+#include <jpeglib.h>
+#endif
+#if defined(FACECAMERA_HAVE_PNG)
+#include <png.h>
+#endif
+
+/* Larger images are refused, their buffers would not fit the frame sizes. */
+#define IMAGE_MAX_DIMENSION 16384
+
+/**
+ * @brief Returns the format of an image file by its name, unknown for the
+ *        formats this build does not support.
+ */
+image_format_e image_format_from_path(const char *path)
+{
+    const char *dot = strrchr(path, '.');
+
+    if (NULL == dot)
+        return IMAGE_FORMAT_UNKNOWN;
+    if (0 == strcasecmp(dot, ".pgm") || 0 == strcasecmp(dot, ".ppm")
+            || 0 == strcasecmp(dot, ".pnm"))
+        return IMAGE_FORMAT_PNM;
+#if defined(FACECAMERA_HAVE_JPEG)
+    if (0 == strcasecmp(dot, ".jpg") || 0 == strcasecmp(dot, ".jpeg"))
+        return IMAGE_FORMAT_JPEG;
+#endif
+#if defined(FACECAMERA_HAVE_PNG)
+    if (0 == strcasecmp(dot, ".png"))
+        return IMAGE_FORMAT_PNG;
+#endif
+
+    return IMAGE_FORMAT_UNKNOWN;
+}
+
+static int _alloc_image(image_s *image, int width, int height, int channels)
+{
+    if (width <= 0 || height <= 0 || width > IMAGE_MAX_DIMENSION
+            || height > IMAGE_MAX_DIMENSION)
+        return -EINVAL;
+
+    image->width = width;
+    image->height = height;
+    image->channels = channels;
+    image->data = (unsigned char *) malloc((size_t) width * height * channels);
+
+    return (NULL != image->data) ? 0 : -ENOMEM;
+}
+
+/* Reads a number of the PNM header, skipping blanks and comments. */
+static int _read_pnm_number(FILE *file)
+{
+    int c = fgetc(file);
+
+    while (EOF != c && (isspace(c) || '#' == c)) {
+        if ('#' == c)
+            while (EOF != c && '\n' != c)
+                c = fgetc(file);
+        c = fgetc(file);
+    }
+
+    int value = 0;
+    if (!isdigit(c))
+        return -1;
+    while (isdigit(c) && value < IMAGE_MAX_DIMENSION * 10) {
+        value = value * 10 + (c - '0');
+        c = fgetc(file);
+    }
+
+    return value;
+}
+
+static int _read_pnm(FILE *file, image_s *image)
+{
+    char magic[2];
+
+    if (2 != fread(magic, 1, 2, file) || 'P' != magic[0]
+            || ('5' != magic[1] && '6' != magic[1]))
+        return -EINVAL;
+
+    int width = _read_pnm_number(file);
+    int height = _read_pnm_number(file);
+    int max = _read_pnm_number(file);
+    if (255 != max)
+        return -EINVAL;
+
+    int error = _alloc_image(image, width, height, ('5' == magic[1]) ? 1 : 3);
+    if (0 != error)
+        return error;
+
+    size_t size = (size_t) width * height * image->channels;
+    if (size != fread(image->data, 1, size, file)) {
+        image_free(image);
+        return -EINVAL;
+    }
+
+    return 0;
+}
+
+static int _write_pnm(FILE *file, const image_s *image)
+{
+    fprintf(file, "P%c\n%d %d\n255\n", (1 == image->channels) ? '5' : '6',
+            image->width, image->height);
+    fwrite(image->data, 1, (size_t) image->width * image->height * image->channels,
+            file);
+
+    return 0;
+}
+
+#if defined(FACECAMERA_HAVE_JPEG)
+typedef struct _jpeg_error {
+    struct jpeg_error_mgr manager;
+    jmp_buf jump;
+} jpeg_error_s;
+
+/* libjpeg exits the process on errors by default. */
+static void _jpeg_error_exit(j_common_ptr info)
+{
+    longjmp(((jpeg_error_s *) info->err)->jump, 1);
+}
+
+static int _read_jpeg(FILE *file, image_s *image)
+{
+    struct jpeg_decompress_struct info;
+    jpeg_error_s error;
+
+    info.err = jpeg_std_error(&error.manager);
+    error.manager.error_exit = _jpeg_error_exit;
+    image->data = NULL;
+    if (setjmp(error.jump)) {
+        jpeg_destroy_decompress(&info);
+        image_free(image);
+        return -EINVAL;
+    }
+
+    jpeg_create_decompress(&info);
+    jpeg_stdio_src(&info, file);
+    jpeg_read_header(&info, TRUE);
+    info.out_color_space = (1 == info.num_components) ? JCS_GRAYSCALE : JCS_RGB;
+    jpeg_start_decompress(&info);
+
+    int result = _alloc_image(image, info.output_width, info.output_height,
+            info.output_components);
+    if (0 != result) {
+        jpeg_destroy_decompress(&info);
+        return result;
+    }
+
+    while (info.output_scanline < info.output_height) {
+        JSAMPROW row = image->data
+                + (size_t) info.output_scanline * image->width * image->channels;
+        jpeg_read_scanlines(&info, &row, 1);
+    }
+    jpeg_finish_decompress(&info);
+    jpeg_destroy_decompress(&info);
+
+    return 0;
+}
+
+static int _write_jpeg(FILE *file, const image_s *image, int quality)
+{
+    struct jpeg_compress_struct info;
+    jpeg_error_s error;
+
+    info.err = jpeg_std_error(&error.manager);
+    error.manager.error_exit = _jpeg_error_exit;
+    if (setjmp(error.jump)) {
+        jpeg_destroy_compress(&info);
+        return -EIO;
+    }
+
+    jpeg_create_compress(&info);
+    jpeg_stdio_dest(&info, file);
+    info.image_width = image->width;
+    info.image_height = image->height;
+    info.input_components = image->channels;
+    info.in_color_space = (1 == image->channels) ? JCS_GRAYSCALE : JCS_RGB;
+    jpeg_set_defaults(&info);
+    jpeg_set_quality(&info, quality, TRUE);
+    jpeg_start_compress(&info, TRUE);
+
+    while (info.next_scanline < info.image_height) {
+        JSAMPROW row = image->data
+                + (size_t) info.next_scanline * image->width * image->channels;
+        jpeg_write_scanlines(&info, &row, 1);
+    }
+    jpeg_finish_compress(&info);
+    jpeg_destroy_compress(&info);
+
+    return 0;
+}
+#endif
+
+#if defined(FACECAMERA_HAVE_PNG)
+static int _read_png(FILE *file, image_s *image)
+{
+    png_image png;
+
+    memset(&png, 0, sizeof(png));
+    png.version = PNG_IMAGE_VERSION;
+    if (!png_image_begin_read_from_stdio(&png, file))
+        return -EINVAL;
+
+    /* The alpha channel is composited onto the buffer, cleared to black. */
+    png.format = (png.format & PNG_FORMAT_FLAG_COLOR) ? PNG_FORMAT_RGB : PNG_FORMAT_GRAY;
+    int error = _alloc_image(image, png.width, png.height,
+            PNG_IMAGE_SAMPLE_CHANNELS(png.format));
+    if (0 != error) {
+        png_image_free(&png);
+        return error;
+    }
+
+    memset(image->data, 0, (size_t) image->width * image->height * image->channels);
+    if (!png_image_finish_read(&png, NULL, image->data, 0, NULL)) {
+        image_free(image);
+        return -EINVAL;
+    }
+
+    return 0;
+}
+
+static int _write_png(FILE *file, const image_s *image)
+{
+    png_image png;
+
+    memset(&png, 0, sizeof(png));
+    png.version = PNG_IMAGE_VERSION;
+    png.width = image->width;
+    png.height = image->height;
+    png.format = (1 == image->channels) ? PNG_FORMAT_GRAY : PNG_FORMAT_RGB;
+
+    return png_image_write_to_stdio(&png, file, 0, image->data, 0, NULL) ? 0 : -EIO;
+}
+#endif
+
+/**
+ * @brief Decodes an image file.
+ *
+ * @param path   The file, its extension selects the format
+ * @param image  The image, to be released with image_free()
+ *
+ * @return 0 on success, -ENOTSUP for an unsupported format, -EINVAL for an
+ *         invalid file, otherwise a negative errno value
+ */
+int image_read(const char *path, image_s *image)
+{
+    image_format_e format = image_format_from_path(path);
+
+    image->data = NULL;
+    if (IMAGE_FORMAT_UNKNOWN == format)
+        return -ENOTSUP;
+
+    FILE *file = fopen(path, "rb");
+    if (NULL == file)
+        return -errno;
+
+    int error = -ENOTSUP;
+    switch (format) {
+    case IMAGE_FORMAT_PNM:
+        error = _read_pnm(file, image);
+        break;
+#if defined(FACECAMERA_HAVE_JPEG)
+    case IMAGE_FORMAT_JPEG:
+        error = _read_jpeg(file, image);
+        break;
+#endif
+#if defined(FACECAMERA_HAVE_PNG)
+    case IMAGE_FORMAT_PNG:
+        error = _read_png(file, image);
+        break;
+#endif
+    default:
+        break;
+    }
+    fclose(file);
+
+    return error;
+}
+
+/**
+ * @brief Encodes an image file.
+ *
+ * @param path     The file, its extension selects the format
+ * @param image    The image
+ * @param quality  The JPEG quality, 1 to 100
+ *
+ * @return 0 on success, otherwise a negative errno value
+ */
+int image_write(const char *path, const image_s *image, int quality)
+{
+    image_format_e format = image_format_from_path(path);
+
+    if (IMAGE_FORMAT_UNKNOWN == format)
+        return -ENOTSUP;
+
+    FILE *file = fopen(path, "wb");
+    if (NULL == file)
+        return -errno;
+
+    int error = -ENOTSUP;
+    switch (format) {
+    case IMAGE_FORMAT_PNM:
+        error = _write_pnm(file, image);
+        break;
+#if defined(FACECAMERA_HAVE_JPEG)
+    case IMAGE_FORMAT_JPEG:
+        error = _write_jpeg(file, image, quality);
+        break;
+#endif
+#if defined(FACECAMERA_HAVE_PNG)
+    case IMAGE_FORMAT_PNG:
+        error = _write_png(file, image);
+        break;
+#endif
+    default:
+        break;
+    }
+
+    if (0 == error && ferror(file))
+        error = -EIO;
+    if (0 != fclose(file) && 0 == error)
+        error = -errno;
+    if (0 != error)
+        remove(path);
+
+    return error;
+}
+
+void image_free(image_s *image)
+{
+    free(image->data);
+    image->data = NULL;
+}
+
+/**
+ * @brief Returns the size of the NV12 frame of an image. The frame has even
+ *        dimensions, an odd last row or column is repeated.
+ */
+unsigned int image_nv12_size(const image_s *image)
+{
+    unsigned int width = (image->width + 1) & ~1;
+    unsigned int height = (image->height + 1) & ~1;
+
+    return width * height * 3 / 2;
+}
+
+static unsigned char _clamp(int value)
+{
+    return (value < 0) ? 0 : (value > 255) ? 255 : (unsigned char) value;
+}
+
+/**
+ * @brief Converts an image into a NV12 frame.
+ *
+ * @param image   The image
+ * @param buffer  The frame buffer, image_nv12_size() bytes
+ * @param frame   The frame, set up on the buffer
+ */
+void image_to_nv12(const image_s *image, unsigned char *buffer, frame_s *frame)
+{
+    int width = (image->width + 1) & ~1;
+    int height = (image->height + 1) & ~1;
+    int channels = image->channels;
+
+    frame->width = width;
+    frame->height = height;
+    frame->y = buffer;
+    frame->y_size = width * height;
+    frame->uv = buffer + frame->y_size;
+    frame->uv_size = frame->y_size / 2;
+    frame->timestamp_us = 0;
+
+    for (int y = 0; y < height; y++) {
+        const unsigned char *row = image->data
+                + (size_t) ((y < image->height) ? y : y - 1) * image->width * channels;
+        unsigned char *out = frame->y + y * width;
+
+        for (int x = 0; x < width; x++) {
+            const unsigned char *p = row + ((x < image->width) ? x : x - 1) * channels;
+            out[x] = (1 == channels) ? p[0]
+                    : (unsigned char) ((77 * p[0] + 150 * p[1] + 29 * p[2] + 128) >> 8);
+        }
+    }
+
+    if (1 == channels) {
+        memset(frame->uv, 128, frame->uv_size);
+        return;
+    }
+
+    /* The chroma of the top left pixel of every 2x2 block. */
+    for (int y = 0; y < height; y += 2) {
+        const unsigned char *row = image->data + (size_t) y * image->width * 3;
+        unsigned char *out = frame->uv + (y / 2) * width;
+
+        for (int x = 0; x < width; x += 2) {
+            const unsigned char *p = row + x * 3;
+            out[x] = _clamp(((-43 * p[0] - 85 * p[1] + 128 * p[2] + 128) >> 8) + 128);
+            out[x + 1] = _clamp(((128 * p[0] - 107 * p[1] - 21 * p[2] + 128) >> 8) + 128);
+        }
+    }
+}
+
+/**
+ * @brief Converts a rectangle of a NV12 frame back into the image it was
+ *        made from.
+ *
+ * @param image   The image
+ * @param frame   The frame made by image_to_nv12()
+ * @param x       The left of the rectangle
+ * @param y       The top of the rectangle
+ * @param width   The width of the rectangle, clipped to the image
+ * @param height  The height of the rectangle, clipped to the image
+ */
+void image_from_nv12(image_s *image, const frame_s *frame, int x, int y,
+        int width, int height)
+{
+    int right = (x + width < image->width) ? x + width : image->width;
+    int bottom = (y + height < image->height) ? y + height : image->height;
+    int channels = image->channels;
+
+    for (int j = (y > 0) ? y : 0; j < bottom; j++) {
+        const unsigned char *luma = frame->y + j * frame->width;
+        const unsigned char *chroma = frame->uv + (j / 2) * frame->width;
+        unsigned char *out = image->data + (size_t) j * image->width * channels;
+
+        for (int i = (x > 0) ? x : 0; i < right; i++) {
+            if (1 == channels) {
+                out[i] = luma[i];
+                continue;
+            }
+
+            int l = luma[i] << 8;
+            int u = chroma[i & ~1] - 128;
+            int v = chroma[(i & ~1) + 1] - 128;
+            out[i * 3] = _clamp((l + 359 * v + 128) >> 8);
+            out[i * 3 + 1] = _clamp((l - 88 * u - 183 * v + 128) >> 8);
+            out[i * 3 + 2] = _clamp((l + 454 * u + 128) >> 8);
+        }
+    }
+}
@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Flora License, Version 1.1 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://floralicense.org/license/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#if !defined(_IMAGE_IO_H)
+#define _IMAGE_IO_H
+
+#include "frame.h"
+
+/*
+ * Still image files for the host tools. PGM and PPM files are always
+ * supported, JPEG and PNG files where the build found libjpeg and libpng
+ * (FACECAMERA_HAVE_JPEG, FACECAMERA_HAVE_PNG). The format follows the file
+ * name extension. Images are 8 bit gray or RGB, an alpha channel is
+ * dropped.
+ *
+ * image_to_nv12() and image_from_nv12() convert between the images and the
+ * NV12 frames of the filter with the full range BT.601 matrix of JPEG.
+ */
+
+typedef enum {
+    IMAGE_FORMAT_UNKNOWN,
+    IMAGE_FORMAT_PNM,
+    IMAGE_FORMAT_JPEG,
+    IMAGE_FORMAT_PNG,
+} image_format_e;
+
+typedef struct _image {
+    int width;
+    int height;
+    int channels; /* 1 for gray, 3 for RGB */
+    unsigned char *data;
+} image_s;
+
+image_format_e image_format_from_path(const char *path);
+int image_read(const char *path, image_s *image);
+int image_write(const char *path, const image_s *image, int quality);
+void image_free(image_s *image);
+
+unsigned int image_nv12_size(const image_s *image);
+void image_to_nv12(const image_s *image, unsigned char *buffer, frame_s *frame);
+void image_from_nv12(image_s *image, const frame_s *frame, int x, int y,
+        int width, int height);
+
+#endif
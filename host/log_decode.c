@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Flora License, Version 1.1 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://floralicense.org/license/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Formats a binary log written with log.mode = binary (inc/binlog.h).
+ *
+ * usage: facecamera_log_decode [-p level] file.blog
+ *
+ *   -p  lowest priority to print: debug, info, warn or error
+ *
+ * Every line shows the time since the first message in seconds, the thread
+ * the message was logged on and the message.
+ */
+
+#include "binlog.h"
+#include "hal.h"
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+typedef struct _decode {
+    int priority;
+    unsigned long long first_ns;
+    bool started;
+} decode_s;
+
+static void _message_cb(const binlog_message_s *message, void *user_data)
+{
+    static const char letters[] = { 'D', 'I', 'W', 'E' };
+    decode_s *decode = (decode_s *) user_data;
+
+    if (!decode->started) {
+        decode->first_ns = message->timestamp_ns;
+        decode->started = true;
+    }
+    if (message->priority < decode->priority)
+        return;
+
+    printf("%12.6f T%-2d %c %s\n",
+            (double) (long long) (message->timestamp_ns - decode->first_ns) / 1e9,
+            message->thread,
+            (message->priority >= 0 && message->priority <= HAL_LOG_ERROR)
+                    ? letters[message->priority] : '?',
+            message->text);
+}
+
+static void _usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [-p debug|info|warn|error] file.blog\n", name);
+}
+
+int main(int argc, char *argv[])
+{
+    static const char *const levels[] = { "debug", "info", "warn", "error" };
+    decode_s decode = { HAL_LOG_DEBUG, 0, false };
+    int opt;
+
+    while ((opt = getopt(argc, argv, "p:h")) != -1) {
+        switch (opt) {
+        case 'p':
+            decode.priority = -1;
+            for (int i = 0; i <= HAL_LOG_ERROR; i++)
+                if (0 == strcmp(optarg, levels[i]))
+                    decode.priority = i;
+            if (decode.priority < 0) {
+                _usage(argv[0]);
+                return 2;
+            }
+            break;
+        default:
+            _usage(argv[0]);
+            return 2;
+        }
+    }
+
+    if (optind >= argc) {
+        _usage(argv[0]);
+        return 2;
+    }
+
+    int messages = binlog_decode(argv[optind], _message_cb, &decode);
+    if (messages < 0) {
+        fprintf(stderr, "binlog_decode() failed: %s\n", hal_error_message(messages));
+        return 1;
+    }
+
+    return 0;
+}
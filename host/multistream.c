@@ -0,0 +1,893 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Flora License, Version 1.1 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://floralicense.org/license/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Runs independent filter pipelines, one per camera stream, on a shared pool
+ * of worker threads without any display.
+ *
+ * usage: facecamera_multistream [-n streams] [-w workers] [-t seconds]
+ *                               [-d deadline_ms] [-o uri] [-s WxH] [-r fps]
+ *                               [-S] [-U] [-M] source...
+ *
+ *   -n  the number of streams (the number of sources)
+ *   -w  the worker threads, one per processor by default
+ *   -t  run for that long, looping the files, instead of playing them once
+ *   -d  the deadline of a frame after its arrival, one frame period by
+ *       default (33 ms for shared memory)
+ *   -o  stream the filtered frames, a URI with %d for the stream number,
+ *       see stream_create_from_uri()
+ *   -s  the frame size of raw NV12 files
+ *   -r  the frame rate of raw NV12 files (30)
+ *   -S  scale: run 1, 2, 4 ... up to -n streams one after the other
+ *   -U  unpaced: read the files as fast as the streams are filtered, without
+ *       dropping or skipping frames
+ *   -M  no motion tracking between the detections
+ *
+ * A source is a video file with its face track next to it as file.faces (see
+ * host/video_io.h), or shm:/name for the frames and faces exported by the
+ * camera, see facecamera_replay -x. The streams take the sources in turn, so
+ * one source runs as many streams as asked for.
+ *
+ * Every stream has the state of one camera: its own filter, face snapshot
+ * and motion tracking, fed by a source thread at the frame rate of the
+ * source. A filter tracks MAXIMUM_FACE_NUMBER faces, so a stream whose
+ * source detects more faces at once runs a chain of filters, each masking
+ * its share of the faces; the last one streams the frame. Like a camera, a source does not wait for a stream that falls
+ * behind: it replaces the oldest frame waiting. The workers take the frame
+ * with the earliest deadline among the streams, one frame of a stream at a
+ * time so it is filtered in order, the least recently served stream first
+ * on a tie. A frame whose deadline has passed while a newer one waits is
+ * skipped, frames filtered after their deadline are counted late.
+ *
+ * At the end the tool reports the throughput, the drops and the latency of
+ * every stream and of all of them, and how busy the workers were.
+ */
+
+#include "facefilter.h"
+#include "hal.h"
+#include "shmring.h"
+#include "stream.h"
+#include "video_io.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define FACES_SUFFIX ".faces"
+#define SHM_PREFIX "shm:"
+#define STREAM_MAX 64
+/* Frames waiting for a worker, and the one being filtered. */
+#define STREAM_PENDING 3
+#define STREAM_FRAMES (STREAM_PENDING + 1)
+#define SHM_DEADLINE_MS 33
+#define SHM_WAIT_MS 100
+/* A shared memory source that played once ends after that long idle. */
+#define SHM_IDLE_MS 2000
+
+typedef struct _source {
+    const char *name;
+    bool shm;
+    const video_demuxer_s *demuxer;
+    video_format_s format;
+    video_track_s track;
+    int max_faces; /* Of a detection */
+} source_s;
+
+typedef struct _item {
+    frame_s frame;
+    size_t capacity; /* Bytes of the frame buffer */
+    face_s *faces;   /* MAXIMUM_FACE_NUMBER per filter of the stream */
+    int face_num;
+    bool detection; /* The faces are a detection to apply before filtering */
+    unsigned long long arrival_ns;
+    unsigned long long deadline_ns;
+} item_s;
+
+typedef struct _instance_stats {
+    unsigned long arrived;
+    unsigned long filtered;
+    unsigned long dropped; /* Replaced by the source while waiting */
+    unsigned long skipped; /* Past their deadline with a newer frame waiting */
+    unsigned long late;    /* Filtered after their deadline */
+    unsigned long long latency_ns;
+    unsigned long long latency_max_ns;
+    unsigned long long busy_ns;
+} instance_stats_s;
+
+/* The pipeline of one camera stream. */
+typedef struct _instance {
+    int index;
+    const source_s *source;
+    facefilter_s *filters; /* Chained, filter i takes the faces from
+                              i * MAXIMUM_FACE_NUMBER on */
+    int filter_num;
+    int filter_started;
+    stream_h output;
+    pthread_t thread;
+    bool thread_started;
+    int width; /* Geometry the filter was set to */
+    int height;
+    item_s items[STREAM_FRAMES];
+    /* The following are guarded by the scheduler lock. */
+    item_s *free[STREAM_FRAMES];
+    int free_num;
+    item_s *pending[STREAM_PENDING]; /* Oldest first */
+    int pending_num;
+    bool busy;     /* A worker is filtering a frame of the stream */
+    bool finished; /* The source has ended */
+    unsigned long long served_ns; /* A worker last took a frame */
+    instance_stats_s stats;
+    int error;
+} instance_s;
+
+typedef struct _round {
+    int streams;
+    double seconds;
+    instance_stats_s total;
+} round_s;
+
+static struct {
+    source_s sources[STREAM_MAX];
+    int source_num;
+    instance_s *instances;
+    int instance_num;
+    int worker_num;
+    double duration; /* Seconds, 0 to play the sources once */
+    unsigned long long deadline_ns;
+    const char *output_uri;
+    bool paced;
+    bool motion;
+    pthread_mutex_t lock;
+    pthread_cond_t work;  /* Frames to filter, or the end */
+    pthread_cond_t space; /* Frames filtered, for the unpaced sources */
+    bool stop;
+    int finished_num;     /* Sources that have ended */
+} s_host = {
+    .paced = true,
+    .motion = true,
+};
+
+static unsigned long long _now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static bool _stopped(void)
+{
+    return __atomic_load_n(&s_host.stop, __ATOMIC_RELAXED);
+}
+
+/* Sets the frame fields for a size, growing the buffer as needed. */
+static int _item_reserve(item_s *item, int width, int height)
+{
+    size_t y_size = (size_t) width * height;
+
+    if (y_size * 3 / 2 > item->capacity) {
+        unsigned char *buffer = (unsigned char *) realloc(item->frame.y, y_size * 3 / 2);
+        if (NULL == buffer)
+            return -ENOMEM;
+        item->frame.y = buffer;
+        item->capacity = y_size * 3 / 2;
+    }
+
+    item->frame.width = width;
+    item->frame.height = height;
+    item->frame.uv = item->frame.y + y_size;
+    item->frame.y_size = y_size;
+    item->frame.uv_size = y_size / 2;
+
+    return 0;
+}
+
+/* Hands a detection over to the frame after a dropped one, if it has none. */
+static void _carry_detection(const item_s *dropped, item_s *next)
+{
+    if (!dropped->detection || NULL == next || next->detection)
+        return;
+
+    memcpy(next->faces, dropped->faces, dropped->face_num * sizeof(face_s));
+    next->face_num = dropped->face_num;
+    next->detection = true;
+}
+
+/* Takes the oldest waiting frame, the lock held. */
+static item_s *_take_oldest_locked(instance_s *instance)
+{
+    item_s *item = instance->pending[0];
+
+    instance->pending_num--;
+    memmove(instance->pending, instance->pending + 1,
+            instance->pending_num * sizeof(item_s *));
+
+    return item;
+}
+
+/* Drops the oldest waiting frame, keeping its detection, the lock held. */
+static item_s *_drop_oldest_locked(instance_s *instance)
+{
+    item_s *item = _take_oldest_locked(instance);
+
+    _carry_detection(item, (instance->pending_num > 0) ? instance->pending[0] : NULL);
+
+    return item;
+}
+
+/**
+ * @brief Takes a frame to fill for a source.
+ * @details A paced source replaces the oldest waiting frame when the stream
+ *          has none free, an unpaced one waits for the workers to make room.
+ *
+ * @return The frame, @c NULL once the run is stopped
+ */
+static item_s *_acquire(instance_s *instance)
+{
+    item_s *item = NULL;
+
+    pthread_mutex_lock(&s_host.lock);
+    while (!s_host.stop && !s_host.paced
+            && (0 == instance->free_num || STREAM_PENDING == instance->pending_num))
+        pthread_cond_wait(&s_host.space, &s_host.lock);
+    if (!s_host.stop) {
+        if (instance->free_num > 0) {
+            item = instance->free[--instance->free_num];
+        } else {
+            /* All the others wait or are filtered, the oldest has a successor. */
+            item = _drop_oldest_locked(instance);
+            instance->stats.dropped++;
+        }
+    }
+    pthread_mutex_unlock(&s_host.lock);
+
+    if (NULL != item)
+        item->detection = false;
+
+    return item;
+}
+
+static void _release(instance_s *instance, item_s *item)
+{
+    pthread_mutex_lock(&s_host.lock);
+    instance->free[instance->free_num++] = item;
+    pthread_mutex_unlock(&s_host.lock);
+}
+
+/* Queues a filled frame for the workers. */
+static void _submit(instance_s *instance, item_s *item, unsigned long long period_ns)
+{
+    item->arrival_ns = _now_ns();
+    item->deadline_ns = item->arrival_ns
+            + ((s_host.deadline_ns > 0) ? s_host.deadline_ns : period_ns);
+
+    pthread_mutex_lock(&s_host.lock);
+    if (STREAM_PENDING == instance->pending_num) {
+        /* Only when the frame being filtered came back as free meanwhile. */
+        item_s *dropped = _drop_oldest_locked(instance);
+        instance->free[instance->free_num++] = dropped;
+        instance->stats.dropped++;
+    }
+    instance->pending[instance->pending_num++] = item;
+    instance->stats.arrived++;
+    pthread_cond_signal(&s_host.work);
+    pthread_mutex_unlock(&s_host.lock);
+}
+
+/* Sleeps until the next frame time, restarting the clock when far behind. */
+static void _pace(unsigned long long *next_ns, unsigned long long period_ns)
+{
+    unsigned long long now = _now_ns();
+
+    *next_ns += period_ns;
+    if (*next_ns + period_ns < now) {
+        *next_ns = now;
+        return;
+    }
+
+    struct timespec ts = {
+        .tv_sec = *next_ns / 1000000000ULL,
+        .tv_nsec = *next_ns % 1000000000ULL,
+    };
+    while (EINTR == clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL))
+        ;
+}
+
+static int _file_source(instance_s *instance)
+{
+    const source_s *source = instance->source;
+    video_format_s format = source->format;
+    unsigned long long period_ns = 1000000000ULL * format.fps_den / format.fps_num;
+    unsigned long long next_ns = _now_ns();
+    void *input = NULL;
+    unsigned long frames = 0;
+    int next = 0;
+    int index = 0;
+
+    int error = source->demuxer->open(&input, source->name, &format);
+    while (0 == error) {
+        item_s *item = _acquire(instance);
+        if (NULL == item)
+            break;
+
+        error = _item_reserve(item, format.width, format.height);
+        if (0 == error)
+            error = source->demuxer->read(input, &item->frame);
+        if (-ENODATA == error && s_host.duration > 0 && index > 0) {
+            source->demuxer->close(input);
+            input = NULL;
+            next = index = 0;
+            error = source->demuxer->open(&input, source->name, &format);
+            if (0 == error)
+                error = source->demuxer->read(input, &item->frame);
+        }
+        if (0 != error) {
+            _release(instance, item);
+            break;
+        }
+
+        item->frame.timestamp_us = frames++ * period_ns / 1000;
+        item->face_num = video_track_detection(&source->track, &next, index,
+                item->faces, instance->filter_num * MAXIMUM_FACE_NUMBER);
+        item->detection = item->face_num >= 0;
+        index++;
+        _submit(instance, item, period_ns);
+        if (s_host.paced)
+            _pace(&next_ns, period_ns);
+    }
+    if (NULL != input)
+        source->demuxer->close(input);
+
+    return (-ENODATA == error) ? 0 : error;
+}
+
+static int _shm_source(instance_s *instance)
+{
+    const char *name = instance->source->name + strlen(SHM_PREFIX);
+    unsigned long long period_ns = SHM_DEADLINE_MS * 1000000ULL;
+    unsigned long long idle_ns = _now_ns();
+    unsigned int generation = 0;
+    bool first = true;
+    shmring_h reader = NULL;
+    int error;
+
+    /* The camera may not have created the ring yet. */
+    while ((-ENOENT == (error = shmring_open(name, &reader)) || -EAGAIN == error)
+            && !_stopped() && (s_host.duration > 0
+                || _now_ns() - idle_ns < SHM_IDLE_MS * 1000000ULL))
+        usleep(10000);
+    if (-EAGAIN == error)
+        error = -ENOENT;
+
+    while (0 == error) {
+        shmring_frame_s f;
+
+        error = shmring_next(reader, SHM_WAIT_MS, &f);
+        if (-ETIMEDOUT == error || -EAGAIN == error) {
+            error = 0;
+            if (_stopped() || (0 == s_host.duration
+                    && _now_ns() - idle_ns > SHM_IDLE_MS * 1000000ULL))
+                break;
+            continue;
+        }
+        if (0 != error)
+            break;
+        idle_ns = _now_ns();
+
+        item_s *item = _acquire(instance);
+        if (NULL == item)
+            break;
+
+        error = _item_reserve(item, f.frame.width, f.frame.height);
+        if (0 == error && (f.frame.y_size != item->frame.y_size
+                || f.frame.uv_size != item->frame.uv_size))
+            error = -EINVAL;
+        if (0 != error) {
+            _release(instance, item);
+            break;
+        }
+        memcpy(item->frame.y, f.frame.y, f.frame.y_size);
+        memcpy(item->frame.uv, f.frame.uv, f.frame.uv_size);
+        item->frame.timestamp_us = f.frame.timestamp_us;
+        item->detection = first || f.generation != generation;
+        if (item->detection) {
+            int capacity = instance->filter_num * MAXIMUM_FACE_NUMBER;
+
+            item->face_num = (f.face_num < capacity) ? f.face_num : capacity;
+            memcpy(item->faces, f.faces, item->face_num * sizeof(face_s));
+        }
+
+        /* Whatever was copied from a stale frame is not to be trusted. */
+        if (0 != shmring_release(reader, &f)) {
+            _release(instance, item);
+            continue;
+        }
+        first = false;
+        generation = f.generation;
+        _submit(instance, item, period_ns);
+    }
+    if (NULL != reader)
+        shmring_close(reader);
+
+    return error;
+}
+
+static void *_source_thread(void *user_data)
+{
+    instance_s *instance = (instance_s *) user_data;
+
+    int error = instance->source->shm ? _shm_source(instance) : _file_source(instance);
+    if (0 != error)
+        fprintf(stderr, "stream %d, %s: %s\n", instance->index,
+                instance->source->name, hal_error_message(error));
+
+    pthread_mutex_lock(&s_host.lock);
+    instance->error = error;
+    instance->finished = true;
+    s_host.finished_num++;
+    pthread_cond_broadcast(&s_host.work);
+    pthread_mutex_unlock(&s_host.lock);
+
+    return NULL;
+}
+
+/**
+ * @brief Picks the stream to serve next, the lock held.
+ * @details The earliest deadline first among the streams no worker is
+ *          filtering, the least recently served one on a tie. The frames of
+ *          the picked stream that are past their deadline while a newer one
+ *          waits are skipped, unless the sources are unpaced.
+ *
+ * @return The stream, @c NULL if no frame can be taken
+ */
+static instance_s *_pick_locked(unsigned long long now)
+{
+    instance_s *best = NULL;
+
+    for (int i = 0; i < s_host.instance_num; i++) {
+        instance_s *instance = &s_host.instances[i];
+
+        if (instance->busy || 0 == instance->pending_num)
+            continue;
+        if (NULL == best || instance->pending[0]->deadline_ns < best->pending[0]->deadline_ns
+                || (instance->pending[0]->deadline_ns == best->pending[0]->deadline_ns
+                    && instance->served_ns < best->served_ns))
+            best = instance;
+    }
+
+    if (NULL != best && s_host.paced)
+        while (best->pending_num > 1 && best->pending[0]->deadline_ns < now) {
+            best->free[best->free_num++] = _drop_oldest_locked(best);
+            best->stats.skipped++;
+        }
+
+    return best;
+}
+
+static void _filter(instance_s *instance, item_s *item)
+{
+    bool resized = item->frame.width != instance->width
+            || item->frame.height != instance->height;
+
+    instance->width = item->frame.width;
+    instance->height = item->frame.height;
+    for (int i = 0; i < instance->filter_num; i++) {
+        facefilter_s *filter = &instance->filters[i];
+
+        if (resized)
+            facefilter_set_geometry(filter, instance->width, instance->height);
+        if (item->detection) {
+            int share = item->face_num - i * MAXIMUM_FACE_NUMBER;
+
+            share = (share < 0) ? 0 : share;
+            share = (share > MAXIMUM_FACE_NUMBER) ? MAXIMUM_FACE_NUMBER : share;
+            facefilter_faces_detected(filter, item->faces + i * MAXIMUM_FACE_NUMBER,
+                    share);
+        }
+        facefilter_preview(filter, &item->frame);
+    }
+}
+
+static void *_worker_thread(void *user_data)
+{
+    pthread_mutex_lock(&s_host.lock);
+    for (;;) {
+        unsigned long long now = _now_ns();
+        instance_s *instance = _pick_locked(now);
+
+        if (NULL == instance) {
+            if (s_host.finished_num == s_host.instance_num)
+                break;
+            pthread_cond_wait(&s_host.work, &s_host.lock);
+            continue;
+        }
+
+        item_s *item = _take_oldest_locked(instance);
+        instance->busy = true;
+        instance->served_ns = now;
+        pthread_mutex_unlock(&s_host.lock);
+
+        _filter(instance, item);
+        unsigned long long done = _now_ns();
+
+        pthread_mutex_lock(&s_host.lock);
+        instance_stats_s *stats = &instance->stats;
+        unsigned long long latency = done - item->arrival_ns;
+        stats->filtered++;
+        stats->latency_ns += latency;
+        if (latency > stats->latency_max_ns)
+            stats->latency_max_ns = latency;
+        if (done > item->deadline_ns)
+            stats->late++;
+        stats->busy_ns += done - now;
+        instance->free[instance->free_num++] = item;
+        instance->busy = false;
+        /* Another worker may wait for this stream, a source for the frame. */
+        pthread_cond_signal(&s_host.work);
+        pthread_cond_broadcast(&s_host.space);
+    }
+    pthread_cond_broadcast(&s_host.work);
+    pthread_mutex_unlock(&s_host.lock);
+
+    return NULL;
+}
+
+static void _instance_deinit(instance_s *instance)
+{
+    if (instance->filter_started > 0)
+        facefilter_set_stream(&instance->filters[instance->filter_num - 1], NULL);
+    if (NULL != instance->output)
+        stream_destroy(instance->output);
+    for (int i = 0; i < instance->filter_started; i++)
+        facefilter_deinit(&instance->filters[i]);
+    free(instance->filters);
+    for (int i = 0; i < STREAM_FRAMES; i++) {
+        free(instance->items[i].frame.y);
+        free(instance->items[i].faces);
+    }
+}
+
+static int _instance_init(instance_s *instance, int index)
+{
+    instance->index = index;
+    instance->source = &s_host.sources[index % s_host.source_num];
+    for (int i = 0; i < STREAM_FRAMES; i++)
+        instance->free[instance->free_num++] = &instance->items[i];
+
+    int max_faces = instance->source->max_faces;
+    instance->filter_num = (max_faces > 0)
+            ? (max_faces + MAXIMUM_FACE_NUMBER - 1) / MAXIMUM_FACE_NUMBER : 1;
+    instance->filters = (facefilter_s *) calloc(instance->filter_num,
+            sizeof(facefilter_s));
+    int error = (NULL == instance->filters) ? -ENOMEM : 0;
+    for (int i = 0; 0 == error && i < STREAM_FRAMES; i++) {
+        instance->items[i].faces = (face_s *) calloc(
+                instance->filter_num * MAXIMUM_FACE_NUMBER, sizeof(face_s));
+        if (NULL == instance->items[i].faces)
+            error = -ENOMEM;
+    }
+
+    for (; 0 == error && instance->filter_started < instance->filter_num;
+            instance->filter_started++) {
+        facefilter_s *filter = &instance->filters[instance->filter_started];
+
+        error = facefilter_init(filter);
+        if (0 != error)
+            break;
+        facefilter_set_motion(filter, s_host.motion);
+        facefilter_set_running(filter, true);
+    }
+
+    if (0 == error && NULL != s_host.output_uri) {
+        char uri[4096];
+        if (snprintf(uri, sizeof(uri), s_host.output_uri, index) >= (int) sizeof(uri))
+            error = -ENAMETOOLONG;
+        if (0 == error)
+            error = stream_create_from_uri(uri, STREAM_PENDING, STREAM_DROP_OLDEST,
+                    &instance->output);
+        if (0 != error)
+            fprintf(stderr, "stream %d: %s\n", index, hal_error_message(error));
+        else
+            facefilter_set_stream(&instance->filters[instance->filter_num - 1],
+                    instance->output);
+    }
+
+    if (0 != error)
+        _instance_deinit(instance);
+
+    return error;
+}
+
+static void _add_stats(instance_stats_s *total, const instance_stats_s *stats)
+{
+    total->arrived += stats->arrived;
+    total->filtered += stats->filtered;
+    total->dropped += stats->dropped;
+    total->skipped += stats->skipped;
+    total->late += stats->late;
+    total->latency_ns += stats->latency_ns;
+    if (stats->latency_max_ns > total->latency_max_ns)
+        total->latency_max_ns = stats->latency_max_ns;
+    total->busy_ns += stats->busy_ns;
+}
+
+static void _print_stats(const char *name, const instance_stats_s *stats,
+                         double seconds)
+{
+    unsigned long lost = stats->dropped + stats->skipped;
+
+    printf("%-8s %7lu %7.1f %6.1f%% %6.1f%% %8.2f %8.2f\n", name, stats->filtered,
+            (seconds > 0) ? stats->filtered / seconds : 0.0,
+            (stats->arrived > 0) ? 100.0 * lost / stats->arrived : 0.0,
+            (stats->filtered > 0) ? 100.0 * stats->late / stats->filtered : 0.0,
+            (stats->filtered > 0) ? stats->latency_ns / 1e6 / stats->filtered : 0.0,
+            stats->latency_max_ns / 1e6);
+}
+
+/**
+ * @brief Runs a number of streams until their sources end or the duration
+ *        has passed.
+ *
+ * @return 0 on success, otherwise the negative errno value of the first
+ *         stream that failed
+ */
+static int _run(int streams, bool verbose, round_s *round)
+{
+    pthread_t workers[s_host.worker_num];
+    int started = 0;
+    int error = 0;
+
+    s_host.instances = (instance_s *) calloc(streams, sizeof(instance_s));
+    if (NULL == s_host.instances)
+        return -ENOMEM;
+    s_host.stop = false;
+    s_host.finished_num = 0;
+
+    for (s_host.instance_num = 0; s_host.instance_num < streams; s_host.instance_num++) {
+        error = _instance_init(&s_host.instances[s_host.instance_num], s_host.instance_num);
+        if (0 != error)
+            break;
+    }
+
+    unsigned long long start = _now_ns();
+    for (int i = 0; 0 == error && i < s_host.worker_num; i++, started++)
+        if (0 != pthread_create(&workers[i], NULL, _worker_thread, NULL))
+            error = -EAGAIN;
+    for (int i = 0; i < s_host.instance_num; i++) {
+        instance_s *instance = &s_host.instances[i];
+
+        if (0 != error || 0 != pthread_create(&instance->thread, NULL, _source_thread,
+                instance)) {
+            /* Counted as ended so the workers do not wait for it. */
+            if (0 == error)
+                error = -EAGAIN;
+            pthread_mutex_lock(&s_host.lock);
+            instance->finished = true;
+            s_host.finished_num++;
+            pthread_cond_broadcast(&s_host.work);
+            pthread_mutex_unlock(&s_host.lock);
+        } else {
+            instance->thread_started = true;
+        }
+    }
+
+    if (0 == error && s_host.duration > 0) {
+        unsigned long long end = start + (unsigned long long) (s_host.duration * 1e9);
+        pthread_mutex_lock(&s_host.lock);
+        while (s_host.finished_num < s_host.instance_num && _now_ns() < end) {
+            pthread_mutex_unlock(&s_host.lock);
+            usleep(10000);
+            pthread_mutex_lock(&s_host.lock);
+        }
+        pthread_mutex_unlock(&s_host.lock);
+    }
+    if (0 != error || s_host.duration > 0) {
+        pthread_mutex_lock(&s_host.lock);
+        __atomic_store_n(&s_host.stop, true, __ATOMIC_RELAXED);
+        pthread_cond_broadcast(&s_host.space);
+        pthread_mutex_unlock(&s_host.lock);
+    }
+
+    for (int i = 0; i < s_host.instance_num; i++)
+        if (s_host.instances[i].thread_started)
+            pthread_join(s_host.instances[i].thread, NULL);
+    for (int i = 0; i < started; i++)
+        pthread_join(workers[i], NULL);
+    double seconds = (_now_ns() - start) / 1e9;
+
+    round->streams = s_host.instance_num;
+    round->seconds = seconds;
+    memset(&round->total, 0, sizeof(round->total));
+    for (int i = 0; i < s_host.instance_num; i++) {
+        instance_s *instance = &s_host.instances[i];
+
+        if (verbose) {
+            char name[16];
+            snprintf(name, sizeof(name), "%d", i);
+            _print_stats(name, &instance->stats, seconds);
+        }
+        _add_stats(&round->total, &instance->stats);
+        if (0 == error)
+            error = instance->error;
+        _instance_deinit(instance);
+    }
+    free(s_host.instances);
+    s_host.instances = NULL;
+
+    return error;
+}
+
+static void _print_header(void)
+{
+    printf("stream    frames     fps    lost    late   avg ms   max ms\n");
+}
+
+static void _print_round(const round_s *round, const char *name)
+{
+    double capacity = s_host.worker_num * round->seconds;
+
+    _print_stats(name, &round->total, round->seconds);
+    printf("%d stream(s) on %d worker(s) in %.2f s, workers %.1f%% busy\n",
+            round->streams, s_host.worker_num, round->seconds,
+            (capacity > 0) ? 100.0 * round->total.busy_ns / 1e9 / capacity : 0.0);
+}
+
+static int _source_init(source_s *source, const char *name)
+{
+    source->name = name;
+    if (0 == strncmp(name, SHM_PREFIX, strlen(SHM_PREFIX))) {
+        source->shm = true;
+        source->max_faces = SHMRING_MAX_FACES;
+        return 0;
+    }
+
+    source->demuxer = video_demuxer_for_path(name);
+    if (NULL == source->demuxer)
+        return -ENOTSUP;
+
+    /* The format is checked once, every stream opens the file on its own. */
+    void *input = NULL;
+    int error = source->demuxer->open(&input, name, &source->format);
+    if (0 != error)
+        return error;
+    source->demuxer->close(input);
+
+    char track[4096];
+    if (snprintf(track, sizeof(track), "%s%s", name, FACES_SUFFIX) >= (int) sizeof(track))
+        return -ENAMETOOLONG;
+
+    error = video_track_read(track, &source->track);
+    if (0 == error)
+        source->max_faces = video_track_max_faces(&source->track);
+
+    return error;
+}
+
+/* Whether the output URI has one %d and no other conversion. */
+static bool _check_output_uri(const char *uri)
+{
+    const char *conversion = strchr(uri, '%');
+
+    return NULL != conversion && 'd' == conversion[1]
+            && NULL == strchr(conversion + 2, '%');
+}
+
+static void _usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [-n streams] [-w workers] [-t seconds] "
+            "[-d deadline_ms] [-o uri] [-s WxH] [-r fps] [-S] [-U] [-M] "
+            "source...\n", name);
+}
+
+int main(int argc, char *argv[])
+{
+    video_format_s raw_format = { 0, 0, 30, 1 };
+    int streams = 0;
+    bool scale = false;
+    int opt;
+
+    s_host.worker_num = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    while ((opt = getopt(argc, argv, "n:w:t:d:o:s:r:SUMh")) != -1) {
+        switch (opt) {
+        case 'n':
+            streams = atoi(optarg);
+            break;
+        case 'w':
+            s_host.worker_num = atoi(optarg);
+            break;
+        case 't':
+            s_host.duration = atof(optarg);
+            break;
+        case 'd':
+            s_host.deadline_ns = (unsigned long long) (atof(optarg) * 1e6);
+            break;
+        case 'o':
+            s_host.output_uri = optarg;
+            break;
+        case 's':
+            if (2 != sscanf(optarg, "%dx%d", &raw_format.width, &raw_format.height)) {
+                _usage(argv[0]);
+                return 2;
+            }
+            break;
+        case 'r':
+            raw_format.fps_num = atoi(optarg);
+            break;
+        case 'S':
+            scale = true;
+            break;
+        case 'U':
+            s_host.paced = false;
+            break;
+        case 'M':
+            s_host.motion = false;
+            break;
+        default:
+            _usage(argv[0]);
+            return 2;
+        }
+    }
+
+    s_host.source_num = argc - optind;
+    if (0 == streams)
+        streams = s_host.source_num;
+    if (s_host.source_num < 1 || s_host.source_num > STREAM_MAX || streams < 1
+            || streams > STREAM_MAX || s_host.worker_num < 1 || s_host.duration < 0
+            || (NULL != s_host.output_uri && !_check_output_uri(s_host.output_uri))) {
+        _usage(argv[0]);
+        return 2;
+    }
+
+    int error = 0;
+    for (int i = 0; 0 == error && i < s_host.source_num; i++) {
+        source_s *source = &s_host.sources[i];
+
+        source->format = raw_format;
+        error = _source_init(source, argv[optind + i]);
+        if (0 != error)
+            fprintf(stderr, "%s: %s\n", source->name, hal_error_message(error));
+    }
+
+    hal_set_log_priority(HAL_LOG_WARN);
+    pthread_mutex_init(&s_host.lock, NULL);
+    pthread_cond_init(&s_host.work, NULL);
+    pthread_cond_init(&s_host.space, NULL);
+
+    /* The scaling rounds double the streams up to the number asked for. */
+    round_s round;
+    if (0 == error)
+        _print_header();
+    for (int count = scale ? 1 : streams; 0 == error && count <= streams;
+            count = (count < streams && 2 * count > streams) ? streams : 2 * count) {
+        char name[16];
+
+        error = _run(count, !scale, &round);
+        snprintf(name, sizeof(name), scale ? "all/%d" : "all", count);
+        _print_round(&round, name);
+    }
+
+    pthread_cond_destroy(&s_host.space);
+    pthread_cond_destroy(&s_host.work);
+    pthread_mutex_destroy(&s_host.lock);
+    for (int i = 0; i < s_host.source_num; i++)
+        video_track_free(&s_host.sources[i].track);
+
+    return (0 == error) ? 0 : 1;
+}
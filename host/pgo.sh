@@ -0,0 +1,90 @@
+#!/bin/sh
+#
+# Profile guided optimization of the camera pipeline core.
+#
+# usage: host/pgo.sh [build-dir] [session.ffs ...]
+#
+# 1. builds a reference without profiles,
+# 2. builds an instrumented core and trains it by replaying the given
+#    sessions at maximum speed (the synthetic camera when none is given),
+#    never with the benchmark that measures the result,
+# 3. rebuilds the same tree with the collected profiles, runs the preview
+#    benchmark of both builds alternately ROUNDS times (default 7) and
+#    reports the median speedup with its range over the rounds.
+#
+# The instrumented and the optimized builds share one build directory, as
+# GCC locates the profiles by the object file paths.
+
+set -e
+
+SRC_DIR=$(cd "$(dirname "$0")/.." && pwd)
+BUILD_DIR=${1:-"$SRC_DIR/build-pgo"}
+[ $# -gt 0 ] && shift
+PGO_DIR="$BUILD_DIR/pgo/profiles"
+JOBS=$(nproc 2>/dev/null || echo 2)
+ROUNDS=${ROUNDS:-7}
+CC_ID=$(${CC:-cc} --version 2>/dev/null | head -n 1)
+
+configure() {
+    cmake -S "$SRC_DIR" -B "$1" -DCMAKE_BUILD_TYPE=Release \
+        -DFACECAMERA_O3=ON -DFACECAMERA_PGO="$2" \
+        -DFACECAMERA_PGO_DIR="$PGO_DIR" > /dev/null
+    cmake --build "$1" -j "$JOBS" > /dev/null
+}
+
+bench() {
+    "$1/bench_preview" -i 5000 -r 3 | sed -n 's/^median: \([0-9]*\) ns.*/\1/p'
+}
+
+echo "== reference build"
+configure "$BUILD_DIR/reference" ""
+
+echo "== instrumented build"
+rm -rf "$PGO_DIR"
+mkdir -p "$PGO_DIR"
+configure "$BUILD_DIR/pgo" GENERATE
+
+if [ $# -eq 0 ]; then
+    echo "   training with the synthetic camera"
+    "$BUILD_DIR/pgo/facecamera_replay" -t 2 > /dev/null
+else
+    for session in "$@"; do
+        echo "   training with $session"
+        "$BUILD_DIR/pgo/facecamera_replay" -m "$session" > /dev/null
+    done
+fi
+
+case "$CC_ID" in
+*clang*)
+    llvm-profdata merge -o "$PGO_DIR/merged.profdata" "$PGO_DIR"/*.profraw
+    ;;
+esac
+
+echo "== optimized build"
+configure "$BUILD_DIR/pgo" USE
+
+# Alternated, so that a drift of the clock or the load hits both builds.
+echo "== preview benchmark, $ROUNDS rounds"
+round=0
+RATIOS=""
+while [ "$round" -lt "$ROUNDS" ]; do
+    REFERENCE=$(bench "$BUILD_DIR/reference")
+    OPTIMIZED=$(bench "$BUILD_DIR/pgo")
+    echo "   reference $REFERENCE ns/frame, PGO $OPTIMIZED ns/frame"
+    RATIOS="$RATIOS $(awk -v r="$REFERENCE" -v o="$OPTIMIZED" \
+        'BEGIN { if (o > 0) printf "%.4f", r / o }')"
+    round=$((round + 1))
+done
+
+echo $RATIOS | tr ' ' '\n' | sort -n | awk '
+    { ratio[NR] = $1 }
+    END {
+        if (NR == 0)
+            exit 1
+        if (NR % 2)
+            median = ratio[(NR + 1) / 2]
+        else
+            median = (ratio[NR / 2] + ratio[NR / 2 + 1]) / 2
+        printf "speedup: %.2fx median, %.2fx to %.2fx over %d rounds\n",
+            median, ratio[1], ratio[NR], NR
+    }'
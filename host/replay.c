@@ -0,0 +1,350 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Flora License, Version 1.1 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://floralicense.org/license/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Replays a recorded camera session through the same pipeline the
+ * application wires up in data.c, using the Linux HAL backend.
+ *
+ * usage: facecamera_replay [-m] [-c] [-t seconds] [-f config] [-s uri]
+ *                          [-x name] [-r] [-p profile] [-T trace.json]
+ *                          [-l file.blog] [-M metrics] [session.ffs]
+ *
+ *   -m  replay at maximum speed instead of the recorded pace
+ *   -c  take a photo through the capture path after the replay
+ *   -t  without a session, run the synthetic camera for the given time
+ *   -f  apply a configuration file like the application does at startup;
+ *       the options below take precedence over its output settings
+ *   -s  stream the filtered frames to file:<path> or unix:<path>
+ *   -x  export the frames to the shared memory ring of the given name
+ *   -r  export the frames before the faces are masked
+ *   -p  switch to a pipeline profile (normal, low-memory, low-battery) at
+ *       the start, the synthetic camera takes the resolution it allows
+ *   -T  trace the pipeline stages into a Chrome trace event file
+ *   -l  defer the log into a binary file for facecamera_log_decode; the
+ *       log.mode setting of the configuration file applies otherwise
+ *   -M  write the pipeline metrics into a file at the end, in the
+ *       metrics.format of the configuration file
+ */
+
+#include "hal_linux.h"
+#include "facefilter.h"
+#include "config.h"
+#include "profile.h"
+#include "trace.h"
+#include "binlog.h"
+#include "metrics.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+
+static struct {
+    facefilter_s filter;
+    unsigned long frames;
+    unsigned long face_events;
+    unsigned long long filter_ns;
+    unsigned long long filter_max_ns;
+    char *camera_directory;
+    config_s config;
+    unsigned long long capture_start_ns;
+} s_replay;
+
+static unsigned long long _now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void _preview_cb(frame_s *frame, void *user_data)
+{
+    unsigned long long start = _now_ns();
+    facefilter_preview(&s_replay.filter, frame);
+    unsigned long long elapsed = _now_ns() - start;
+
+    s_replay.frames++;
+    s_replay.filter_ns += elapsed;
+    if (elapsed > s_replay.filter_max_ns)
+        s_replay.filter_max_ns = elapsed;
+}
+
+static void _face_detected_cb(face_s *faces, int count, void *user_data)
+{
+    s_replay.face_events++;
+    facefilter_faces_detected(&s_replay.filter, faces, count);
+}
+
+static void _capturing_cb(const unsigned char *data, unsigned int size,
+                          void *user_data)
+{
+    char path[s_replay.config.path_length];
+
+    int error = facefilter_write_image(s_replay.camera_directory, data, size,
+            path, sizeof(path));
+    if (0 != error) {
+        hal_log(HAL_LOG_ERROR, "facefilter_write_image() failed! Error: %s",
+                hal_error_message(error));
+        return;
+    }
+
+    metrics_observe(METRIC_CAPTURE_LATENCY, _now_ns() - s_replay.capture_start_ns);
+    printf("image stored in %s\n", path);
+}
+
+/* Keeps the largest resolution within the width in user_data[2]. */
+static bool _resolution_cb(int width, int height, void *user_data)
+{
+    int *resolution = (int *) user_data;
+
+    if (width <= resolution[2]) {
+        resolution[0] = width;
+        resolution[1] = height;
+    }
+
+    return true;
+}
+
+static void _usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [-m] [-c] [-t seconds] [-f config] [-s uri] "
+            "[-x name] [-r] [-p profile] [-T trace.json] [-l file.blog] "
+            "[-M metrics] [session.ffs]\n", name);
+}
+
+int main(int argc, char *argv[])
+{
+    session_replay_speed_e speed = SESSION_REPLAY_REALTIME;
+    bool capture = false;
+    int seconds = 3;
+    const char *stream_uri = NULL;
+    stream_h stream = NULL;
+    const char *export_name = NULL;
+    bool export_raw = false;
+    shmring_h ring = NULL;
+    const char *config_path = NULL;
+    const profile_s *profile = NULL;
+    const char *trace_path = NULL;
+    const char *log_path = NULL;
+    const char *metrics_path = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "mct:f:s:x:rp:T:l:M:h")) != -1) {
+        switch (opt) {
+        case 'm':
+            speed = SESSION_REPLAY_MAX_SPEED;
+            break;
+        case 'c':
+            capture = true;
+            break;
+        case 't':
+            seconds = atoi(optarg);
+            break;
+        case 'f':
+            config_path = optarg;
+            break;
+        case 's':
+            stream_uri = optarg;
+            break;
+        case 'x':
+            export_name = optarg;
+            break;
+        case 'r':
+            export_raw = true;
+            break;
+        case 'p':
+            profile = profile_find(optarg);
+            if (NULL == profile) {
+                fprintf(stderr, "unknown profile %s\n", optarg);
+                return 2;
+            }
+            break;
+        case 'T':
+            trace_path = optarg;
+            break;
+        case 'l':
+            log_path = optarg;
+            break;
+        case 'M':
+            metrics_path = optarg;
+            break;
+        default:
+            _usage(argv[0]);
+            return 2;
+        }
+    }
+
+    config_s *config = &s_replay.config;
+    config_default(config);
+    if (NULL != config_path) {
+        int error = config_load(config_path, config);
+        if (0 != error) {
+            fprintf(stderr, "config_load() failed: %s\n", hal_error_message(error));
+            return 1;
+        }
+        hal_set_log_priority(config->log_level);
+        if (NULL == stream_uri && '\0' != config->stream_uri[0])
+            stream_uri = config->stream_uri;
+        if (NULL == metrics_path && '\0' != config->metrics_file[0])
+            metrics_path = config->metrics_file;
+        if (NULL == export_name && '\0' != config->export_name[0]) {
+            export_name = config->export_name;
+            export_raw = export_raw || config->export_raw;
+        }
+    }
+
+    if (NULL == log_path && CONFIG_LOG_BINARY == config->log_mode)
+        log_path = BINLOG_FILE_NAME;
+    if (NULL != log_path || CONFIG_LOG_DEFERRED == config->log_mode) {
+        int error = binlog_start(log_path);
+        if (0 != error) {
+            fprintf(stderr, "binlog_start() failed: %s\n", hal_error_message(error));
+            return 1;
+        }
+    }
+
+    const char *session = (optind < argc) ? argv[optind] : NULL;
+    hal_linux_set_session(session, speed);
+
+    if (0 != facefilter_init(&s_replay.filter))
+        return 1;
+    facefilter_set_max_faces(&s_replay.filter, config->max_faces);
+    facefilter_set_motion(&s_replay.filter, config->motion);
+    facefilter_set_zones(&s_replay.filter, config->zones, config->zone_num);
+    facefilter_set_running(&s_replay.filter, true);
+
+    if (NULL != stream_uri) {
+        int error = stream_create_from_uri(stream_uri, config->stream_queue_length,
+                STREAM_DROP_OLDEST, &stream);
+        if (0 != error) {
+            fprintf(stderr, "stream_create_from_uri() failed: %s\n",
+                    hal_error_message(error));
+            return 1;
+        }
+        facefilter_set_stream(&s_replay.filter, stream);
+    }
+
+    if (NULL != export_name) {
+        int error = shmring_create(export_name, config->export_slots,
+                config->export_slot_size, &ring);
+        if (0 != error) {
+            fprintf(stderr, "shmring_create() failed: %s\n",
+                    hal_error_message(error));
+            return 1;
+        }
+        facefilter_set_export(&s_replay.filter, ring, export_raw);
+    }
+
+    hal_camera_h camera = NULL;
+    int error = hal_camera_create(config->camera_device, &camera);
+    if (HAL_ERROR_NONE != error) {
+        fprintf(stderr, "hal_camera_create() failed: %s\n", hal_error_message(error));
+        return 1;
+    }
+
+    if (NULL != profile) {
+        int resolution[3] = { 0, 0, profile_get_max_width(profile, config) };
+
+        profile_apply(profile, config, &s_replay.filter, stream);
+        hal_camera_foreach_supported_preview_resolution(camera, _resolution_cb,
+                resolution);
+        if (resolution[0] > 0)
+            hal_camera_set_preview_resolution(camera, resolution[0], resolution[1]);
+    }
+
+    hal_storage_get_camera_directory(&s_replay.camera_directory);
+    hal_camera_set_preview_cb(camera, _preview_cb, NULL);
+    hal_camera_start_face_detection(camera, _face_detected_cb, NULL);
+
+    if (NULL != trace_path) {
+        trace_set_thread_name("replay");
+        trace_start();
+    }
+
+    metrics_reset();
+    unsigned long long start = _now_ns();
+
+    error = hal_camera_start_preview(camera);
+    if (HAL_ERROR_NONE != error) {
+        fprintf(stderr, "hal_camera_start_preview() failed: %s\n",
+                hal_error_message(error));
+        return 1;
+    }
+
+    if (NULL != session) {
+        hal_linux_wait_preview_end(camera);
+    } else {
+        sleep(seconds);
+        hal_camera_stop_preview(camera);
+    }
+
+    unsigned long long wall_ns = _now_ns() - start;
+
+    if (capture) {
+        s_replay.capture_start_ns = _now_ns();
+        hal_camera_start_capture(camera, _capturing_cb, NULL, NULL);
+    }
+
+    hal_camera_destroy(camera);
+
+    stream_stats_s stream_stats = { 0, };
+    if (NULL != stream) {
+        facefilter_set_stream(&s_replay.filter, NULL);
+        stream_get_stats(stream, &stream_stats);
+        stream_destroy(stream);
+    }
+
+    if (NULL != ring) {
+        facefilter_set_export(&s_replay.filter, NULL, false);
+        shmring_destroy(ring);
+    }
+
+    facefilter_deinit(&s_replay.filter);
+    free(s_replay.camera_directory);
+
+    /* The camera and stream threads are done, their events are kept. */
+    if (NULL != trace_path) {
+        trace_stop();
+        error = trace_write(trace_path);
+        if (0 != error)
+            fprintf(stderr, "trace_write() failed: %s\n", hal_error_message(error));
+        trace_release();
+    }
+
+    if (NULL != metrics_path) {
+        error = metrics_write(metrics_path, config->metrics_format);
+        if (0 != error)
+            fprintf(stderr, "metrics_write() failed: %s\n", hal_error_message(error));
+    }
+
+    binlog_stop();
+
+    double wall_s = wall_ns / 1e9;
+    printf("frames:        %lu\n", s_replay.frames);
+    printf("face events:   %lu\n", s_replay.face_events);
+    printf("wall time:     %.3f s (%.1f fps)\n", wall_s,
+            (wall_s > 0) ? s_replay.frames / wall_s : 0.0);
+    printf("filter mean:   %.0f ns/frame\n",
+            s_replay.frames ? (double) s_replay.filter_ns / s_replay.frames : 0.0);
+    printf("filter max:    %llu ns\n", s_replay.filter_max_ns);
+    if (NULL != stream_uri)
+        printf("stream:        %lu sent, %lu dropped, %lu unfiltered, %lu errors\n",
+                stream_stats.sent, stream_stats.dropped, stream_stats.unfiltered,
+                stream_stats.errors);
+
+    return 0;
+}
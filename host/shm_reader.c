@@ -0,0 +1,169 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Flora License, Version 1.1 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://floralicense.org/license/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Reads the frames exported through a shared memory ring, the way an
+ * external analytics process would, and checks that the faces of the
+ * filtered frames are masked.
+ *
+ * usage: facecamera_shm_reader [-n frames] [-t timeout_ms] [-d delay_us] [-v]
+ *                              name
+ *
+ *   -n  stop after the given number of frames
+ *   -t  give up when no frame arrives within the timeout (default 2000)
+ *   -d  simulate processing time per frame
+ *   -v  print every frame
+ */
+
+#include "shmring.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static unsigned long long _now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* A face is leaked if the centre of its box inside the frame is not black. */
+static int _count_leaks(const shmring_frame_s *f)
+{
+    const frame_s *frame = &f->frame;
+    int leaks = 0;
+
+    for (int i = 0; i < f->face_num; i++) {
+        const face_s *face = &f->faces[i];
+        long long cx = (long long) face->x + face->width / 2;
+        long long cy = (long long) face->y + face->height / 2;
+
+        if (face->width <= 0 || face->height <= 0 || cx < 0 || cy < 0
+                || cx >= frame->width || cy >= frame->height)
+            continue;
+
+        if (0 != frame->y[cy * frame->width + cx])
+            leaks++;
+    }
+
+    return leaks;
+}
+
+static void _usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [-n frames] [-t timeout_ms] [-d delay_us] [-v] name\n",
+            name);
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned long limit = 0;
+    int timeout_ms = 2000;
+    int delay_us = 0;
+    bool verbose = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:t:d:vh")) != -1) {
+        switch (opt) {
+        case 'n':
+            limit = strtoul(optarg, NULL, 10);
+            break;
+        case 't':
+            timeout_ms = atoi(optarg);
+            break;
+        case 'd':
+            delay_us = atoi(optarg);
+            break;
+        case 'v':
+            verbose = true;
+            break;
+        default:
+            _usage(argv[0]);
+            return 2;
+        }
+    }
+
+    if (optind >= argc) {
+        _usage(argv[0]);
+        return 2;
+    }
+
+    /* The ring may not exist yet if the reader is started first. */
+    shmring_h reader = NULL;
+    unsigned long long deadline = _now_ns() + timeout_ms * 1000000ULL;
+    int error;
+
+    while ((error = shmring_open(argv[optind], &reader)) == -ENOENT
+            || -EAGAIN == error) {
+        if (_now_ns() > deadline)
+            break;
+        usleep(10000);
+    }
+    if (0 != error) {
+        fprintf(stderr, "shmring_open() failed: %s\n", strerror(-error));
+        return 1;
+    }
+
+    unsigned long frames = 0, raw = 0, stale = 0, leaks = 0;
+    unsigned long long first_ns = 0, last_ns = 0;
+    shmring_frame_s f;
+
+    while (0 == limit || frames < limit) {
+        error = shmring_next(reader, timeout_ms, &f);
+        if (0 != error)
+            break;
+
+        unsigned long long now = _now_ns();
+        if (0 == frames)
+            first_ns = now;
+        last_ns = now;
+
+        int leaked = f.raw ? 0 : _count_leaks(&f);
+        if (delay_us > 0)
+            usleep(delay_us);
+
+        /* Whatever was read from a stale frame is not to be trusted. */
+        if (0 != shmring_release(reader, &f)) {
+            stale++;
+            continue;
+        }
+
+        frames++;
+        if (f.raw)
+            raw++;
+        leaks += leaked;
+
+        if (verbose)
+            printf("#%u %dx%d ts %llu us, generation %u, %d face(s)%s%s\n",
+                    f.number, f.frame.width, f.frame.height,
+                    f.frame.timestamp_us, f.generation, f.face_num,
+                    f.raw ? ", raw" : "", leaked ? ", LEAKED" : "");
+    }
+
+    double seconds = (last_ns - first_ns) / 1e9;
+    printf("frames:        %lu (%lu raw)\n", frames, raw);
+    printf("rate:          %.1f fps\n", (seconds > 0) ? (frames - 1) / seconds : 0.0);
+    printf("skipped:       %u\n", shmring_get_skipped(reader));
+    printf("stale:         %lu\n", stale);
+    printf("leaked faces:  %lu\n", leaks);
+
+    shmring_close(reader);
+
+    return (0 == leaks) ? 0 : 1;
+}
@@ -0,0 +1,308 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Flora License, Version 1.1 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://floralicense.org/license/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Stresses the threads of the camera pipeline the way the camera view uses
+ * them: the synthetic camera delivers the preview frames and the faces from
+ * two threads, while other threads toggle the preview and the face
+ * detection through the camera command thread and change the filter
+ * settings, all as fast as the given intervals allow. Meant to run in a
+ * build with FACECAMERA_SANITIZE=thread, which reports the data races.
+ *
+ * usage: facecamera_stress [-t seconds] [-f frame_us] [-d face_us]
+ *                          [-j jitter_us] [-i toggle_us] [-r]
+ *
+ *   -t  duration of the run (5)
+ *   -f  interval of the preview frames, 4166 for 240 fps (4166)
+ *   -d  interval of the face detections (4166)
+ *   -j  random variation of every interval in both directions (1000)
+ *   -i  interval of the toggles of every toggling thread (10000)
+ *   -r  take the frames by reference, as with camera.frame_refs
+ *
+ * The run fails if a command fails unexpectedly, if no frame or face gets
+ * through or if the camera does not end up stopped with the filter idle.
+ */
+
+#include "hal_linux.h"
+#include "camctl.h"
+#include "facefilter.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define RESOLUTION_NUMBER 3
+
+typedef struct _toggler {
+    pthread_t thread;
+    void (*toggle)(unsigned int n);
+    unsigned int seed;
+} toggler_s;
+
+static const int s_resolutions[RESOLUTION_NUMBER][2] = {
+    { 320, 240 },
+    { 640, 480 },
+    { 1280, 720 },
+};
+
+static struct {
+    facefilter_s filter;
+    camctl_h ctl;
+    unsigned int toggle_us;
+    unsigned int jitter_us;
+    bool stop;                   /* Accessed atomically */
+    unsigned long frames;        /* Counters, accessed atomically */
+    unsigned long detections;
+    unsigned long submitted;
+    unsigned long rejected;      /* Queue full */
+    unsigned long completed;
+    unsigned long failed;
+} s_stress;
+
+static void _preview_cb(frame_s *frame, void *user_data)
+{
+    facefilter_preview(&s_stress.filter, frame);
+    __atomic_add_fetch(&s_stress.frames, 1, __ATOMIC_RELAXED);
+}
+
+static void _frame_cb(hal_frame_h frame, void *user_data)
+{
+    _preview_cb(hal_frame_get(frame), user_data);
+    hal_frame_unref(frame);
+}
+
+static void _faces_cb(face_s *faces, int count, void *user_data)
+{
+    facefilter_faces_detected(&s_stress.filter, faces, count);
+    __atomic_add_fetch(&s_stress.detections, 1, __ATOMIC_RELAXED);
+}
+
+static void _state_changed_cb(camctl_state_e state, void *user_data)
+{
+    facefilter_set_running(&s_stress.filter, CAMCTL_STATE_FACE_DETECTION == state);
+}
+
+/*
+ * Starting the face detection without a preview fails by design, as does a
+ * resolution change overtaken by a stop of the preview.
+ */
+static void _completed_cb(camctl_command_e command, int error,
+                          camctl_state_e state, void *user_data)
+{
+    __atomic_add_fetch(&s_stress.completed, 1, __ATOMIC_RELAXED);
+    if (0 != error && -EINVAL != error) {
+        fprintf(stderr, "%s failed: %d\n", camctl_command_name(command), error);
+        __atomic_add_fetch(&s_stress.failed, 1, __ATOMIC_RELAXED);
+    }
+}
+
+static void _submit(camctl_command_e command)
+{
+    int error = camctl_submit(s_stress.ctl, command);
+
+    if (-EBUSY == error)
+        __atomic_add_fetch(&s_stress.rejected, 1, __ATOMIC_RELAXED);
+    else if (0 == error)
+        __atomic_add_fetch(&s_stress.submitted, 1, __ATOMIC_RELAXED);
+}
+
+/* The "Preview" button, now and then a resolution change instead. */
+static void _toggle_preview(unsigned int n)
+{
+    if (5 == n % 16) {
+        const int *resolution = s_resolutions[(n / 16) % RESOLUTION_NUMBER];
+        if (-EBUSY == camctl_set_preview_resolution(s_stress.ctl, resolution[0],
+                resolution[1]))
+            __atomic_add_fetch(&s_stress.rejected, 1, __ATOMIC_RELAXED);
+        else
+            __atomic_add_fetch(&s_stress.submitted, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    _submit((0 == n % 2) ? CAMCTL_START_PREVIEW : CAMCTL_STOP_PREVIEW);
+}
+
+/* The "Face Detect" button. */
+static void _toggle_detection(unsigned int n)
+{
+    _submit((0 == n % 2) ? CAMCTL_START_FACE_DETECTION
+            : CAMCTL_STOP_FACE_DETECTION);
+}
+
+/* The power profiles and the configuration. */
+static void _toggle_settings(unsigned int n)
+{
+    facefilter_s *filter = &s_stress.filter;
+
+    switch (n % 3) {
+    case 0:
+        facefilter_set_motion(filter, 0 == (n / 3) % 2);
+        break;
+    case 1:
+        facefilter_set_detection_interval(filter, 1 + (n / 3) % 3);
+        break;
+    default:
+        facefilter_set_max_faces(filter, 1 + (n / 3) % MAXIMUM_FACE_NUMBER);
+        break;
+    }
+}
+
+static void *_toggler_thread(void *user_data)
+{
+    toggler_s *toggler = (toggler_s *) user_data;
+
+    for (unsigned int n = 0; !__atomic_load_n(&s_stress.stop, __ATOMIC_ACQUIRE); n++) {
+        toggler->toggle(n);
+
+        long long us = s_stress.toggle_us;
+        if (s_stress.jitter_us > 0)
+            us += (long long) (rand_r(&toggler->seed) % (2 * s_stress.jitter_us + 1))
+                    - s_stress.jitter_us;
+        if (us > 0) {
+            struct timespec period = { us / 1000000, (us % 1000000) * 1000 };
+            nanosleep(&period, NULL);
+        }
+    }
+
+    return NULL;
+}
+
+static void _usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [-t seconds] [-f frame_us] [-d face_us] "
+            "[-j jitter_us] [-i toggle_us] [-r]\n", name);
+}
+
+int main(int argc, char *argv[])
+{
+    int seconds = 5;
+    int frame_us = 4166;
+    int face_us = 4166;
+    int jitter_us = 1000;
+    int toggle_us = 10000;
+    bool refs = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "t:f:d:j:i:rh")) != -1) {
+        switch (opt) {
+        case 't':
+            seconds = atoi(optarg);
+            break;
+        case 'f':
+            frame_us = atoi(optarg);
+            break;
+        case 'd':
+            face_us = atoi(optarg);
+            break;
+        case 'j':
+            jitter_us = atoi(optarg);
+            break;
+        case 'i':
+            toggle_us = atoi(optarg);
+            break;
+        case 'r':
+            refs = true;
+            break;
+        default:
+            _usage(argv[0]);
+            return 2;
+        }
+    }
+
+    /* The faces need a thread of their own, face_us 0 would not give one. */
+    if (seconds < 1 || frame_us < 0 || face_us < 1 || jitter_us < 0
+            || toggle_us < 0) {
+        _usage(argv[0]);
+        return 2;
+    }
+
+    hal_set_log_priority(HAL_LOG_WARN);
+    hal_linux_set_frame_interval(frame_us);
+    hal_linux_set_face_interval(face_us);
+    hal_linux_set_jitter(jitter_us);
+    s_stress.toggle_us = toggle_us;
+    s_stress.jitter_us = jitter_us;
+
+    hal_camera_h camera = NULL;
+    if (0 != facefilter_init(&s_stress.filter)
+            || 0 != hal_camera_create(HAL_CAMERA_DEVICE_BACK, &camera)) {
+        fprintf(stderr, "setting up the camera failed\n");
+        return 1;
+    }
+
+    camctl_callbacks_s callbacks = {
+        .preview = _preview_cb,
+        .frame = refs ? _frame_cb : NULL,
+        .faces = _faces_cb,
+        .state_changed = _state_changed_cb,
+        .completed = _completed_cb,
+    };
+    int error = camctl_create(camera, &callbacks, NULL, &s_stress.ctl);
+    if (0 != error) {
+        fprintf(stderr, "camctl_create() failed: %d\n", error);
+        return 1;
+    }
+
+    toggler_s togglers[] = {
+        { .toggle = _toggle_preview, .seed = 1 },
+        { .toggle = _toggle_detection, .seed = 2 },
+        { .toggle = _toggle_settings, .seed = 3 },
+    };
+    int toggler_number = (int) (sizeof(togglers) / sizeof(togglers[0]));
+    int started = 0;
+
+    for (; started < toggler_number; started++)
+        if (0 != pthread_create(&togglers[started].thread, NULL, _toggler_thread,
+                &togglers[started]))
+            break;
+
+    if (started == toggler_number)
+        sleep(seconds);
+    __atomic_store_n(&s_stress.stop, true, __ATOMIC_RELEASE);
+    for (int i = 0; i < started; i++)
+        pthread_join(togglers[i].thread, NULL);
+
+    /* Ends like closing the camera view while the detection runs. */
+    _submit(CAMCTL_START_PREVIEW);
+    _submit(CAMCTL_START_FACE_DETECTION);
+    camctl_sync(s_stress.ctl);
+    _submit(CAMCTL_STOP_PREVIEW);
+    camctl_sync(s_stress.ctl);
+    hal_linux_dispatch_flush();
+
+    bool stopped = CAMCTL_STATE_STOPPED == camctl_get_state(s_stress.ctl)
+            && !facefilter_is_running(&s_stress.filter);
+    unsigned long dropped = hal_linux_get_dropped_frames(camera);
+
+    camctl_destroy(s_stress.ctl);
+    hal_camera_destroy(camera);
+    facefilter_deinit(&s_stress.filter);
+
+    printf("frames:     %lu (%lu dropped by the camera)\n", s_stress.frames,
+            dropped);
+    printf("detections: %lu\n", s_stress.detections);
+    printf("commands:   %lu submitted, %lu completed, %lu rejected, %lu failed\n",
+            s_stress.submitted, s_stress.completed, s_stress.rejected,
+            s_stress.failed);
+
+    bool pass = started == toggler_number && stopped && 0 == s_stress.failed
+            && s_stress.frames > 0 && s_stress.detections > 0;
+    printf("%s\n", pass ? "PASS" : "FAIL");
+
+    return pass ? 0 : 1;
+}
@@ -0,0 +1,398 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Flora License, Version 1.1 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://floralicense.org/license/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Masks the faces of a video file with the filter path of the camera
+ * preview, frame by frame as the preview callback does.
+ *
+ * usage: facecamera_video [-f faces] [-s WxH] [-r fps] [-q frames] [-M]
+ *                         input output
+ *
+ *   -f  the face track, input.faces by default
+ *   -s  the frame size of a raw NV12 input
+ *   -r  the frame rate of a raw NV12 input (30)
+ *   -q  frames waiting between two stages (4)
+ *   -M  no motion tracking between the detections
+ *
+ * The formats and the face track follow host/video_io.h. The detections are
+ * applied before their frame is filtered, and the masks follow the faces
+ * between them. A filter tracks MAXIMUM_FACE_NUMBER faces, so a track with
+ * larger detections gets a chain of filters, each masking its share of the
+ * faces of every frame.
+ *
+ * Three stages run on their own threads, connected by bounded queues and a
+ * fixed pool of frames: decode, filter (the detections, the motion
+ * tracking and the masking, which need the frames in order) and encode. At
+ * the end the tool reports the frames per second of the run and of every
+ * stage on its own, the speed relative to the frame rate of the video and
+ * how long every stage waited for the others.
+ */
+
+#include "facefilter.h"
+#include "hal.h"
+#include "video_io.h"
+#include "work_queue.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define FACES_SUFFIX ".faces"
+
+typedef enum {
+    STAGE_DECODE,
+    STAGE_FILTER,
+    STAGE_ENCODE,
+    STAGE_NUMBER,
+} stage_e;
+
+static const char *const s_stage_names[STAGE_NUMBER] = {
+    "decode",
+    "filter",
+    "encode",
+};
+
+typedef struct _stage_stats {
+    unsigned long frames;
+    unsigned long long busy_ns;
+    unsigned long long wait_ns; /* For frames to come in or to go out */
+} stage_stats_s;
+
+static struct {
+    const video_demuxer_s *demuxer;
+    const video_muxer_s *muxer;
+    void *input;
+    void *output;
+    video_format_s format;
+    bool motion;
+    video_track_s track;
+    frame_s *frames;
+    int frame_num;
+    work_queue_s free;
+    work_queue_s decoded;
+    work_queue_s filtered;
+    stage_stats_s stats[STAGE_NUMBER]; /* Each written by its stage only */
+    int error;                         /* The first error, set atomically */
+} s_video = {
+    .motion = true,
+};
+
+static unsigned long long _now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void _fail(stage_e stage, int error)
+{
+    int none = 0;
+
+    if (__atomic_compare_exchange_n(&s_video.error, &none, error, false,
+            __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        fprintf(stderr, "%s: %s\n", s_stage_names[stage], hal_error_message(error));
+}
+
+static bool _failed(void)
+{
+    return 0 != __atomic_load_n(&s_video.error, __ATOMIC_RELAXED);
+}
+
+/* Takes a frame off a queue, counting the time waited. */
+static frame_s *_pop(work_queue_s *queue, stage_stats_s *stats)
+{
+    unsigned long long start = _now_ns();
+    frame_s *frame = (frame_s *) work_queue_pop(queue);
+
+    stats->wait_ns += _now_ns() - start;
+
+    return frame;
+}
+
+static void _push(work_queue_s *queue, frame_s *frame, stage_stats_s *stats)
+{
+    unsigned long long start = _now_ns();
+
+    work_queue_push(queue, frame);
+    stats->wait_ns += _now_ns() - start;
+}
+
+static void *_decode_thread(void *user_data)
+{
+    stage_stats_s *stats = &s_video.stats[STAGE_DECODE];
+    unsigned long long frame_us = 1000000ULL * s_video.format.fps_den;
+
+    while (!_failed()) {
+        frame_s *frame = _pop(&s_video.free, stats);
+        unsigned long long start = _now_ns();
+
+        int error = s_video.demuxer->read(s_video.input, frame);
+        if (0 != error) {
+            work_queue_push(&s_video.free, frame);
+            if (-ENODATA != error)
+                _fail(STAGE_DECODE, error);
+            break;
+        }
+        frame->timestamp_us = stats->frames * frame_us / s_video.format.fps_num;
+        stats->busy_ns += _now_ns() - start;
+        stats->frames++;
+        _push(&s_video.decoded, frame, stats);
+    }
+
+    work_queue_leave(&s_video.decoded);
+
+    return NULL;
+}
+
+/**
+ * @brief Runs the frames through the filters in order, like the preview
+ *        callback of the camera, with the detections of the face track
+ *        delivered right before their frames.
+ * @details Filter i gets the faces i * MAXIMUM_FACE_NUMBER and on of every
+ *          detection, in the order of the track.
+ */
+static void *_filter_thread(void *user_data)
+{
+    stage_stats_s *stats = &s_video.stats[STAGE_FILTER];
+    int max_faces = video_track_max_faces(&s_video.track);
+    int filter_num = (max_faces > 0)
+            ? (max_faces + MAXIMUM_FACE_NUMBER - 1) / MAXIMUM_FACE_NUMBER : 1;
+    facefilter_s *filters = (facefilter_s *) calloc(filter_num, sizeof(facefilter_s));
+    face_s *faces = (face_s *) calloc(filter_num * MAXIMUM_FACE_NUMBER,
+            sizeof(face_s));
+    int initialized = 0;
+    int next = 0;
+
+    int error = (NULL == filters || NULL == faces) ? -ENOMEM : 0;
+    for (; 0 == error && initialized < filter_num; initialized++) {
+        facefilter_s *filter = &filters[initialized];
+
+        error = facefilter_init(filter);
+        if (0 != error)
+            break;
+        facefilter_set_motion(filter, s_video.motion);
+        facefilter_set_geometry(filter, s_video.format.width, s_video.format.height);
+        facefilter_set_running(filter, true);
+    }
+    if (0 != error)
+        _fail(STAGE_FILTER, error);
+
+    frame_s *frame;
+    while (NULL != (frame = _pop(&s_video.decoded, stats))) {
+        if (_failed()) {
+            work_queue_push(&s_video.free, frame);
+            continue;
+        }
+
+        unsigned long long start = _now_ns();
+        int count = video_track_detection(&s_video.track, &next,
+                (int) stats->frames, faces, filter_num * MAXIMUM_FACE_NUMBER);
+
+        for (int i = 0; i < filter_num; i++) {
+            if (count >= 0) {
+                int share = count - i * MAXIMUM_FACE_NUMBER;
+
+                share = (share < 0) ? 0 : share;
+                share = (share > MAXIMUM_FACE_NUMBER) ? MAXIMUM_FACE_NUMBER : share;
+                facefilter_faces_detected(&filters[i],
+                        faces + i * MAXIMUM_FACE_NUMBER, share);
+            }
+            facefilter_preview(&filters[i], frame);
+        }
+        stats->busy_ns += _now_ns() - start;
+        stats->frames++;
+        _push(&s_video.filtered, frame, stats);
+    }
+
+    for (int i = 0; i < initialized; i++)
+        facefilter_deinit(&filters[i]);
+    free(faces);
+    free(filters);
+    work_queue_leave(&s_video.filtered);
+
+    return NULL;
+}
+
+static void *_encode_thread(void *user_data)
+{
+    stage_stats_s *stats = &s_video.stats[STAGE_ENCODE];
+    frame_s *frame;
+
+    while (NULL != (frame = _pop(&s_video.filtered, stats))) {
+        if (!_failed()) {
+            unsigned long long start = _now_ns();
+            int error = s_video.muxer->write(s_video.output, frame);
+
+            if (0 != error)
+                _fail(STAGE_ENCODE, error);
+            stats->busy_ns += _now_ns() - start;
+            stats->frames++;
+        }
+        work_queue_push(&s_video.free, frame);
+    }
+
+    return NULL;
+}
+
+static void _usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [-f faces] [-s WxH] [-r fps] [-q frames] [-M] "
+            "input output\n", name);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *track_path = NULL;
+    int queue_length = 4;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "f:s:r:q:Mh")) != -1) {
+        switch (opt) {
+        case 'f':
+            track_path = optarg;
+            break;
+        case 's':
+            if (2 != sscanf(optarg, "%dx%d", &s_video.format.width,
+                    &s_video.format.height)) {
+                _usage(argv[0]);
+                return 2;
+            }
+            break;
+        case 'r':
+            s_video.format.fps_num = atoi(optarg);
+            s_video.format.fps_den = 1;
+            break;
+        case 'q':
+            queue_length = atoi(optarg);
+            break;
+        case 'M':
+            s_video.motion = false;
+            break;
+        default:
+            _usage(argv[0]);
+            return 2;
+        }
+    }
+
+    if (argc - optind != 2 || queue_length < 1) {
+        _usage(argv[0]);
+        return 2;
+    }
+    const char *input = argv[optind];
+    const char *output = argv[optind + 1];
+
+    s_video.demuxer = video_demuxer_for_path(input);
+    s_video.muxer = video_muxer_for_path(output);
+    if (NULL == s_video.demuxer || NULL == s_video.muxer) {
+        fprintf(stderr, "Unknown video format of %s.\n",
+                (NULL == s_video.demuxer) ? input : output);
+        return 2;
+    }
+
+    /* Without faces nothing would be masked, which is never the intent. */
+    char default_track[4096];
+    if (NULL == track_path) {
+        snprintf(default_track, sizeof(default_track), "%s%s", input, FACES_SUFFIX);
+        track_path = default_track;
+    }
+    int error = video_track_read(track_path, &s_video.track);
+    if (0 != error) {
+        fprintf(stderr, "%s: %s\n", track_path, hal_error_message(error));
+        return 1;
+    }
+
+    error = s_video.demuxer->open(&s_video.input, input, &s_video.format);
+    if (0 != error) {
+        fprintf(stderr, "%s: %s\n", input, hal_error_message(error));
+        return 1;
+    }
+    error = s_video.muxer->open(&s_video.output, output, &s_video.format);
+    if (0 != error) {
+        fprintf(stderr, "%s: %s\n", output, hal_error_message(error));
+        s_video.demuxer->close(s_video.input);
+        return 1;
+    }
+
+    /* Every frame is in a queue or in a stage, the pool bounds the memory. */
+    s_video.frame_num = 2 * queue_length + STAGE_NUMBER;
+    s_video.frames = (frame_s *) calloc(s_video.frame_num, sizeof(frame_s));
+    if (NULL == s_video.frames
+            || 0 != work_queue_init(&s_video.free, s_video.frame_num, 1)
+            || 0 != work_queue_init(&s_video.decoded, queue_length, 1)
+            || 0 != work_queue_init(&s_video.filtered, queue_length, 1)) {
+        fprintf(stderr, "Out of memory.\n");
+        return 1;
+    }
+    for (int i = 0; i < s_video.frame_num; i++) {
+        if (0 != video_frame_alloc(&s_video.format, &s_video.frames[i])) {
+            fprintf(stderr, "Out of memory.\n");
+            return 1;
+        }
+        work_queue_push(&s_video.free, &s_video.frames[i]);
+    }
+
+    void *(*const functions[STAGE_NUMBER])(void *) = {
+        _decode_thread,
+        _filter_thread,
+        _encode_thread,
+    };
+    pthread_t threads[STAGE_NUMBER];
+    unsigned long long start = _now_ns();
+    for (int stage = 0; stage < STAGE_NUMBER; stage++)
+        if (0 != pthread_create(&threads[stage], NULL, functions[stage], NULL)) {
+            /* The queues count on every stage, there is no way back. */
+            fprintf(stderr, "Could not start the %s thread.\n", s_stage_names[stage]);
+            return 1;
+        }
+    for (int stage = 0; stage < STAGE_NUMBER; stage++)
+        pthread_join(threads[stage], NULL);
+    double seconds = (_now_ns() - start) / 1e9;
+
+    s_video.demuxer->close(s_video.input);
+    error = s_video.muxer->close(s_video.output);
+    if (0 != error)
+        _fail(STAGE_ENCODE, error);
+
+    unsigned long frames = s_video.stats[STAGE_ENCODE].frames;
+    double fps = (seconds > 0) ? frames / seconds : 0.0;
+    double video_fps = (double) s_video.format.fps_num / s_video.format.fps_den;
+    fprintf(stderr, "%lu frames %dx%d in %.2f s: %.1f fps, %.1fx real time\n",
+            frames, s_video.format.width, s_video.format.height, seconds, fps,
+            fps / video_fps);
+    for (int stage = 0; stage < STAGE_NUMBER; stage++) {
+        const stage_stats_s *stats = &s_video.stats[stage];
+        fprintf(stderr, "%-7s %8.1f fps alone, %5.1f%% busy, waited %.2f s\n",
+                s_stage_names[stage],
+                (stats->busy_ns > 0) ? stats->frames / (stats->busy_ns / 1e9) : 0.0,
+                (seconds > 0) ? 100.0 * stats->busy_ns / 1e9 / seconds : 0.0,
+                stats->wait_ns / 1e9);
+    }
+
+    work_queue_deinit(&s_video.filtered);
+    work_queue_deinit(&s_video.decoded);
+    work_queue_deinit(&s_video.free);
+    for (int i = 0; i < s_video.frame_num; i++)
+        video_frame_free(&s_video.frames[i]);
+    free(s_video.frames);
+    video_track_free(&s_video.track);
+
+    return _failed() ? 1 : 0;
+}
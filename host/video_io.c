@@ -0,0 +1,518 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Flora License, Version 1.1 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://floralicense.org/license/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "video_io.h"
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#define Y4M_MAGIC "YUV4MPEG2"
+#define Y4M_LINE_MAX 256
+/* Larger frames are refused, their sizes would not fit the frame fields. */
+#define VIDEO_MAX_DIMENSION 8192
+
+typedef struct _video_file {
+    FILE *file;
+    int width;
+    int height;
+    unsigned char *planar; /* The U and V planes of a Y4M frame */
+} video_file_s;
+
+static int _check_format(const video_format_s *format)
+{
+    /* The UV rows of NV12 are as wide as the Y rows. */
+    if (format->width <= 0 || format->height <= 0 || 0 != format->width % 2
+            || 0 != format->height % 2 || format->width > VIDEO_MAX_DIMENSION
+            || format->height > VIDEO_MAX_DIMENSION)
+        return -ENOTSUP;
+
+    return 0;
+}
+
+/**
+ * @brief Creates the context of an open file, which it owns from then on.
+ */
+static int _context_create(void **context, FILE *file,
+                           const video_format_s *format, bool planar)
+{
+    video_file_s *video = (video_file_s *) calloc(1, sizeof(video_file_s));
+    if (NULL != video && planar) {
+        video->planar = (unsigned char *) malloc(format->width * format->height / 2);
+        if (NULL == video->planar) {
+            free(video);
+            video = NULL;
+        }
+    }
+    if (NULL == video) {
+        fclose(file);
+        return -ENOMEM;
+    }
+
+    video->file = file;
+    video->width = format->width;
+    video->height = format->height;
+    *context = video;
+
+    return 0;
+}
+
+static int _file_open(void **context, const char *path, const char *mode,
+                      const video_format_s *format, bool planar)
+{
+    FILE *file = fopen(path, mode);
+
+    return (NULL != file) ? _context_create(context, file, format, planar) : -errno;
+}
+
+static int _file_close(void *context)
+{
+    video_file_s *video = (video_file_s *) context;
+    int error = 0;
+
+    if (NULL == video)
+        return 0;
+
+    if (0 != fclose(video->file))
+        error = -errno;
+    free(video->planar);
+    free(video);
+
+    return error;
+}
+
+static void _demux_close(void *context)
+{
+    _file_close(context);
+}
+
+/* Reads the planes of a frame, -ENODATA at the end of the file. */
+static int _read_exact(FILE *file, unsigned char *data, size_t size, bool first)
+{
+    size_t got = fread(data, 1, size, file);
+
+    if (got == size)
+        return 0;
+
+    return (first && 0 == got && feof(file)) ? -ENODATA : -EIO;
+}
+
+static int _y4m_open(void **context, const char *path, video_format_s *format)
+{
+    char line[Y4M_LINE_MAX];
+    video_format_s found = { 0, 0, 30, 1 };
+    FILE *file = fopen(path, "rb");
+
+    if (NULL == file)
+        return -errno;
+
+    int error = 0;
+    if (NULL == fgets(line, sizeof(line), file) || NULL == strchr(line, '\n')
+            || 0 != strncmp(line, Y4M_MAGIC " ", sizeof(Y4M_MAGIC)))
+        error = -EINVAL;
+
+    for (char *token = strtok(line + sizeof(Y4M_MAGIC), " \n");
+            0 == error && NULL != token; token = strtok(NULL, " \n")) {
+        switch (token[0]) {
+        case 'W':
+            found.width = atoi(token + 1);
+            break;
+        case 'H':
+            found.height = atoi(token + 1);
+            break;
+        case 'F':
+            if (2 != sscanf(token + 1, "%d:%d", &found.fps_num, &found.fps_den)
+                    || found.fps_num <= 0 || found.fps_den <= 0)
+                error = -EINVAL;
+            break;
+        case 'C':
+            /* 420, 420jpeg, 420paldv and 420mpeg2 only differ in siting. */
+            if (0 != strncmp(token + 1, "420", 3))
+                error = -ENOTSUP;
+            break;
+        case 'I':
+            if ('p' != token[1] && '?' != token[1])
+                error = -ENOTSUP;
+            break;
+        default:
+            break;
+        }
+    }
+    if (0 == error)
+        error = _check_format(&found);
+
+    if (0 == error)
+        error = _context_create(context, file, &found, true);
+    else
+        fclose(file);
+    if (0 != error)
+        return error;
+
+    *format = found;
+
+    return 0;
+}
+
+static int _y4m_read(void *context, frame_s *frame)
+{
+    video_file_s *video = (video_file_s *) context;
+    char line[Y4M_LINE_MAX];
+    unsigned int chroma_size = video->width * video->height / 4;
+
+    if (NULL == fgets(line, sizeof(line), video->file))
+        return feof(video->file) ? -ENODATA : -EIO;
+    if (0 != strncmp(line, "FRAME", 5) || NULL == strchr(line, '\n'))
+        return -EINVAL;
+
+    int error = _read_exact(video->file, frame->y, frame->y_size, false);
+    if (0 == error)
+        error = _read_exact(video->file, video->planar, 2 * chroma_size, false);
+    if (0 != error)
+        return error;
+
+    const unsigned char *u = video->planar;
+    const unsigned char *v = video->planar + chroma_size;
+    for (unsigned int i = 0; i < chroma_size; i++) {
+        frame->uv[2 * i] = u[i];
+        frame->uv[2 * i + 1] = v[i];
+    }
+
+    return 0;
+}
+
+static int _y4m_mux_open(void **context, const char *path,
+                         const video_format_s *format)
+{
+    int error = _check_format(format);
+    if (0 != error)
+        return error;
+
+    error = _file_open(context, path, "wb", format, true);
+    if (0 != error)
+        return error;
+
+    video_file_s *video = (video_file_s *) *context;
+    fprintf(video->file, Y4M_MAGIC " W%d H%d F%d:%d Ip A1:1 C420jpeg\n",
+            format->width, format->height, format->fps_num, format->fps_den);
+
+    return 0;
+}
+
+static int _y4m_write(void *context, const frame_s *frame)
+{
+    video_file_s *video = (video_file_s *) context;
+    unsigned int chroma_size = video->width * video->height / 4;
+    unsigned char *u = video->planar;
+    unsigned char *v = video->planar + chroma_size;
+
+    for (unsigned int i = 0; i < chroma_size; i++) {
+        u[i] = frame->uv[2 * i];
+        v[i] = frame->uv[2 * i + 1];
+    }
+
+    fputs("FRAME\n", video->file);
+    fwrite(frame->y, 1, frame->y_size, video->file);
+    fwrite(video->planar, 1, 2 * chroma_size, video->file);
+
+    return ferror(video->file) ? -EIO : 0;
+}
+
+static int _raw_open(void **context, const char *path, video_format_s *format)
+{
+    int error = _check_format(format);
+    if (0 != error)
+        return error;
+
+    if (format->fps_num <= 0 || format->fps_den <= 0) {
+        format->fps_num = 30;
+        format->fps_den = 1;
+    }
+
+    return _file_open(context, path, "rb", format, false);
+}
+
+static int _raw_read(void *context, frame_s *frame)
+{
+    video_file_s *video = (video_file_s *) context;
+
+    int error = _read_exact(video->file, frame->y, frame->y_size, true);
+    if (0 == error)
+        error = _read_exact(video->file, frame->uv, frame->uv_size, false);
+
+    return error;
+}
+
+static int _raw_mux_open(void **context, const char *path,
+                         const video_format_s *format)
+{
+    int error = _check_format(format);
+
+    return (0 != error) ? error : _file_open(context, path, "wb", format, false);
+}
+
+static int _raw_write(void *context, const frame_s *frame)
+{
+    video_file_s *video = (video_file_s *) context;
+
+    fwrite(frame->y, 1, frame->y_size, video->file);
+    fwrite(frame->uv, 1, frame->uv_size, video->file);
+
+    return ferror(video->file) ? -EIO : 0;
+}
+
+const video_demuxer_s video_demuxer_y4m = {
+    .name = "y4m",
+    .extensions = "y4m",
+    .open = _y4m_open,
+    .read = _y4m_read,
+    .close = _demux_close,
+};
+
+const video_demuxer_s video_demuxer_raw = {
+    .name = "raw",
+    .extensions = "nv12 yuv",
+    .open = _raw_open,
+    .read = _raw_read,
+    .close = _demux_close,
+};
+
+const video_muxer_s video_muxer_y4m = {
+    .name = "y4m",
+    .extensions = "y4m",
+    .open = _y4m_mux_open,
+    .write = _y4m_write,
+    .close = _file_close,
+};
+
+const video_muxer_s video_muxer_raw = {
+    .name = "raw",
+    .extensions = "nv12 yuv",
+    .open = _raw_mux_open,
+    .write = _raw_write,
+    .close = _file_close,
+};
+
+/* Whether the extension of a path is in a space separated list. */
+static bool _has_extension(const char *path, const char *extensions)
+{
+    const char *dot = strrchr(path, '.');
+    size_t len = (NULL != dot) ? strlen(dot + 1) : 0;
+
+    if (0 == len)
+        return false;
+
+    for (const char *p = extensions; '\0' != *p; p += strspn(p, " ")) {
+        size_t word = strcspn(p, " ");
+        if (word == len && 0 == strncasecmp(p, dot + 1, len))
+            return true;
+        p += word;
+    }
+
+    return false;
+}
+
+/**
+ * @brief Returns the demuxer for a file by its extension, @c NULL if there
+ *        is none.
+ */
+const video_demuxer_s *video_demuxer_for_path(const char *path)
+{
+    static const video_demuxer_s *demuxers[] = {
+        &video_demuxer_y4m,
+        &video_demuxer_raw,
+    };
+
+    for (unsigned int i = 0; i < sizeof(demuxers) / sizeof(demuxers[0]); i++)
+        if (_has_extension(path, demuxers[i]->extensions))
+            return demuxers[i];
+
+    return NULL;
+}
+
+/**
+ * @brief Returns the muxer for a file by its extension, @c NULL if there is
+ *        none.
+ */
+const video_muxer_s *video_muxer_for_path(const char *path)
+{
+    static const video_muxer_s *muxers[] = {
+        &video_muxer_y4m,
+        &video_muxer_raw,
+    };
+
+    for (unsigned int i = 0; i < sizeof(muxers) / sizeof(muxers[0]); i++)
+        if (_has_extension(path, muxers[i]->extensions))
+            return muxers[i];
+
+    return NULL;
+}
+
+/**
+ * @brief Allocates a NV12 frame of the given format.
+ *
+ * @return 0 on success, otherwise a negative errno value
+ */
+int video_frame_alloc(const video_format_s *format, frame_s *frame)
+{
+    unsigned int y_size = format->width * format->height;
+    unsigned char *buffer = (unsigned char *) malloc(y_size * 3 / 2);
+
+    if (NULL == buffer)
+        return -ENOMEM;
+
+    frame->width = format->width;
+    frame->height = format->height;
+    frame->y = buffer;
+    frame->uv = buffer + y_size;
+    frame->y_size = y_size;
+    frame->uv_size = y_size / 2;
+    frame->timestamp_us = 0;
+
+    return 0;
+}
+
+void video_frame_free(frame_s *frame)
+{
+    free(frame->y);
+    frame->y = NULL;
+    frame->uv = NULL;
+}
+
+static int _compare_entries(const void *a, const void *b)
+{
+    const video_track_entry_s *x = (const video_track_entry_s *) a;
+    const video_track_entry_s *y = (const video_track_entry_s *) b;
+
+    /* The faces of a frame keep the order of the file, by their ids. */
+    if (x->frame != y->frame)
+        return (x->frame > y->frame) - (x->frame < y->frame);
+
+    return (x->face.id > y->face.id) - (x->face.id < y->face.id);
+}
+
+/**
+ * @brief Reads a face track, sorted by frame.
+ *
+ * @return 0 on success, -EINVAL for a line that is not a detection,
+ *         otherwise a negative errno value
+ */
+int video_track_read(const char *path, video_track_s *track)
+{
+    FILE *file = fopen(path, "r");
+    char line[256];
+    int capacity = 0;
+    int error = 0;
+
+    track->entries = NULL;
+    track->entry_num = 0;
+    if (NULL == file)
+        return -errno;
+
+    while (0 == error && NULL != fgets(line, sizeof(line), file)) {
+        video_track_entry_s entry = { .face = { .score = 100, .width = -1 } };
+        char *text = line + strspn(line, " \t");
+
+        if ('#' == *text || '\n' == *text || '\0' == *text)
+            continue;
+
+        int fields = sscanf(text, "%d %d %d %d %d", &entry.frame, &entry.face.x,
+                &entry.face.y, &entry.face.width, &entry.face.height);
+        if ((1 != fields && 5 != fields) || entry.frame < 0
+                || (5 == fields && (entry.face.width <= 0 || entry.face.height <= 0))) {
+            error = -EINVAL;
+            break;
+        }
+
+        if (track->entry_num == capacity) {
+            capacity = (capacity > 0) ? 2 * capacity : 256;
+            video_track_entry_s *entries = (video_track_entry_s *) realloc(
+                    track->entries, capacity * sizeof(video_track_entry_s));
+            if (NULL == entries) {
+                error = -ENOMEM;
+                break;
+            }
+            track->entries = entries;
+        }
+        entry.face.id = track->entry_num;
+        track->entries[track->entry_num++] = entry;
+    }
+    fclose(file);
+
+    if (0 == error)
+        qsort(track->entries, track->entry_num, sizeof(video_track_entry_s),
+                _compare_entries);
+    else
+        video_track_free(track);
+
+    return error;
+}
+
+void video_track_free(video_track_s *track)
+{
+    free(track->entries);
+    track->entries = NULL;
+    track->entry_num = 0;
+}
+
+/**
+ * @brief Returns the largest number of faces of a detection of the track.
+ */
+int video_track_max_faces(const video_track_s *track)
+{
+    int max_faces = 0;
+
+    for (int i = 0, count = 0; i < track->entry_num; i++) {
+        if (i > 0 && track->entries[i].frame != track->entries[i - 1].frame)
+            count = 0;
+        if (track->entries[i].face.width > 0 && ++count > max_faces)
+            max_faces = count;
+    }
+
+    return max_faces;
+}
+
+/**
+ * @brief Looks up the detection of a frame.
+ * @details The frames are looked up in increasing order, the cursor keeps
+ *          the position between the calls and starts at 0.
+ *
+ * @param track      The face track
+ * @param next       The cursor
+ * @param frame      The frame number
+ * @param faces      Receives the faces detected on the frame
+ * @param max_faces  The size of the faces array
+ *
+ * @return The number of faces, -ENOENT if the frame has no detection
+ */
+int video_track_detection(const video_track_s *track, int *next, int frame,
+                          face_s *faces, int max_faces)
+{
+    const video_track_entry_s *entries = track->entries;
+    int count = 0;
+
+    while (*next < track->entry_num && entries[*next].frame < frame)
+        (*next)++;
+    if (*next >= track->entry_num || entries[*next].frame != frame)
+        return -ENOENT;
+
+    for (; *next < track->entry_num && entries[*next].frame == frame; (*next)++)
+        if (entries[*next].face.width > 0 && count < max_faces)
+            faces[count++] = entries[*next].face;
+
+    return count;
+}
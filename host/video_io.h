@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Flora License, Version 1.1 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://floralicense.org/license/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#if !defined(_VIDEO_IO_H)
+#define _VIDEO_IO_H
+
+#include "frame.h"
+
+/*
+ * Video files for the host tools, read and written as NV12 frames like the
+ * camera delivers them.
+ *
+ * A demuxer reads the frames of a file format into frames whose buffers
+ * the caller allocates for the format, a muxer writes them. The formats are
+ * picked by the file name extension; another container or codec is added
+ * as one more demuxer or muxer in the tables of video_io.c:
+ *   y4m  YUV4MPEG2 with 4:2:0 chroma, converted from and to I420
+ *   raw  NV12 frames back to back (.nv12, .yuv), the size and rate given by
+ *        the caller
+ *
+ * A face track stands in for the face detection of the device, which only
+ * runs on the camera preview: one line per detected face as
+ * "frame x y width height", or a line with the frame number alone for a
+ * detection that found no face.
+ */
+
+typedef struct _video_format {
+    int width;
+    int height;
+    int fps_num; /* Frame rate as a fraction */
+    int fps_den;
+} video_format_s;
+
+typedef struct _video_demuxer {
+    const char *name;
+    const char *extensions; /* Space separated, without the dot */
+    /* The format is the size and rate of a raw file on input. */
+    int (*open)(void **context, const char *path, video_format_s *format);
+    /* Fills the planes of the frame, -ENODATA after the last frame. */
+    int (*read)(void *context, frame_s *frame);
+    void (*close)(void *context);
+} video_demuxer_s;
+
+typedef struct _video_muxer {
+    const char *name;
+    const char *extensions;
+    int (*open)(void **context, const char *path, const video_format_s *format);
+    int (*write)(void *context, const frame_s *frame);
+    int (*close)(void *context);
+} video_muxer_s;
+
+/* A face of the track, or a detection without faces for a negative width. */
+typedef struct _video_track_entry {
+    int frame;
+    face_s face;
+} video_track_entry_s;
+
+typedef struct _video_track {
+    video_track_entry_s *entries; /* Sorted by frame */
+    int entry_num;
+} video_track_s;
+
+extern const video_demuxer_s video_demuxer_y4m;
+extern const video_demuxer_s video_demuxer_raw;
+extern const video_muxer_s video_muxer_y4m;
+extern const video_muxer_s video_muxer_raw;
+
+const video_demuxer_s *video_demuxer_for_path(const char *path);
+const video_muxer_s *video_muxer_for_path(const char *path);
+int video_frame_alloc(const video_format_s *format, frame_s *frame);
+void video_frame_free(frame_s *frame);
+int video_track_read(const char *path, video_track_s *track);
+void video_track_free(video_track_s *track);
+int video_track_max_faces(const video_track_s *track);
+int video_track_detection(const video_track_s *track, int *next, int frame,
+        face_s *faces, int max_faces);
+
+#endif
@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Flora License, Version 1.1 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://floralicense.org/license/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "work_queue.h"
+#include <errno.h>
+#include <stdlib.h>
+
+/**
+ * @brief Sets up an empty queue.
+ *
+ * @param queue      The queue
+ * @param capacity   The number of items the queue holds
+ * @param producers  The number of threads pushing into the queue
+ *
+ * @return 0 on success, otherwise a negative errno value
+ */
+int work_queue_init(work_queue_s *queue, int capacity, int producers)
+{
+    if (capacity < 1)
+        return -EINVAL;
+
+    queue->items = (void **) calloc(capacity, sizeof(void *));
+    if (NULL == queue->items)
+        return -ENOMEM;
+
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->not_empty, NULL);
+    pthread_cond_init(&queue->not_full, NULL);
+    queue->capacity = capacity;
+    queue->head = 0;
+    queue->count = 0;
+    queue->producers = producers;
+
+    return 0;
+}
+
+void work_queue_deinit(work_queue_s *queue)
+{
+    pthread_cond_destroy(&queue->not_full);
+    pthread_cond_destroy(&queue->not_empty);
+    pthread_mutex_destroy(&queue->lock);
+    free(queue->items);
+    queue->items = NULL;
+}
+
+void work_queue_push(work_queue_s *queue, void *item)
+{
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == queue->capacity)
+        pthread_cond_wait(&queue->not_full, &queue->lock);
+    queue->items[(queue->head + queue->count) % queue->capacity] = item;
+    queue->count++;
+    pthread_cond_signal(&queue->not_empty);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+/**
+ * @brief Takes the next item of a queue, waiting for one.
+ *
+ * @return The item, @c NULL once the queue is empty and all its producers
+ *         left
+ */
+void *work_queue_pop(work_queue_s *queue)
+{
+    void *item = NULL;
+
+    pthread_mutex_lock(&queue->lock);
+    while (0 == queue->count && queue->producers > 0)
+        pthread_cond_wait(&queue->not_empty, &queue->lock);
+    if (queue->count > 0) {
+        item = queue->items[queue->head];
+        queue->head = (queue->head + 1) % queue->capacity;
+        queue->count--;
+        pthread_cond_signal(&queue->not_full);
+    }
+    pthread_mutex_unlock(&queue->lock);
+
+    return item;
+}
+
+/**
+ * @brief Called by every producer when it is done, the last one closes the
+ *        queue.
+ */
+void work_queue_leave(work_queue_s *queue)
+{
+    pthread_mutex_lock(&queue->lock);
+    if (0 == --queue->producers)
+        pthread_cond_broadcast(&queue->not_empty);
+    pthread_mutex_unlock(&queue->lock);
+}
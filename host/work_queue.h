@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Flora License, Version 1.1 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://floralicense.org/license/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#if !defined(_WORK_QUEUE_H)
+#define _WORK_QUEUE_H
+
+#include <pthread.h>
+
+/*
+ * A bounded queue of work items between the stages of the host pipelines.
+ * A push waits while the queue is full, a pop while it is empty. Every
+ * producer thread leaves the queue when it is done; once the last one has
+ * left and the queue ran empty, work_queue_pop() returns NULL, which ends
+ * the consumers.
+ */
+
+typedef struct _work_queue {
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    void **items;
+    int capacity;
+    int head;
+    int count;
+    int producers; /* Threads still pushing */
+} work_queue_s;
+
+int work_queue_init(work_queue_s *queue, int capacity, int producers);
+void work_queue_deinit(work_queue_s *queue);
+void work_queue_push(work_queue_s *queue, void *item);
+void *work_queue_pop(work_queue_s *queue);
+void work_queue_leave(work_queue_s *queue);
+
+#endif
@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Flora License, Version 1.1 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://floralicense.org/license/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#if !defined(_ARENA_H)
+#define _ARENA_H
+
+#include <stddef.h>
+
+/* Size of the chunks the arena takes from the system, larger blocks get a
+ * chunk of their own. */
+#define ARENA_CHUNK_SIZE (256 * 1024)
+/* Subsystems accounted separately. */
+#define ARENA_OWNERS 16
+
+/*
+ * Arena holding the long-lived memory of a camera session (buffer pools,
+ * paths), released in one shot when the session ends. Buffers resized at
+ * runtime stay on the heap, the arena would never give them back.
+ *
+ * Blocks are carved out of large chunks and tagged with the subsystem owning
+ * them, so the peak usage of every subsystem can be reported to size the
+ * memory of low-RAM devices. Freeing a block only updates the accounting,
+ * apart from the last block of the arena which is given back; the memory is
+ * reclaimed by arena_destroy().
+ *
+ * arena_alloc() and arena_free() accept a NULL arena and then fall back to
+ * malloc() and free(), so a module can take an arena optionally.
+ */
+
+typedef struct _arena_usage {
+    const char *owner;
+    size_t used;   /* Bytes in live blocks */
+    size_t peak;   /* Highest value of used */
+    unsigned long blocks;
+} arena_usage_s;
+
+typedef struct _arena *arena_h;
+
+int arena_create(arena_h *arena);
+void arena_destroy(arena_h arena);
+void *arena_alloc(arena_h arena, const char *owner, size_t size);
+void arena_free(arena_h arena, void *block);
+char *arena_strdup(arena_h arena, const char *owner, const char *text);
+int arena_get_usage(arena_h arena, arena_usage_s *usage, int count);
+size_t arena_get_reserved(arena_h arena);
+void arena_log_usage(arena_h arena);
+
+#endif
@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Flora License, Version 1.1 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://floralicense.org/license/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#if !defined(_BENCH_H)
+#define _BENCH_H
+
+#include <stdbool.h>
+#include "frame.h"
+
+#define BENCH_REPORT_FILE_NAME "benchmark.json"
+/* Cases of the suite. */
+#define BENCH_CASES 9
+
+/*
+ * The benchmark suite of the pipeline stages, run on the device by the
+ * hidden Benchmark view and on a host by bench_preview -a: the filter
+ * kernels, the face coordinate conversion, the frame copy of the export
+ * ring, and the stream and photo writers.
+ *
+ * Every case runs in rounds of about 50 ms on a private copy of the given
+ * frame, the median round is reported. The writers write into the given
+ * directory and remove their files afterwards. A run takes a few seconds
+ * and blocks the calling thread. The filter cases count into the pipeline
+ * metrics like preview frames do.
+ */
+
+typedef struct _bench_result {
+    const char *name;
+    double ns_per_frame; /* Median round */
+    double fps;
+    int iterations;      /* Per round */
+    int error;           /* Negative errno value if the case could not run */
+    bool storage;        /* Writes files, the time depends on the storage */
+} bench_result_s;
+
+int bench_frame_create(int width, int height, frame_s *frame);
+int bench_frame_copy(const frame_s *source, frame_s *frame);
+void bench_frame_free(frame_s *frame);
+int bench_run(const frame_s *frame, const char *directory,
+        bench_result_s *results, int max_results);
+int bench_write_report(const char *path, const char *source,
+        const frame_s *frame, const bench_result_s *results, int count);
+
+#endif
@@ -0,0 +1,27 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Flora License, Version 1.1 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://floralicense.org/license/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#if !defined(_BENCHVIEW_H)
+#define _BENCHVIEW_H
+
+/*
+ * The hidden Benchmark view, opened by a launch request with the extra data
+ * "mode" set to "benchmark". It runs the benchmark suite (bench.h) on a
+ * synthetic frame or on a frame of the running camera preview.
+ */
+void benchview_create(void);
+
+#endif
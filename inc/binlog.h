@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Flora License, Version 1.1 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://floralicense.org/license/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#if !defined(_BINLOG_H)
+#define _BINLOG_H
+
+#include <stdarg.h>
+#include <stdbool.h>
+
+#define BINLOG_FILE_NAME "facecamera.blog"
+#define BINLOG_MAGIC 0x4c424646 /* "FFBL" */
+#define BINLOG_VERSION 1
+
+/* Threads that can log at the same time. */
+#define BINLOG_THREADS 32
+/* Bytes of the ring of every thread. */
+#define BINLOG_RING_SIZE (64 * 1024)
+/* Distinct format strings. */
+#define BINLOG_SITES 512
+/* Arguments of a message, including the '*' widths and precisions. */
+#define BINLOG_ARGS 12
+/* Bytes kept of a string argument. */
+#define BINLOG_STRING_MAX 128
+/* Period of the drain thread, which also wakes up when a ring is half full. */
+#define BINLOG_DRAIN_MS 50
+
+/*
+ * Deferred logging: hal_log() stores the format string ID and the raw
+ * arguments of a message into a ring of the calling thread, which costs a
+ * few stores and copies instead of formatting the text. A drain thread
+ * formats the messages later and passes them to hal_log_text(), or writes
+ * them as they are into a binary file, which facecamera_log_decode formats
+ * offline.
+ *
+ * A format string is identified by its address, so it must be a string
+ * literal. Messages whose format cannot be deferred (more than BINLOG_ARGS
+ * arguments, %n, long double) and messages of threads that find no free
+ * ring are logged directly. When a ring is full the messages are dropped
+ * and counted.
+ *
+ * The binary file holds a binlog_file_header_s followed by entries, all in
+ * the native byte order of the device. Every entry starts with a
+ * binlog_entry_s of its kind and is padded to 8 bytes:
+ *   BINLOG_ENTRY_SITE     the format string of an ID, before its first use
+ *   BINLOG_ENTRY_MESSAGE  the arguments, 8 bytes each; a string is its
+ *                         length followed by its bytes
+ *   BINLOG_ENTRY_DROPPED  8 bytes count of messages dropped by a thread
+ */
+
+typedef enum {
+    BINLOG_ENTRY_MESSAGE,
+    BINLOG_ENTRY_SITE,
+    BINLOG_ENTRY_DROPPED,
+} binlog_entry_e;
+
+typedef struct _binlog_file_header {
+    unsigned int magic;
+    unsigned int version;
+} binlog_file_header_s;
+
+typedef struct _binlog_entry {
+    unsigned short size;     /* Bytes of the entry, header included */
+    unsigned short site;     /* Format string ID */
+    unsigned char kind;      /* binlog_entry_e */
+    unsigned char priority;  /* hal_log_priority_e */
+    unsigned char thread;
+    unsigned char reserved;
+    unsigned long long timestamp_ns;
+} binlog_entry_s;
+
+/* A message formatted by binlog_decode(). */
+typedef struct _binlog_message {
+    int priority;
+    int thread;
+    unsigned long long timestamp_ns;
+    unsigned long long dropped; /* Messages dropped instead of this one */
+    const char *text;
+} binlog_message_s;
+
+typedef void (*binlog_decode_cb)(const binlog_message_s *message,
+        void *user_data);
+
+int binlog_start(const char *path);
+void binlog_stop(void);
+bool binlog_vrecord(int priority, const char *fmt, va_list ap);
+int binlog_decode(const char *path, binlog_decode_cb callback,
+        void *user_data);
+
+#endif
@@ -0,0 +1,40 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Flora License, Version 1.1 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://floralicense.org/license/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#if !defined(_BUFPOOL_H)
+#define _BUFPOOL_H
+
+#include "arena.h"
+
+/*
+ * Pool of equally sized buffers allocated once when the pool is created, for
+ * the buffers the camera callbacks would otherwise allocate per frame or per
+ * photo. Buffers can be taken and returned from any thread. When all of them
+ * are in use the pool is empty rather than growing, the caller drops its work
+ * like the camera drops frames. The pool may live in the arena of the camera
+ * session.
+ */
+
+typedef struct _bufpool *bufpool_h;
+
+int bufpool_create(arena_h arena, int count, unsigned int size,
+        bufpool_h *pool);
+void bufpool_destroy(bufpool_h pool);
+void *bufpool_get(bufpool_h pool);
+void bufpool_put(bufpool_h pool, void *buffer);
+unsigned int bufpool_get_size(bufpool_h pool);
+
+#endif
@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Flora License, Version 1.1 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://floralicense.org/license/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#if !defined(_CAMCTL_H)
+#define _CAMCTL_H
+
+#include "hal.h"
+
+/* Commands that can wait for the command thread. */
+#define CAMCTL_QUEUE_LENGTH 16
+
+/*
+ * Camera control running the slow camera calls on a command thread, so the
+ * main loop never waits for the camera.
+ *
+ * The UI submits commands which are queued and executed one after another by
+ * a small state machine. A command that undoes the last queued one cancels
+ * it (e.g. stop preview followed by start preview), and a command that would
+ * not change the state once the queue is done is dropped, apart from the
+ * commands acting on a running preview (restart, resolution change) which
+ * are always executed. Every submitted command completes on the main loop,
+ * through hal_dispatch(), with the error of the camera call and the state
+ * the camera is in.
+ */
+
+typedef enum {
+    CAMCTL_STATE_STOPPED,        /* Created, no preview */
+    CAMCTL_STATE_PREVIEW,        /* Preview running */
+    CAMCTL_STATE_FACE_DETECTION, /* Preview and face detection running */
+} camctl_state_e;
+
+typedef enum {
+    CAMCTL_START_PREVIEW,
+    CAMCTL_STOP_PREVIEW,      /* Stops the face detection as well */
+    CAMCTL_START_FACE_DETECTION,
+    CAMCTL_STOP_FACE_DETECTION,
+    CAMCTL_RESTART_PREVIEW,   /* After a capture, see camctl.c */
+    CAMCTL_CHANGE_RESOLUTION, /* See camctl_set_preview_resolution() */
+} camctl_command_e;
+
+typedef struct _camctl_callbacks {
+    hal_preview_cb preview; /* Used if there is no frame callback */
+    hal_frame_cb frame;     /* Preferred where the camera supports it */
+    hal_face_detected_cb faces;
+    /* On the command thread, right after the camera changed its state. */
+    void (*state_changed)(camctl_state_e state, void *user_data);
+    /* On the main loop, once per submitted command. */
+    void (*completed)(camctl_command_e command, int error,
+            camctl_state_e state, void *user_data);
+} camctl_callbacks_s;
+
+typedef struct _camctl *camctl_h;
+
+int camctl_create(hal_camera_h camera, const camctl_callbacks_s *callbacks,
+        void *user_data, camctl_h *ctl);
+void camctl_destroy(camctl_h ctl);
+int camctl_submit(camctl_h ctl, camctl_command_e command);
+camctl_state_e camctl_get_state(camctl_h ctl);
+camctl_state_e camctl_get_pending_state(camctl_h ctl);
+int camctl_set_preview_resolution(camctl_h ctl, int width, int height);
+void camctl_sync(camctl_h ctl);
+const char *camctl_command_name(camctl_command_e command);
+
+#endif
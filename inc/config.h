@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Flora License, Version 1.1 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://floralicense.org/license/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#if !defined(_CONFIG_H)
+#define _CONFIG_H
+
+#include <stdbool.h>
+#include "hal.h"
+#include "frame.h"
+#include "metrics.h"
+
+#define CONFIG_FILE_NAME "facecamera.conf"
+#define CONFIG_STRING_MAX 128
+
+typedef enum {
+    CONFIG_LOG_DIRECT,
+    CONFIG_LOG_DEFERRED,
+    CONFIG_LOG_BINARY,
+} config_log_mode_e;
+
+/*
+ * Settings read once at startup from a "key = value" file, so the pipeline
+ * can be tuned per device without rebuilding the application. Lines starting
+ * with '#' are comments; unknown keys and invalid values are logged and the
+ * defaults are kept.
+ *
+ *   filter.max_faces      faces masked per frame, 1 to MAXIMUM_FACE_NUMBER
+ *   filter.motion         follow the faces between detections (true/false)
+ *   filter.zones          static zones masked along with the faces, up to
+ *                         MAXIMUM_ZONE_NUMBER "x y width height" separated
+ *                         by ';', in thousandths of the frame size
+ *   preview.max_width     largest preview width to choose (699)
+ *   preview.max_height    largest preview height to choose, 0 for any
+ *   camera.device         front or back
+ *   camera.image_quality  JPEG quality of the photos, 1 to 100
+ *   camera.frame_refs     take the preview frames by reference (media
+ *                         packets) where supported (true/false)
+ *   storage.path_length   size of the path buffers (512)
+ *   stream.uri            file:<path> or unix:<path>, empty to disable
+ *   stream.queue_length   frames waiting for the stream transport
+ *   export.name           shared memory ring name, empty to disable
+ *   export.raw            export the frames before masking (true/false)
+ *   export.slots          frames in the shared memory ring
+ *   export.slot_size      largest frame in the ring in bytes
+ *   log.level             debug, info, warn or error
+ *   log.mode              direct, deferred (formatted on a drain thread) or
+ *                         binary (written to BINLOG_FILE_NAME of the data
+ *                         directory for facecamera_log_decode)
+ *   trace.file            trace the pipeline stages into this file of the
+ *                         data directory, written when the application is
+ *                         paused or the camera closed; empty to disable
+ *   metrics.file          write the pipeline metrics into this file of the
+ *                         data directory periodically; empty to disable
+ *   metrics.format        prometheus (text exposition format) or json
+ *   metrics.interval      seconds between the writes of the metrics file
+ */
+typedef struct _config {
+    /* Filter chain */
+    int max_faces;
+    bool motion;
+    zone_s zones[MAXIMUM_ZONE_NUMBER];
+    int zone_num;
+    /* Resolution policy */
+    int preview_max_width;
+    int preview_max_height;
+    /* Camera */
+    hal_camera_device_e camera_device;
+    int image_quality;
+    bool frame_refs;
+    /* Pools */
+    int path_length;
+    int stream_queue_length;
+    int export_slots;
+    int export_slot_size;
+    /* Output */
+    char stream_uri[CONFIG_STRING_MAX];
+    char export_name[CONFIG_STRING_MAX];
+    bool export_raw;
+    /* Instrumentation */
+    hal_log_priority_e log_level;
+    config_log_mode_e log_mode;
+    char trace_file[CONFIG_STRING_MAX];
+    char metrics_file[CONFIG_STRING_MAX];
+    metrics_format_e metrics_format;
+    int metrics_interval;
+} config_s;
+
+void config_default(config_s *config);
+int config_load(const char *path, config_s *config);
+
+#endif
@@ -18,9 +18,14 @@
 #define _DATA_H
 
 #include "view.h"
-
-#define MAXIMUM_FACE_NUMBER 7
+#include "facefilter.h"
 
 void create_buttons_in_main_window(void);
+void camera_set_low_memory(bool active);
+void camera_set_low_battery(bool active);
+void camera_write_trace(void);
+
+typedef void (*camera_frame_grab_cb)(const frame_s *frame, void *user_data);
+int camera_grab_frame(camera_frame_grab_cb callback, void *user_data);
 
 #endif
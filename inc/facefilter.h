@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Flora License, Version 1.1 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://floralicense.org/license/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#if !defined(_FACEFILTER_H)
+#define _FACEFILTER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+#include "frame.h"
+#include "stream.h"
+#include "shmring.h"
+#include "motion.h"
+
+#define MAXIMUM_FACE_NUMBER 7
+/*
+ * The faces and the zones are merged into disjoint spans: n rectangles cut
+ * the rows into at most 2n - 1 bands of at most n runs each.
+ */
+#define MAXIMUM_MASK_NUMBER (MAXIMUM_FACE_NUMBER + MAXIMUM_ZONE_NUMBER)
+#define MAXIMUM_SPAN_NUMBER ((2 * MAXIMUM_MASK_NUMBER - 1) * MAXIMUM_MASK_NUMBER)
+
+/*
+ * A face clipped against the frame and aligned to the 2x2 chroma subsampling,
+ * ready to be masked without any further checks.
+ */
+typedef struct _face_span {
+    unsigned int offset;    /* Y plane offset of the top left corner */
+    unsigned int uv_offset; /* UV plane offset of the top left corner */
+    int width;
+    int height;
+} face_span_s;
+
+/*
+ * The platform independent part of the camera pipeline: the face store shared
+ * between the face detection and the preview callbacks, the preview filter and
+ * the captured image writer.
+ */
+typedef struct _facefilter {
+    pthread_mutex_t facelock;
+    face_s faces[MAXIMUM_FACE_NUMBER];
+    int face_num;
+    int face_limit; /* Faces kept from a detection, up to MAXIMUM_FACE_NUMBER */
+    zone_s zones[MAXIMUM_ZONE_NUMBER]; /* Static zones masked with the faces */
+    int zone_num;
+    face_span_s zone_spans[MAXIMUM_ZONE_NUMBER]; /* The zones in the geometry */
+    int zone_span_num;
+    face_span_s spans[MAXIMUM_SPAN_NUMBER]; /* Faces and zones, sorted by row */
+    int span_num;
+    int visible_num; /* Faces inside the frame */
+    int frame_width;  /* Geometry the spans were computed for */
+    int frame_height;
+    motion_s motion;
+    bool motion_enabled; /* Expand the masks along the face motion */
+    int detection_interval;  /* Detections applied, one out of N */
+    unsigned int detections; /* Detections received */
+    int shift[MAXIMUM_FACE_NUMBER][2]; /* Face motion since the detection */
+    face_span_s tracked[MAXIMUM_SPAN_NUMBER];
+    bool running; /* Face detection is running, accessed atomically */
+    bool clear_pending; /* Faces lost while the store was held, atomic */
+    unsigned int generation; /* Incremented with every face snapshot */
+    stream_h stream; /* Receives the filtered frames, set while not previewing */
+    shmring_h ring;  /* Exports the frames to other processes */
+    bool ring_raw;   /* Export the frames before the faces are masked */
+    unsigned long long frame_ns; /* Running average of the preview time */
+    bool metrics; /* Counts the frames in the metrics registry */
+} facefilter_s;
+
+int facefilter_init(facefilter_s *filter);
+void facefilter_deinit(facefilter_s *filter);
+void facefilter_set_running(facefilter_s *filter, bool running);
+void facefilter_set_geometry(facefilter_s *filter, int width, int height);
+void facefilter_set_stream(facefilter_s *filter, stream_h stream);
+void facefilter_set_export(facefilter_s *filter, shmring_h ring, bool raw);
+void facefilter_set_motion(facefilter_s *filter, bool enabled);
+void facefilter_set_metrics(facefilter_s *filter, bool enabled);
+void facefilter_set_max_faces(facefilter_s *filter, int max_faces);
+int facefilter_set_zones(facefilter_s *filter, const zone_s *zones, int count);
+void facefilter_set_detection_interval(facefilter_s *filter, int interval);
+size_t facefilter_get_memory(facefilter_s *filter);
+unsigned long long facefilter_get_frame_time(facefilter_s *filter);
+bool facefilter_is_running(facefilter_s *filter);
+void facefilter_faces_detected(facefilter_s *filter, const face_s *faces,
+        int count);
+void facefilter_preview(facefilter_s *filter, frame_s *frame);
+
+int facefilter_write_image(const char *directory, const unsigned char *data,
+        unsigned int size, char *path, size_t path_len);
+int facefilter_write_file(const char *path, const unsigned char *data,
+        unsigned int size);
+
+#endif
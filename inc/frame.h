@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Flora License, Version 1.1 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://floralicense.org/license/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#if !defined(_FRAME_H)
+#define _FRAME_H
+
+/*
+ * Platform independent descriptions of the data delivered by the camera
+ * callbacks. They carry no Tizen types, so the code working on them can be
+ * compiled and run on a host as well.
+ */
+
+/* A preview frame in the NV12 layout (a Y plane followed by an interleaved UV plane). */
+typedef struct _frame {
+    int width;
+    int height;
+    unsigned char *y;
+    unsigned char *uv;
+    unsigned int y_size;
+    unsigned int uv_size;
+    unsigned long long timestamp_us;
+} frame_s;
+
+/* A face reported by the face detection, in preview frame coordinates. */
+typedef struct _face {
+    int id;
+    int score;
+    int x;
+    int y;
+    int width;
+    int height;
+} face_s;
+
+#define MAXIMUM_ZONE_NUMBER 8
+#define ZONE_SCALE 1000
+
+/*
+ * A static privacy zone masked on every frame along with the faces, in
+ * thousandths of the preview frame size so it stays on the same region at
+ * every resolution.
+ */
+typedef struct _zone {
+    int x;
+    int y;
+    int width;
+    int height;
+} zone_s;
+
+#endif
@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Flora License, Version 1.1 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://floralicense.org/license/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#if !defined(_HAL_H)
+#define _HAL_H
+
+#include <stdbool.h>
+#include "frame.h"
+
+/*
+ * Thin platform abstraction over the camera, storage, logging and main loop
+ * services used by the camera pipeline. The Tizen backend (src/hal_tizen.c)
+ * wraps the native APIs, the Linux backend (host/hal_linux.c) feeds recorded
+ * sessions or synthetic frames through the same callbacks.
+ *
+ * All functions returning int return HAL_ERROR_NONE on success, otherwise a
+ * negative, backend specific error code which hal_error_message() describes.
+ * The Tizen backend passes the native error codes through unchanged.
+ */
+
+#define HAL_ERROR_NONE 0
+
+typedef enum {
+    HAL_LOG_DEBUG,
+    HAL_LOG_INFO,
+    HAL_LOG_WARN,
+    HAL_LOG_ERROR,
+} hal_log_priority_e;
+
+typedef enum {
+    HAL_CAMERA_DEVICE_BACK,
+    HAL_CAMERA_DEVICE_FRONT,
+} hal_camera_device_e;
+
+typedef struct _hal_camera *hal_camera_h;
+
+/*
+ * A preview frame held by reference. The frame callback passes one reference
+ * to the callee, which may keep the frame past the callback, hand it to
+ * other threads and modify it in place, and releases it with
+ * hal_frame_unref(). The camera has a small number of frame buffers, so
+ * frames have to be released at the frame rate or the camera drops frames.
+ * All frames must be released before the camera is destroyed.
+ */
+typedef struct _hal_frame *hal_frame_h;
+
+typedef void (*hal_preview_cb)(frame_s *frame, void *user_data);
+typedef void (*hal_frame_cb)(hal_frame_h frame, void *user_data);
+typedef void (*hal_face_detected_cb)(face_s *faces, int count, void *user_data);
+typedef void (*hal_capturing_cb)(const unsigned char *data, unsigned int size,
+        void *user_data);
+typedef void (*hal_capture_completed_cb)(void *user_data);
+typedef bool (*hal_preview_resolution_cb)(int width, int height, void *user_data);
+typedef void (*hal_dispatch_cb)(void *data);
+
+/* Camera */
+int hal_camera_create(hal_camera_device_e device, hal_camera_h *camera);
+void hal_camera_destroy(hal_camera_h camera);
+void *hal_camera_get_native(hal_camera_h camera);
+int hal_camera_start_preview(hal_camera_h camera);
+int hal_camera_stop_preview(hal_camera_h camera);
+int hal_camera_set_preview_cb(hal_camera_h camera, hal_preview_cb callback,
+        void *user_data);
+int hal_camera_unset_preview_cb(hal_camera_h camera);
+int hal_camera_set_frame_cb(hal_camera_h camera, hal_frame_cb callback,
+        void *user_data);
+int hal_camera_unset_frame_cb(hal_camera_h camera);
+int hal_camera_foreach_supported_preview_resolution(hal_camera_h camera,
+        hal_preview_resolution_cb callback, void *user_data);
+int hal_camera_set_preview_resolution(hal_camera_h camera, int width, int height);
+bool hal_camera_is_supported_face_detection(hal_camera_h camera);
+int hal_camera_start_face_detection(hal_camera_h camera,
+        hal_face_detected_cb callback, void *user_data);
+int hal_camera_stop_face_detection(hal_camera_h camera);
+int hal_camera_start_capture(hal_camera_h camera, hal_capturing_cb capturing,
+        hal_capture_completed_cb completed, void *user_data);
+
+/* Frames held by reference */
+frame_s *hal_frame_get(hal_frame_h frame);
+hal_frame_h hal_frame_ref(hal_frame_h frame);
+void hal_frame_unref(hal_frame_h frame);
+
+/* Storage */
+int hal_storage_get_camera_directory(char **path);
+char *hal_get_data_path(void);
+
+/* Device */
+char *hal_get_device_model(void);
+
+/* Logging, deferred while binlog_start() is in effect */
+void hal_log(hal_log_priority_e priority, const char *fmt, ...);
+void hal_log_text(hal_log_priority_e priority, const char *text);
+void hal_set_log_priority(hal_log_priority_e priority);
+const char *hal_error_message(int error_code);
+
+/* Main loop dispatch, callable from any thread */
+int hal_dispatch(hal_dispatch_cb callback, void *data);
+
+#endif
@@ -18,6 +18,7 @@
 #define _MAIN_H_
 
 #include <dlog.h>
+#include "hal.h"
 
 #if !defined(PACKAGE)
 #define PACKAGE "org.example.facecamera"
@@ -28,12 +29,14 @@
 #endif
 #define LOG_TAG "facecamera"
 
-#define _DEBUG_MSG_LOG_BUFFER_SIZE_ 1024
-#define DLOG_PRINT_DEBUG_MSG(fmt, args...) do { char _log_[_DEBUG_MSG_LOG_BUFFER_SIZE_]; \
-    snprintf(_log_, _PRINT_MSG_LOG_BUFFER_SIZE_, fmt, ##args); \
-    dlog_print(DLOG_DEBUG, LOG_TAG, _log_); } while (0)
+/*
+ * Both go through hal_log(), which only records the format and the arguments
+ * while the log is deferred (see binlog.h), so they are cheap on the camera
+ * threads.
+ */
+#define DLOG_PRINT_DEBUG_MSG(fmt, args...) hal_log(HAL_LOG_DEBUG, fmt, ##args)
 
-#define DLOG_PRINT_ERROR(fun_name, error_code) dlog_print(DLOG_ERROR, LOG_TAG, \
+#define DLOG_PRINT_ERROR(fun_name, error_code) hal_log(HAL_LOG_ERROR, \
         "%s() failed! Error: %s [code: %d]", \
         fun_name, get_error_message(error_code), error_code)
 
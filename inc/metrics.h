@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Flora License, Version 1.1 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://floralicense.org/license/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#if !defined(_METRICS_H)
+#define _METRICS_H
+
+/*
+ * Registry of the pipeline metrics, written periodically to a file that a
+ * local collector scrapes, in the Prometheus text format or as JSON.
+ *
+ * The metrics are fixed and updated from any thread without locks: a counter
+ * or gauge update is one atomic operation, a histogram observation two. The
+ * rates are derived from their counter whenever the file is written, over
+ * the time since the previous write. metrics_reset() and metrics_write() are
+ * called from one control thread.
+ */
+
+typedef enum {
+    METRIC_PREVIEW_FRAMES,   /* Counter, frames through the filter */
+    METRIC_PREVIEW_FPS,      /* Rate of METRIC_PREVIEW_FRAMES */
+    METRIC_FILTER_LATENCY,   /* Histogram, ns to filter a frame */
+    METRIC_FACES,            /* Histogram, faces masked per frame */
+    METRIC_DETECTIONS,       /* Counter, face detections received */
+    METRIC_DETECTION_RATE,   /* Rate of METRIC_DETECTIONS */
+    METRIC_FRAMES_UNFILTERED, /* Counter, frames unmasked, face store busy */
+    METRIC_FRAMES_DROPPED,   /* Counter, frames dropped by the stream queue */
+    METRIC_STREAM_QUEUE,     /* Gauge, frames waiting for the transport */
+    METRIC_CAPTURE_LATENCY,  /* Histogram, ns from the photo request to its file */
+    METRIC_BYTES_WRITTEN,    /* Counter, bytes of the stream and the photos */
+    METRIC_NUMBER,
+} metric_e;
+
+typedef enum {
+    METRICS_PROMETHEUS,
+    METRICS_JSON,
+} metrics_format_e;
+
+void metrics_reset(void);
+void metrics_add(metric_e id, unsigned long long value);
+void metrics_set(metric_e id, unsigned long long value);
+void metrics_observe(metric_e id, unsigned long long value);
+int metrics_write(const char *path, metrics_format_e format);
+
+#endif
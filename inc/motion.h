@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Flora License, Version 1.1 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://floralicense.org/license/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#if !defined(_MOTION_H)
+#define _MOTION_H
+
+#include <stdbool.h>
+#include "frame.h"
+
+/* Downscaling factor of the luma used for the motion search. */
+#define MOTION_SCALE 4
+/* Search range in downscaled samples, i.e. +-16 pixels per frame. */
+#define MOTION_SEARCH_RANGE 4
+/* Maximum number of samples per block side compared by the search. */
+#define MOTION_BLOCK_SAMPLES 16
+
+/*
+ * Cheap motion estimation on a downscaled copy of the luma of the last two
+ * preview frames, used to follow faces between two detections.
+ */
+typedef struct _motion {
+    int width;  /* Downscaled geometry */
+    int height;
+    unsigned char *prev;
+    unsigned char *cur;
+    bool has_prev;
+} motion_s;
+
+void motion_init(motion_s *motion);
+void motion_deinit(motion_s *motion);
+void motion_release(motion_s *motion);
+int motion_update(motion_s *motion, const frame_s *frame);
+void motion_estimate(const motion_s *motion, const face_s *face, int *dx,
+        int *dy);
+
+#endif
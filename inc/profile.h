@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Flora License, Version 1.1 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://floralicense.org/license/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#if !defined(_PROFILE_H)
+#define _PROFILE_H
+
+#include <stdbool.h>
+#include "config.h"
+#include "facefilter.h"
+#include "stream.h"
+
+/*
+ * Predefined settings of the pipeline the application switches to when the
+ * system runs low on memory or battery. A profile only lowers the configured
+ * settings, and several profiles apply together by taking the cheaper value
+ * of every setting.
+ *
+ * All the settings apply to a running preview, except the resolution which
+ * needs a preview restart and is left to the application.
+ */
+
+typedef enum {
+    PROFILE_NORMAL,      /* The configured settings */
+    PROFILE_LOW_MEMORY,  /* Smaller queues, no motion buffers */
+    PROFILE_LOW_BATTERY, /* Lower resolution, fewer detections, plain masks */
+    PROFILE_NUMBER,
+} profile_e;
+
+typedef struct _profile {
+    const char *name;
+    bool motion;             /* Masks expanded along the face motion */
+    int detection_interval;  /* Face detections applied, one out of N */
+    int preview_max_width;   /* 0 to keep the configured limit */
+    int stream_queue_length; /* 0 to keep the configured length */
+} profile_s;
+
+const profile_s *profile_get(profile_e id);
+const profile_s *profile_find(const char *name);
+void profile_combine(profile_s *profile, const profile_s *other);
+void profile_apply(const profile_s *profile, const config_s *config,
+        facefilter_s *filter, stream_h stream);
+int profile_get_max_width(const profile_s *profile, const config_s *config);
+
+#endif
@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Flora License, Version 1.1 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://floralicense.org/license/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#if !defined(_SESSION_H)
+#define _SESSION_H
+
+#include <stdbool.h>
+#include "frame.h"
+
+/*
+ * Session file layout (all integers little endian):
+ *
+ *   header:  "FFSR" u32 version
+ *   chunk:   tag[4] u32 payload_size u64 timestamp_us payload
+ *
+ *   "FRME"  u16 width u16 height u8 decimation u8 planes u16 reserved
+ *           Y plane (width/decimation * height/decimation bytes)
+ *           UV plane (only when planes == 2, stored at full resolution)
+ *   "FACE"  u32 count, count * (i32 id, score, x, y, width, height)
+ *   "CAPT"  u32 size u8 has_data, followed by size bytes when has_data
+ *   "END "  empty, written when the recording is stopped
+ */
+
+#define SESSION_FILE_VERSION 1
+
+typedef enum {
+    SESSION_ERROR_NONE = 0,
+    SESSION_ERROR_INVALID_PARAMETER = -1,
+    SESSION_ERROR_IO = -2,
+    SESSION_ERROR_FORMAT = -3,
+    SESSION_ERROR_OUT_OF_MEMORY = -4,
+    SESSION_ERROR_INVALID_STATE = -5,
+} session_error_e;
+
+typedef struct _session_options {
+    int frame_interval; /* Record every n-th preview frame, 1 records all of them */
+    int decimation;     /* Spatial subsampling of the recorded Y plane: 1, 2 or 4 */
+    bool capture_data;  /* Store the encoded image of capture events */
+} session_options_s;
+
+typedef enum {
+    SESSION_REPLAY_REALTIME, /* Keep the recorded time between events */
+    SESSION_REPLAY_MAX_SPEED, /* Deliver the events back to back */
+} session_replay_speed_e;
+
+typedef struct _session_callbacks {
+    void (*preview)(frame_s *frame, void *user_data);
+    void (*faces)(face_s *faces, int count, void *user_data);
+    void (*capture)(const unsigned char *data, unsigned int size, void *user_data);
+    bool (*keep_going)(void *user_data); /* Optional, return false to abort the replay */
+} session_callbacks_s;
+
+typedef struct _session_recorder *session_recorder_h;
+
+void session_options_default(session_options_s *options);
+
+int session_recorder_create(session_recorder_h *recorder);
+int session_recorder_start(session_recorder_h recorder, const char *path,
+        const session_options_s *options);
+int session_recorder_stop(session_recorder_h recorder);
+bool session_recorder_is_recording(session_recorder_h recorder);
+void session_recorder_destroy(session_recorder_h recorder);
+
+void session_recorder_frame(session_recorder_h recorder, const frame_s *frame);
+void session_recorder_faces(session_recorder_h recorder, const face_s *faces,
+        int count);
+void session_recorder_capture(session_recorder_h recorder,
+        const unsigned char *data, unsigned int size);
+
+int session_replay(const char *path, session_replay_speed_e speed,
+        const session_callbacks_s *callbacks, void *user_data);
+
+#endif
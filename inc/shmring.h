@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Flora License, Version 1.1 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://floralicense.org/license/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#if !defined(_SHMRING_H)
+#define _SHMRING_H
+
+#include <stdbool.h>
+#include "frame.h"
+
+/*
+ * Export of the preview frames and their faces to other processes through a
+ * POSIX shared memory ring.
+ *
+ * The writer copies every frame once into the next slot of the ring and never
+ * waits for the readers; a reader that falls behind by more than the ring
+ * length skips to the newest frame. Readers get the frames in place and check
+ * after processing that the writer did not reuse the slot meanwhile. New
+ * frames are signalled with a futex on the frame counter in the ring header.
+ *
+ * Layout, all in the native byte order of the device:
+ *   shmring_header_s, then slot_count times
+ *   shmring_slot_s followed by slot_size bytes of Y and UV planes.
+ */
+
+#define SHMRING_MAGIC 0x4d534646 /* "FFSM" */
+#define SHMRING_VERSION 1
+#define SHMRING_MAX_FACES 8
+
+typedef struct _shmring_header {
+    unsigned int magic;
+    unsigned int version;
+    unsigned int slot_count;
+    unsigned int slot_size;  /* Bytes of pixel data per slot */
+    unsigned int published;  /* Frame counter, the futex word */
+    unsigned int waiters;    /* Readers sleeping on the futex */
+    unsigned int reserved[2];
+} shmring_header_s;
+
+typedef struct _shmring_slot {
+    unsigned int sequence;   /* 2n + 1 while frame n is written, 2n + 2 once done */
+    unsigned int raw;        /* The faces were not masked */
+    unsigned int generation; /* Face snapshot generation */
+    unsigned int face_num;
+    int width;
+    int height;
+    unsigned int y_size;
+    unsigned int uv_size;
+    unsigned long long timestamp_us;
+    face_s faces[SHMRING_MAX_FACES];
+} shmring_slot_s;
+
+/* A frame read in place from the ring. */
+typedef struct _shmring_frame {
+    frame_s frame;
+    const face_s *faces;
+    int face_num;
+    unsigned int generation;
+    bool raw;
+    unsigned int number;   /* Frame number since the ring was created */
+    unsigned int sequence; /* Slot sequence the frame was read with */
+} shmring_frame_s;
+
+typedef struct _shmring *shmring_h;
+
+int shmring_create(const char *name, int slot_count, unsigned int slot_size,
+        shmring_h *ring);
+void shmring_destroy(shmring_h ring);
+int shmring_publish(shmring_h ring, const frame_s *frame, const face_s *faces,
+        int face_num, unsigned int generation, bool raw);
+
+int shmring_open(const char *name, shmring_h *reader);
+void shmring_close(shmring_h reader);
+int shmring_next(shmring_h reader, int timeout_ms, shmring_frame_s *frame);
+int shmring_release(shmring_h reader, const shmring_frame_s *frame);
+unsigned int shmring_get_skipped(shmring_h reader);
+
+#endif
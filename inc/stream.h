@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Flora License, Version 1.1 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://floralicense.org/license/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#if !defined(_STREAM_H)
+#define _STREAM_H
+
+#include <stddef.h>
+#include "frame.h"
+
+/*
+ * Streaming output of the filtered preview frames.
+ *
+ * Frames are copied into a bounded queue of preallocated slots by the preview
+ * filter, right after the faces of the current snapshot have been masked, and
+ * handed to the transport by a sender thread. When the transport falls behind
+ * the queue drops frames according to the drop policy instead of blocking the
+ * camera thread.
+ *
+ * Each frame is sent as a 32 byte little endian header followed by the Y and
+ * UV planes:
+ *   "FFRM" u32 width u32 height u32 generation u64 timestamp_us
+ *   u32 y_size u32 uv_size
+ */
+
+#define STREAM_FRAME_HEADER_SIZE 32
+
+typedef enum {
+    STREAM_DROP_OLDEST, /* Replace the oldest queued frame, keeps latency low */
+    STREAM_DROP_NEWEST, /* Discard the incoming frame, keeps the queue intact */
+} stream_drop_policy_e;
+
+typedef struct _stream_transport {
+    const char *name;
+    int (*open)(void **context, const char *target);
+    int (*send)(void *context, const unsigned char *header,
+            const frame_s *frame);
+    void (*close)(void *context);
+} stream_transport_s;
+
+typedef struct _stream_stats {
+    unsigned long pushed;     /* Frames accepted into the queue */
+    unsigned long sent;       /* Frames delivered to the transport */
+    unsigned long dropped;    /* Frames dropped under backpressure */
+    unsigned long unfiltered; /* Frames refused as they were not filtered */
+    unsigned long errors;     /* Failed transport sends */
+} stream_stats_s;
+
+typedef struct _stream *stream_h;
+
+extern const stream_transport_s stream_transport_file;
+extern const stream_transport_s stream_transport_unix;
+
+int stream_create(const stream_transport_s *transport, const char *target,
+        int queue_length, stream_drop_policy_e policy, stream_h *stream);
+int stream_create_from_uri(const char *uri, int queue_length,
+        stream_drop_policy_e policy, stream_h *stream);
+void stream_destroy(stream_h stream);
+int stream_push(stream_h stream, const frame_s *frame, unsigned int generation);
+void stream_refuse_unfiltered(stream_h stream);
+int stream_set_queue_length(stream_h stream, int queue_length);
+size_t stream_get_memory(stream_h stream);
+void stream_get_stats(stream_h stream, stream_stats_s *stats);
+
+#endif
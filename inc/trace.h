@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Flora License, Version 1.1 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://floralicense.org/license/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#if !defined(_TRACE_H)
+#define _TRACE_H
+
+#include <stdbool.h>
+
+/* Threads that can record events at the same time. */
+#define TRACE_THREADS 32
+/* Events kept per thread, the older ones are overwritten. */
+#define TRACE_EVENTS 16384
+
+/*
+ * Timeline of the pipeline stages across the threads, written as Chrome
+ * trace events (JSON), which chrome://tracing and the Perfetto UI open.
+ *
+ * Every thread records into a ring of its own, taken on its first event, so
+ * recording is a few stores without locks. The rings keep the latest
+ * TRACE_EVENTS events of every thread and can be written out at any time,
+ * while the threads keep recording. Event names must be string literals or
+ * other strings that live as long as the trace.
+ *
+ * trace_start(), trace_stop(), trace_write() and trace_release() are called
+ * from one control thread. While the trace is stopped the macros below cost
+ * one load.
+ */
+
+extern int trace_enabled;
+
+#define TRACE_IS_ENABLED() __atomic_load_n(&trace_enabled, __ATOMIC_RELAXED)
+#define TRACE_BEGIN(name) \
+    do { if (TRACE_IS_ENABLED()) trace_event('B', (name)); } while (0)
+#define TRACE_END(name) \
+    do { if (TRACE_IS_ENABLED()) trace_event('E', (name)); } while (0)
+#define TRACE_INSTANT(name) \
+    do { if (TRACE_IS_ENABLED()) trace_event('i', (name)); } while (0)
+
+void trace_start(void);
+void trace_stop(void);
+void trace_event(char phase, const char *name);
+void trace_set_thread_name(const char *name);
+int trace_write(const char *path);
+void trace_release(void);
+
+#endif
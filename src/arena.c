@@ -0,0 +1,282 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Flora License, Version 1.1 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://floralicense.org/license/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "arena.h"
+#include "hal.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Alignment of the blocks, enough for any type and for vector loads. */
+#define ARENA_ALIGN 16
+
+typedef struct _arena_chunk {
+    struct _arena_chunk *next;
+    size_t size;  /* Usable bytes after the header */
+    size_t used;
+} arena_chunk_s;
+
+/* Precedes every block, keeps the block aligned. */
+typedef struct _arena_block {
+    size_t size;
+    int owner;
+} __attribute__((aligned(ARENA_ALIGN))) arena_block_s;
+
+struct _arena {
+    pthread_mutex_t lock;
+    arena_chunk_s *chunks;  /* The current chunk first */
+    size_t reserved;
+    arena_usage_s owners[ARENA_OWNERS];
+    int owner_count;
+};
+
+#define CHUNK_HEADER_SIZE \
+    ((sizeof(arena_chunk_s) + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1))
+
+static unsigned char *_chunk_data(arena_chunk_s *chunk)
+{
+    return (unsigned char *) chunk + CHUNK_HEADER_SIZE;
+}
+
+/**
+ * @brief Creates an empty arena. The first chunk is taken on the first
+ *        allocation.
+ *
+ * @param arena  The handle of the newly created arena
+ *
+ * @return 0 on success, otherwise a negative errno value
+ */
+int arena_create(arena_h *arena)
+{
+    if (NULL == arena)
+        return -EINVAL;
+
+    arena_h a = (arena_h) calloc(1, sizeof(*a));
+    if (NULL == a)
+        return -ENOMEM;
+
+    pthread_mutex_init(&a->lock, NULL);
+    *arena = a;
+
+    return 0;
+}
+
+/**
+ * @brief Releases all the memory of the arena at once.
+ */
+void arena_destroy(arena_h arena)
+{
+    if (NULL == arena)
+        return;
+
+    arena_chunk_s *chunk = arena->chunks;
+    while (NULL != chunk) {
+        arena_chunk_s *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+
+    pthread_mutex_destroy(&arena->lock);
+    free(arena);
+}
+
+/* Finds or adds the accounting of an owner, the lock is held. */
+static int _owner(arena_h arena, const char *owner)
+{
+    if (NULL == owner)
+        owner = "other";
+
+    for (int i = 0; i < arena->owner_count; i++) {
+        if (0 == strcmp(arena->owners[i].owner, owner))
+            return i;
+    }
+
+    /* The last entry takes the owners beyond the table. */
+    if (arena->owner_count == ARENA_OWNERS)
+        return ARENA_OWNERS - 1;
+
+    arena->owners[arena->owner_count].owner = owner;
+
+    return arena->owner_count++;
+}
+
+/**
+ * @brief Allocates a block of the arena.
+ *
+ * @param arena  The arena, NULL to use malloc()
+ * @param owner  The subsystem the block is accounted to, a string which
+ *               outlives the arena
+ * @param size   The size of the block in bytes
+ *
+ * @return The block aligned to 16 bytes, NULL if out of memory
+ */
+void *arena_alloc(arena_h arena, const char *owner, size_t size)
+{
+    if (NULL == arena)
+        return malloc(size);
+
+    size_t needed = sizeof(arena_block_s)
+            + ((size + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1));
+    if (needed < size)
+        return NULL;
+
+    pthread_mutex_lock(&arena->lock);
+
+    arena_chunk_s *chunk = arena->chunks;
+    if (NULL == chunk || chunk->size - chunk->used < needed) {
+        size_t chunk_size = (needed > ARENA_CHUNK_SIZE) ? needed : ARENA_CHUNK_SIZE;
+
+        chunk = (arena_chunk_s *) malloc(CHUNK_HEADER_SIZE + chunk_size);
+        if (NULL == chunk) {
+            pthread_mutex_unlock(&arena->lock);
+            return NULL;
+        }
+        chunk->size = chunk_size;
+        chunk->used = 0;
+        arena->reserved += CHUNK_HEADER_SIZE + chunk_size;
+
+        /* A dedicated chunk goes behind the current one, which stays open. */
+        if (NULL != arena->chunks && chunk_size > ARENA_CHUNK_SIZE) {
+            chunk->next = arena->chunks->next;
+            arena->chunks->next = chunk;
+        } else {
+            chunk->next = arena->chunks;
+            arena->chunks = chunk;
+        }
+    }
+
+    arena_block_s *block = (arena_block_s *) (_chunk_data(chunk) + chunk->used);
+    chunk->used += needed;
+    block->size = needed;
+    block->owner = _owner(arena, owner);
+
+    arena_usage_s *usage = &arena->owners[block->owner];
+    usage->used += needed;
+    usage->blocks++;
+    if (usage->used > usage->peak)
+        usage->peak = usage->used;
+
+    pthread_mutex_unlock(&arena->lock);
+
+    return block + 1;
+}
+
+/**
+ * @brief Releases a block of the arena.
+ * @details The memory of the last block of the current chunk is reused, the
+ *          memory of the other blocks only when the arena is destroyed.
+ *
+ * @param arena  The arena the block was allocated from, NULL to use free()
+ * @param block  The block, may be NULL
+ */
+void arena_free(arena_h arena, void *block)
+{
+    if (NULL == arena) {
+        free(block);
+        return;
+    }
+    if (NULL == block)
+        return;
+
+    arena_block_s *header = (arena_block_s *) block - 1;
+
+    pthread_mutex_lock(&arena->lock);
+
+    arena_usage_s *usage = &arena->owners[header->owner];
+    usage->used -= header->size;
+    usage->blocks--;
+
+    arena_chunk_s *chunk = arena->chunks;
+    if ((unsigned char *) header + header->size == _chunk_data(chunk) + chunk->used)
+        chunk->used -= header->size;
+
+    pthread_mutex_unlock(&arena->lock);
+}
+
+/**
+ * @brief Copies a string into the arena.
+ *
+ * @return The copy, NULL if out of memory
+ */
+char *arena_strdup(arena_h arena, const char *owner, const char *text)
+{
+    if (NULL == text)
+        return NULL;
+
+    size_t size = strlen(text) + 1;
+    char *copy = (char *) arena_alloc(arena, owner, size);
+    if (NULL != copy)
+        memcpy(copy, text, size);
+
+    return copy;
+}
+
+/**
+ * @brief Returns the usage of the owners of the arena.
+ *
+ * @param arena  The arena
+ * @param usage  Array receiving the usage of every owner
+ * @param count  The size of the array
+ *
+ * @return The number of owners written
+ */
+int arena_get_usage(arena_h arena, arena_usage_s *usage, int count)
+{
+    if (NULL == arena || NULL == usage || count < 0)
+        return 0;
+
+    pthread_mutex_lock(&arena->lock);
+    if (count > arena->owner_count)
+        count = arena->owner_count;
+    memcpy(usage, arena->owners, sizeof(arena_usage_s) * count);
+    pthread_mutex_unlock(&arena->lock);
+
+    return count;
+}
+
+/**
+ * @brief Returns the memory taken from the system by the arena in bytes.
+ */
+size_t arena_get_reserved(arena_h arena)
+{
+    if (NULL == arena)
+        return 0;
+
+    pthread_mutex_lock(&arena->lock);
+    size_t reserved = arena->reserved;
+    pthread_mutex_unlock(&arena->lock);
+
+    return reserved;
+}
+
+/**
+ * @brief Logs the peak usage of every owner and the memory reserved.
+ */
+void arena_log_usage(arena_h arena)
+{
+    arena_usage_s usage[ARENA_OWNERS];
+    int count = arena_get_usage(arena, usage, ARENA_OWNERS);
+    size_t total = 0;
+
+    for (int i = 0; i < count; i++) {
+        hal_log(HAL_LOG_INFO, "arena: %-10s peak %8zu bytes, %8zu in %lu block(s)",
+                usage[i].owner, usage[i].peak, usage[i].used, usage[i].blocks);
+        total += usage[i].peak;
+    }
+    hal_log(HAL_LOG_INFO, "arena: peaks %zu bytes, reserved %zu bytes", total,
+            arena_get_reserved(arena));
+}
@@ -0,0 +1,462 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Flora License, Version 1.1 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://floralicense.org/license/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "bench.h"
+#include "facefilter.h"
+#include "hal.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_ROUNDS 5
+#define BENCH_ROUND_NS 50000000ULL
+#define BENCH_FACES 2
+#define BENCH_RING_NAME "/facecamera-bench"
+#define BENCH_STREAM_FILE_NAME "bench.raw"
+#define BENCH_PHOTO_FILE_NAME "bench.jpg"
+#define BENCH_PATH_MAX 512
+
+typedef struct _bench_context {
+    frame_s frame;          /* Copy of the source, modified by the filter */
+    const char *directory;
+    face_s faces[BENCH_FACES];
+    facefilter_s filter;
+    motion_s motion;
+    shmring_h ring;
+    void *stream;           /* Context of the file transport */
+    unsigned char header[STREAM_FRAME_HEADER_SIZE];
+    char path[BENCH_PATH_MAX];
+} bench_context_s;
+
+typedef struct _bench_case {
+    const char *name;
+    int max_iterations;
+    bool storage;
+    int (*setup)(bench_context_s *context);
+    void (*run)(bench_context_s *context);
+    void (*teardown)(bench_context_s *context);
+} bench_case_s;
+
+static unsigned long long _now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int _compare(const void *a, const void *b)
+{
+    double x = *(const double *) a;
+    double y = *(const double *) b;
+
+    return (x > y) - (x < y);
+}
+
+static int _filter_setup(bench_context_s *context, bool motion, int faces)
+{
+    int error = facefilter_init(&context->filter);
+    if (0 != error)
+        return error;
+
+    /* The timed frames are not those of the camera. */
+    facefilter_set_metrics(&context->filter, false);
+    facefilter_set_geometry(&context->filter, context->frame.width,
+            context->frame.height);
+    facefilter_set_motion(&context->filter, motion);
+    facefilter_set_running(&context->filter, true);
+    facefilter_faces_detected(&context->filter, context->faces, faces);
+
+    return 0;
+}
+
+static int _mask_setup(bench_context_s *context)
+{
+    return _filter_setup(context, false, BENCH_FACES);
+}
+
+static int _track_setup(bench_context_s *context)
+{
+    return _filter_setup(context, true, BENCH_FACES);
+}
+
+static int _idle_setup(bench_context_s *context)
+{
+    return _filter_setup(context, false, 0);
+}
+
+static void _filter_run(bench_context_s *context)
+{
+    facefilter_preview(&context->filter, &context->frame);
+}
+
+static void _filter_teardown(bench_context_s *context)
+{
+    facefilter_deinit(&context->filter);
+}
+
+static int _motion_setup(bench_context_s *context)
+{
+    motion_init(&context->motion);
+
+    /* Two frames, so the search has a previous one. */
+    int error = motion_update(&context->motion, &context->frame);
+    if (0 == error)
+        error = motion_update(&context->motion, &context->frame);
+    if (0 != error)
+        motion_deinit(&context->motion);
+
+    return error;
+}
+
+static void _downscale_run(bench_context_s *context)
+{
+    motion_update(&context->motion, &context->frame);
+}
+
+static void _search_run(bench_context_s *context)
+{
+    int dx;
+    int dy;
+
+    for (int i = 0; i < BENCH_FACES; i++)
+        motion_estimate(&context->motion, &context->faces[i], &dx, &dy);
+}
+
+static void _motion_teardown(bench_context_s *context)
+{
+    motion_deinit(&context->motion);
+}
+
+static int _spans_setup(bench_context_s *context)
+{
+    return _filter_setup(context, false, 0);
+}
+
+/* Converts the detected faces into the masks of the frame geometry. */
+static void _spans_run(bench_context_s *context)
+{
+    facefilter_faces_detected(&context->filter, context->faces, BENCH_FACES);
+}
+
+static int _export_setup(bench_context_s *context)
+{
+    return shmring_create(BENCH_RING_NAME, 2,
+            context->frame.y_size + context->frame.uv_size, &context->ring);
+}
+
+static void _export_run(bench_context_s *context)
+{
+    shmring_publish(context->ring, &context->frame, context->faces, BENCH_FACES,
+            0, false);
+}
+
+static void _export_teardown(bench_context_s *context)
+{
+    shmring_destroy(context->ring);
+    context->ring = NULL;
+}
+
+static int _stream_setup(bench_context_s *context)
+{
+    snprintf(context->path, sizeof(context->path), "%s%s", context->directory,
+            BENCH_STREAM_FILE_NAME);
+    memset(context->header, 0, sizeof(context->header));
+    memcpy(context->header, "FFRM", 4);
+
+    return stream_transport_file.open(&context->stream, context->path);
+}
+
+static void _stream_run(bench_context_s *context)
+{
+    stream_transport_file.send(context->stream, context->header, &context->frame);
+}
+
+static void _stream_teardown(bench_context_s *context)
+{
+    stream_transport_file.close(context->stream);
+    context->stream = NULL;
+    remove(context->path);
+}
+
+static int _photo_setup(bench_context_s *context)
+{
+    snprintf(context->path, sizeof(context->path), "%s%s", context->directory,
+            BENCH_PHOTO_FILE_NAME);
+
+    return 0;
+}
+
+/*
+ * Writes the luma as a stand-in for an encoded photo of the same size. Every
+ * run replaces the same file, the photo names of the camera would differ by
+ * the second only.
+ */
+static void _photo_run(bench_context_s *context)
+{
+    facefilter_write_file(context->path, context->frame.y, context->frame.y_size);
+}
+
+static void _photo_teardown(bench_context_s *context)
+{
+    remove(context->path);
+}
+
+static const bench_case_s s_cases[BENCH_CASES] = {
+    { "filter mask", 100000, false,
+            _mask_setup, _filter_run, _filter_teardown },
+    { "filter track + mask", 100000, false,
+            _track_setup, _filter_run, _filter_teardown },
+    { "filter no faces", 100000, false,
+            _idle_setup, _filter_run, _filter_teardown },
+    { "motion downscale", 100000, false,
+            _motion_setup, _downscale_run, _motion_teardown },
+    { "motion search", 100000, false,
+            _motion_setup, _search_run, _motion_teardown },
+    { "face spans", 100000, false,
+            _spans_setup, _spans_run, _filter_teardown },
+    { "export copy", 100000, false,
+            _export_setup, _export_run, _export_teardown },
+    { "stream writer", 8, true,
+            _stream_setup, _stream_run, _stream_teardown },
+    { "photo writer", 4, true,
+            _photo_setup, _photo_run, _photo_teardown },
+};
+
+/**
+ * @brief Fills a frame with a synthetic scene: a textured luma, so the
+ *        motion search has something to match, and neutral chroma.
+ *
+ * @param width   The frame width, even
+ * @param height  The frame height, even
+ * @param frame   The frame, to be freed with bench_frame_free()
+ *
+ * @return 0 on success, otherwise a negative errno value
+ */
+int bench_frame_create(int width, int height, frame_s *frame)
+{
+    if (width <= 0 || height <= 0 || 0 != (width | height) % 2 || NULL == frame)
+        return -EINVAL;
+
+    unsigned int y_size = (unsigned int) width * height;
+    unsigned char *buffer = (unsigned char *) malloc(y_size * 3 / 2);
+    if (NULL == buffer)
+        return -ENOMEM;
+
+    for (int y = 0; y < height; y++)
+        for (int x = 0; x < width; x++)
+            buffer[y * width + x] =
+                    (unsigned char) ((x * 7 + y * 3 + (x * y) % 13) & 0xff);
+    memset(buffer + y_size, 128, y_size / 2);
+
+    memset(frame, 0, sizeof(*frame));
+    frame->width = width;
+    frame->height = height;
+    frame->y = buffer;
+    frame->uv = buffer + y_size;
+    frame->y_size = y_size;
+    frame->uv_size = y_size / 2;
+
+    return 0;
+}
+
+/**
+ * @brief Copies a frame into a buffer of its own.
+ *
+ * @param source  The frame to copy, e.g. a live preview frame
+ * @param frame   The copy, to be freed with bench_frame_free()
+ *
+ * @return 0 on success, otherwise a negative errno value
+ */
+int bench_frame_copy(const frame_s *source, frame_s *frame)
+{
+    if (NULL == source || NULL == source->y || NULL == frame)
+        return -EINVAL;
+
+    unsigned int uv_size = (NULL != source->uv) ? source->uv_size : 0;
+    unsigned char *buffer = (unsigned char *) malloc(source->y_size + uv_size);
+    if (NULL == buffer)
+        return -ENOMEM;
+
+    memcpy(buffer, source->y, source->y_size);
+    if (uv_size > 0)
+        memcpy(buffer + source->y_size, source->uv, uv_size);
+
+    *frame = *source;
+    frame->y = buffer;
+    frame->uv = (uv_size > 0) ? buffer + source->y_size : NULL;
+    frame->uv_size = uv_size;
+
+    return 0;
+}
+
+void bench_frame_free(frame_s *frame)
+{
+    if (NULL == frame)
+        return;
+
+    free(frame->y);
+    frame->y = NULL;
+    frame->uv = NULL;
+}
+
+/* Times the rounds of a case, the first one calibrates the iterations. */
+static void _run_case(const bench_case_s *bench_case, bench_context_s *context,
+                      const frame_s *source, bench_result_s *result)
+{
+    unsigned int uv_size = (NULL != source->uv) ? source->uv_size : 0;
+    double rounds[BENCH_ROUNDS];
+    int iterations = 1;
+
+    result->name = bench_case->name;
+    result->ns_per_frame = 0.0;
+    result->fps = 0.0;
+    result->iterations = 0;
+    result->error = 0;
+    result->storage = bench_case->storage;
+
+    for (int r = -1; r < BENCH_ROUNDS; r++) {
+        memcpy(context->frame.y, source->y, source->y_size);
+        if (uv_size > 0)
+            memcpy(context->frame.uv, source->uv, uv_size);
+
+        int error = bench_case->setup(context);
+        if (0 != error) {
+            result->error = error;
+            return;
+        }
+
+        unsigned long long start = _now_ns();
+        for (int i = 0; i < iterations; i++)
+            bench_case->run(context);
+        unsigned long long elapsed = _now_ns() - start;
+
+        bench_case->teardown(context);
+
+        if (r < 0) {
+            unsigned long long count = BENCH_ROUND_NS / (elapsed + 1);
+            iterations = (count < 1) ? 1
+                    : (count > (unsigned long long) bench_case->max_iterations)
+                    ? bench_case->max_iterations : (int) count;
+        } else {
+            rounds[r] = (double) elapsed / iterations;
+        }
+    }
+
+    qsort(rounds, BENCH_ROUNDS, sizeof(double), _compare);
+    result->ns_per_frame = rounds[BENCH_ROUNDS / 2];
+    result->fps = (result->ns_per_frame > 0) ? 1e9 / result->ns_per_frame : 0.0;
+    result->iterations = iterations;
+}
+
+/**
+ * @brief Runs the benchmark suite on a frame.
+ *
+ * @param frame        The frame, left untouched
+ * @param directory    The directory the writers write into, ending with '/'
+ * @param results      Receives the result of every case
+ * @param max_results  The size of @p results, BENCH_CASES for all cases
+ *
+ * @return The number of results, otherwise a negative errno value
+ */
+int bench_run(const frame_s *frame, const char *directory,
+              bench_result_s *results, int max_results)
+{
+    if (NULL == frame || NULL == frame->y || frame->width <= 0
+            || frame->height <= 0 || NULL == directory || NULL == results)
+        return -EINVAL;
+
+    bench_context_s context;
+    memset(&context, 0, sizeof(context));
+    context.directory = directory;
+
+    int error = bench_frame_copy(frame, &context.frame);
+    if (0 != error)
+        return error;
+
+    /* Faces of a quarter of the frame height, apart from each other. */
+    int size = frame->height / 4;
+    for (int i = 0; i < BENCH_FACES; i++) {
+        context.faces[i].id = i;
+        context.faces[i].score = 100;
+        context.faces[i].x = frame->width / 8 + i * frame->width / 2;
+        context.faces[i].y = frame->height / 4;
+        context.faces[i].width = size;
+        context.faces[i].height = size;
+    }
+
+    int count = (max_results < BENCH_CASES) ? max_results : BENCH_CASES;
+    for (int i = 0; i < count; i++) {
+        _run_case(&s_cases[i], &context, frame, &results[i]);
+        if (0 != results[i].error)
+            hal_log(HAL_LOG_WARN, "bench: %s failed: %s", results[i].name,
+                    hal_error_message(results[i].error));
+    }
+
+    bench_frame_free(&context.frame);
+
+    return count;
+}
+
+/**
+ * @brief Writes the results of a run as JSON, with the device model, so the
+ *        reports of several devices can be compared.
+ *
+ * @param path     The file to write
+ * @param source   Where the frame came from, e.g. "synthetic" or "live"
+ * @param frame    The frame of the run
+ * @param results  The results of bench_run()
+ * @param count    The number of results
+ *
+ * @return 0 on success, otherwise a negative errno value
+ */
+int bench_write_report(const char *path, const char *source,
+                       const frame_s *frame, const bench_result_s *results,
+                       int count)
+{
+    if (NULL == path || NULL == source || NULL == frame || NULL == results)
+        return -EINVAL;
+
+    FILE *file = fopen(path, "w");
+    if (NULL == file)
+        return -errno;
+
+    char *model = hal_get_device_model();
+    fprintf(file, "{\"model\":\"%s\",\"source\":\"%s\",\"timestamp\":%lld,"
+            "\"width\":%d,\"height\":%d,\"faces\":%d,\"results\":[",
+            (NULL != model) ? model : "unknown", source, (long long) time(NULL),
+            frame->width, frame->height, BENCH_FACES);
+    free(model);
+
+    for (int i = 0; i < count; i++) {
+        const bench_result_s *result = &results[i];
+
+        fprintf(file, "%s\n{\"name\":\"%s\",", (i > 0) ? "," : "", result->name);
+        if (0 != result->error)
+            fprintf(file, "\"error\":\"%s\"}", hal_error_message(result->error));
+        else
+            fprintf(file, "\"ns_per_frame\":%.0f,\"fps\":%.1f,\"iterations\":%d}",
+                    result->ns_per_frame, result->fps, result->iterations);
+    }
+    fprintf(file, "\n]}\n");
+
+    int error = ferror(file) ? -EIO : 0;
+    if (0 != fclose(file) && 0 == error)
+        error = -errno;
+
+    return error;
+}
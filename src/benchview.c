@@ -0,0 +1,297 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Flora License, Version 1.1 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://floralicense.org/license/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "main.h"
+#include "view.h"
+#include "data.h"
+#include "hal.h"
+#include "bench.h"
+#include "benchview.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Resolution of the synthetic frame, a common preview resolution. */
+#define BENCH_SYNTHETIC_WIDTH 640
+#define BENCH_SYNTHETIC_HEIGHT 480
+
+/* A run of the suite, handed from the main loop to its thread and back. */
+typedef struct _bench_job {
+    frame_s frame;
+    const char *source;
+    char *directory;
+    bench_result_s results[BENCH_CASES];
+    int count;
+} bench_job_s;
+
+static struct {
+    Evas_Object *display;
+    Evas_Object *synthetic_bt;
+    Evas_Object *live_bt;
+    bool running;  /* A run is in progress, the view stays */
+    bool grabbing; /* Waiting for a live frame */
+} s_bench;
+
+static void _job_free(bench_job_s *job)
+{
+    bench_frame_free(&job->frame);
+    free(job->directory);
+    free(job);
+}
+
+/**
+ * @brief Enables the buttons when no run is in progress.
+ */
+static void _show_running(void)
+{
+    Eina_Bool busy = (s_bench.running || s_bench.grabbing) ? EINA_TRUE : EINA_FALSE;
+
+    if (NULL == s_bench.display)
+        return;
+    elm_object_disabled_set(s_bench.synthetic_bt, busy);
+    elm_object_disabled_set(s_bench.live_bt, busy);
+}
+
+/**
+ * @brief Shows the results of a run and writes its report.
+ * @remarks This function matches the hal_dispatch_cb() signature defined in
+ *          the hal.h header file.
+ *
+ * @param data  The finished job
+ */
+static void _bench_done(void *data)
+{
+    bench_job_s *job = (bench_job_s *) data;
+
+    if (job->count < 0) {
+        PRINT_MSG("The benchmark failed: %s", hal_error_message(job->count));
+    } else {
+        PRINT_MSG("%s frame %dx%d:", job->source, job->frame.width,
+                job->frame.height);
+        for (int i = 0; i < job->count; i++) {
+            const bench_result_s *result = &job->results[i];
+
+            if (0 != result->error)
+                PRINT_MSG("%s: %s", result->name, hal_error_message(result->error));
+            else
+                PRINT_MSG("%s: %.0f ns/frame, %.1f fps", result->name,
+                        result->ns_per_frame, result->fps);
+        }
+
+        char *path = (char *) malloc(strlen(job->directory)
+                + sizeof(BENCH_REPORT_FILE_NAME));
+        if (NULL != path) {
+            sprintf(path, "%s%s", job->directory, BENCH_REPORT_FILE_NAME);
+            int error_code = bench_write_report(path, job->source, &job->frame,
+                    job->results, job->count);
+            if (0 != error_code)
+                PRINT_MSG("Could not write the report: %s",
+                        hal_error_message(error_code));
+            else
+                PRINT_MSG("Report stored in %s", path);
+            free(path);
+        }
+    }
+
+    _job_free(job);
+    s_bench.running = false;
+    _show_running();
+}
+
+static void *_bench_thread(void *data)
+{
+    bench_job_s *job = (bench_job_s *) data;
+
+    job->count = bench_run(&job->frame, job->directory, job->results,
+            BENCH_CASES);
+    if (0 != hal_dispatch(_bench_done, job))
+        _job_free(job);
+
+    return NULL;
+}
+
+/**
+ * @brief Runs the suite on the frame of the job, off the main loop.
+ *
+ * @param job  The job, owned by the run from now on
+ */
+static void _start(bench_job_s *job)
+{
+    pthread_attr_t attr;
+    pthread_t thread;
+
+    job->directory = hal_get_data_path();
+    if (NULL == job->directory) {
+        PRINT_MSG("No data directory for the benchmark.");
+        _job_free(job);
+        return;
+    }
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    int error_code = pthread_create(&thread, &attr, _bench_thread, job);
+    pthread_attr_destroy(&attr);
+    if (0 != error_code) {
+        PRINT_MSG("Could not start the benchmark: %s",
+                hal_error_message(-error_code));
+        _job_free(job);
+        return;
+    }
+
+    PRINT_MSG("Running the benchmark on the %s frame...", job->source);
+    s_bench.running = true;
+    _show_running();
+}
+
+/**
+ * @brief Called when the "Synthetic frame" button is clicked.
+ * @remarks This function matches the Evas_Smart_Cb() signature defined in the
+ *          Evas_Legacy.h header file.
+ *
+ * @param data        The user data passed via void pointer. This argument is
+ *                    not used in this case.
+ * @param obj         A handle to the object on which the event occurred. This
+ *                    argument is not used in this case.
+ * @param event_info  This argument is not used in this case.
+ */
+static void __bench_cb_synthetic(void *data, Evas_Object *obj, void *event_info)
+{
+    bench_job_s *job = (bench_job_s *) calloc(1, sizeof(bench_job_s));
+    if (NULL == job)
+        return;
+
+    int error_code = bench_frame_create(BENCH_SYNTHETIC_WIDTH,
+            BENCH_SYNTHETIC_HEIGHT, &job->frame);
+    if (0 != error_code) {
+        PRINT_MSG("Could not create the frame: %s", hal_error_message(error_code));
+        free(job);
+        return;
+    }
+
+    job->source = "synthetic";
+    _start(job);
+}
+
+/**
+ * @brief Receives the live frame requested by __bench_cb_live().
+ * @remarks This function matches the camera_frame_grab_cb() signature
+ *          defined in the data.h header file.
+ *
+ * @param frame      The preview frame, valid during the call
+ * @param user_data  The user data passed to camera_grab_frame(). This
+ *                   argument is not used in this case.
+ */
+static void _live_frame_cb(const frame_s *frame, void *user_data)
+{
+    s_bench.grabbing = false;
+
+    /* The view was closed meanwhile. */
+    if (NULL == s_bench.display)
+        return;
+
+    bench_job_s *job = (bench_job_s *) calloc(1, sizeof(bench_job_s));
+    if (NULL == job) {
+        _show_running();
+        return;
+    }
+
+    int error_code = bench_frame_copy(frame, &job->frame);
+    if (0 != error_code) {
+        PRINT_MSG("Could not copy the frame: %s", hal_error_message(error_code));
+        free(job);
+        _show_running();
+        return;
+    }
+
+    job->source = "live";
+    _start(job);
+}
+
+/**
+ * @brief Called when the "Live frame" button is clicked.
+ * @details Takes the next frame of the camera preview, which must be
+ *          running in the camera view.
+ * @remarks This function matches the Evas_Smart_Cb() signature defined in the
+ *          Evas_Legacy.h header file.
+ *
+ * @param data        The user data passed via void pointer. This argument is
+ *                    not used in this case.
+ * @param obj         A handle to the object on which the event occurred. This
+ *                    argument is not used in this case.
+ * @param event_info  This argument is not used in this case.
+ */
+static void __bench_cb_live(void *data, Evas_Object *obj, void *event_info)
+{
+    int error_code = camera_grab_frame(_live_frame_cb, NULL);
+    if (-ENODEV == error_code) {
+        PRINT_MSG("Start the camera preview first.");
+        return;
+    }
+    if (0 != error_code) {
+        PRINT_MSG("Could not grab a preview frame: %s",
+                hal_error_message(error_code));
+        return;
+    }
+
+    s_bench.grabbing = true;
+    _show_running();
+}
+
+/**
+ * @brief Called when the Benchmark view is being closed.
+ * @remarks This function matches the Elm_Naviframe_Item_Pop_Cb() signature
+ *          defined in the elm_naviframe_item.eo.legacy.h header file.
+ *
+ * @param data  The user data passed via void pointer. This argument is not
+ *              used in this case.
+ * @param item  The item being popped. This argument is not used in this case.
+ *
+ * @return @c EINA_FALSE while a run is in progress, otherwise @c EINA_TRUE
+ */
+static Eina_Bool _bench_pop_cb(void *data, Elm_Object_Item *item)
+{
+    if (s_bench.running) {
+        PRINT_MSG("Wait for the benchmark to finish.");
+        return EINA_FALSE;
+    }
+
+    s_bench.display = NULL;
+    s_bench.synthetic_bt = NULL;
+    s_bench.live_bt = NULL;
+
+    return EINA_TRUE;
+}
+
+/**
+ * @brief Opens the Benchmark view over the current view.
+ */
+void benchview_create(void)
+{
+    if (NULL != s_bench.display)
+        return;
+
+    s_bench.display = _create_new_cd_display("Benchmark", _bench_pop_cb);
+    s_bench.synthetic_bt = _new_button(s_bench.display, "Synthetic frame",
+            __bench_cb_synthetic);
+    s_bench.live_bt = _new_button(s_bench.display, "Live frame",
+            __bench_cb_live);
+    _show_running();
+
+    PRINT_MSG("Runs the filter kernels, the frame copies and the writers. "
+            "The live frame comes from the camera preview.");
+}
@@ -0,0 +1,837 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Flora License, Version 1.1 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://floralicense.org/license/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "binlog.h"
+#include "hal.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Largest message entry. */
+#define MESSAGE_MAX (sizeof(binlog_entry_s) + BINLOG_ARGS * (8 + BINLOG_STRING_MAX))
+/* Largest formatted message. */
+#define TEXT_MAX 1024
+
+typedef enum {
+    ARG_INT,
+    ARG_LONG,
+    ARG_LLONG,
+    ARG_SIZE,
+    ARG_PTRDIFF,
+    ARG_INTMAX,
+    ARG_DOUBLE,
+    ARG_STRING,
+    ARG_POINTER,
+    ARG_PERCENT,     /* "%%", no argument */
+    ARG_UNSUPPORTED,
+} arg_type_e;
+
+/* A conversion of a format string. */
+typedef struct _spec {
+    const char *start; /* The '%' */
+    int length;        /* Characters of the conversion */
+    int stars;         /* '*' width and precision arguments before the value */
+    arg_type_e type;
+} spec_s;
+
+typedef struct _binlog_site {
+    const char *fmt;   /* The key, set once */
+    int ready;         /* argc and types are set */
+    int argc;          /* -1 if the format cannot be deferred */
+    unsigned char types[BINLOG_ARGS];
+} binlog_site_s;
+
+typedef enum {
+    RING_FREE,
+    RING_ACTIVE, /* Owned by a running thread */
+    RING_EXITED, /* The thread exited, freed once drained */
+} ring_state_e;
+
+/* Single producer, single consumer ring of the messages of one thread. */
+typedef struct _binlog_ring {
+    int state;
+    unsigned long long head;  /* Bytes written, by the thread */
+    unsigned long long tail;  /* Bytes read, by the drain thread */
+    unsigned long long dropped;
+    unsigned char *data;
+} binlog_ring_s;
+
+static int s_running = 0;
+static binlog_site_s s_sites[BINLOG_SITES];
+static binlog_ring_s s_rings[BINLOG_THREADS];
+
+static pthread_once_t s_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t s_key;
+static __thread binlog_ring_s *t_ring = NULL;
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_t thread;
+    bool stop;
+    FILE *file;                    /* Binary output, NULL for text */
+    bool written[BINLOG_SITES];    /* Format strings in the file */
+    unsigned long long buffer[MESSAGE_MAX / 8 + 1];
+    char text[TEXT_MAX];
+} s_drain = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+};
+
+static unsigned long long _now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * @brief Finds the next conversion of a format string.
+ *
+ * @return The text after the conversion, @c NULL if there is none
+ */
+static const char *_next_spec(const char *p, spec_s *spec)
+{
+    p = strchr(p, '%');
+    if (NULL == p)
+        return NULL;
+
+    spec->start = p++;
+    spec->stars = 0;
+
+    while ('\0' != *p && NULL != strchr("-+ #0'", *p))
+        p++;
+    if ('*' == *p) {
+        spec->stars++;
+        p++;
+    }
+    while (*p >= '0' && *p <= '9')
+        p++;
+    if ('.' == *p) {
+        p++;
+        if ('*' == *p) {
+            spec->stars++;
+            p++;
+        }
+        while (*p >= '0' && *p <= '9')
+            p++;
+    }
+
+    arg_type_e integer = ARG_INT;
+    bool long_double = false;
+
+    switch (*p) {
+    case 'h':
+        p += ('h' == p[1]) ? 2 : 1;
+        break;
+    case 'l':
+        integer = ('l' == p[1]) ? ARG_LLONG : ARG_LONG;
+        p += ('l' == p[1]) ? 2 : 1;
+        break;
+    case 'q':
+        integer = ARG_LLONG;
+        p++;
+        break;
+    case 'L':
+        long_double = true;
+        p++;
+        break;
+    case 'z':
+        integer = ARG_SIZE;
+        p++;
+        break;
+    case 't':
+        integer = ARG_PTRDIFF;
+        p++;
+        break;
+    case 'j':
+        integer = ARG_INTMAX;
+        p++;
+        break;
+    }
+
+    switch (*p) {
+    case 'd': case 'i': case 'u': case 'o': case 'x': case 'X': case 'c':
+        spec->type = long_double ? ARG_UNSUPPORTED : integer;
+        break;
+    case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+        spec->type = long_double ? ARG_UNSUPPORTED : ARG_DOUBLE;
+        break;
+    case 's':
+        spec->type = (ARG_INT == integer && !long_double) ? ARG_STRING
+                : ARG_UNSUPPORTED;
+        break;
+    case 'p':
+        spec->type = ARG_POINTER;
+        break;
+    case '%':
+        spec->type = ARG_PERCENT;
+        break;
+    default:
+        /* %n, wide characters, or the end of the string */
+        spec->type = ARG_UNSUPPORTED;
+        return p + ('\0' != *p);
+    }
+
+    p++;
+    spec->length = (int) (p - spec->start);
+
+    return p;
+}
+
+/**
+ * @brief Lists the types of the arguments of a format string.
+ *
+ * @return The number of arguments, -1 if the format cannot be deferred
+ */
+static int _parse_format(const char *fmt, unsigned char *types)
+{
+    spec_s spec;
+    int argc = 0;
+
+    for (const char *p = fmt; NULL != (p = _next_spec(p, &spec)); ) {
+        if (ARG_UNSUPPORTED == spec.type)
+            return -1;
+        if (ARG_PERCENT == spec.type)
+            continue;
+        if (argc + spec.stars + 1 > BINLOG_ARGS)
+            return -1;
+        for (int i = 0; i < spec.stars; i++)
+            types[argc++] = ARG_INT;
+        types[argc++] = spec.type;
+    }
+
+    return argc;
+}
+
+/**
+ * @brief Formats a message from its raw arguments.
+ *
+ * @param fmt    The format string
+ * @param args   The arguments as recorded by binlog_vrecord()
+ * @param end    The end of the arguments
+ * @param text   The buffer receiving the message
+ * @param size   The size of the buffer
+ */
+static void _format(const char *fmt, const unsigned char *args,
+                    const unsigned char *end, char *text, size_t size)
+{
+    const char *p = fmt;
+    size_t n = 0;
+    spec_s spec;
+
+    while (n + 1 < size) {
+        const char *next = _next_spec(p, &spec);
+        size_t literal = (NULL != next) ? (size_t) (spec.start - p) : strlen(p);
+
+        if (literal > size - 1 - n)
+            literal = size - 1 - n;
+        memcpy(text + n, p, literal);
+        n += literal;
+        if (NULL == next || ARG_UNSUPPORTED == spec.type || n + 1 >= size)
+            break;
+        p = next;
+
+        if (ARG_PERCENT == spec.type) {
+            text[n++] = '%';
+            continue;
+        }
+
+        int star[2] = { 0, 0 };
+        unsigned long long value;
+        for (int i = 0; i < spec.stars; i++) {
+            if (args + 8 > end)
+                goto truncated;
+            memcpy(&value, args, 8);
+            star[i] = (int) value;
+            args += 8;
+        }
+        if (args + 8 > end)
+            goto truncated;
+        memcpy(&value, args, 8);
+        args += 8;
+
+        char conversion[32];
+        if (spec.length >= (int) sizeof(conversion))
+            goto truncated;
+        memcpy(conversion, spec.start, spec.length);
+        conversion[spec.length] = '\0';
+
+        char *out = text + n;
+        size_t room = size - n;
+        int stars = spec.stars;
+        int written = 0;
+
+#define FORMAT_ARG(arg) \
+        (0 == stars ? snprintf(out, room, conversion, arg) \
+         : 1 == stars ? snprintf(out, room, conversion, star[0], arg) \
+         : snprintf(out, room, conversion, star[0], star[1], arg))
+
+        switch (spec.type) {
+        case ARG_INT:
+            written = FORMAT_ARG((int) value);
+            break;
+        case ARG_LONG:
+            written = FORMAT_ARG((long) value);
+            break;
+        case ARG_LLONG:
+            written = FORMAT_ARG((long long) value);
+            break;
+        case ARG_SIZE:
+            written = FORMAT_ARG((size_t) value);
+            break;
+        case ARG_PTRDIFF:
+            written = FORMAT_ARG((ptrdiff_t) value);
+            break;
+        case ARG_INTMAX:
+            written = FORMAT_ARG((intmax_t) value);
+            break;
+        case ARG_DOUBLE: {
+            double d;
+            memcpy(&d, &value, sizeof(d));
+            written = FORMAT_ARG(d);
+            break;
+        }
+        case ARG_POINTER:
+            written = FORMAT_ARG((void *) (uintptr_t) value);
+            break;
+        case ARG_STRING: {
+            char string[BINLOG_STRING_MAX + 1];
+            size_t len = (value < BINLOG_STRING_MAX) ? (size_t) value
+                    : BINLOG_STRING_MAX;
+
+            if (args + len > end)
+                goto truncated;
+            memcpy(string, args, len);
+            string[len] = '\0';
+            args += (len + 7) & ~(size_t) 7;
+            written = FORMAT_ARG(string);
+            break;
+        }
+        default:
+            break;
+        }
+#undef FORMAT_ARG
+
+        if (written > 0)
+            n += ((size_t) written < room) ? (size_t) written : room - 1;
+    }
+
+    text[n] = '\0';
+    return;
+
+truncated:
+    snprintf(text + n, size - n, "<truncated>");
+}
+
+/**
+ * @brief Returns the ID of a format string, registering it on its first
+ *        use.
+ *
+ * @return The ID, -1 if the format cannot be deferred
+ */
+static int _find_site(const char *fmt)
+{
+    unsigned int hash = (unsigned int) ((uintptr_t) fmt >> 3) * 2654435761u;
+
+    for (int i = 0; i < BINLOG_SITES; i++) {
+        int index = (hash + i) % BINLOG_SITES;
+        binlog_site_s *site = &s_sites[index];
+        const char *key = __atomic_load_n(&site->fmt, __ATOMIC_ACQUIRE);
+
+        if (NULL == key && __atomic_compare_exchange_n(&site->fmt, &key, fmt,
+                false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            site->argc = _parse_format(fmt, site->types);
+            __atomic_store_n(&site->ready, 1, __ATOMIC_RELEASE);
+            key = fmt;
+        }
+        if (key != fmt)
+            continue;
+
+        /* Still parsed by another thread, this message is logged directly. */
+        if (!__atomic_load_n(&site->ready, __ATOMIC_ACQUIRE) || site->argc < 0)
+            return -1;
+
+        return index;
+    }
+
+    return -1;
+}
+
+/* Frees the ring of an exiting thread once it is drained. */
+static void _thread_exit(void *data)
+{
+    binlog_ring_s *ring = (binlog_ring_s *) data;
+
+    __atomic_store_n(&ring->state, RING_EXITED, __ATOMIC_RELEASE);
+}
+
+static void _create_key(void)
+{
+    pthread_key_create(&s_key, _thread_exit);
+}
+
+/**
+ * @brief Takes a free ring for the calling thread.
+ *
+ * @return The ring, @c NULL if all of them are in use
+ */
+static binlog_ring_s *_claim(void)
+{
+    pthread_once(&s_key_once, _create_key);
+
+    for (int i = 0; i < BINLOG_THREADS; i++) {
+        binlog_ring_s *ring = &s_rings[i];
+        int expected = RING_FREE;
+
+        if (!__atomic_compare_exchange_n(&ring->state, &expected, RING_ACTIVE,
+                false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            continue;
+
+        /* A ring is drained before it is free, it goes on from its head. */
+        if (NULL == ring->data) {
+            ring->data = (unsigned char *) malloc(BINLOG_RING_SIZE);
+            if (NULL == ring->data) {
+                __atomic_store_n(&ring->state, RING_FREE, __ATOMIC_RELEASE);
+                return NULL;
+            }
+        }
+        pthread_setspecific(s_key, ring);
+
+        return ring;
+    }
+
+    return NULL;
+}
+
+/* Copies into the ring at a position that may wrap around its end. */
+static void _ring_write(binlog_ring_s *ring, unsigned long long position,
+                        const void *data, size_t size)
+{
+    size_t offset = position % BINLOG_RING_SIZE;
+    size_t first = (size < BINLOG_RING_SIZE - offset) ? size
+            : BINLOG_RING_SIZE - offset;
+
+    memcpy(ring->data + offset, data, first);
+    memcpy(ring->data, (const unsigned char *) data + first, size - first);
+}
+
+static void _ring_read(binlog_ring_s *ring, unsigned long long position,
+                       void *data, size_t size)
+{
+    size_t offset = position % BINLOG_RING_SIZE;
+    size_t first = (size < BINLOG_RING_SIZE - offset) ? size
+            : BINLOG_RING_SIZE - offset;
+
+    memcpy(data, ring->data + offset, first);
+    memcpy((unsigned char *) data + first, ring->data, size - first);
+}
+
+/**
+ * @brief Records a message for the drain thread.
+ * @details Called by hal_log(). Takes the arguments as they are, strings are
+ *          copied up to BINLOG_STRING_MAX bytes.
+ *
+ * @param priority  The hal_log_priority_e of the message
+ * @param fmt       The format string, a string literal
+ * @param ap        The arguments
+ *
+ * @return @c true if the message is taken care of, @c false if the caller
+ *         must log it directly
+ */
+bool binlog_vrecord(int priority, const char *fmt, va_list ap)
+{
+    if (!__atomic_load_n(&s_running, __ATOMIC_RELAXED))
+        return false;
+
+    binlog_ring_s *ring = t_ring;
+    if (NULL == ring) {
+        ring = _claim();
+        if (NULL == ring)
+            return false;
+        t_ring = ring;
+    }
+
+    int id = _find_site(fmt);
+    if (id < 0)
+        return false;
+
+    const binlog_site_s *site = &s_sites[id];
+    unsigned long long buffer[MESSAGE_MAX / 8 + 1];
+    binlog_entry_s *entry = (binlog_entry_s *) buffer;
+    unsigned char *p = (unsigned char *) (entry + 1);
+
+    for (int i = 0; i < site->argc; i++) {
+        unsigned long long value = 0;
+
+        switch (site->types[i]) {
+        case ARG_INT:
+            value = (long long) va_arg(ap, int);
+            break;
+        case ARG_LONG:
+            value = (long long) va_arg(ap, long);
+            break;
+        case ARG_LLONG:
+            value = va_arg(ap, long long);
+            break;
+        case ARG_SIZE:
+            value = va_arg(ap, size_t);
+            break;
+        case ARG_PTRDIFF:
+            value = (long long) va_arg(ap, ptrdiff_t);
+            break;
+        case ARG_INTMAX:
+            value = (long long) va_arg(ap, intmax_t);
+            break;
+        case ARG_DOUBLE: {
+            double d = va_arg(ap, double);
+            memcpy(&value, &d, sizeof(value));
+            break;
+        }
+        case ARG_POINTER:
+            value = (uintptr_t) va_arg(ap, void *);
+            break;
+        case ARG_STRING: {
+            const char *string = va_arg(ap, const char *);
+            if (NULL == string)
+                string = "(null)";
+            size_t len = strnlen(string, BINLOG_STRING_MAX);
+            size_t padded = (len + 7) & ~(size_t) 7;
+
+            value = len;
+            memcpy(p, &value, 8);
+            p += 8;
+            if (padded > len)
+                memset(p + padded - 8, 0, 8);
+            memcpy(p, string, len);
+            p += padded;
+            continue;
+        }
+        }
+
+        memcpy(p, &value, 8);
+        p += 8;
+    }
+
+    unsigned int size = (unsigned int) (p - (unsigned char *) buffer);
+    entry->size = (unsigned short) size;
+    entry->site = (unsigned short) id;
+    entry->kind = BINLOG_ENTRY_MESSAGE;
+    entry->priority = (unsigned char) priority;
+    entry->thread = (unsigned char) (ring - s_rings);
+    entry->reserved = 0;
+    entry->timestamp_ns = _now_ns();
+
+    unsigned long long head = ring->head;
+    unsigned long long tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+
+    if (head + size - tail > BINLOG_RING_SIZE) {
+        __atomic_add_fetch(&ring->dropped, 1, __ATOMIC_RELAXED);
+        return true;
+    }
+
+    _ring_write(ring, head, buffer, size);
+    __atomic_store_n(&ring->head, head + size, __ATOMIC_RELEASE);
+
+    /*
+     * A burst filling half of the ring wakes the drain thread up early. The
+     * wake up may be missed without the lock, then the period applies.
+     */
+    if (head - tail < BINLOG_RING_SIZE / 2
+            && head + size - tail >= BINLOG_RING_SIZE / 2)
+        pthread_cond_signal(&s_drain.cond);
+
+    return true;
+}
+
+/* Writes an entry to the binary file, padded to 8 bytes. */
+static void _write_entry(binlog_entry_s *entry, const void *body,
+                         size_t body_size)
+{
+    static const unsigned char zeros[8];
+    size_t size = sizeof(*entry) + body_size;
+    size_t padded = (size + 7) & ~(size_t) 7;
+
+    entry->size = (unsigned short) padded;
+    fwrite(entry, sizeof(*entry), 1, s_drain.file);
+    fwrite(body, 1, body_size, s_drain.file);
+    fwrite(zeros, 1, padded - size, s_drain.file);
+}
+
+/* Outputs a message taken from a ring. */
+static void _output_message(binlog_entry_s *entry)
+{
+    const binlog_site_s *site = &s_sites[entry->site];
+
+    if (NULL == s_drain.file) {
+        _format(site->fmt, (const unsigned char *) (entry + 1),
+                (const unsigned char *) entry + entry->size,
+                s_drain.text, sizeof(s_drain.text));
+        hal_log_text((hal_log_priority_e) entry->priority, s_drain.text);
+        return;
+    }
+
+    if (!s_drain.written[entry->site]) {
+        binlog_entry_s definition = {
+            .site = entry->site,
+            .kind = BINLOG_ENTRY_SITE,
+        };
+        size_t length = strlen(site->fmt) + 1;
+
+        if (sizeof(definition) + length > 0xfff8)
+            length = 0xfff8 - sizeof(definition);
+        _write_entry(&definition, site->fmt, length);
+        s_drain.written[entry->site] = true;
+    }
+
+    fwrite(entry, entry->size, 1, s_drain.file);
+}
+
+static void _output_dropped(int thread, unsigned long long dropped)
+{
+    if (NULL == s_drain.file) {
+        snprintf(s_drain.text, sizeof(s_drain.text),
+                "binlog: %llu messages of thread %d dropped", dropped, thread);
+        hal_log_text(HAL_LOG_WARN, s_drain.text);
+        return;
+    }
+
+    binlog_entry_s entry = {
+        .kind = BINLOG_ENTRY_DROPPED,
+        .priority = HAL_LOG_WARN,
+        .thread = (unsigned char) thread,
+        .timestamp_ns = _now_ns(),
+    };
+    _write_entry(&entry, &dropped, sizeof(dropped));
+}
+
+static void _drain_ring(int index)
+{
+    binlog_ring_s *ring = &s_rings[index];
+    unsigned long long head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    unsigned long long tail = ring->tail;
+    binlog_entry_s *entry = (binlog_entry_s *) s_drain.buffer;
+
+    while (tail < head) {
+        _ring_read(ring, tail, entry, sizeof(*entry));
+        _ring_read(ring, tail, entry, entry->size);
+        _output_message(entry);
+        tail += entry->size;
+    }
+    __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+
+    unsigned long long dropped = __atomic_exchange_n(&ring->dropped, 0,
+            __ATOMIC_RELAXED);
+    if (dropped > 0)
+        _output_dropped(index, dropped);
+}
+
+static void *_drain_thread(void *user_data)
+{
+    pthread_mutex_lock(&s_drain.lock);
+
+    for (;;) {
+        bool stop = s_drain.stop;
+        pthread_mutex_unlock(&s_drain.lock);
+
+        for (int i = 0; i < BINLOG_THREADS; i++) {
+            int state = __atomic_load_n(&s_rings[i].state, __ATOMIC_ACQUIRE);
+
+            if (RING_FREE == state)
+                continue;
+            _drain_ring(i);
+            if (RING_EXITED == state)
+                __atomic_store_n(&s_rings[i].state, RING_FREE, __ATOMIC_RELEASE);
+        }
+        if (NULL != s_drain.file)
+            fflush(s_drain.file);
+
+        pthread_mutex_lock(&s_drain.lock);
+        if (stop)
+            break;
+        if (!s_drain.stop) {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_nsec += BINLOG_DRAIN_MS * 1000000L;
+            deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+            deadline.tv_nsec %= 1000000000L;
+            pthread_cond_timedwait(&s_drain.cond, &s_drain.lock, &deadline);
+        }
+    }
+
+    pthread_mutex_unlock(&s_drain.lock);
+
+    return NULL;
+}
+
+/**
+ * @brief Starts deferring the messages of hal_log().
+ *
+ * @param path  The binary file to write the messages to, @c NULL to format
+ *              them on the drain thread and pass them to hal_log_text()
+ *
+ * @return 0 on success, otherwise a negative errno value
+ */
+int binlog_start(const char *path)
+{
+    if (__atomic_load_n(&s_running, __ATOMIC_ACQUIRE))
+        return -EALREADY;
+
+    FILE *file = NULL;
+    if (NULL != path) {
+        file = fopen(path, "wb");
+        if (NULL == file)
+            return -errno;
+
+        binlog_file_header_s header = { BINLOG_MAGIC, BINLOG_VERSION };
+        if (1 != fwrite(&header, sizeof(header), 1, file)) {
+            fclose(file);
+            return -EIO;
+        }
+    }
+
+    s_drain.stop = false;
+    s_drain.file = file;
+    memset(s_drain.written, 0, sizeof(s_drain.written));
+
+    int error = -pthread_create(&s_drain.thread, NULL, _drain_thread, NULL);
+    if (0 != error) {
+        if (NULL != file)
+            fclose(file);
+        s_drain.file = NULL;
+        return error;
+    }
+
+    __atomic_store_n(&s_running, 1, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+/**
+ * @brief Logs the deferred messages and logs directly from now on.
+ */
+void binlog_stop(void)
+{
+    if (!__atomic_exchange_n(&s_running, 0, __ATOMIC_ACQ_REL))
+        return;
+
+    pthread_mutex_lock(&s_drain.lock);
+    s_drain.stop = true;
+    pthread_cond_signal(&s_drain.cond);
+    pthread_mutex_unlock(&s_drain.lock);
+    pthread_join(s_drain.thread, NULL);
+
+    if (NULL != s_drain.file) {
+        if (0 != fclose(s_drain.file))
+            hal_log(HAL_LOG_ERROR, "binlog: could not close the log file");
+        s_drain.file = NULL;
+    }
+}
+
+/**
+ * @brief Formats the messages of a binary log file.
+ *
+ * @param path       The file written by the drain thread
+ * @param callback   Called for every message, in the order of the file
+ * @param user_data  The user data passed to the callback
+ *
+ * @return The number of messages on success, -EINVAL if the file is not a
+ *         log file, otherwise a negative errno value
+ */
+int binlog_decode(const char *path, binlog_decode_cb callback, void *user_data)
+{
+    if (NULL == path || NULL == callback)
+        return -EINVAL;
+
+    FILE *file = fopen(path, "rb");
+    if (NULL == file)
+        return -errno;
+
+    binlog_file_header_s header;
+    if (1 != fread(&header, sizeof(header), 1, file)
+            || BINLOG_MAGIC != header.magic || BINLOG_VERSION != header.version) {
+        fclose(file);
+        return -EINVAL;
+    }
+
+    char **formats = (char **) calloc(BINLOG_SITES, sizeof(char *));
+    unsigned char *body = (unsigned char *) malloc(0x10000);
+    char *text = (char *) malloc(TEXT_MAX);
+    int messages = 0;
+    binlog_entry_s entry;
+
+    if (NULL == formats || NULL == body || NULL == text)
+        messages = -ENOMEM;
+
+    while (messages >= 0 && 1 == fread(&entry, sizeof(entry), 1, file)) {
+        size_t size = (entry.size > sizeof(entry)) ? entry.size - sizeof(entry) : 0;
+
+        if (entry.size < sizeof(entry) || size != fread(body, 1, size, file)) {
+            messages = -EINVAL;
+            break;
+        }
+
+        binlog_message_s message = {
+            .priority = entry.priority,
+            .thread = entry.thread,
+            .timestamp_ns = entry.timestamp_ns,
+            .text = text,
+        };
+
+        switch (entry.kind) {
+        case BINLOG_ENTRY_SITE:
+            if (entry.site < BINLOG_SITES && size > 0) {
+                free(formats[entry.site]);
+                formats[entry.site] = strndup((const char *) body, size);
+            }
+            continue;
+
+        case BINLOG_ENTRY_MESSAGE:
+            if (entry.site < BINLOG_SITES && NULL != formats[entry.site])
+                _format(formats[entry.site], body, body + size, text, TEXT_MAX);
+            else
+                snprintf(text, TEXT_MAX, "<unknown format %u>", entry.site);
+            break;
+
+        case BINLOG_ENTRY_DROPPED:
+            if (size >= sizeof(message.dropped))
+                memcpy(&message.dropped, body, sizeof(message.dropped));
+            snprintf(text, TEXT_MAX, "%llu messages dropped", message.dropped);
+            break;
+
+        default:
+            continue;
+        }
+
+        callback(&message, user_data);
+        messages++;
+    }
+
+    if (NULL != formats)
+        for (int i = 0; i < BINLOG_SITES; i++)
+            free(formats[i]);
+    free(formats);
+    free(body);
+    free(text);
+    fclose(file);
+
+    return messages;
+}
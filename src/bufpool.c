@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Flora License, Version 1.1 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://floralicense.org/license/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "bufpool.h"
+#include <errno.h>
+#include <pthread.h>
+
+struct _bufpool {
+    pthread_mutex_t lock;
+    arena_h arena;
+    unsigned char *memory; /* All the buffers, one after another */
+    unsigned int size;
+    int count;
+    void **free;           /* Stack of the buffers not in use */
+    int free_count;
+};
+
+/**
+ * @brief Creates a pool and allocates all its buffers.
+ *
+ * @param arena  The arena to allocate the pool from, NULL for the heap
+ * @param count  The number of buffers
+ * @param size   The size of every buffer in bytes
+ * @param pool   The handle of the newly created pool
+ *
+ * @return 0 on success, otherwise a negative errno value
+ */
+int bufpool_create(arena_h arena, int count, unsigned int size,
+                   bufpool_h *pool)
+{
+    if (count < 1 || 0 == size || NULL == pool)
+        return -EINVAL;
+
+    bufpool_h p = (bufpool_h) arena_alloc(arena, "bufpool", sizeof(*p));
+    if (NULL == p)
+        return -ENOMEM;
+
+    p->arena = arena;
+    p->memory = (unsigned char *) arena_alloc(arena, "bufpool",
+            (size_t) count * size);
+    p->free = (void **) arena_alloc(arena, "bufpool", sizeof(void *) * count);
+    if (NULL == p->memory || NULL == p->free) {
+        arena_free(arena, p->free);
+        arena_free(arena, p->memory);
+        arena_free(arena, p);
+        return -ENOMEM;
+    }
+
+    p->size = size;
+    p->count = count;
+    for (int i = 0; i < count; i++)
+        p->free[i] = p->memory + (size_t) i * size;
+    p->free_count = count;
+    pthread_mutex_init(&p->lock, NULL);
+
+    *pool = p;
+
+    return 0;
+}
+
+/**
+ * @brief Releases the pool. The buffers taken from it must not be used
+ *        anymore.
+ */
+void bufpool_destroy(bufpool_h pool)
+{
+    if (NULL == pool)
+        return;
+
+    pthread_mutex_destroy(&pool->lock);
+    arena_free(pool->arena, pool->free);
+    arena_free(pool->arena, pool->memory);
+    arena_free(pool->arena, pool);
+}
+
+/**
+ * @brief Takes a buffer from the pool.
+ *
+ * @return The buffer of bufpool_get_size() bytes, NULL if all the buffers are
+ *         in use
+ */
+void *bufpool_get(bufpool_h pool)
+{
+    void *buffer = NULL;
+
+    if (NULL == pool)
+        return NULL;
+
+    pthread_mutex_lock(&pool->lock);
+    if (pool->free_count > 0)
+        buffer = pool->free[--pool->free_count];
+    pthread_mutex_unlock(&pool->lock);
+
+    return buffer;
+}
+
+/**
+ * @brief Returns a buffer taken with bufpool_get() to the pool.
+ */
+void bufpool_put(bufpool_h pool, void *buffer)
+{
+    if (NULL == pool || NULL == buffer)
+        return;
+
+    pthread_mutex_lock(&pool->lock);
+    if (pool->free_count < pool->count)
+        pool->free[pool->free_count++] = buffer;
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/**
+ * @brief Returns the size of the buffers of the pool in bytes.
+ */
+unsigned int bufpool_get_size(bufpool_h pool)
+{
+    return (NULL != pool) ? pool->size : 0;
+}
@@ -0,0 +1,577 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Flora License, Version 1.1 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://floralicense.org/license/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "camctl.h"
+#include "trace.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+
+struct _camctl {
+    hal_camera_h camera;
+    camctl_callbacks_s callbacks;
+    void *user_data;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_t thread;
+    bool stop;
+    camctl_command_e queue[CAMCTL_QUEUE_LENGTH];
+    unsigned long long queued_ns[CAMCTL_QUEUE_LENGTH];
+    int head;
+    int count;
+    bool executing;
+    camctl_command_e current; /* The command being executed */
+    camctl_state_e state;     /* Only changed by the command thread */
+    bool frame_path;          /* The frames come by reference */
+    int width;                /* Of CAMCTL_CHANGE_RESOLUTION */
+    int height;
+};
+
+typedef struct _camctl_completion {
+    void (*completed)(camctl_command_e command, int error,
+            camctl_state_e state, void *user_data);
+    void *user_data;
+    camctl_command_e command;
+    int error;
+    camctl_state_e state;
+} camctl_completion_s;
+
+static unsigned long long _now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+const char *camctl_command_name(camctl_command_e command)
+{
+    switch (command) {
+    case CAMCTL_START_PREVIEW:
+        return "start preview";
+    case CAMCTL_STOP_PREVIEW:
+        return "stop preview";
+    case CAMCTL_START_FACE_DETECTION:
+        return "start face detection";
+    case CAMCTL_STOP_FACE_DETECTION:
+        return "stop face detection";
+    case CAMCTL_RESTART_PREVIEW:
+        return "restart preview";
+    case CAMCTL_CHANGE_RESOLUTION:
+        return "change resolution";
+    default:
+        return "unknown";
+    }
+}
+
+/**
+ * @brief Returns the state a successful command leads to.
+ */
+static camctl_state_e _apply(camctl_state_e state, camctl_command_e command)
+{
+    switch (command) {
+    case CAMCTL_START_PREVIEW:
+    case CAMCTL_RESTART_PREVIEW:
+        return (CAMCTL_STATE_STOPPED == state) ? CAMCTL_STATE_PREVIEW : state;
+    case CAMCTL_STOP_PREVIEW:
+        return CAMCTL_STATE_STOPPED;
+    case CAMCTL_START_FACE_DETECTION:
+        return (CAMCTL_STATE_PREVIEW == state) ? CAMCTL_STATE_FACE_DETECTION : state;
+    case CAMCTL_STOP_FACE_DETECTION:
+        return (CAMCTL_STATE_FACE_DETECTION == state) ? CAMCTL_STATE_PREVIEW : state;
+    case CAMCTL_CHANGE_RESOLUTION:
+        return state;
+    }
+
+    return state;
+}
+
+/**
+ * @brief Whether a command acts without changing the state, so it is neither
+ *        dropped nor cancelled by the command coalescing.
+ */
+static bool _is_action(camctl_command_e command)
+{
+    return CAMCTL_RESTART_PREVIEW == command || CAMCTL_CHANGE_RESOLUTION == command;
+}
+
+/**
+ * @brief Returns the state the camera is in once the first @p count queued
+ *        commands are done. Must be called with the lock held.
+ */
+static camctl_state_e _projected_state(camctl_h ctl, int count)
+{
+    camctl_state_e state = ctl->state;
+
+    if (ctl->executing)
+        state = _apply(state, ctl->current);
+    for (int i = 0; i < count; i++)
+        state = _apply(state, ctl->queue[(ctl->head + i) % CAMCTL_QUEUE_LENGTH]);
+
+    return state;
+}
+
+static void _completion_job(void *data)
+{
+    camctl_completion_s *completion = (camctl_completion_s *) data;
+
+    completion->completed(completion->command, completion->error,
+            completion->state, completion->user_data);
+    free(completion);
+}
+
+/**
+ * @brief Reports a command as completed on the main loop.
+ */
+static void _complete(camctl_h ctl, camctl_command_e command, int error,
+                      camctl_state_e state)
+{
+    if (NULL == ctl->callbacks.completed)
+        return;
+
+    camctl_completion_s *completion = (camctl_completion_s *) malloc(
+            sizeof(camctl_completion_s));
+    if (NULL == completion)
+        return;
+
+    completion->completed = ctl->callbacks.completed;
+    completion->user_data = ctl->user_data;
+    completion->command = command;
+    completion->error = error;
+    completion->state = state;
+
+    if (HAL_ERROR_NONE != hal_dispatch(_completion_job, completion))
+        free(completion);
+}
+
+/**
+ * @brief Sets the frame callback, or the preview callback if there is none
+ *        or the camera does not support it.
+ */
+static int _set_preview_callback(camctl_h ctl)
+{
+    if (NULL != ctl->callbacks.frame) {
+        int error = hal_camera_set_frame_cb(ctl->camera, ctl->callbacks.frame,
+                ctl->user_data);
+        ctl->frame_path = (HAL_ERROR_NONE == error);
+        if (ctl->frame_path || NULL == ctl->callbacks.preview)
+            return error;
+
+        hal_log(HAL_LOG_INFO, "camctl: no frames by reference (%s), using the preview callback",
+                hal_error_message(error));
+    }
+
+    return hal_camera_set_preview_cb(ctl->camera, ctl->callbacks.preview,
+            ctl->user_data);
+}
+
+static void _unset_preview_callback(camctl_h ctl)
+{
+    if (ctl->frame_path)
+        hal_camera_unset_frame_cb(ctl->camera);
+    else
+        hal_camera_unset_preview_cb(ctl->camera);
+}
+
+static void _set_state(camctl_h ctl, camctl_state_e state)
+{
+    pthread_mutex_lock(&ctl->lock);
+    ctl->state = state;
+    pthread_mutex_unlock(&ctl->lock);
+
+    if (NULL != ctl->callbacks.state_changed)
+        ctl->callbacks.state_changed(state, ctl->user_data);
+}
+
+/**
+ * @brief Runs the camera calls of a command. Only the command thread, or the
+ *        destroying thread once the command thread is gone, calls this.
+ *
+ * @return HAL_ERROR_NONE on success, otherwise the error of the failed call
+ */
+static int _execute(camctl_h ctl, camctl_command_e command)
+{
+    hal_camera_h camera = ctl->camera;
+    camctl_state_e state = ctl->state;
+    int error = HAL_ERROR_NONE;
+
+    switch (command) {
+    case CAMCTL_START_PREVIEW:
+        if (CAMCTL_STATE_STOPPED != state)
+            break;
+
+        error = _set_preview_callback(ctl);
+        if (HAL_ERROR_NONE != error)
+            break;
+
+        error = hal_camera_start_preview(camera);
+        if (HAL_ERROR_NONE != error) {
+            _unset_preview_callback(ctl);
+            break;
+        }
+
+        _set_state(ctl, CAMCTL_STATE_PREVIEW);
+        break;
+
+    case CAMCTL_STOP_PREVIEW:
+        if (CAMCTL_STATE_FACE_DETECTION == state) {
+            error = hal_camera_stop_face_detection(camera);
+            if (HAL_ERROR_NONE != error)
+                hal_log(HAL_LOG_WARN, "camctl: stopping the face detection failed: %s",
+                        hal_error_message(error));
+            _set_state(ctl, CAMCTL_STATE_PREVIEW);
+        }
+        if (CAMCTL_STATE_STOPPED == state)
+            break;
+
+        _unset_preview_callback(ctl);
+        error = hal_camera_stop_preview(camera);
+        if (HAL_ERROR_NONE != error)
+            break;
+
+        _set_state(ctl, CAMCTL_STATE_STOPPED);
+        break;
+
+    case CAMCTL_START_FACE_DETECTION:
+        if (CAMCTL_STATE_PREVIEW != state) {
+            error = (CAMCTL_STATE_STOPPED == state) ? -EINVAL : HAL_ERROR_NONE;
+            break;
+        }
+
+        error = hal_camera_start_face_detection(camera, ctl->callbacks.faces,
+                ctl->user_data);
+        if (HAL_ERROR_NONE == error)
+            _set_state(ctl, CAMCTL_STATE_FACE_DETECTION);
+        break;
+
+    case CAMCTL_STOP_FACE_DETECTION:
+        if (CAMCTL_STATE_FACE_DETECTION != state)
+            break;
+
+        error = hal_camera_stop_face_detection(camera);
+        if (HAL_ERROR_NONE == error)
+            _set_state(ctl, CAMCTL_STATE_PREVIEW);
+        break;
+
+    case CAMCTL_RESTART_PREVIEW:
+        if (CAMCTL_STATE_STOPPED == state) {
+            error = _set_preview_callback(ctl);
+            if (HAL_ERROR_NONE != error)
+                break;
+        }
+
+        /*
+         * Start, stop and start again: after a capture the changes of the
+         * preview brightness are not visible otherwise.
+         */
+        error = hal_camera_start_preview(camera);
+        if (HAL_ERROR_NONE == error)
+            error = hal_camera_stop_preview(camera);
+        if (HAL_ERROR_NONE == error)
+            error = hal_camera_start_preview(camera);
+
+        if (HAL_ERROR_NONE == error && CAMCTL_STATE_STOPPED == state)
+            _set_state(ctl, CAMCTL_STATE_PREVIEW);
+        break;
+
+    case CAMCTL_CHANGE_RESOLUTION: {
+        pthread_mutex_lock(&ctl->lock);
+        int width = ctl->width;
+        int height = ctl->height;
+        pthread_mutex_unlock(&ctl->lock);
+
+        if (CAMCTL_STATE_STOPPED == state) {
+            error = hal_camera_set_preview_resolution(camera, width, height);
+            break;
+        }
+
+        /* The resolution only changes while the preview is stopped. */
+        if (CAMCTL_STATE_FACE_DETECTION == state) {
+            error = hal_camera_stop_face_detection(camera);
+            if (HAL_ERROR_NONE != error)
+                break;
+            _set_state(ctl, CAMCTL_STATE_PREVIEW);
+        }
+
+        error = hal_camera_stop_preview(camera);
+        if (HAL_ERROR_NONE == error) {
+            error = hal_camera_set_preview_resolution(camera, width, height);
+            int start_error = hal_camera_start_preview(camera);
+            if (HAL_ERROR_NONE == error)
+                error = start_error;
+            if (HAL_ERROR_NONE != start_error) {
+                _unset_preview_callback(ctl);
+                _set_state(ctl, CAMCTL_STATE_STOPPED);
+                break;
+            }
+        }
+
+        if (CAMCTL_STATE_FACE_DETECTION == state) {
+            int detection_error = hal_camera_start_face_detection(camera,
+                    ctl->callbacks.faces, ctl->user_data);
+            if (HAL_ERROR_NONE == detection_error)
+                _set_state(ctl, CAMCTL_STATE_FACE_DETECTION);
+            else if (HAL_ERROR_NONE == error)
+                error = detection_error;
+        }
+        break;
+    }
+    }
+
+    return error;
+}
+
+static void *_command_thread(void *user_data)
+{
+    camctl_h ctl = (camctl_h) user_data;
+
+    trace_set_thread_name("camctl");
+    pthread_mutex_lock(&ctl->lock);
+
+    for (;;) {
+        while (0 == ctl->count && !ctl->stop)
+            pthread_cond_wait(&ctl->cond, &ctl->lock);
+        if (ctl->stop)
+            break;
+
+        camctl_command_e command = ctl->queue[ctl->head];
+        unsigned long long queued_ns = ctl->queued_ns[ctl->head];
+        ctl->head = (ctl->head + 1) % CAMCTL_QUEUE_LENGTH;
+        ctl->count--;
+        ctl->executing = true;
+        ctl->current = command;
+        pthread_mutex_unlock(&ctl->lock);
+
+        unsigned long long start_ns = _now_ns();
+        TRACE_BEGIN(camctl_command_name(command));
+        int error = _execute(ctl, command);
+        TRACE_END(camctl_command_name(command));
+        unsigned long long end_ns = _now_ns();
+
+        hal_log((HAL_ERROR_NONE == error) ? HAL_LOG_INFO : HAL_LOG_ERROR,
+                "camctl: %s took %llu us, queued for %llu us, error %d",
+                camctl_command_name(command), (end_ns - start_ns) / 1000,
+                (start_ns - queued_ns) / 1000, error);
+
+        pthread_mutex_lock(&ctl->lock);
+        ctl->executing = false;
+        _complete(ctl, command, error, ctl->state);
+        pthread_cond_broadcast(&ctl->cond);
+    }
+
+    pthread_mutex_unlock(&ctl->lock);
+
+    return NULL;
+}
+
+/**
+ * @brief Creates the camera control of a stopped camera and starts its
+ *        command thread.
+ *
+ * @param camera     The camera, which is left to the control until it is
+ *                   destroyed
+ * @param callbacks  The camera callbacks and the command notifications
+ * @param user_data  The user data passed to all the callbacks
+ * @param ctl        The handle of the newly created camera control
+ *
+ * @return 0 on success, otherwise a negative errno value
+ */
+int camctl_create(hal_camera_h camera, const camctl_callbacks_s *callbacks,
+                  void *user_data, camctl_h *ctl)
+{
+    if (NULL == camera || NULL == callbacks
+            || (NULL == callbacks->preview && NULL == callbacks->frame)
+            || NULL == callbacks->faces || NULL == ctl)
+        return -EINVAL;
+
+    camctl_h c = (camctl_h) calloc(1, sizeof(*c));
+    if (NULL == c)
+        return -ENOMEM;
+
+    c->camera = camera;
+    c->callbacks = *callbacks;
+    c->user_data = user_data;
+    c->state = CAMCTL_STATE_STOPPED;
+    pthread_mutex_init(&c->lock, NULL);
+    pthread_cond_init(&c->cond, NULL);
+
+    int error = -pthread_create(&c->thread, NULL, _command_thread, c);
+    if (0 != error) {
+        pthread_cond_destroy(&c->cond);
+        pthread_mutex_destroy(&c->lock);
+        free(c);
+        return error;
+    }
+
+    *ctl = c;
+
+    return 0;
+}
+
+/**
+ * @brief Drops the queued commands, stops the camera and the command thread.
+ * @details Waits for the command being executed and stops the preview on the
+ *          calling thread, so the camera can be destroyed right after. The
+ *          dropped commands are not reported.
+ *
+ * @param ctl  The camera control handle
+ */
+void camctl_destroy(camctl_h ctl)
+{
+    if (NULL == ctl)
+        return;
+
+    pthread_mutex_lock(&ctl->lock);
+    ctl->stop = true;
+    ctl->count = 0;
+    pthread_cond_broadcast(&ctl->cond);
+    pthread_mutex_unlock(&ctl->lock);
+
+    pthread_join(ctl->thread, NULL);
+    _execute(ctl, CAMCTL_STOP_PREVIEW);
+
+    pthread_cond_destroy(&ctl->cond);
+    pthread_mutex_destroy(&ctl->lock);
+    free(ctl);
+}
+
+/**
+ * @brief Queues a command for the command thread.
+ * @details A command that undoes the last queued one cancels it, and a
+ *          command without effect on the state the queue leads to is dropped.
+ *          Both still complete, without error. Starting the face detection
+ *          without a preview completes with -EINVAL.
+ *
+ * @param ctl      The camera control handle
+ * @param command  The command
+ *
+ * @return 0 if the command will complete, -EBUSY if the queue is full,
+ *         otherwise a negative errno value
+ */
+int camctl_submit(camctl_h ctl, camctl_command_e command)
+{
+    if (NULL == ctl)
+        return -EINVAL;
+
+    pthread_mutex_lock(&ctl->lock);
+
+    camctl_state_e pending = _projected_state(ctl, ctl->count);
+    camctl_state_e next = _apply(pending, command);
+
+    if (CAMCTL_START_FACE_DETECTION == command && CAMCTL_STATE_STOPPED == pending) {
+        _complete(ctl, command, -EINVAL, pending);
+    } else if (next == pending && !_is_action(command)) {
+        _complete(ctl, command, HAL_ERROR_NONE, pending);
+    } else if (ctl->count > 0
+            && !_is_action(command)
+            && !_is_action(ctl->queue[(ctl->head + ctl->count - 1)
+                    % CAMCTL_QUEUE_LENGTH])
+            && _projected_state(ctl, ctl->count - 1) == next) {
+        /* Back to the state before the last queued command. */
+        camctl_command_e last = ctl->queue[(ctl->head + ctl->count - 1)
+                % CAMCTL_QUEUE_LENGTH];
+        ctl->count--;
+        hal_log(HAL_LOG_DEBUG, "camctl: %s cancels %s",
+                camctl_command_name(command), camctl_command_name(last));
+        _complete(ctl, last, HAL_ERROR_NONE, next);
+        _complete(ctl, command, HAL_ERROR_NONE, next);
+    } else if (CAMCTL_QUEUE_LENGTH == ctl->count) {
+        pthread_mutex_unlock(&ctl->lock);
+        return -EBUSY;
+    } else {
+        int tail = (ctl->head + ctl->count) % CAMCTL_QUEUE_LENGTH;
+        ctl->queue[tail] = command;
+        ctl->queued_ns[tail] = _now_ns();
+        ctl->count++;
+        pthread_cond_broadcast(&ctl->cond);
+    }
+
+    pthread_mutex_unlock(&ctl->lock);
+
+    return 0;
+}
+
+/**
+ * @brief Changes the preview resolution, restarting the preview if it runs.
+ * @details Queues CAMCTL_CHANGE_RESOLUTION. The face detection is started
+ *          again if it was running. When several changes are queued, all of
+ *          them apply the last resolution.
+ *
+ * @param ctl     The camera control handle
+ * @param width   The preview width, one of the supported resolutions
+ * @param height  The preview height
+ *
+ * @return 0 if the command will complete, -EBUSY if the queue is full,
+ *         otherwise a negative errno value
+ */
+int camctl_set_preview_resolution(camctl_h ctl, int width, int height)
+{
+    if (NULL == ctl || width <= 0 || height <= 0)
+        return -EINVAL;
+
+    pthread_mutex_lock(&ctl->lock);
+    ctl->width = width;
+    ctl->height = height;
+    pthread_mutex_unlock(&ctl->lock);
+
+    return camctl_submit(ctl, CAMCTL_CHANGE_RESOLUTION);
+}
+
+/**
+ * @brief Returns the state the camera is in now.
+ */
+camctl_state_e camctl_get_state(camctl_h ctl)
+{
+    if (NULL == ctl)
+        return CAMCTL_STATE_STOPPED;
+
+    pthread_mutex_lock(&ctl->lock);
+    camctl_state_e state = ctl->state;
+    pthread_mutex_unlock(&ctl->lock);
+
+    return state;
+}
+
+/**
+ * @brief Returns the state the camera will be in once the queued commands
+ *        succeeded, which is what the UI shows.
+ */
+camctl_state_e camctl_get_pending_state(camctl_h ctl)
+{
+    if (NULL == ctl)
+        return CAMCTL_STATE_STOPPED;
+
+    pthread_mutex_lock(&ctl->lock);
+    camctl_state_e state = _projected_state(ctl, ctl->count);
+    pthread_mutex_unlock(&ctl->lock);
+
+    return state;
+}
+
+/**
+ * @brief Waits until all the queued commands are executed. Blocks for as
+ *        long as the camera calls take, so it is not meant for the main loop.
+ */
+void camctl_sync(camctl_h ctl)
+{
+    if (NULL == ctl)
+        return;
+
+    pthread_mutex_lock(&ctl->lock);
+    while (ctl->count > 0 || ctl->executing)
+        pthread_cond_wait(&ctl->cond, &ctl->lock);
+    pthread_mutex_unlock(&ctl->lock);
+}
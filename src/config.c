@@ -0,0 +1,348 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Flora License, Version 1.1 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://floralicense.org/license/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "config.h"
+#include "facefilter.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+typedef enum {
+    CONFIG_INT,
+    CONFIG_BOOL,
+    CONFIG_STRING,
+    CONFIG_ENUM,
+    CONFIG_ZONES,
+} config_type_e;
+
+typedef struct _config_key {
+    const char *name;
+    config_type_e type;
+    size_t offset;
+    int min;          /* Range of CONFIG_INT */
+    int max;
+    const char *const *names; /* Values of CONFIG_ENUM, in enum order */
+} config_key_s;
+
+static const char *const s_devices[] = {
+    [HAL_CAMERA_DEVICE_BACK] = "back",
+    [HAL_CAMERA_DEVICE_FRONT] = "front",
+    NULL,
+};
+
+static const char *const s_levels[] = {
+    [HAL_LOG_DEBUG] = "debug",
+    [HAL_LOG_INFO] = "info",
+    [HAL_LOG_WARN] = "warn",
+    [HAL_LOG_ERROR] = "error",
+    NULL,
+};
+
+static const char *const s_log_modes[] = {
+    [CONFIG_LOG_DIRECT] = "direct",
+    [CONFIG_LOG_DEFERRED] = "deferred",
+    [CONFIG_LOG_BINARY] = "binary",
+    NULL,
+};
+
+static const char *const s_metrics_formats[] = {
+    [METRICS_PROMETHEUS] = "prometheus",
+    [METRICS_JSON] = "json",
+    NULL,
+};
+
+#define INT_KEY(key, field, lo, hi) \
+    { key, CONFIG_INT, offsetof(config_s, field), lo, hi, NULL }
+#define BOOL_KEY(key, field) \
+    { key, CONFIG_BOOL, offsetof(config_s, field), 0, 0, NULL }
+#define STRING_KEY(key, field) \
+    { key, CONFIG_STRING, offsetof(config_s, field), 0, 0, NULL }
+#define ENUM_KEY(key, field, values) \
+    { key, CONFIG_ENUM, offsetof(config_s, field), 0, 0, values }
+#define ZONES_KEY(key, field) \
+    { key, CONFIG_ZONES, offsetof(config_s, field), 0, ZONE_SCALE, NULL }
+
+static const config_key_s s_keys[] = {
+    INT_KEY("filter.max_faces", max_faces, 1, MAXIMUM_FACE_NUMBER),
+    BOOL_KEY("filter.motion", motion),
+    ZONES_KEY("filter.zones", zones),
+    INT_KEY("preview.max_width", preview_max_width, 1, 65535),
+    INT_KEY("preview.max_height", preview_max_height, 0, 65535),
+    ENUM_KEY("camera.device", camera_device, s_devices),
+    INT_KEY("camera.image_quality", image_quality, 1, 100),
+    BOOL_KEY("camera.frame_refs", frame_refs),
+    INT_KEY("storage.path_length", path_length, 64, 4096),
+    STRING_KEY("stream.uri", stream_uri),
+    INT_KEY("stream.queue_length", stream_queue_length, 1, 64),
+    STRING_KEY("export.name", export_name),
+    BOOL_KEY("export.raw", export_raw),
+    INT_KEY("export.slots", export_slots, 1, 64),
+    INT_KEY("export.slot_size", export_slot_size, 1, 64 * 1024 * 1024),
+    ENUM_KEY("log.level", log_level, s_levels),
+    ENUM_KEY("log.mode", log_mode, s_log_modes),
+    STRING_KEY("trace.file", trace_file),
+    STRING_KEY("metrics.file", metrics_file),
+    ENUM_KEY("metrics.format", metrics_format, s_metrics_formats),
+    INT_KEY("metrics.interval", metrics_interval, 1, 3600),
+};
+
+/**
+ * @brief Fills the configuration with the built-in settings.
+ *
+ * @param config  The configuration
+ */
+void config_default(config_s *config)
+{
+    memset(config, 0, sizeof(*config));
+    config->max_faces = MAXIMUM_FACE_NUMBER;
+    config->motion = true;
+    config->preview_max_width = 699;
+    config->preview_max_height = 0;
+    config->camera_device = HAL_CAMERA_DEVICE_FRONT;
+    config->image_quality = 100;
+    config->frame_refs = false;
+    config->path_length = 512;
+    config->stream_queue_length = 4;
+    config->export_slots = 8;
+    config->export_slot_size = 1920 * 1080 * 3 / 2;
+    config->export_raw = false;
+    config->log_level = HAL_LOG_DEBUG;
+    config->log_mode = CONFIG_LOG_DIRECT;
+    config->metrics_format = METRICS_PROMETHEUS;
+    config->metrics_interval = 10;
+}
+
+static bool _equals(const char *text, size_t len, const char *word)
+{
+    return strlen(word) == len && strncmp(text, word, len) == 0;
+}
+
+/**
+ * @brief Parses the "x y width height" zones separated by ';'. The text is
+ *        not terminated.
+ *
+ * @return @c false if a zone is malformed, out of the frame or one too many
+ */
+static bool _parse_zones(config_s *config, const config_key_s *key,
+                         const char *value, size_t len)
+{
+    zone_s zones[MAXIMUM_ZONE_NUMBER];
+    int count = 0;
+    const char *end = value + len;
+
+    while (value < end) {
+        int numbers[4];
+        int n = 0;
+
+        for (; value < end && ';' != *value; value++) {
+            if (' ' == *value || '\t' == *value)
+                continue;
+            if (*value < '0' || *value > '9' || 4 == n)
+                return false;
+            numbers[n] = 0;
+            for (; value < end && *value >= '0' && *value <= '9'; value++)
+                if ((numbers[n] = numbers[n] * 10 + (*value - '0')) > key->max)
+                    return false;
+            n++;
+            value--;
+        }
+        if (value < end)
+            value++;
+        if (0 == n)
+            continue;
+        if (4 != n || MAXIMUM_ZONE_NUMBER == count || numbers[2] < 1
+                || numbers[3] < 1)
+            return false;
+
+        zones[count].x = numbers[0];
+        zones[count].y = numbers[1];
+        zones[count].width = numbers[2];
+        zones[count].height = numbers[3];
+        count++;
+    }
+
+    memcpy(config->zones, zones, count * sizeof(zone_s));
+    config->zone_num = count;
+
+    return true;
+}
+
+/**
+ * @brief Stores a value into the field of its key.
+ *
+ * @return @c false if the value is not valid for the key
+ */
+static bool _set_value(config_s *config, const config_key_s *key,
+                       const char *value, size_t len)
+{
+    char *field = (char *) config + key->offset;
+
+    switch (key->type) {
+    case CONFIG_INT: {
+        long long number = 0;
+        size_t i = 0;
+        bool negative = (len > 0 && '-' == value[0]);
+
+        if (negative)
+            i++;
+        if (i == len)
+            return false;
+        for (; i < len; i++) {
+            if (value[i] < '0' || value[i] > '9' || number > 0x7fffffff)
+                return false;
+            number = number * 10 + (value[i] - '0');
+        }
+        if (negative)
+            number = -number;
+        if (number < key->min || number > key->max)
+            return false;
+
+        *(int *) field = (int) number;
+        return true;
+    }
+
+    case CONFIG_BOOL:
+        if (_equals(value, len, "true") || _equals(value, len, "1"))
+            *(bool *) field = true;
+        else if (_equals(value, len, "false") || _equals(value, len, "0"))
+            *(bool *) field = false;
+        else
+            return false;
+        return true;
+
+    case CONFIG_STRING:
+        if (len >= CONFIG_STRING_MAX)
+            return false;
+        memcpy(field, value, len);
+        field[len] = '\0';
+        return true;
+
+    case CONFIG_ENUM:
+        for (int i = 0; NULL != key->names[i]; i++) {
+            if (_equals(value, len, key->names[i])) {
+                /* The enums of the settings have the size of an int. */
+                *(int *) field = i;
+                return true;
+            }
+        }
+        return false;
+
+    case CONFIG_ZONES:
+        return _parse_zones(config, key, value, len);
+    }
+
+    return false;
+}
+
+/**
+ * @brief Parses one "key = value" line. The text is not terminated.
+ */
+static void _parse_line(config_s *config, const char *line, size_t len,
+                        int number)
+{
+    const char *end = line + len;
+
+    while (line < end && (' ' == *line || '\t' == *line))
+        line++;
+    while (end > line && (' ' == end[-1] || '\t' == end[-1] || '\r' == end[-1]))
+        end--;
+    if (line == end || '#' == *line)
+        return;
+
+    const char *equals = memchr(line, '=', end - line);
+    if (NULL == equals) {
+        hal_log(HAL_LOG_WARN, "config: line %d: missing '='", number);
+        return;
+    }
+
+    const char *key_end = equals;
+    while (key_end > line && (' ' == key_end[-1] || '\t' == key_end[-1]))
+        key_end--;
+    const char *value = equals + 1;
+    while (value < end && (' ' == *value || '\t' == *value))
+        value++;
+
+    for (unsigned int i = 0; i < sizeof(s_keys) / sizeof(s_keys[0]); i++) {
+        if (!_equals(line, key_end - line, s_keys[i].name))
+            continue;
+
+        if (!_set_value(config, &s_keys[i], value, end - value))
+            hal_log(HAL_LOG_WARN, "config: line %d: invalid value for %s",
+                    number, s_keys[i].name);
+        return;
+    }
+
+    hal_log(HAL_LOG_WARN, "config: line %d: unknown key '%.*s'", number,
+            (int) (key_end - line), line);
+}
+
+/**
+ * @brief Reads the settings of a configuration file over the current ones.
+ * @details The file is mapped and parsed in place, it is only read once at
+ *          startup. Lines that cannot be applied are logged and skipped, so a
+ *          mistake in one setting does not take the others down.
+ *
+ * @param path    The configuration file
+ * @param config  The configuration, usually filled by config_default() before
+ *
+ * @return 0 on success, -ENOENT if there is no such file, otherwise a
+ *         negative errno value
+ */
+int config_load(const char *path, config_s *config)
+{
+    if (NULL == path || NULL == config)
+        return -EINVAL;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return -errno;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        int error = -errno;
+        close(fd);
+        return error;
+    }
+
+    if (0 == st.st_size) {
+        close(fd);
+        return 0;
+    }
+
+    const char *text = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (MAP_FAILED == text)
+        return -errno;
+
+    const char *end = text + st.st_size;
+    int number = 1;
+
+    for (const char *line = text; line < end; number++) {
+        const char *newline = memchr(line, '\n', end - line);
+        const char *line_end = (NULL != newline) ? newline : end;
+
+        _parse_line(config, line, line_end - line, number);
+        line = line_end + 1;
+    }
+
+    munmap((void *) text, st.st_size);
+
+    return 0;
+}
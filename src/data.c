@@ -16,33 +16,113 @@
 
 #include "main.h"
 #include "data.h"
+#include "hal.h"
+#include "facefilter.h"
+#include "session.h"
+#include "config.h"
+#include "camctl.h"
+#include "bufpool.h"
+#include "arena.h"
+#include "profile.h"
+#include "trace.h"
+#include "binlog.h"
+#include "metrics.h"
+#include <errno.h>
 #include <stdio.h>
+#include <string.h>
+#include <time.h>
 #include <unistd.h>
 #include <camera.h>
-#include <storage.h>
-#include <pthread.h>
-
-#define BUFLEN 512
 
 typedef struct _camdata {
-    camera_h g_camera; /* Camera handle */
+    hal_camera_h g_camera; /* Camera handle */
+    camera_h native; /* Native handle for the Tizen specific camera settings */
     Evas_Object *cam_display;
     Evas_Object *cam_display_box;
     Evas_Object *display;
     Evas_Object *preview_bt;
     Evas_Object *face_bt;
     Evas_Object *photo_bt;
-    bool cam_prev;
-    bool face_running;
+    Evas_Object *record_bt;
 } camdata;
 static camdata cam_data;
 
 static char *camera_directory = NULL;
 
-pthread_mutex_t facelock;
+static facefilter_s face_filter;
+
+static session_recorder_h recorder = NULL;
+
+static config_s app_config;
+
+static stream_h preview_stream = NULL;
+
+static shmring_h export_ring = NULL;
+
+static camctl_h camera_ctl = NULL;
+
+/* Long-lived memory of the camera session, released when the view closes. */
+static arena_h session_arena = NULL;
+
+/* Conditions reported by the system, which select the pipeline profile. */
+static bool low_memory = false;
+static bool low_battery = false;
+
+/* Seconds after a profile switch until its effect is reported. */
+#define PROFILE_REPORT_DELAY 2.0
+
+/* State before the last profile switch, to report what it saved. */
+static struct {
+    Ecore_Timer *timer;
+    const char *name;
+    size_t memory;
+    unsigned long long frame_ns;
+} profile_switch;
+
+/* File the pipeline trace is written to, NULL while not tracing. */
+static char *trace_path = NULL;
+
+/* File the metrics are written to and the timer writing it. */
+static char *metrics_path = NULL;
+static Ecore_Timer *metrics_timer = NULL;
 
-camera_detected_face_s *cam_face;
-int cam_face_num = 0;
+/*
+ * When the photo being taken was requested, for its capture latency. Set on
+ * the main loop and taken, atomically, by the capture callback; 0 while no
+ * photo is pending.
+ */
+static unsigned long long capture_start_ns = 0;
+
+typedef enum {
+    FRAME_GRAB_IDLE,
+    FRAME_GRAB_REQUESTED, /* The next preview frame is copied */
+    FRAME_GRAB_DONE,      /* Copied, waiting for the main loop */
+} frame_grab_state_e;
+
+/* A copy of one preview frame requested by camera_grab_frame(). */
+static struct {
+    int state;
+    unsigned char *buffer;
+    unsigned int capacity;
+    frame_s frame;
+    camera_frame_grab_cb callback;
+    void *user_data;
+} frame_grab;
+
+/* The running preview resolution. */
+static int preview_width = 0;
+static int preview_height = 0;
+
+/* Paths of the photos being stored, until the main loop has shown them. */
+#define CAPTURE_PATH_NUMBER 4
+static bufpool_h capture_paths = NULL;
+
+static unsigned long long _now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
 
 /**
  * @brief Maps the given camera state to its string representation.
@@ -75,43 +155,6 @@ static const char *_camera_state_to_string(camera_state_e state)
     }
 }
 
-/**
- * @brief Gets the ID of the internal storage.
- * @details It assigns the get ID to the variable passed as the user data
- *          to the callback. This callback is called for every storage supported
- *          by the device.
- * @remarks This function matches the storage_device_supported_cb() signature
- *          defined in the storage-expand.h header file.
- *
- * @param storage_id  The unique ID of the detected storage
- * @param type        The type of the detected storage
- * @param state       The current state of the detected storage.
- *                    This argument is not used in this case.
- * @param path        The absolute path to the root directory of the detected
- *                    storage. This argument is not used in this case.
- * @param user_data   The user data passed via void pointer
- *
- * @return @c true to continue iterating over supported storages, @c false to
- *         stop the iteration.
- */
-static bool _storage_cb(int storage_id, storage_type_e type,
-                        storage_state_e state, const char *path,
-                        void *user_data)
-{
-    if (STORAGE_TYPE_INTERNAL == type) {
-        int *internal_storage_id = (int *) user_data;
-
-        if (NULL != internal_storage_id)
-            *internal_storage_id = storage_id;
-
-        /* Internal storage found, stop the iteration. */
-        return false;
-    } else {
-        /* Continue iterating over storages. */
-        return true;
-    }
-}
-
 /**
  * @brief Retrieves all supported camera preview resolutions.
  * @details Called for every preview resolution that is supported by the device.
@@ -128,8 +171,11 @@ static bool _storage_cb(int storage_id, storage_type_e type,
  */
 static bool _preview_resolution_cb(int width, int height, void *user_data)
 {
-    if (NULL != user_data && width < 700) {
-        int *resolution = (int *) user_data;
+    /* The found resolution followed by the largest width and height. */
+    int *resolution = (int *) user_data;
+
+    if (NULL != resolution && width <= resolution[2]
+            && (0 == resolution[3] || height <= resolution[3])) {
         resolution[0] = width;
         resolution[1] = height;
     }
@@ -137,6 +183,33 @@ static bool _preview_resolution_cb(int width, int height, void *user_data)
     return true;
 }
 
+/**
+ * @brief Finds the preview resolution to use within the given limits.
+ *
+ * @param max_width   The largest width
+ * @param max_height  The largest height, 0 for any
+ * @param resolution  Receives the width and the height
+ *
+ * @return CAMERA_ERROR_NONE on success, otherwise an error code
+ */
+static int _find_preview_resolution(int max_width, int max_height,
+                                    int resolution[2])
+{
+    int found[4] = { 0, 0, max_width, max_height };
+
+    int error_code = hal_camera_foreach_supported_preview_resolution(
+            cam_data.g_camera, _preview_resolution_cb, found);
+    if (CAMERA_ERROR_NONE != error_code)
+        return error_code;
+    if (0 == found[0])
+        return CAMERA_ERROR_NOT_SUPPORTED;
+
+    resolution[0] = found[0];
+    resolution[1] = found[1];
+
+    return CAMERA_ERROR_NONE;
+}
+
 /**
  * @brief Called to get the information about image data taken by the camera
  *        once per frame while capturing.
@@ -149,46 +222,10 @@ static bool _preview_resolution_cb(int width, int height, void *user_data)
  */
 static void _camera_completed_cb(void *user_data)
 {
-    /* Start the camera preview again. */
-    int error_code = camera_start_preview(cam_data.g_camera);
-    if (CAMERA_ERROR_NONE != error_code) {
-        DLOG_PRINT_ERROR("camera_start_preview", error_code);
-        PRINT_MSG("Could not restart the camera preview.");
-    }
-
-    /*
-     * The following actions (start -> stop -> start preview) are required
-     * to deal with a bug related to the camera brightness changes
-     * (Without applying this workaround, after taking a photo,
-     * the changes of the camera preview brightness are not visible).
-     */
-    error_code = camera_stop_preview(cam_data.g_camera);
-    if (CAMERA_ERROR_NONE != error_code) {
-        DLOG_PRINT_ERROR("camera_stop_preview", error_code);
-        PRINT_MSG("Could not stop the camera preview.");
-    }
-
-    error_code = camera_start_preview(cam_data.g_camera);
-    if (CAMERA_ERROR_NONE != error_code) {
-        DLOG_PRINT_ERROR("camera_start_preview", error_code);
-        PRINT_MSG("Could not restart the camera preview.");
-    }
-
-    /*
-     * The following actions (start -> stop -> start preview) are required
-     * to deal with a bug related to the camera brightness changes
-     * (without applying this workaround, after taking a photo,
-     * the changes of the camera preview brightness are not visible).
-     */
-    error_code = camera_stop_preview(cam_data.g_camera);
-    if (CAMERA_ERROR_NONE != error_code) {
-        DLOG_PRINT_ERROR("camera_stop_preview", error_code);
-        PRINT_MSG("Could not stop the camera preview.");
-    }
-
-    error_code = camera_start_preview(cam_data.g_camera);
-    if (CAMERA_ERROR_NONE != error_code) {
-        DLOG_PRINT_ERROR("camera_start_preview", error_code);
+    /* Start the camera preview again, on the camera command thread. */
+    int error_code = camctl_submit(camera_ctl, CAMCTL_RESTART_PREVIEW);
+    if (0 != error_code) {
+        DLOG_PRINT_ERROR("camctl_submit", error_code);
         PRINT_MSG("Could not restart the camera preview.");
     }
 }
@@ -203,50 +240,67 @@ static void _camera_completed_cb(void *user_data)
 static void _image_saved(void *data)
 {
     PRINT_MSG("Image stored in the %s", (char *) data);
-    free(data);
+    bufpool_put(capture_paths, data);
+}
+
+/**
+ * @brief Reports the peak memory of the camera session and releases it.
+ * @details Dispatched to the main loop after the camera is destroyed, so it
+ *          runs after the _image_saved() calls still queued, which use paths
+ *          of the arena.
+ *
+ * @param data  The arena of the session
+ */
+static void _release_session_memory(void *data)
+{
+    arena_log_usage((arena_h) data);
+    arena_destroy((arena_h) data);
 }
 
 /**
  * @brief Called to get information about image data taken by the camera
  *        once per frame while capturing.
- * @remarks This function matches the camera_capturing_cb() signature defined in
- *          the camera.h header file.
- *
- * @param image      The image data of the captured picture
- * @param postview   The image data of the post view. This argument is not used
- *                   in this case.
- * @param thumbnail  The image data of the thumbnail (it should be @c NULL if
- *                   the available thumbnail data does not exist). This argument
- *                   is not used in this case.
+ * @remarks This function matches the hal_capturing_cb() signature defined in
+ *          the hal.h header file.
+ *
+ * @param data       The encoded image of the captured picture
+ * @param size       The size of the encoded image
  * @param user_data  The user data passed from the callback registration
  *                   function. This argument is not used in this case.
  */
-static void _camera_capturing_cb(camera_image_data_s *image,
-                                 camera_image_data_s *postview,
-                                 camera_image_data_s *thumbnail,
+static void _camera_capturing_cb(const unsigned char *data, unsigned int size,
                                  void *user_data)
 {
-    if (NULL != image && NULL != image->data) {
-        dlog_print(DLOG_DEBUG, LOG_TAG, "Writing image to file.");
-
-        char *file_path = (char *) malloc(sizeof(char) * BUFLEN);
+    /* Taken even if the photo is lost, so a later photo does not reuse it. */
+    unsigned long long start_ns = __atomic_exchange_n(&capture_start_ns, 0,
+            __ATOMIC_RELAXED);
 
-        /* Create a full path to newly created file for storing the taken photo. */
-        snprintf(file_path, BUFLEN, "%s/cam%d.jpg", camera_directory,
-                (int) time(NULL));
+    if (NULL != data) {
+        hal_log(HAL_LOG_DEBUG, "Writing image to file.");
 
-        /* Open the file for writing. */
-        FILE *file = fopen(file_path, "w+");
+        /* The path comes from a pool, taking a photo does not allocate. */
+        char *file_path = (char *) bufpool_get(capture_paths);
+        if (NULL == file_path) {
+            hal_log(HAL_LOG_ERROR, "No capture path available.");
+            return;
+        }
 
-        /* Write the image to a file. */
-        fwrite(image->data, 1, image->size, file);
+        int error_code = facefilter_write_image(camera_directory, data, size,
+                file_path, bufpool_get_size(capture_paths));
+        if (0 != error_code) {
+            hal_log(HAL_LOG_ERROR,
+                    "facefilter_write_image() failed! Error code = %d", error_code);
+            bufpool_put(capture_paths, file_path);
+            return;
+        }
 
-        /* Close the file. */
-        fclose(file);
+        if (0 != start_ns)
+            metrics_observe(METRIC_CAPTURE_LATENCY, _now_ns() - start_ns);
+        session_recorder_capture(recorder, data, size);
 
-        ecore_job_add(_image_saved, (void *) file_path);
+        hal_dispatch(_image_saved, (void *) file_path);
     } else {
-        dlog_print(DLOG_ERROR, LOG_TAG,
+        hal_log(HAL_LOG_ERROR,
                 "An error occurred during taking the photo. The image is NULL.");
     }
 }
@@ -265,10 +319,11 @@ static void _camera_focus_cb(camera_focus_state_e state, void *user_data)
 {
     if (CAMERA_FOCUS_STATE_FOCUSED == state) {
         /* Take a photo. */
-        int error_code = camera_start_capture(cam_data.g_camera,
+        int error_code = hal_camera_start_capture(cam_data.g_camera,
                 _camera_capturing_cb, _camera_completed_cb,
                 NULL);
         if (CAMERA_ERROR_NONE != error_code) {
+            __atomic_store_n(&capture_start_ns, 0, __ATOMIC_RELAXED);
             DLOG_PRINT_ERROR("camera_start_capture", error_code);
             PRINT_MSG("Could not start taking a photo.");
         }
@@ -292,8 +347,11 @@ static void _camera_focus_cb(camera_focus_state_e state, void *user_data)
  */
 static void __camera_cb_photo(void *data, Evas_Object *obj, void *event_info)
 {
+    /* The latency of the photo includes the focusing. */
+    __atomic_store_n(&capture_start_ns, _now_ns(), __ATOMIC_RELAXED);
+
     /* Focus the camera on the current view. */
-    int error_code = camera_start_focusing(cam_data.g_camera, false);
+    int error_code = camera_start_focusing(cam_data.native, false);
     if (CAMERA_ERROR_NONE != error_code) {
         if (CAMERA_ERROR_NOT_SUPPORTED != error_code) {
             DLOG_PRINT_ERROR("camera_start_focusing", error_code);
@@ -310,72 +368,307 @@ static void __camera_cb_photo(void *data, Evas_Object *obj, void *event_info)
          * Take a photo (If the focusing is not supported, then just take a
          * photo, without focusing).
          */
-        error_code = camera_start_capture(cam_data.g_camera,
+        error_code = hal_camera_start_capture(cam_data.g_camera,
                 _camera_capturing_cb, _camera_completed_cb,
                 NULL);
         if (CAMERA_ERROR_NONE != error_code) {
+            __atomic_store_n(&capture_start_ns, 0, __ATOMIC_RELAXED);
             DLOG_PRINT_ERROR("camera_start_capture", error_code);
             PRINT_MSG("Could not start capturing the photo.");
         }
     }
 }
 
-static void __camera_face_detected_cb(camera_detected_face_s *faces, int count, void *user_data)
+static void __camera_face_detected_cb(face_s *faces, int count, void *user_data)
 {
-	if(count == 0){
-		cam_face_num = count;
-		return;
-	}
+	TRACE_BEGIN("camera faces");
+	if(faces != NULL || count == 0)
+		session_recorder_faces(recorder, faces, count);
 
-	if(count > 0 && faces != NULL){
-		// as there are only MAXIMUM_FACE_NUMBER space allocated for cam_face
-		count = (count > MAXIMUM_FACE_NUMBER) ? MAXIMUM_FACE_NUMBER : count;
+	facefilter_faces_detected(&face_filter, faces, count);
+	TRACE_END("camera faces");
+}
 
-		if(pthread_mutex_trylock(&facelock) == 0){
-			memcpy(cam_face, faces, sizeof(camera_detected_face_s)*count);
-			cam_face_num = count;
-			PRINT_MSG("detected: (%d, %d)", faces->x, faces->y);
-			pthread_mutex_unlock(&facelock);
-		}
-	}
+/**
+ * @brief Shows the camera state on the buttons and the preview display.
+ *
+ * @param state  The state the camera is in, or is going to be in
+ */
+static void _show_camera_state(camctl_state_e state)
+{
+    TRACE_BEGIN("ui state");
+    if (CAMCTL_STATE_STOPPED != state) {
+        /* Show the camera preview UI element. */
+        evas_object_size_hint_weight_set(cam_data.display, EVAS_HINT_EXPAND,
+                2.0);
+        evas_object_size_hint_weight_set(cam_data.cam_display_box,
+                EVAS_HINT_EXPAND, EVAS_HINT_EXPAND);
+        evas_object_show(cam_data.cam_display_box);
+
+        elm_object_text_set(cam_data.preview_bt, "Stop preview");
+
+        /* Enable other camera buttons. */
+        elm_object_disabled_set(cam_data.face_bt, EINA_FALSE);
+        // elm_object_disabled_set(cam_data.photo_bt, EINA_FALSE);
+    } else {
+        /* Hide the camera preview UI element. */
+        evas_object_size_hint_weight_set(cam_data.display, EVAS_HINT_EXPAND,
+                0.0);
+        evas_object_size_hint_weight_set(cam_data.cam_display_box,
+                EVAS_HINT_EXPAND, 0.0);
+        evas_object_hide(cam_data.cam_display_box);
+
+        elm_object_text_set(cam_data.preview_bt, "Start preview");
+
+        /* Disable other camera buttons. */
+        elm_object_disabled_set(cam_data.face_bt, EINA_TRUE);
+        // elm_object_disabled_set(cam_data.photo_bt, EINA_TRUE);
+    }
+    TRACE_END("ui state");
+}
+
+/**
+ * @brief Updates the filter right when the camera changed its state.
+ * @details Called on the camera command thread, so the filter masks faces
+ *          from the first detection on and stops with the face detection.
+ *
+ * @param state      The new camera state
+ * @param user_data  The user data passed to camctl_create(). This argument is
+ *                   not used in this case.
+ */
+static void _camera_state_changed_cb(camctl_state_e state, void *user_data)
+{
+    facefilter_set_running(&face_filter, CAMCTL_STATE_FACE_DETECTION == state);
+}
+
+/**
+ * @brief Reports a finished camera command.
+ * @details Called on the main loop. While more commands are queued, the UI
+ *          keeps showing the state they lead to.
+ *
+ * @param command    The command
+ * @param error      The error of the camera call that failed, if any
+ * @param state      The camera state after the command
+ * @param user_data  The user data passed to camctl_create(). This argument is
+ *                   not used in this case.
+ */
+static void _camera_command_completed_cb(camctl_command_e command, int error,
+                                         camctl_state_e state, void *user_data)
+{
+    /* The camera screen may be gone meanwhile. */
+    if (NULL == camera_ctl)
+        return;
+
+    if (CAMERA_ERROR_NONE != error) {
+        dlog_print(DLOG_ERROR, LOG_TAG, "Camera command %s failed! Error code = %d",
+                camctl_command_name(command), error);
+        PRINT_MSG("Could not %s.", camctl_command_name(command));
+    } else if (CAMCTL_START_PREVIEW == command) {
+        PRINT_MSG("Camera preview started.");
+    } else if (CAMCTL_STOP_PREVIEW == command) {
+        PRINT_MSG("Camera preview stopped.");
+    }
+
+    _show_camera_state(camctl_get_pending_state(camera_ctl));
 }
 
+/**
+ * @brief Toggles the face detection.
+ * @details Called when the "Face Detect" button is clicked. The command is
+ *          executed by the camera command thread.
+ * @remarks This function matches the Evas_Smart_Cb() signature defined in the
+ *          Evas_Legacy.h header file.
+ *
+ * @param data        The user data passed via void pointer. This argument is
+ *                    not used in this case.
+ * @param obj         A handle to the object on which the event occurred. In
+ *                    this case it's a pointer to the button object. This
+ *                    argument is not used in this case.
+ * @param event_info  A pointer to a data which is totally dependent on the
+ *                    smart object's implementation and semantic for the given
+ *                    event. This argument is not used in this case.
+ */
 static void __camera_cb_face(void *data, Evas_Object *obj, void *event_info)
 {
-	int error_code = 0;
-	if(cam_data.face_running){
-		error_code = camera_stop_face_detection(cam_data.g_camera);
-		if(error_code != CAMERA_ERROR_NONE){
-			DLOG_PRINT_ERROR("camera_stop_face_detection", error_code);
-			PRINT_MSG("Fail to stop face detection");
-		} else {
-			cam_data.face_running = false;
-		}
-	} else {
-		error_code = camera_start_face_detection(cam_data.g_camera, __camera_face_detected_cb, NULL);
-		if(error_code != CAMERA_ERROR_NONE){
-			DLOG_PRINT_ERROR("camera_start_face_detection", error_code);
-			PRINT_MSG("Fail to start face detection");
-		} else {
-			cam_data.face_running = true;
-		}
+	camctl_command_e command = CAMCTL_START_FACE_DETECTION;
+
+	if (CAMCTL_STATE_FACE_DETECTION == camctl_get_pending_state(camera_ctl))
+		command = CAMCTL_STOP_FACE_DETECTION;
+
+	int error_code = camctl_submit(camera_ctl, command);
+	if (0 != error_code) {
+		DLOG_PRINT_ERROR("camctl_submit", error_code);
+		PRINT_MSG("Fail to %s", camctl_command_name(command));
 	}
 }
 
-static void __camera_preview_cb(camera_preview_data_s *frame, void *user_data)
+/**
+ * @brief Passes the grabbed preview frame to the requester.
+ * @remarks This function matches the hal_dispatch_cb() signature defined in
+ *          the hal.h header file.
+ *
+ * @param data  The user data passed via void pointer. This argument is not
+ *              used in this case.
+ */
+static void _frame_grabbed(void *data)
+{
+    frame_grab.callback(&frame_grab.frame, frame_grab.user_data);
+
+    free(frame_grab.buffer);
+    frame_grab.buffer = NULL;
+    __atomic_store_n(&frame_grab.state, FRAME_GRAB_IDLE, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Copies the frame if camera_grab_frame() asked for one.
+ * @details Called on the preview thread before the frame is filtered, costs
+ *          one load otherwise.
+ */
+static void _grab_frame(const frame_s *frame)
 {
-	if(pthread_mutex_trylock(&facelock) == 0){
-		if(cam_face != NULL && cam_face_num > 0 && cam_data.face_running){
-			int begin = cam_face->x + cam_face->y*640;
-			for(int j=0;j<cam_face->height;j++){
-				for(int i=0;i<cam_face->width;i++){
-					int end = begin + i + j*640;
-					frame->data.double_plane.y[end] = 0;
-				}
-			}
-		}
-		pthread_mutex_unlock(&facelock);
-	}
+    if (FRAME_GRAB_REQUESTED != __atomic_load_n(&frame_grab.state, __ATOMIC_ACQUIRE))
+        return;
+
+    unsigned int uv_size = (NULL != frame->uv) ? frame->uv_size : 0;
+    if (frame->y_size + uv_size > frame_grab.capacity)
+        return;
+
+    memcpy(frame_grab.buffer, frame->y, frame->y_size);
+    if (uv_size > 0)
+        memcpy(frame_grab.buffer + frame->y_size, frame->uv, uv_size);
+    frame_grab.frame = *frame;
+    frame_grab.frame.y = frame_grab.buffer;
+    frame_grab.frame.uv = (uv_size > 0) ? frame_grab.buffer + frame->y_size : NULL;
+    frame_grab.frame.uv_size = uv_size;
+
+    __atomic_store_n(&frame_grab.state, FRAME_GRAB_DONE, __ATOMIC_RELEASE);
+    hal_dispatch(_frame_grabbed, NULL);
+}
+
+/**
+ * @brief Copies the next preview frame, as delivered by the camera.
+ * @details The callback runs on the main loop, the frame is valid during
+ *          the call only.
+ *
+ * @param callback   The function receiving the frame
+ * @param user_data  The user data passed to the callback
+ *
+ * @return 0 on success, -ENODEV if the preview is not running, -EBUSY if a
+ *         frame is being grabbed, otherwise a negative errno value
+ */
+int camera_grab_frame(camera_frame_grab_cb callback, void *user_data)
+{
+    if (NULL == callback)
+        return -EINVAL;
+    if (NULL == camera_ctl || CAMCTL_STATE_STOPPED == camctl_get_state(camera_ctl)
+            || 0 == preview_width)
+        return -ENODEV;
+    if (FRAME_GRAB_IDLE != __atomic_load_n(&frame_grab.state, __ATOMIC_ACQUIRE))
+        return -EBUSY;
+
+    /* Room for the preview resolution, which frames of a switch may exceed. */
+    frame_grab.capacity = (unsigned int) preview_width * preview_height * 3 / 2;
+    frame_grab.buffer = (unsigned char *) malloc(frame_grab.capacity);
+    if (NULL == frame_grab.buffer)
+        return -ENOMEM;
+
+    frame_grab.callback = callback;
+    frame_grab.user_data = user_data;
+    __atomic_store_n(&frame_grab.state, FRAME_GRAB_REQUESTED, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+static void __camera_preview_cb(frame_s *frame, void *user_data)
+{
+	TRACE_BEGIN("camera preview");
+	_grab_frame(frame);
+	/* Record the frame as delivered by the camera, before it is filtered. */
+	session_recorder_frame(recorder, frame);
+
+	facefilter_preview(&face_filter, frame);
+	TRACE_END("camera preview");
+}
+
+/**
+ * @brief Filters a preview frame received by reference.
+ * @details Used instead of __camera_preview_cb() where the camera passes its
+ *          buffers as media packets. The frame is processed in place like in
+ *          the preview callback and then released to the camera.
+ */
+static void __camera_frame_cb(hal_frame_h frame, void *user_data)
+{
+	frame_s *data = hal_frame_get(frame);
+
+	TRACE_BEGIN("camera frame");
+	_grab_frame(data);
+	session_recorder_frame(recorder, data);
+	facefilter_preview(&face_filter, data);
+
+	hal_frame_unref(frame);
+	TRACE_END("camera frame");
+}
+
+/**
+ * @brief Starts or stops recording the camera session.
+ * @details Called when the "Record session" button is clicked. The preview
+ *          frames, face detection and capture events are written to a session
+ *          file in the application data directory, which can be replayed
+ *          later to reproduce the camera callbacks without a device.
+ * @remarks This function matches the Evas_Smart_Cb() signature defined in the
+ *          Evas_Legacy.h header file.
+ *
+ * @param data        The user data passed via void pointer. This argument is
+ *                    not used in this case.
+ * @param obj         A handle to the object on which the event occurred. In
+ *                    this case it's a pointer to the button object. This
+ *                    argument is not used in this case.
+ * @param event_info  A pointer to a data which is totally dependent on the
+ *                    smart object's implementation and semantic for the given
+ *                    event. This argument is not used in this case.
+ */
+static void __camera_cb_record(void *data, Evas_Object *obj, void *event_info)
+{
+    if (session_recorder_is_recording(recorder)) {
+        if (SESSION_ERROR_NONE != session_recorder_stop(recorder))
+            PRINT_MSG("Could not finish the session file.");
+        else
+            PRINT_MSG("Session recording stopped.");
+
+        elm_object_text_set(cam_data.record_bt, "Record session");
+        return;
+    }
+
+    char *data_path = hal_get_data_path();
+    if (NULL == data_path) {
+        PRINT_MSG("Could not get the application data directory.");
+        return;
+    }
+
+    char *file_path = (char *) malloc(sizeof(char) * app_config.path_length);
+    if (NULL == file_path) {
+        free(data_path);
+        return;
+    }
+    snprintf(file_path, app_config.path_length, "%ssession%d.ffs", data_path,
+            (int) time(NULL));
+    free(data_path);
+
+    session_options_s options;
+    session_options_default(&options);
+
+    int error_code = session_recorder_start(recorder, file_path, &options);
+    if (SESSION_ERROR_NONE != error_code) {
+        dlog_print(DLOG_ERROR, LOG_TAG,
+                "session_recorder_start() failed! Error code = %d", error_code);
+        PRINT_MSG("Could not start recording the session.");
+        free(file_path);
+        return;
+    }
+
+    PRINT_MSG("Recording the session to %s", file_path);
+    elm_object_text_set(cam_data.record_bt, "Stop recording");
+    free(file_path);
 }
 
 /**
@@ -396,74 +689,326 @@ static void __camera_preview_cb(camera_preview_data_s *frame, void *user_data)
 static void __camera_cb_preview(void *data, Evas_Object *obj,
                                 void *event_info)
 {
-    int error_code = CAMERA_ERROR_NONE;
+    camctl_command_e command = CAMCTL_START_PREVIEW;
 
-    if (!cam_data.cam_prev) {
-        /* Show the camera preview UI element. */
-        evas_object_size_hint_weight_set(cam_data.display, EVAS_HINT_EXPAND,
-                2.0);
-        evas_object_size_hint_weight_set(cam_data.cam_display_box,
-        		EVAS_HINT_EXPAND, EVAS_HINT_EXPAND);
-        evas_object_show(cam_data.cam_display_box);
+    if (CAMCTL_STATE_STOPPED != camctl_get_pending_state(camera_ctl))
+        command = CAMCTL_STOP_PREVIEW;
 
-        /* Start the camera preview. */
-        error_code = camera_start_preview(cam_data.g_camera);
-        if (CAMERA_ERROR_NONE != error_code) {
-            DLOG_PRINT_ERROR("camera_start_preview", error_code);
-            PRINT_MSG("Could not start the camera preview.");
+    int error_code = camctl_submit(camera_ctl, command);
+    if (0 != error_code) {
+        DLOG_PRINT_ERROR("camctl_submit", error_code);
+        PRINT_MSG("Could not %s.", camctl_command_name(command));
+        return;
+    }
+
+    /* Show the state right away, a failure is reported on completion. */
+    _show_camera_state(camctl_get_pending_state(camera_ctl));
+}
+
+/**
+ * @brief Loads the configuration file from the application data directory.
+ * @details Without a file, the built-in settings apply.
+ */
+static void _load_config(void)
+{
+    config_default(&app_config);
+
+    char *data_path = hal_get_data_path();
+    if (NULL == data_path)
+        return;
+
+    char *file_path = (char *) malloc(strlen(data_path) + sizeof(CONFIG_FILE_NAME));
+    if (NULL != file_path) {
+        sprintf(file_path, "%s%s", data_path, CONFIG_FILE_NAME);
+
+        int error_code = config_load(file_path, &app_config);
+        if (0 == error_code)
+            dlog_print(DLOG_INFO, LOG_TAG, "Configuration loaded from %s", file_path);
+        else if (-ENOENT != error_code)
+            dlog_print(DLOG_ERROR, LOG_TAG,
+                    "config_load() failed! Error code = %d", error_code);
+        free(file_path);
+    }
+    free(data_path);
+
+    hal_set_log_priority(app_config.log_level);
+}
+
+/**
+ * @brief Defers the log of the pipeline as configured.
+ * @details The messages are formatted on the drain thread, or written to a
+ *          binary file of the data directory and formatted offline.
+ */
+static void _start_log(void)
+{
+    char *file_path = NULL;
+
+    if (CONFIG_LOG_DIRECT == app_config.log_mode)
+        return;
+
+    if (CONFIG_LOG_BINARY == app_config.log_mode) {
+        char *data_path = hal_get_data_path();
+        if (NULL == data_path)
             return;
-        }
 
-        /* Set preview callback */
-		error_code = camera_set_preview_cb(cam_data.g_camera, __camera_preview_cb, NULL);
-		if(error_code != CAMERA_ERROR_NONE){
-			DLOG_PRINT_ERROR("camera_set_preview_cb", error_code);
-			PRINT_MSG("Could not set preview callback.");
-			return;
-		}
+        file_path = (char *) malloc(strlen(data_path) + sizeof(BINLOG_FILE_NAME));
+        if (NULL != file_path)
+            sprintf(file_path, "%s%s", data_path, BINLOG_FILE_NAME);
+        free(data_path);
+        if (NULL == file_path)
+            return;
+    }
+
+    int error_code = binlog_start(file_path);
+    if (0 != error_code)
+        dlog_print(DLOG_ERROR, LOG_TAG,
+                "binlog_start() failed! Error code = %d", error_code);
+    else if (NULL != file_path)
+        dlog_print(DLOG_INFO, LOG_TAG, "Logging into %s", file_path);
+    free(file_path);
+}
 
-        PRINT_MSG("Camera preview started.");
-        cam_data.cam_prev = true;
+/**
+ * @brief Starts tracing the pipeline stages if the configuration asks for it.
+ */
+static void _start_trace(void)
+{
+    if ('\0' == app_config.trace_file[0])
+        return;
 
-        elm_object_text_set(cam_data.preview_bt, "Stop preview");
+    char *data_path = hal_get_data_path();
+    if (NULL == data_path)
+        return;
 
-        /* Enable other camera buttons. */
-        elm_object_disabled_set(cam_data.face_bt, EINA_FALSE);
-        // elm_object_disabled_set(cam_data.photo_bt, EINA_FALSE);
+    trace_path = (char *) malloc(strlen(data_path) + strlen(app_config.trace_file) + 1);
+    if (NULL != trace_path) {
+        sprintf(trace_path, "%s%s", data_path, app_config.trace_file);
+        trace_set_thread_name("main");
+        trace_start();
+        dlog_print(DLOG_INFO, LOG_TAG, "Tracing the pipeline into %s", trace_path);
+    }
+    free(data_path);
+}
+
+/**
+ * @brief Writes the pipeline trace recorded so far, if tracing.
+ * @details The recording goes on, the next call writes the file again with
+ *          the latest events.
+ */
+void camera_write_trace(void)
+{
+    if (NULL == trace_path)
+        return;
+
+    int error_code = trace_write(trace_path);
+    if (0 != error_code)
+        dlog_print(DLOG_ERROR, LOG_TAG,
+                "trace_write() failed! Error code = %d", error_code);
+}
+
+/**
+ * @brief Writes the metrics file.
+ * @remarks This function matches the Ecore_Task_Cb() signature defined in the
+ *          Ecore_Common.h header file.
+ *
+ * @param data  The user data passed via void pointer. This argument is not
+ *              used in this case.
+ *
+ * @return ECORE_CALLBACK_RENEW, the timer keeps running
+ */
+static Eina_Bool _metrics_write_cb(void *data)
+{
+    int error_code = metrics_write(metrics_path, app_config.metrics_format);
+    if (0 != error_code)
+        dlog_print(DLOG_ERROR, LOG_TAG,
+                "metrics_write() failed! Error code = %d", error_code);
+
+    return ECORE_CALLBACK_RENEW;
+}
+
+/**
+ * @brief Starts the metrics of the camera session and writes them
+ *        periodically if the configuration asks for it.
+ */
+static void _start_metrics(void)
+{
+    metrics_reset();
+
+    if ('\0' == app_config.metrics_file[0])
+        return;
+
+    char *data_path = hal_get_data_path();
+    if (NULL == data_path)
+        return;
+
+    metrics_path = (char *) malloc(strlen(data_path)
+            + strlen(app_config.metrics_file) + 1);
+    if (NULL != metrics_path) {
+        sprintf(metrics_path, "%s%s", data_path, app_config.metrics_file);
+        metrics_timer = ecore_timer_add(app_config.metrics_interval,
+                _metrics_write_cb, NULL);
+        dlog_print(DLOG_INFO, LOG_TAG, "Writing the metrics into %s every %d s",
+                metrics_path, app_config.metrics_interval);
+    }
+    free(data_path);
+}
+
+/**
+ * @brief Opens the configured outputs of the filtered frames and attaches
+ *        them to the filter.
+ */
+static void _open_outputs(void)
+{
+    if ('\0' != app_config.stream_uri[0]) {
+        int error_code = stream_create_from_uri(app_config.stream_uri,
+                app_config.stream_queue_length, STREAM_DROP_OLDEST,
+                &preview_stream);
+        if (0 != error_code)
+            dlog_print(DLOG_ERROR, LOG_TAG,
+                    "stream_create_from_uri() failed! Error code = %d", error_code);
+        else
+            facefilter_set_stream(&face_filter, preview_stream);
+    }
+
+    if ('\0' != app_config.export_name[0]) {
+        int error_code = shmring_create(app_config.export_name,
+                app_config.export_slots, app_config.export_slot_size,
+                &export_ring);
+        if (0 != error_code)
+            dlog_print(DLOG_ERROR, LOG_TAG,
+                    "shmring_create() failed! Error code = %d", error_code);
+        else
+            facefilter_set_export(&face_filter, export_ring,
+                    app_config.export_raw);
+    }
+}
+
+/**
+ * @brief Returns the memory of the buffers a profile can release in bytes.
+ * @details These buffers live on the heap, so what a profile drops is given
+ *          back to the system. The session arena is not counted, it is only
+ *          released when the view closes.
+ */
+static size_t _get_buffer_memory(void)
+{
+    return facefilter_get_memory(&face_filter) + stream_get_memory(preview_stream);
+}
+
+/**
+ * @brief Reports what the last profile switch changed.
+ * @remarks This function matches the Ecore_Task_Cb() signature defined in the
+ *          Ecore_Common.h header file.
+ *
+ * @param data  The user data passed via void pointer. This argument is not
+ *              used in this case.
+ *
+ * @return ECORE_CALLBACK_CANCEL, the timer runs once
+ */
+static Eina_Bool _profile_report_cb(void *data)
+{
+    size_t memory = _get_buffer_memory();
+    unsigned long long frame_ns = facefilter_get_frame_time(&face_filter);
+
+    dlog_print(DLOG_INFO, LOG_TAG,
+            "Profile %s: buffers %zu -> %zu bytes (%lld released), "
+            "session arena %zu bytes, frame time %llu -> %llu us",
+            profile_switch.name, profile_switch.memory, memory,
+            (long long) profile_switch.memory - (long long) memory,
+            arena_get_reserved(session_arena),
+            profile_switch.frame_ns / 1000, frame_ns / 1000);
+
+    profile_switch.timer = NULL;
+
+    return ECORE_CALLBACK_CANCEL;
+}
+
+/**
+ * @brief Switches the pipeline to the profile matching the system
+ *        conditions.
+ * @details The filter and stream settings apply to the running preview. The
+ *          preview is only restarted if the profile changes the resolution.
+ *          The buffer memory and the frame time are reported a moment later,
+ *          once the new settings are in effect.
+ */
+static void _apply_profile(void)
+{
+    profile_s profile = *profile_get(PROFILE_NORMAL);
+
+    if (low_memory)
+        profile_combine(&profile, profile_get(PROFILE_LOW_MEMORY));
+    if (low_battery)
+        profile_combine(&profile, profile_get(PROFILE_LOW_BATTERY));
+
+    if (low_memory && low_battery)
+        profile.name = "low-memory+low-battery";
+    else if (low_memory)
+        profile.name = profile_get(PROFILE_LOW_MEMORY)->name;
+    else if (low_battery)
+        profile.name = profile_get(PROFILE_LOW_BATTERY)->name;
+
+    /* Compare with the state before the first of close switches. */
+    if (NULL == profile_switch.timer) {
+        profile_switch.memory = _get_buffer_memory();
+        profile_switch.frame_ns = facefilter_get_frame_time(&face_filter);
     } else {
-        /* Hide the camera preview UI element. */
-        evas_object_size_hint_weight_set(cam_data.display, EVAS_HINT_EXPAND,
-                0.0);
-        evas_object_size_hint_weight_set(cam_data.cam_display_box,
-                EVAS_HINT_EXPAND, 0.0);
-        evas_object_hide(cam_data.cam_display_box);
+        ecore_timer_del(profile_switch.timer);
+    }
+    profile_switch.name = profile.name;
 
-        /* unset the camera preview callback */
-        error_code = camera_unset_preview_cb(cam_data.g_camera);
-		if (CAMERA_ERROR_NONE != error_code) {
-			DLOG_PRINT_ERROR("camera_unset_preview_cb", error_code);
-			PRINT_MSG("Could not unset the camera preview callback.");
-			return;
-		}
+    profile_apply(&profile, &app_config, &face_filter, preview_stream);
 
-        /* Stop the camera preview. */
-        error_code = camera_stop_preview(cam_data.g_camera);
-        if (CAMERA_ERROR_NONE != error_code) {
-            DLOG_PRINT_ERROR("camera_stop_preview", error_code);
-            PRINT_MSG("Could not stop the camera preview.");
-            return;
+    int resolution[2];
+    int max_width = profile_get_max_width(&profile, &app_config);
+    if (CAMERA_ERROR_NONE == _find_preview_resolution(max_width,
+            app_config.preview_max_height, resolution)
+            && (resolution[0] != preview_width || resolution[1] != preview_height)) {
+        int error_code = camctl_set_preview_resolution(camera_ctl, resolution[0],
+                resolution[1]);
+        if (0 != error_code) {
+            DLOG_PRINT_ERROR("camctl_set_preview_resolution", error_code);
+        } else {
+            preview_width = resolution[0];
+            preview_height = resolution[1];
         }
+    }
 
-        PRINT_MSG("Camera preview stopped.");
-        cam_data.cam_prev = false;
-        cam_data.face_running = false;
+    dlog_print(DLOG_INFO, LOG_TAG, "Pipeline profile %s, preview %dx%d",
+            profile.name, preview_width, preview_height);
 
-        elm_object_text_set(cam_data.preview_bt, "Start preview");
+    profile_switch.timer = ecore_timer_add(PROFILE_REPORT_DELAY,
+            _profile_report_cb, NULL);
+}
 
-        /* Disable other camera buttons. */
-        elm_object_disabled_set(cam_data.face_bt, EINA_TRUE);
-        // elm_object_disabled_set(cam_data.photo_bt, EINA_TRUE);
-    }
+/**
+ * @brief Switches the pipeline profile when the system runs low on memory
+ *        or recovers.
+ *
+ * @param active  Whether the memory is low
+ */
+void camera_set_low_memory(bool active)
+{
+    if (active == low_memory)
+        return;
+
+    low_memory = active;
+    if (NULL != camera_ctl)
+        _apply_profile();
+}
+
+/**
+ * @brief Switches the pipeline profile when the battery runs low or is
+ *        charged again.
+ *
+ * @param active  Whether the battery is low
+ */
+void camera_set_low_battery(bool active)
+{
+    if (active == low_battery)
+        return;
+
+    low_battery = active;
+    if (NULL != camera_ctl)
+        _apply_profile();
 }
 
 /**
@@ -472,24 +1017,84 @@ static void __camera_cb_preview(void *data, Evas_Object *obj,
 void camera_pop_cb()
 {
     /* Stop camera focusing. */
-    camera_cancel_focusing(cam_data.g_camera);
+    camera_cancel_focusing(cam_data.native);
 
-    /* Stop camera preview. */
-    camera_stop_preview(cam_data.g_camera);
-    cam_data.cam_prev = false;
-
-    /* Unregister camera preview callback. */
-    camera_unset_preview_cb(cam_data.g_camera);
+    /*
+     * Drop the pending camera commands and stop the preview and the face
+     * detection. This is the only place waiting for the camera.
+     */
+    camctl_h ctl = camera_ctl;
+    camera_ctl = NULL;
+    camctl_destroy(ctl);
 
     /* Unregister camera focus change callback. */
-    camera_unset_focus_changed_cb(cam_data.g_camera);
+    camera_unset_focus_changed_cb(cam_data.native);
 
     /* Destroy camera handle. */
-    camera_destroy(cam_data.g_camera);
+    hal_camera_destroy(cam_data.g_camera);
     cam_data.g_camera = NULL;
+    cam_data.native = NULL;
+
+    /* A frame requested but not delivered will not come any more. */
+    if (FRAME_GRAB_REQUESTED == frame_grab.state) {
+        free(frame_grab.buffer);
+        frame_grab.buffer = NULL;
+        frame_grab.state = FRAME_GRAB_IDLE;
+    }
+
+    /* Finish the session recording, the callbacks no longer use it. */
+    session_recorder_destroy(recorder);
+    recorder = NULL;
+
+    /* Flush and close the outputs of the filtered frames. */
+    facefilter_set_stream(&face_filter, NULL);
+    stream_destroy(preview_stream);
+    preview_stream = NULL;
+    facefilter_set_export(&face_filter, NULL, false);
+    shmring_destroy(export_ring);
+    export_ring = NULL;
+
+    /* The profile report reads the filter. */
+    if (NULL != profile_switch.timer) {
+        ecore_timer_del(profile_switch.timer);
+        profile_switch.timer = NULL;
+    }
+
+    /* Release the face store. */
+    facefilter_deinit(&face_filter);
+
+    /* The camera threads are done, write their trace. */
+    camera_write_trace();
+    trace_release();
+    free(trace_path);
+    trace_path = NULL;
+
+    /* Write the final metrics of the session. */
+    if (NULL != metrics_timer) {
+        ecore_timer_del(metrics_timer);
+        metrics_timer = NULL;
+        _metrics_write_cb(NULL);
+    }
+    free(metrics_path);
+    metrics_path = NULL;
 
-    /* Free the Camera directory path. */
-    free(camera_directory);
+    /* Log the deferred messages, the later ones are logged directly. */
+    binlog_stop();
+
+    bufpool_destroy(capture_paths);
+    capture_paths = NULL;
+    /* Without the session arena, the path was copied to the heap. */
+    if (NULL == session_arena)
+        free(camera_directory);
+    camera_directory = NULL;
+
+    /*
+     * Release the memory of the session at once, including the Camera
+     * directory path, when the pending notifications have been shown.
+     */
+    if (0 != hal_dispatch(_release_session_memory, session_arena))
+        _release_session_memory(session_arena);
+    session_arena = NULL;
 }
 
 /**
@@ -553,6 +1158,8 @@ void create_buttons_in_main_window(void)
             __camera_cb_preview);
     cam_data.face_bt = _new_button(cam_data.display, "Face Detect",
                 __camera_cb_face);
+    cam_data.record_bt = _new_button(cam_data.display, "Record session",
+            __camera_cb_record);
     // cam_data.photo_bt = _new_button(cam_data.display, "Take a photo", __camera_cb_photo);
 
     /*
@@ -562,17 +1169,49 @@ void create_buttons_in_main_window(void)
     elm_object_disabled_set(cam_data.face_bt, EINA_TRUE);
     // elm_object_disabled_set(cam_data.photo_bt, EINA_TRUE);
 
-    /* Create the camera handle for the main camera of the device. */
-    int error_code = camera_create(CAMERA_DEVICE_CAMERA1, &(cam_data.g_camera));
+    /* Read the device specific settings over the built-in ones. */
+    _load_config();
+    _start_log();
+    _start_trace();
+    _start_metrics();
+
+    /*
+     * The long-lived memory of the session comes from one arena. Without it,
+     * the modules fall back to the heap.
+     */
+    int error_code = arena_create(&session_arena);
+    if (0 != error_code)
+        dlog_print(DLOG_ERROR, LOG_TAG,
+                "arena_create() failed! Error code = %d", error_code);
+
+    /* Initialize the face store shared by the camera callbacks. */
+    if (0 != facefilter_init(&face_filter)) {
+        PRINT_MSG("Fail to initiate mutex.");
+    }
+    facefilter_set_max_faces(&face_filter, app_config.max_faces);
+    facefilter_set_motion(&face_filter, app_config.motion);
+    facefilter_set_zones(&face_filter, app_config.zones, app_config.zone_num);
+    _open_outputs();
+
+    /* Preallocate the paths of the photos, the capture callback takes them. */
+    error_code = bufpool_create(session_arena, CAPTURE_PATH_NUMBER,
+            app_config.path_length, &capture_paths);
+    if (0 != error_code)
+        dlog_print(DLOG_ERROR, LOG_TAG,
+                "bufpool_create() failed! Error code = %d", error_code);
+
+    /* Create the camera handle for the configured camera of the device. */
+    error_code = hal_camera_create(app_config.camera_device, &(cam_data.g_camera));
     if (CAMERA_ERROR_NONE != error_code) {
         DLOG_PRINT_ERROR("camera_create", error_code);
         PRINT_MSG("Could not create a handle to the camera.");
         return;
     }
+    cam_data.native = (camera_h) hal_camera_get_native(cam_data.g_camera);
 
     /* Check the camera state after creating the handle. */
     camera_state_e state;
-    error_code = camera_get_state(cam_data.g_camera, &state);
+    error_code = camera_get_state(cam_data.native, &state);
     if (CAMERA_ERROR_NONE != error_code || CAMERA_STATE_CREATED != state) {
         dlog_print(DLOG_ERROR, LOG_TAG,
                 "camera_get_state() failed! Error code = %d, state = %s",
@@ -584,7 +1223,7 @@ void create_buttons_in_main_window(void)
      * Enable EXIF data storing during taking picture. This is required to edit
      * the orientation of the image.
      */
-    error_code = camera_attr_enable_tag(cam_data.g_camera, true);
+    error_code = camera_attr_enable_tag(cam_data.native, true);
     if (CAMERA_ERROR_NONE != error_code) {
         DLOG_PRINT_ERROR("camera_attr_enable_tag", error_code);
         PRINT_MSG("Could not enable the camera tag.");
@@ -594,22 +1233,23 @@ void create_buttons_in_main_window(void)
      * Set the camera image orientation. Required (on Kiran device) to save the
      * image in regular orientation (without any rotation).
      */
-    error_code = camera_attr_set_tag_orientation(cam_data.g_camera,
+    error_code = camera_attr_set_tag_orientation(cam_data.native,
             CAMERA_ATTR_TAG_ORIENTATION_RIGHT_TOP);
     if (CAMERA_ERROR_NONE != error_code) {
         DLOG_PRINT_ERROR("camera_attr_set_tag_orientation", error_code);
         PRINT_MSG("Could not set the camera image orientation.");
     }
 
-    /* Set the picture quality attribute of the camera to maximum. */
-    error_code = camera_attr_set_image_quality(cam_data.g_camera, 100);
+    /* Set the picture quality attribute of the camera, maximum by default. */
+    error_code = camera_attr_set_image_quality(cam_data.native,
+            app_config.image_quality);
     if (CAMERA_ERROR_NONE != error_code) {
         DLOG_PRINT_ERROR("camera_attr_set_image_quality", error_code);
         PRINT_MSG("Could not set the picture quality.");
     }
 
     /* Set the display for the camera preview. */
-    error_code = camera_set_display(cam_data.g_camera, CAMERA_DISPLAY_TYPE_EVAS,
+    error_code = camera_set_display(cam_data.native, CAMERA_DISPLAY_TYPE_EVAS,
             GET_DISPLAY(cam_data.cam_display));
     if (CAMERA_ERROR_NONE != error_code) {
         DLOG_PRINT_ERROR("camera_set_display", error_code);
@@ -621,8 +1261,8 @@ void create_buttons_in_main_window(void)
     int resolution[2];
 
     /* 1. Find the best resolution that is supported by the device. */
-    error_code = camera_foreach_supported_preview_resolution(cam_data.g_camera,
-            _preview_resolution_cb, resolution);
+    error_code = _find_preview_resolution(app_config.preview_max_width,
+            app_config.preview_max_height, resolution);
     if (CAMERA_ERROR_NONE != error_code) {
         DLOG_PRINT_ERROR("camera_foreach_supported_preview_resolution",
                 error_code);
@@ -631,17 +1271,21 @@ void create_buttons_in_main_window(void)
     }
 
     /* 2. Set found supported resolution for the camera preview. */
-    error_code = camera_set_preview_resolution(cam_data.g_camera, resolution[0],
+    error_code = hal_camera_set_preview_resolution(cam_data.g_camera, resolution[0],
             resolution[1]);
     if (CAMERA_ERROR_NONE != error_code) {
         DLOG_PRINT_ERROR("camera_set_preview_resolution", error_code);
         PRINT_MSG("Could not set the camera preview resolution.");
-    } else
+    } else {
         PRINT_MSG("Camera resolution set to: %d %d", resolution[0],
                 resolution[1]);
+        facefilter_set_geometry(&face_filter, resolution[0], resolution[1]);
+        preview_width = resolution[0];
+        preview_height = resolution[1];
+    }
 
     /* Set the capture format for the camera. */
-    error_code = camera_set_capture_format(cam_data.g_camera,
+    error_code = camera_set_capture_format(cam_data.native,
             CAMERA_PIXEL_FORMAT_JPEG);
     if (CAMERA_ERROR_NONE != error_code) {
         DLOG_PRINT_ERROR("camera_set_capture_format", error_code);
@@ -649,55 +1293,59 @@ void create_buttons_in_main_window(void)
     }
 
     /* Set the focusing callback function. */
-    error_code = camera_set_focus_changed_cb(cam_data.g_camera,
+    error_code = camera_set_focus_changed_cb(cam_data.native,
             _camera_focus_cb, NULL);
     if (CAMERA_ERROR_NONE != error_code) {
         DLOG_PRINT_ERROR("camera_set_focus_changed_cb", error_code);
         PRINT_MSG("Could not set a callback for the focus changes.");
     }
 
-    /* Set preview callback */
-    error_code = camera_set_preview_cb(cam_data.g_camera, __camera_preview_cb, NULL);
-    if(error_code != CAMERA_ERROR_NONE){
-    	DLOG_PRINT_ERROR("camera_set_preview_cb", error_code);
-		PRINT_MSG("Could not set preview callback.");
-		return;
+    /*
+     * Hand the camera to the command thread, which sets the preview and face
+     * detection callbacks when it starts them.
+     */
+    camctl_callbacks_s callbacks = {
+        .preview = __camera_preview_cb,
+        .frame = app_config.frame_refs ? __camera_frame_cb : NULL,
+        .faces = __camera_face_detected_cb,
+        .state_changed = _camera_state_changed_cb,
+        .completed = _camera_command_completed_cb,
+    };
+    error_code = camctl_create(cam_data.g_camera, &callbacks, NULL, &camera_ctl);
+    if (0 != error_code) {
+        DLOG_PRINT_ERROR("camctl_create", error_code);
+        PRINT_MSG("Could not start the camera command thread.");
+        elm_object_disabled_set(cam_data.preview_bt, EINA_TRUE);
+        return;
     }
 
     /* set face detection */
-    cam_data.face_running = false;
+    facefilter_set_running(&face_filter, false);
 
-	if(camera_is_supported_face_detection(cam_data.g_camera)){
+	if(hal_camera_is_supported_face_detection(cam_data.g_camera)){
 		PRINT_MSG("face support");
-		cam_face = (camera_detected_face_s*)malloc(sizeof(camera_detected_face_s)*MAXIMUM_FACE_NUMBER);
 	} else {
 		PRINT_MSG("face NO support");
 	}
 
+    /* The system may have reported low memory or battery already. */
+    if (low_memory || low_battery)
+        _apply_profile();
 
-    /* Get the path to the Camera directory: */
-
-    /* 1. Get internal storage id. */
-    int internal_storage_id = -1;
 
-    error_code = storage_foreach_device_supported(_storage_cb,
-            &internal_storage_id);
-    if (STORAGE_ERROR_NONE != error_code) {
-        DLOG_PRINT_ERROR("storage_foreach_device_supported", error_code);
-        PRINT_MSG("Could not get internal storage id.");
-        return;
-    }
-
-    /* 2. Get the path to the Camera directory. */
-    error_code = storage_get_directory(internal_storage_id,
-            STORAGE_DIRECTORY_CAMERA, &camera_directory);
-    if (STORAGE_ERROR_NONE != error_code) {
+    /* Get the path to the Camera directory, kept in the session arena. */
+    char *directory = NULL;
+    error_code = hal_storage_get_camera_directory(&directory);
+    if (HAL_ERROR_NONE != error_code) {
         DLOG_PRINT_ERROR("storage_get_directory", error_code);
         PRINT_MSG("Could not get the path to the Camera directory.");
+    } else {
+        camera_directory = arena_strdup(session_arena, "paths", directory);
+        free(directory);
     }
 
-    if(pthread_mutex_init(&facelock, NULL) != 0){
-    	PRINT_MSG("Fail to initiate mutex.");
+    if (SESSION_ERROR_NONE != session_recorder_create(&recorder)) {
+        PRINT_MSG("Could not create the session recorder.");
+        elm_object_disabled_set(cam_data.record_bt, EINA_TRUE);
     }
-
 }
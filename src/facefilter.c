@@ -0,0 +1,878 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Flora License, Version 1.1 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://floralicense.org/license/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "facefilter.h"
+#include "hal.h"
+#include "trace.h"
+#include "metrics.h"
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+static unsigned long long _now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * @brief Initializes an empty face store.
+ *
+ * @param filter  The filter to initialize
+ *
+ * @return 0 on success, otherwise a negative error value
+ */
+int facefilter_init(facefilter_s *filter)
+{
+    memset(filter->faces, 0, sizeof(filter->faces));
+    filter->face_num = 0;
+    filter->face_limit = MAXIMUM_FACE_NUMBER;
+    filter->zone_num = 0;
+    filter->zone_span_num = 0;
+    filter->span_num = 0;
+    filter->visible_num = 0;
+    filter->frame_width = 0;
+    filter->frame_height = 0;
+    motion_init(&filter->motion);
+    filter->motion_enabled = true;
+    filter->detection_interval = 1;
+    filter->detections = 0;
+    filter->frame_ns = 0;
+    filter->ring = NULL;
+    filter->ring_raw = false;
+    memset(filter->shift, 0, sizeof(filter->shift));
+    filter->running = false;
+    filter->clear_pending = false;
+    filter->generation = 0;
+    filter->stream = NULL;
+    filter->metrics = true;
+
+    return -pthread_mutex_init(&filter->facelock, NULL);
+}
+
+void facefilter_deinit(facefilter_s *filter)
+{
+    motion_deinit(&filter->motion);
+    pthread_mutex_destroy(&filter->facelock);
+}
+
+/**
+ * @brief Marks the face detection as running or stopped. The preview filter
+ *        only masks faces while the detection is running.
+ */
+void facefilter_set_running(facefilter_s *filter, bool running)
+{
+    __atomic_store_n(&filter->running, running, __ATOMIC_RELEASE);
+}
+
+bool facefilter_is_running(facefilter_s *filter)
+{
+    return __atomic_load_n(&filter->running, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief Clips the face rectangle against the frame and aligns it to the
+ *        chroma subsampling.
+ * @details The face detection may report boxes reaching past the frame edges
+ *          or even negative coordinates. The box is grown to even coordinates,
+ *          so it covers whole chroma samples, and then intersected with the
+ *          frame.
+ *
+ * @return @c false if nothing of the face is inside the frame
+ */
+static bool _clip_face(const face_s *face, int width, int height,
+                       face_span_s *span)
+{
+    long long left = face->x;
+    long long top = face->y;
+    long long right = left + face->width;
+    long long bottom = top + face->height;
+
+    if (right <= left || bottom <= top)
+        return false;
+
+    left &= ~1LL;
+    top &= ~1LL;
+    right = (right + 1) & ~1LL;
+    bottom = (bottom + 1) & ~1LL;
+
+    /* An odd frame size leaves a last column/row without its own chroma. */
+    int w = width & ~1;
+    int h = height & ~1;
+    int x0 = (left < 0) ? 0 : (left > w) ? w : (int) left;
+    int y0 = (top < 0) ? 0 : (top > h) ? h : (int) top;
+    int x1 = (right < 0) ? 0 : (right > w) ? w : (int) right;
+    int y1 = (bottom < 0) ? 0 : (bottom > h) ? h : (int) bottom;
+
+    if (x0 >= x1 || y0 >= y1)
+        return false;
+
+    span->offset = (unsigned int) y0 * width + x0;
+    span->uv_offset = (unsigned int) (y0 / 2) * width + x0;
+    span->width = x1 - x0;
+    span->height = y1 - y0;
+
+    return true;
+}
+
+/**
+ * @brief Merges clipped masks into disjoint spans sorted by row.
+ * @details The rows are cut into bands at the top and bottom edges of the
+ *          masks, and the masks covering a band are merged into disjoint
+ *          runs. A band with the same runs as the band right above extends
+ *          its spans instead of adding new ones. Every pixel is then masked
+ *          once and in memory order, however the faces and zones overlap. The
+ *          edges are even, so the spans stay aligned to the chroma.
+ *
+ * @param masks  The clipped masks, at most MAXIMUM_MASK_NUMBER
+ * @param count  The number of masks
+ * @param width  The frame width the masks were clipped for
+ * @param spans  Receives up to MAXIMUM_SPAN_NUMBER spans
+ *
+ * @return The number of spans
+ */
+static int _merge_spans(const face_span_s *masks, int count, int width,
+                        face_span_s *spans)
+{
+    int left[MAXIMUM_MASK_NUMBER], top[MAXIMUM_MASK_NUMBER];
+    int right[MAXIMUM_MASK_NUMBER], bottom[MAXIMUM_MASK_NUMBER];
+    int edges[2 * MAXIMUM_MASK_NUMBER];
+    int edge_num = 0;
+
+    for (int i = 0; i < count; i++) {
+        left[i] = masks[i].offset % width;
+        top[i] = masks[i].offset / width;
+        right[i] = left[i] + masks[i].width;
+        bottom[i] = top[i] + masks[i].height;
+
+        /* The sorted distinct edges, a handful at most. */
+        int y[2] = { top[i], bottom[i] };
+        for (int k = 0; k < 2; k++) {
+            int j = edge_num;
+            while (j > 0 && edges[j - 1] > y[k])
+                j--;
+            if (j > 0 && edges[j - 1] == y[k])
+                continue;
+            memmove(&edges[j + 1], &edges[j], (edge_num - j) * sizeof(int));
+            edges[j] = y[k];
+            edge_num++;
+        }
+    }
+
+    int n = 0;
+    int above = 0, above_num = 0; /* The spans of the band above */
+
+    for (int b = 0; b + 1 < edge_num; b++) {
+        int y0 = edges[b];
+        int y1 = edges[b + 1];
+        int runs[MAXIMUM_MASK_NUMBER][2];
+        int run_num = 0;
+
+        for (int i = 0; i < count; i++) {
+            if (top[i] > y0 || bottom[i] < y1)
+                continue;
+            int j = run_num++;
+            for (; j > 0 && runs[j - 1][0] > left[i]; j--) {
+                runs[j][0] = runs[j - 1][0];
+                runs[j][1] = runs[j - 1][1];
+            }
+            runs[j][0] = left[i];
+            runs[j][1] = right[i];
+        }
+
+        int merged = 0;
+        for (int j = 0; j < run_num; j++) {
+            if (merged > 0 && runs[j][0] <= runs[merged - 1][1]) {
+                if (runs[j][1] > runs[merged - 1][1])
+                    runs[merged - 1][1] = runs[j][1];
+            } else {
+                runs[merged][0] = runs[j][0];
+                runs[merged][1] = runs[j][1];
+                merged++;
+            }
+        }
+
+        bool same = merged > 0 && merged == above_num;
+        for (int j = 0; same && j < merged; j++)
+            same = (int) (spans[above + j].offset % width) == runs[j][0]
+                    && spans[above + j].width == runs[j][1] - runs[j][0];
+        if (same) {
+            for (int j = 0; j < merged; j++)
+                spans[above + j].height += y1 - y0;
+            continue;
+        }
+
+        above = n;
+        above_num = merged;
+        for (int j = 0; j < merged; j++, n++) {
+            spans[n].offset = (unsigned int) y0 * width + runs[j][0];
+            spans[n].uv_offset = (unsigned int) (y0 / 2) * width + runs[j][0];
+            spans[n].width = runs[j][1] - runs[j][0];
+            spans[n].height = y1 - y0;
+        }
+    }
+
+    return n;
+}
+
+/* Limits a zone edge to the frame, in thousandths of the frame size. */
+static long long _zone_edge(long long edge)
+{
+    return (edge < 0) ? 0 : (edge > ZONE_SCALE) ? ZONE_SCALE : edge;
+}
+
+/**
+ * @brief Clips a zone against the frame like a face.
+ * @details The edges are limited to the frame first, so zones of any size
+ *          scale to the frame without overflowing.
+ */
+static bool _clip_zone(const zone_s *zone, int width, int height,
+                       face_span_s *span)
+{
+    long long left = _zone_edge(zone->x);
+    long long top = _zone_edge(zone->y);
+    long long right = _zone_edge((long long) zone->x + zone->width);
+    long long bottom = _zone_edge((long long) zone->y + zone->height);
+    face_s box = {
+        .x = (int) (left * width / ZONE_SCALE),
+        .y = (int) (top * height / ZONE_SCALE),
+    };
+
+    box.width = (int) (right * width / ZONE_SCALE) - box.x;
+    box.height = (int) (bottom * height / ZONE_SCALE) - box.y;
+
+    return _clip_face(&box, width, height, span);
+}
+
+/**
+ * @brief Recomputes the spans of the stored faces and zones for the current
+ *        frame geometry. Must be called with the face lock held.
+ * @details Called whenever the faces, the zones or the geometry change, the
+ *          preview filter masks the spans as they are while nothing moves.
+ */
+static void _update_spans(facefilter_s *filter)
+{
+    face_span_s masks[MAXIMUM_MASK_NUMBER];
+    int width = filter->frame_width;
+    int height = filter->frame_height;
+    int n = 0;
+
+    filter->zone_span_num = 0;
+    if (width > 0 && height > 0) {
+        for (int i = 0; i < filter->face_num; i++)
+            if (_clip_face(&filter->faces[i], width, height, &masks[n]))
+                n++;
+        filter->visible_num = n;
+
+        for (int i = 0; i < filter->zone_num; i++)
+            if (_clip_zone(&filter->zones[i], width, height,
+                    &filter->zone_spans[filter->zone_span_num]))
+                masks[n++] = filter->zone_spans[filter->zone_span_num++];
+    } else {
+        filter->visible_num = 0;
+    }
+
+    filter->span_num = _merge_spans(masks, n, width, filter->spans);
+}
+
+/**
+ * @brief Sets the preview geometry the faces are clipped against.
+ * @details Called when the preview resolution is set. The preview filter
+ *          also picks up geometry changes from the frames themselves.
+ *
+ * @param filter  The filter
+ * @param width   The preview width
+ * @param height  The preview height
+ */
+void facefilter_set_geometry(facefilter_s *filter, int width, int height)
+{
+    pthread_mutex_lock(&filter->facelock);
+    filter->frame_width = width;
+    filter->frame_height = height;
+    _update_spans(filter);
+    pthread_mutex_unlock(&filter->facelock);
+}
+
+/**
+ * @brief Attaches the streaming output fed with the filtered frames.
+ * @details Must be called while the preview is stopped. Frames are streamed
+ *          only while the face detection is running and only after the faces
+ *          of the current snapshot have been masked; any other frame is
+ *          refused, so the stream never carries an unmasked face.
+ *
+ * @param filter  The filter
+ * @param stream  The stream, @c NULL to detach it
+ */
+void facefilter_set_stream(facefilter_s *filter, stream_h stream)
+{
+    pthread_mutex_lock(&filter->facelock);
+    filter->stream = stream;
+    pthread_mutex_unlock(&filter->facelock);
+}
+
+/**
+ * @brief Attaches a shared memory ring exporting the frames with their faces.
+ * @details Must be called while the preview is stopped. Filtered frames are
+ *          exported under the same rule as the stream. Raw frames are exported
+ *          right before the masking, with the faces the masks are made from,
+ *          for analytics that need to see the faces; they leave the process
+ *          unmasked, so the ring must only be readable by trusted processes.
+ *
+ * @param filter  The filter
+ * @param ring    The ring, @c NULL to detach it
+ * @param raw     Whether to export the frames before masking
+ */
+void facefilter_set_export(facefilter_s *filter, shmring_h ring, bool raw)
+{
+    pthread_mutex_lock(&filter->facelock);
+    filter->ring = ring;
+    filter->ring_raw = raw;
+    pthread_mutex_unlock(&filter->facelock);
+}
+
+/**
+ * @brief Enables or disables the updates of the metrics registry.
+ * @details A filter timing the pipeline stages, like the Benchmark view,
+ *          must not count its frames as those of the camera. Called before
+ *          the filter is used from other threads.
+ *
+ * @param filter   The filter
+ * @param enabled  Whether the frames and detections are counted
+ */
+void facefilter_set_metrics(facefilter_s *filter, bool enabled)
+{
+    filter->metrics = enabled;
+}
+
+/**
+ * @brief Enables or disables the motion compensated mask expansion.
+ *
+ * @param filter   The filter
+ * @param enabled  Whether to follow the faces between detections
+ */
+void facefilter_set_motion(facefilter_s *filter, bool enabled)
+{
+    pthread_mutex_lock(&filter->facelock);
+    filter->motion_enabled = enabled;
+    filter->motion.has_prev = false;
+    /* The downscaled frames are a cache, dropped while not used. */
+    if (!enabled)
+        motion_release(&filter->motion);
+    pthread_mutex_unlock(&filter->facelock);
+}
+
+/**
+ * @brief Applies only one out of @p interval face detections.
+ * @details Lowers the work of the detection callback on a device running out
+ *          of battery. The masks follow the faces less closely, so it is best
+ *          combined with masks expanded by the face motion.
+ *
+ * @param filter    The filter
+ * @param interval  1 to apply every detection
+ */
+void facefilter_set_detection_interval(facefilter_s *filter, int interval)
+{
+    pthread_mutex_lock(&filter->facelock);
+    filter->detection_interval = (interval > 1) ? interval : 1;
+    filter->detections = 0;
+    pthread_mutex_unlock(&filter->facelock);
+}
+
+/**
+ * @brief Returns the memory held by the buffers of the filter in bytes.
+ */
+size_t facefilter_get_memory(facefilter_s *filter)
+{
+    pthread_mutex_lock(&filter->facelock);
+    size_t size = (NULL != filter->motion.prev)
+            ? 2 * (size_t) filter->motion.width * filter->motion.height : 0;
+    pthread_mutex_unlock(&filter->facelock);
+
+    return size;
+}
+
+/**
+ * @brief Returns the average time of facefilter_preview() over the last
+ *        frames in nanoseconds, 0 before the first frame.
+ */
+unsigned long long facefilter_get_frame_time(facefilter_s *filter)
+{
+    return __atomic_load_n(&filter->frame_ns, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Limits the number of faces kept from every detection.
+ *
+ * @param filter     The filter
+ * @param max_faces  The limit, between 1 and MAXIMUM_FACE_NUMBER
+ */
+void facefilter_set_max_faces(facefilter_s *filter, int max_faces)
+{
+    if (max_faces < 1)
+        max_faces = 1;
+    else if (max_faces > MAXIMUM_FACE_NUMBER)
+        max_faces = MAXIMUM_FACE_NUMBER;
+
+    pthread_mutex_lock(&filter->facelock);
+    filter->face_limit = max_faces;
+    pthread_mutex_unlock(&filter->facelock);
+}
+
+/**
+ * @brief Sets the static zones masked along with the faces.
+ * @details The zones are part of the face snapshot: they are merged with the
+ *          faces into the spans here and whenever the faces change, never per
+ *          frame. They are masked on every frame, with or without faces and
+ *          also while the face detection is stopped.
+ *
+ * @param filter  The filter
+ * @param zones   The zones, in thousandths of the frame size
+ * @param count   The number of zones, 0 to remove them
+ *
+ * @return 0 on success, -EINVAL for more than MAXIMUM_ZONE_NUMBER zones
+ */
+int facefilter_set_zones(facefilter_s *filter, const zone_s *zones, int count)
+{
+    if (count < 0 || count > MAXIMUM_ZONE_NUMBER || (count > 0 && NULL == zones))
+        return -EINVAL;
+
+    pthread_mutex_lock(&filter->facelock);
+    if (count > 0)
+        memcpy(filter->zones, zones, count * sizeof(zone_s));
+    filter->zone_num = count;
+    _update_spans(filter);
+    filter->generation++;
+    pthread_mutex_unlock(&filter->facelock);
+
+    return 0;
+}
+
+/**
+ * @brief Forgets the stored faces, the zones stay. Must be called with the
+ *        face lock held.
+ */
+static void _clear_faces(facefilter_s *filter)
+{
+    filter->face_num = 0;
+    _update_spans(filter);
+    filter->generation++;
+}
+
+/**
+ * @brief Stores the faces reported by the face detection.
+ * @details Called from the face detection callback. The faces are clipped
+ *          and aligned once here, so the preview filter can mask them without
+ *          per pixel checks. If the preview filter holds the face store, the
+ *          update is skipped, the next detection event will bring fresh
+ *          faces anyway. An empty detection is not skipped: the preview
+ *          filter drops the faces before its next frame instead.
+ *
+ * @param filter  The filter
+ * @param faces   The detected faces
+ * @param count   The number of detected faces
+ */
+void facefilter_faces_detected(facefilter_s *filter, const face_s *faces,
+                               int count)
+{
+    if (filter->metrics)
+        metrics_add(METRIC_DETECTIONS, 1);
+
+    if (count == 0) {
+        /* The faces must go, if need be by the preview filter. */
+        if (pthread_mutex_trylock(&filter->facelock) == 0) {
+            _clear_faces(filter);
+            pthread_mutex_unlock(&filter->facelock);
+        } else {
+            __atomic_store_n(&filter->clear_pending, true, __ATOMIC_RELEASE);
+        }
+        return;
+    }
+
+    if (count > 0 && faces != NULL) {
+        if (pthread_mutex_trylock(&filter->facelock) == 0) {
+            if (filter->detections++ % filter->detection_interval != 0) {
+                pthread_mutex_unlock(&filter->facelock);
+                return;
+            }
+
+            TRACE_BEGIN("detection");
+
+            /* At most MAXIMUM_FACE_NUMBER, the places in the face store. */
+            count = (count > filter->face_limit) ? filter->face_limit : count;
+            memcpy(filter->faces, faces, sizeof(face_s) * count);
+            filter->face_num = count;
+            memset(filter->shift, 0, sizeof(filter->shift));
+            _update_spans(filter);
+            filter->generation++;
+            /* These faces are newer than a loss not applied yet. */
+            __atomic_store_n(&filter->clear_pending, false, __ATOMIC_RELAXED);
+            hal_log(HAL_LOG_DEBUG, "detected: (%d, %d)", faces->x, faces->y);
+            pthread_mutex_unlock(&filter->facelock);
+            TRACE_END("detection");
+        } else {
+            TRACE_INSTANT("facelock busy (detection)");
+        }
+    }
+}
+
+static int _min3(int a, int b, int c)
+{
+    int m = (a < b) ? a : b;
+
+    return (m < c) ? m : c;
+}
+
+static int _max3(int a, int b, int c)
+{
+    int m = (a > b) ? a : b;
+
+    return (m > c) ? m : c;
+}
+
+/**
+ * @brief Follows the stored faces into the current frame and computes masks
+ *        covering them wherever they may be. Must be called with the face
+ *        lock held.
+ * @details The motion of every face is estimated from the previous frame and
+ *          accumulated since the detection. The mask is the union of the
+ *          detected box, the box moved by the accumulated motion and the box
+ *          one more frame ahead, so it grows with the velocity of the face and
+ *          the age of the snapshot, and the masking cost grows only with the
+ *          extra area.
+ *
+ * @return The number of spans in filter->tracked, merged with the zones,
+ *         0 while the faces stand still and the detected spans apply
+ */
+static int _track_faces(facefilter_s *filter, const frame_s *frame)
+{
+    if (0 != motion_update(&filter->motion, frame))
+        return 0;
+
+    face_s visible[MAXIMUM_FACE_NUMBER];
+    int step[MAXIMUM_FACE_NUMBER][2];
+    bool moved = false;
+    int n = 0;
+
+    for (int i = 0; i < filter->face_num; i++) {
+        face_span_s span;
+        int dx = 0, dy = 0;
+
+        /* Follow the part of the face inside the frame only. */
+        if (_clip_face(&filter->faces[i], frame->width, frame->height, &span)) {
+            visible[i].x = span.offset % frame->width;
+            visible[i].y = span.offset / frame->width;
+            visible[i].width = span.width;
+            visible[i].height = span.height;
+        } else {
+            visible[i].width = 0;
+            visible[i].height = 0;
+        }
+
+        if (visible[i].width > 0) {
+            face_s current = visible[i];
+
+            current.x += filter->shift[i][0];
+            current.y += filter->shift[i][1];
+            motion_estimate(&filter->motion, &current, &dx, &dy);
+        }
+
+        step[i][0] = dx;
+        step[i][1] = dy;
+        filter->shift[i][0] += dx;
+        filter->shift[i][1] += dy;
+        /* A face back at its detected box may still be moving on. */
+        if (0 != filter->shift[i][0] || 0 != filter->shift[i][1] || 0 != dx
+                || 0 != dy)
+            moved = true;
+    }
+
+    if (!moved)
+        return 0;
+
+    face_span_s masks[MAXIMUM_MASK_NUMBER];
+    for (int i = 0; i < filter->face_num; i++) {
+        if (0 == visible[i].width)
+            continue;
+
+        /*
+         * Cover the detected box, the current one and one more step ahead
+         * at the current velocity. The current box is not between the two
+         * others once the face slows down or turns back.
+         */
+        int ax = filter->shift[i][0] + step[i][0];
+        int ay = filter->shift[i][1] + step[i][1];
+        int left = _min3(0, filter->shift[i][0], ax);
+        int top = _min3(0, filter->shift[i][1], ay);
+        face_s expanded = visible[i];
+
+        expanded.x += left;
+        expanded.y += top;
+        expanded.width += _max3(0, filter->shift[i][0], ax) - left;
+        expanded.height += _max3(0, filter->shift[i][1], ay) - top;
+
+        if (_clip_face(&expanded, frame->width, frame->height, &masks[n]))
+            n++;
+    }
+
+    memcpy(&masks[n], filter->zone_spans, filter->zone_span_num * sizeof(face_span_s));
+    n += filter->zone_span_num;
+
+    return _merge_spans(masks, n, frame->width, filter->tracked);
+}
+
+/**
+ * @brief Clears the luma and neutralizes the chroma of the spans.
+ */
+static void _mask_spans(frame_s *frame, const face_span_s *spans, int count)
+{
+    int width = frame->width;
+    bool has_uv = NULL != frame->uv
+            && frame->uv_size / width >= (unsigned int) frame->height / 2;
+
+    for (int i = 0; i < count; i++) {
+        const face_span_s *span = &spans[i];
+        unsigned char *row = frame->y + span->offset;
+
+        for (int j = 0; j < span->height; j++, row += width)
+            memset(row, 0, span->width);
+
+        if (!has_uv)
+            continue;
+
+        row = frame->uv + span->uv_offset;
+        for (int j = 0; j < span->height / 2; j++, row += width)
+            memset(row, 128, span->width);
+    }
+}
+
+/**
+ * @brief Moves the stored faces into a new preview geometry, so the masks
+ *        stay on the faces until the detection reports them in the new
+ *        resolution. Must be called with the face lock held.
+ */
+static void _scale_faces(facefilter_s *filter, int width, int height)
+{
+    int old_width = filter->frame_width;
+    int old_height = filter->frame_height;
+
+    if (old_width <= 0 || old_height <= 0)
+        return;
+
+    for (int i = 0; i < filter->face_num; i++) {
+        face_s *face = &filter->faces[i];
+
+        face->x = (int) ((long long) face->x * width / old_width);
+        face->width = (int) ((long long) face->width * width / old_width);
+        face->y = (int) ((long long) face->y * height / old_height);
+        face->height = (int) ((long long) face->height * height / old_height);
+    }
+    memset(filter->shift, 0, sizeof(filter->shift));
+    filter->motion.has_prev = false;
+}
+
+/* The preview filter, timed by facefilter_preview(). */
+static void _preview(facefilter_s *filter, frame_s *frame)
+{
+    int width = frame->width;
+
+    if (width <= 0 || frame->height <= 0 || NULL == frame->y
+            || frame->y_size / width < (unsigned int) frame->height)
+        return;
+
+    if (pthread_mutex_trylock(&filter->facelock) == 0) {
+        if (__atomic_exchange_n(&filter->clear_pending, false, __ATOMIC_ACQUIRE))
+            _clear_faces(filter);
+
+        bool filtered = facefilter_is_running(filter);
+        unsigned int generation = filter->generation;
+
+        if (width != filter->frame_width || frame->height != filter->frame_height) {
+            _scale_faces(filter, width, frame->height);
+            filter->frame_width = width;
+            filter->frame_height = frame->height;
+            _update_spans(filter);
+        }
+
+        /* Exported in the geometry of the frame. */
+        face_s faces[MAXIMUM_FACE_NUMBER];
+        int face_num = filter->face_num;
+        if (NULL != filter->ring)
+            memcpy(faces, filter->faces, face_num * sizeof(face_s));
+
+        int tracked = 0;
+        if (filter->face_num > 0 && filtered) {
+            if (filter->motion_enabled) {
+                TRACE_BEGIN("track");
+                tracked = _track_faces(filter, frame);
+                TRACE_END("track");
+            }
+        } else {
+            filter->motion.has_prev = false;
+        }
+
+        /*
+         * The faces and the zones are masked in one pass over the rows, from
+         * a copy so that the store is released before the frame is written.
+         */
+        face_span_s spans[MAXIMUM_SPAN_NUMBER];
+        int span_num = 0;
+        if (filtered && tracked > 0) {
+            span_num = tracked;
+            memcpy(spans, filter->tracked, span_num * sizeof(face_span_s));
+        } else if (filtered) {
+            span_num = filter->span_num;
+            memcpy(spans, filter->spans, span_num * sizeof(face_span_s));
+        } else {
+            /* The zones do not depend on the face detection running. */
+            span_num = filter->zone_span_num;
+            memcpy(spans, filter->zone_spans, span_num * sizeof(face_span_s));
+        }
+        int masked = filtered ? filter->visible_num : 0;
+        pthread_mutex_unlock(&filter->facelock);
+        if (filter->metrics)
+            metrics_observe(METRIC_FACES, masked);
+
+        if (NULL != filter->ring && filter->ring_raw) {
+            TRACE_BEGIN("export");
+            shmring_publish(filter->ring, frame, faces, face_num, generation,
+                    true);
+            TRACE_END("export");
+        }
+        if (span_num > 0) {
+            TRACE_BEGIN("mask");
+            _mask_spans(frame, spans, span_num);
+            TRACE_END("mask");
+        }
+
+        if (NULL != filter->stream) {
+            if (filtered) {
+                TRACE_BEGIN("stream push");
+                stream_push(filter->stream, frame, generation);
+                TRACE_END("stream push");
+            } else {
+                stream_refuse_unfiltered(filter->stream);
+            }
+        }
+        if (NULL != filter->ring && !filter->ring_raw && filtered) {
+            TRACE_BEGIN("export");
+            shmring_publish(filter->ring, frame, faces, face_num, generation,
+                    false);
+            TRACE_END("export");
+        }
+    } else {
+        TRACE_INSTANT("facelock busy (preview)");
+        if (filter->metrics)
+            metrics_add(METRIC_FRAMES_UNFILTERED, 1);
+        if (NULL != filter->stream)
+            stream_refuse_unfiltered(filter->stream);
+    }
+}
+
+/**
+ * @brief Masks the stored faces on the preview frame.
+ * @details Called from the camera preview callback. The luma of the faces is
+ *          cleared and their chroma neutralized, which paints them black. The
+ *          static zones are masked the same way, also while the face
+ *          detection is stopped. If the face detection callback holds the
+ *          face store, the frame is left untouched and not streamed.
+ *
+ * @param filter  The filter
+ * @param frame   The preview frame, modified in place
+ */
+void facefilter_preview(facefilter_s *filter, frame_s *frame)
+{
+    unsigned long long start = _now_ns();
+
+    TRACE_BEGIN("filter");
+    _preview(filter, frame);
+    TRACE_END("filter");
+
+    /* Average over about 16 frames, only the preview thread writes it. */
+    long long elapsed = (long long) (_now_ns() - start);
+    if (filter->metrics) {
+        metrics_add(METRIC_PREVIEW_FRAMES, 1);
+        metrics_observe(METRIC_FILTER_LATENCY, (unsigned long long) elapsed);
+    }
+    long long average = (long long) __atomic_load_n(&filter->frame_ns,
+            __ATOMIC_RELAXED);
+    average = (0 == average) ? elapsed : average + (elapsed - average) / 16;
+    __atomic_store_n(&filter->frame_ns, (unsigned long long) average,
+            __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Writes the captured image into a new file of the given directory.
+ *
+ * @param directory  The directory to store the image in
+ * @param data       The encoded image
+ * @param size       The size of the encoded image
+ * @param path       The buffer receiving the path of the written file
+ * @param path_len   The size of the path buffer
+ *
+ * @return 0 on success, otherwise a negative errno value
+ */
+int facefilter_write_image(const char *directory, const unsigned char *data,
+                           unsigned int size, char *path, size_t path_len)
+{
+    if (NULL == directory || NULL == data || NULL == path)
+        return -EINVAL;
+
+    /* Create a full path to newly created file for storing the taken photo. */
+    snprintf(path, path_len, "%s/cam%d.jpg", directory, (int) time(NULL));
+
+    int error = facefilter_write_file(path, data, size);
+    if (0 == error)
+        metrics_add(METRIC_BYTES_WRITTEN, size);
+
+    return error;
+}
+
+/**
+ * @brief Writes the captured image into the file of the given path, which
+ *        is replaced if it exists.
+ *
+ * @param path  The path of the file
+ * @param data  The encoded image
+ * @param size  The size of the encoded image
+ *
+ * @return 0 on success, otherwise a negative errno value
+ */
+int facefilter_write_file(const char *path, const unsigned char *data,
+                          unsigned int size)
+{
+    if (NULL == path || NULL == data)
+        return -EINVAL;
+
+    /* Open the file for writing. */
+    FILE *file = fopen(path, "w+");
+    if (NULL == file)
+        return -errno;
+
+    /* Write the image to a file. */
+    TRACE_BEGIN("write image");
+    int error = 0;
+    if (fwrite(data, 1, size, file) != size)
+        error = -EIO;
+
+    /* Close the file. */
+    if (fclose(file) != 0 && 0 == error)
+        error = -errno;
+    TRACE_END("write image");
+
+    return error;
+}
@@ -0,0 +1,534 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Flora License, Version 1.1 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://floralicense.org/license/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "main.h"
+#include "hal.h"
+#include "trace.h"
+#include "binlog.h"
+#include <stdarg.h>
+#include <stdlib.h>
+#include <time.h>
+#include <tizen.h>
+#include <app.h>
+#include <camera.h>
+#include <media_packet.h>
+#include <storage.h>
+#include <system_info.h>
+#include <Ecore.h>
+
+/* The number of faces converted per face detection event. */
+#define HAL_FACE_NUMBER 32
+/* Media packets held at once, the camera has a few buffers only anyway. */
+#define HAL_FRAME_NUMBER 8
+
+struct _hal_frame {
+    frame_s frame;
+    int refs;
+    media_packet_h packet;
+};
+
+struct _hal_camera {
+    camera_h handle;
+    hal_preview_cb preview_cb;
+    void *preview_data;
+    hal_frame_cb frame_cb;
+    void *frame_data;
+    struct _hal_frame frames[HAL_FRAME_NUMBER];
+    hal_face_detected_cb face_cb;
+    void *face_data;
+    face_s faces[HAL_FACE_NUMBER];
+    hal_capturing_cb capturing_cb;
+    hal_capture_completed_cb completed_cb;
+    void *capture_data;
+};
+
+static unsigned long long _now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long) ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+/**
+ * @brief Converts the native preview frame and forwards it to the HAL callback.
+ * @remarks This function matches the camera_preview_cb() signature defined in
+ *          the camera.h header file.
+ */
+static void _preview_cb(camera_preview_data_s *data, void *user_data)
+{
+    hal_camera_h camera = (hal_camera_h) user_data;
+    frame_s frame = {
+        .width = data->width,
+        .height = data->height,
+        .timestamp_us = _now_us(),
+    };
+
+    if (2 == data->num_of_planes) {
+        frame.y = data->data.double_plane.y;
+        frame.uv = data->data.double_plane.uv;
+        frame.y_size = data->data.double_plane.y_size;
+        frame.uv_size = data->data.double_plane.uv_size;
+    } else if (1 == data->num_of_planes) {
+        frame.y = data->data.single_plane.yuv;
+        frame.y_size = data->data.single_plane.size;
+    } else {
+        return;
+    }
+
+    trace_set_thread_name("camera preview");
+    camera->preview_cb(&frame, camera->preview_data);
+}
+
+/**
+ * @brief Describes the planes of a media packet as a frame.
+ * @details The rows of the planes may be padded. The frame width is the
+ *          stride then, which keeps the row offsets right; the padding is
+ *          never part of a face.
+ *
+ * @return @c true if the packet holds a two plane NV12 frame
+ */
+static bool _packet_to_frame(media_packet_h packet, frame_s *frame)
+{
+    media_format_h format = NULL;
+    media_format_mimetype_e mimetype;
+    int width = 0, height = 0;
+    uint32_t planes = 0;
+    void *y = NULL, *uv = NULL;
+    int y_stride = 0, y_rows = 0, uv_stride = 0, uv_rows = 0;
+
+    if (MEDIA_PACKET_ERROR_NONE != media_packet_get_format(packet, &format))
+        return false;
+    int error_code = media_format_get_video_info(format, &mimetype, &width,
+            &height, NULL, NULL);
+    media_format_unref(format);
+
+    if (MEDIA_FORMAT_ERROR_NONE != error_code || MEDIA_FORMAT_NV12 != mimetype
+            || MEDIA_PACKET_ERROR_NONE != media_packet_get_number_of_video_planes(
+                    packet, &planes)
+            || 2 != planes
+            || MEDIA_PACKET_ERROR_NONE != media_packet_get_video_plane_data_ptr(
+                    packet, 0, &y)
+            || MEDIA_PACKET_ERROR_NONE != media_packet_get_video_plane_data_ptr(
+                    packet, 1, &uv)
+            || MEDIA_PACKET_ERROR_NONE != media_packet_get_video_stride_width(
+                    packet, 0, &y_stride)
+            || MEDIA_PACKET_ERROR_NONE != media_packet_get_video_stride_height(
+                    packet, 0, &y_rows)
+            || MEDIA_PACKET_ERROR_NONE != media_packet_get_video_stride_width(
+                    packet, 1, &uv_stride)
+            || MEDIA_PACKET_ERROR_NONE != media_packet_get_video_stride_height(
+                    packet, 1, &uv_rows)
+            || y_stride < width || y_stride != uv_stride)
+        return false;
+
+    frame->width = y_stride;
+    frame->height = height;
+    frame->y = (unsigned char *) y;
+    frame->uv = (unsigned char *) uv;
+    frame->y_size = (unsigned int) y_stride * y_rows;
+    frame->uv_size = (unsigned int) uv_stride * uv_rows;
+    frame->timestamp_us = _now_us();
+
+    return true;
+}
+
+/**
+ * @brief Wraps the media packet of a preview frame and forwards it by
+ *        reference to the HAL callback.
+ * @details The packet stays with the camera buffer until the last reference
+ *          is released. If all the frame slots are held, the packet is
+ *          released right away and the frame dropped.
+ * @remarks This function matches the camera_media_packet_preview_cb()
+ *          signature defined in the camera.h header file.
+ */
+static void _media_packet_preview_cb(media_packet_h packet, void *user_data)
+{
+    hal_camera_h camera = (hal_camera_h) user_data;
+
+    for (int i = 0; i < HAL_FRAME_NUMBER; i++) {
+        hal_frame_h frame = &camera->frames[i];
+        int expected = 0;
+
+        if (!__atomic_compare_exchange_n(&frame->refs, &expected, 1, false,
+                __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            continue;
+
+        if (!_packet_to_frame(packet, &frame->frame)) {
+            __atomic_store_n(&frame->refs, 0, __ATOMIC_RELEASE);
+            break;
+        }
+
+        frame->packet = packet;
+        trace_set_thread_name("camera preview");
+        camera->frame_cb(frame, camera->frame_data);
+        return;
+    }
+
+    media_packet_destroy(packet);
+}
+
+frame_s *hal_frame_get(hal_frame_h frame)
+{
+    return &frame->frame;
+}
+
+hal_frame_h hal_frame_ref(hal_frame_h frame)
+{
+    __atomic_add_fetch(&frame->refs, 1, __ATOMIC_RELAXED);
+
+    return frame;
+}
+
+/**
+ * @brief Releases a frame, the media packet goes back to the camera with the
+ *        last reference.
+ */
+void hal_frame_unref(hal_frame_h frame)
+{
+    if (NULL == frame)
+        return;
+
+    /* Read before the slot can be taken again by the next packet. */
+    media_packet_h packet = frame->packet;
+
+    if (0 == __atomic_sub_fetch(&frame->refs, 1, __ATOMIC_ACQ_REL))
+        media_packet_destroy(packet);
+}
+
+/**
+ * @brief Converts the native face list and forwards it to the HAL callback.
+ * @remarks This function matches the camera_face_detected_cb() signature
+ *          defined in the camera.h header file.
+ */
+static void _face_detected_cb(camera_detected_face_s *faces, int count,
+                              void *user_data)
+{
+    hal_camera_h camera = (hal_camera_h) user_data;
+
+    if (NULL == faces || count < 0)
+        count = 0;
+    if (count > HAL_FACE_NUMBER)
+        count = HAL_FACE_NUMBER;
+
+    for (int i = 0; i < count; i++) {
+        camera->faces[i].id = faces[i].id;
+        camera->faces[i].score = faces[i].score;
+        camera->faces[i].x = faces[i].x;
+        camera->faces[i].y = faces[i].y;
+        camera->faces[i].width = faces[i].width;
+        camera->faces[i].height = faces[i].height;
+    }
+
+    trace_set_thread_name("camera faces");
+    camera->face_cb(camera->faces, count, camera->face_data);
+}
+
+/**
+ * @brief Forwards the captured image to the HAL callback.
+ * @remarks This function matches the camera_capturing_cb() signature defined
+ *          in the camera.h header file.
+ */
+static void _capturing_cb(camera_image_data_s *image,
+                          camera_image_data_s *postview,
+                          camera_image_data_s *thumbnail, void *user_data)
+{
+    hal_camera_h camera = (hal_camera_h) user_data;
+
+    if (NULL != camera->capturing_cb)
+        camera->capturing_cb((NULL != image) ? image->data : NULL,
+                (NULL != image) ? image->size : 0, camera->capture_data);
+}
+
+/**
+ * @brief Forwards the end of the capture to the HAL callback.
+ * @remarks This function matches the camera_capture_completed_cb() signature
+ *          defined in the camera.h header file.
+ */
+static void _capture_completed_cb(void *user_data)
+{
+    hal_camera_h camera = (hal_camera_h) user_data;
+
+    if (NULL != camera->completed_cb)
+        camera->completed_cb(camera->capture_data);
+}
+
+int hal_camera_create(hal_camera_device_e device, hal_camera_h *camera)
+{
+    if (NULL == camera)
+        return CAMERA_ERROR_INVALID_PARAMETER;
+
+    hal_camera_h cam = (hal_camera_h) calloc(1, sizeof(*cam));
+    if (NULL == cam)
+        return CAMERA_ERROR_OUT_OF_MEMORY;
+
+    int error_code = camera_create((HAL_CAMERA_DEVICE_FRONT == device) ?
+            CAMERA_DEVICE_CAMERA1 : CAMERA_DEVICE_CAMERA0, &cam->handle);
+    if (CAMERA_ERROR_NONE != error_code) {
+        free(cam);
+        return error_code;
+    }
+
+    *camera = cam;
+
+    return HAL_ERROR_NONE;
+}
+
+void hal_camera_destroy(hal_camera_h camera)
+{
+    if (NULL == camera)
+        return;
+
+    camera_destroy(camera->handle);
+    free(camera);
+}
+
+/**
+ * @brief Gets the native camera handle for the Tizen specific settings
+ *        (display, EXIF tags, focusing) which are not part of the HAL.
+ *
+ * @param camera  The HAL camera handle
+ *
+ * @return The camera_h handle
+ */
+void *hal_camera_get_native(hal_camera_h camera)
+{
+    return (NULL != camera) ? camera->handle : NULL;
+}
+
+int hal_camera_start_preview(hal_camera_h camera)
+{
+    return camera_start_preview(camera->handle);
+}
+
+int hal_camera_stop_preview(hal_camera_h camera)
+{
+    return camera_stop_preview(camera->handle);
+}
+
+int hal_camera_set_preview_cb(hal_camera_h camera, hal_preview_cb callback,
+                              void *user_data)
+{
+    if (NULL == callback)
+        return CAMERA_ERROR_INVALID_PARAMETER;
+
+    camera->preview_cb = callback;
+    camera->preview_data = user_data;
+
+    return camera_set_preview_cb(camera->handle, _preview_cb, camera);
+}
+
+/**
+ * @brief Sets the media packet preview callback, which passes the camera
+ *        buffers by reference instead of for the time of the callback.
+ *
+ * @return HAL_ERROR_NONE on success, CAMERA_ERROR_NOT_SUPPORTED if the device
+ *         has no media packet preview, otherwise a camera error code
+ */
+int hal_camera_set_frame_cb(hal_camera_h camera, hal_frame_cb callback,
+                            void *user_data)
+{
+    if (NULL == callback)
+        return CAMERA_ERROR_INVALID_PARAMETER;
+    if (!camera_is_supported_media_packet_preview_cb(camera->handle))
+        return CAMERA_ERROR_NOT_SUPPORTED;
+
+    camera->frame_cb = callback;
+    camera->frame_data = user_data;
+
+    return camera_set_media_packet_preview_cb(camera->handle,
+            _media_packet_preview_cb, camera);
+}
+
+int hal_camera_unset_frame_cb(hal_camera_h camera)
+{
+    return camera_unset_media_packet_preview_cb(camera->handle);
+}
+
+int hal_camera_unset_preview_cb(hal_camera_h camera)
+{
+    return camera_unset_preview_cb(camera->handle);
+}
+
+int hal_camera_foreach_supported_preview_resolution(hal_camera_h camera,
+        hal_preview_resolution_cb callback, void *user_data)
+{
+    return camera_foreach_supported_preview_resolution(camera->handle,
+            (camera_supported_preview_resolution_cb) callback, user_data);
+}
+
+int hal_camera_set_preview_resolution(hal_camera_h camera, int width, int height)
+{
+    return camera_set_preview_resolution(camera->handle, width, height);
+}
+
+bool hal_camera_is_supported_face_detection(hal_camera_h camera)
+{
+    return camera_is_supported_face_detection(camera->handle);
+}
+
+int hal_camera_start_face_detection(hal_camera_h camera,
+        hal_face_detected_cb callback, void *user_data)
+{
+    if (NULL == callback)
+        return CAMERA_ERROR_INVALID_PARAMETER;
+
+    camera->face_cb = callback;
+    camera->face_data = user_data;
+
+    return camera_start_face_detection(camera->handle, _face_detected_cb, camera);
+}
+
+int hal_camera_stop_face_detection(hal_camera_h camera)
+{
+    return camera_stop_face_detection(camera->handle);
+}
+
+int hal_camera_start_capture(hal_camera_h camera, hal_capturing_cb capturing,
+                             hal_capture_completed_cb completed, void *user_data)
+{
+    camera->capturing_cb = capturing;
+    camera->completed_cb = completed;
+    camera->capture_data = user_data;
+
+    return camera_start_capture(camera->handle, _capturing_cb,
+            _capture_completed_cb, camera);
+}
+
+/**
+ * @brief Gets the ID of the internal storage.
+ * @remarks This function matches the storage_device_supported_cb() signature
+ *          defined in the storage-expand.h header file.
+ *
+ * @return @c true to continue iterating over supported storages, @c false to
+ *         stop the iteration.
+ */
+static bool _storage_cb(int storage_id, storage_type_e type,
+                        storage_state_e state, const char *path,
+                        void *user_data)
+{
+    if (STORAGE_TYPE_INTERNAL == type) {
+        int *internal_storage_id = (int *) user_data;
+
+        if (NULL != internal_storage_id)
+            *internal_storage_id = storage_id;
+
+        /* Internal storage found, stop the iteration. */
+        return false;
+    } else {
+        /* Continue iterating over storages. */
+        return true;
+    }
+}
+
+/**
+ * @brief Gets the path to the Camera directory of the internal storage.
+ *
+ * @param path  The path, to be released with free()
+ *
+ * @return HAL_ERROR_NONE on success, otherwise a negative error code
+ */
+int hal_storage_get_camera_directory(char **path)
+{
+    /* 1. Get internal storage id. */
+    int internal_storage_id = -1;
+
+    int error_code = storage_foreach_device_supported(_storage_cb,
+            &internal_storage_id);
+    if (STORAGE_ERROR_NONE != error_code)
+        return error_code;
+
+    /* 2. Get the path to the Camera directory. */
+    return storage_get_directory(internal_storage_id,
+            STORAGE_DIRECTORY_CAMERA, path);
+}
+
+char *hal_get_data_path(void)
+{
+    return app_get_data_path();
+}
+
+/**
+ * @brief Returns the model name of the device, to be freed by the caller.
+ */
+char *hal_get_device_model(void)
+{
+    char *model = NULL;
+
+    if (SYSTEM_INFO_ERROR_NONE != system_info_get_platform_string(
+            "http://tizen.org/system/model_name", &model))
+        return NULL;
+
+    return model;
+}
+
+static hal_log_priority_e s_log_priority = HAL_LOG_DEBUG;
+
+/**
+ * @brief Sets the lowest priority of the messages passed to dlog.
+ */
+void hal_set_log_priority(hal_log_priority_e priority)
+{
+    s_log_priority = priority;
+}
+
+static const log_priority s_dlog_priorities[] = {
+    [HAL_LOG_DEBUG] = DLOG_DEBUG,
+    [HAL_LOG_INFO] = DLOG_INFO,
+    [HAL_LOG_WARN] = DLOG_WARN,
+    [HAL_LOG_ERROR] = DLOG_ERROR,
+};
+
+void hal_log(hal_log_priority_e priority, const char *fmt, ...)
+{
+    va_list ap;
+
+    if (priority < s_log_priority)
+        return;
+
+    va_start(ap, fmt);
+    va_list args;
+    va_copy(args, ap);
+    bool deferred = binlog_vrecord(priority, fmt, args);
+    va_end(args);
+    if (!deferred)
+        dlog_vprint(s_dlog_priorities[priority], LOG_TAG, fmt, ap);
+    va_end(ap);
+}
+
+/**
+ * @brief Passes a formatted message to dlog right away.
+ */
+void hal_log_text(hal_log_priority_e priority, const char *text)
+{
+    dlog_print(s_dlog_priorities[priority], LOG_TAG, "%s", text);
+}
+
+const char *hal_error_message(int error_code)
+{
+    return get_error_message(error_code);
+}
+
+/**
+ * @brief Runs the callback on the main loop.
+ * @details Unlike ecore_job_add(), this is safe to call from the camera
+ *          threads.
+ */
+int hal_dispatch(hal_dispatch_cb callback, void *data)
+{
+    ecore_main_loop_thread_safe_call_async(callback, data);
+
+    return HAL_ERROR_NONE;
+}
@@ -19,10 +19,14 @@
 #include <system_settings.h>
 #include <efl_extension.h>
 #include <dlog.h>
+#include <device/battery.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "main.h"
 #include "view.h"
 #include "data.h"
+#include "benchview.h"
 
 /**
  * @brief Hook to take necessary actions before main event loop starts.
@@ -42,13 +46,23 @@ static bool app_create(void *user_data)
 /**
  * @brief This callback function is called when another application
  * sends a launch request to the application.
+ * The extra data "mode" = "benchmark" opens the hidden Benchmark view.
  *
- * @param app_control The launch request handle (not used here)
+ * @param app_control The launch request handle
  * @param user_data The data passed from the callback registration function (not used here)
  */
 static void app_control(app_control_h app_control, void *user_data)
 {
     /* Handle the launch request. */
+    char *mode = NULL;
+
+    if (APP_CONTROL_ERROR_NONE != app_control_get_extra_data(app_control,
+            "mode", &mode))
+        return;
+
+    if (0 == strcmp(mode, "benchmark"))
+        benchview_create();
+    free(mode);
 }
 
 /**
@@ -61,6 +75,7 @@ static void app_control(app_control_h app_control, void *user_data)
 static void app_pause(void *user_data)
 {
     /* Take necessary actions when application becomes invisible. */
+    camera_write_trace();
 }
 
 /**
@@ -72,6 +87,11 @@ static void app_pause(void *user_data)
 static void app_resume(void *user_data)
 {
     /* Take necessary actions when application becomes visible. */
+    bool charging = false;
+
+    /* There is no event when the battery recovers, the charger tells it. */
+    if (DEVICE_ERROR_NONE == device_battery_is_charging(&charging) && charging)
+        camera_set_low_battery(false);
 }
 
 /**
@@ -104,6 +124,43 @@ static void ui_app_lang_changed(app_event_info_h event_info, void *user_data)
     return;
 }
 
+/**
+ * @brief This function will be called when the system runs low on memory or
+ * the memory is available again.
+ *
+ * @param event_info The system event information, holding the memory status
+ * @param user_data The data passed from the callback registration function (not used here)
+ */
+static void ui_app_low_memory(app_event_info_h event_info, void *user_data)
+{
+    /* APP_EVENT_LOW_MEMORY */
+    app_event_low_memory_status_e status = APP_EVENT_LOW_MEMORY_NORMAL;
+
+    if (APP_ERROR_NONE != app_event_get_low_memory_status(event_info, &status))
+        return;
+
+    dlog_print(DLOG_INFO, LOG_TAG, "Low memory status: %d", status);
+    camera_set_low_memory(APP_EVENT_LOW_MEMORY_NORMAL != status);
+}
+
+/**
+ * @brief This function will be called when the battery runs low.
+ *
+ * @param event_info The system event information, holding the battery status
+ * @param user_data The data passed from the callback registration function (not used here)
+ */
+static void ui_app_low_battery(app_event_info_h event_info, void *user_data)
+{
+    /* APP_EVENT_LOW_BATTERY */
+    app_event_low_battery_status_e status = APP_EVENT_LOW_BATTERY_CRITICAL_LOW;
+
+    if (APP_ERROR_NONE != app_event_get_low_battery_status(event_info, &status))
+        return;
+
+    dlog_print(DLOG_INFO, LOG_TAG, "Low battery status: %d", status);
+    camera_set_low_battery(true);
+}
+
 /**
  * @brief Main function of the application.
  */
@@ -125,6 +182,8 @@ int main(int argc, char *argv[])
      * please check the application life cycle guide.
      */
     ui_app_add_event_handler(&handlers[APP_EVENT_LANGUAGE_CHANGED], APP_EVENT_LANGUAGE_CHANGED, ui_app_lang_changed, NULL);
+    ui_app_add_event_handler(&handlers[APP_EVENT_LOW_MEMORY], APP_EVENT_LOW_MEMORY, ui_app_low_memory, NULL);
+    ui_app_add_event_handler(&handlers[APP_EVENT_LOW_BATTERY], APP_EVENT_LOW_BATTERY, ui_app_low_battery, NULL);
 
     ret = ui_app_main(argc, argv, &event_callback, NULL);
     if (ret != APP_ERROR_NONE)
@@ -0,0 +1,328 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Flora License, Version 1.1 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://floralicense.org/license/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "metrics.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Buckets of a histogram, the last one is +Inf. */
+#define METRIC_BUCKETS 15
+
+typedef enum {
+    METRIC_COUNTER,
+    METRIC_GAUGE,
+    METRIC_RATE,      /* Per second increase of another counter */
+    METRIC_HISTOGRAM,
+} metric_type_e;
+
+typedef struct _metric_def {
+    const char *name;
+    const char *help;
+    metric_type_e type;
+    metric_e source;                /* Counter of METRIC_RATE */
+    double scale;                   /* Unit of the file per recorded unit */
+    const unsigned long long *bounds; /* Upper bounds of METRIC_HISTOGRAM */
+    int bound_count;
+} metric_def_s;
+
+/* Values of a metric, kept on a cache line of their own. */
+typedef struct _metric {
+    unsigned long long value; /* Counter, gauge or sum of the histogram */
+    unsigned long long buckets[METRIC_BUCKETS];
+} __attribute__((aligned(64))) metric_s;
+
+static const unsigned long long s_frame_bounds[] = {
+    25000, 50000, 100000, 250000, 500000, 1000000, 2500000, 5000000,
+    10000000, 25000000, 50000000, 100000000, 250000000, 1000000000,
+};
+
+static const unsigned long long s_capture_bounds[] = {
+    10000000, 25000000, 50000000, 100000000, 250000000, 500000000,
+    1000000000, 2500000000ULL, 5000000000ULL, 10000000000ULL,
+};
+
+static const unsigned long long s_face_bounds[] = {
+    0, 1, 2, 3, 4, 5, 6, 7,
+};
+
+#define BOUNDS(bounds) bounds, sizeof(bounds) / sizeof(bounds[0])
+
+static const metric_def_s s_defs[METRIC_NUMBER] = {
+    [METRIC_PREVIEW_FRAMES] = { "preview_frames_total",
+            "Preview frames through the filter", METRIC_COUNTER, 0, 1, NULL, 0 },
+    [METRIC_PREVIEW_FPS] = { "preview_fps",
+            "Preview frames per second since the previous write", METRIC_RATE,
+            METRIC_PREVIEW_FRAMES, 1, NULL, 0 },
+    [METRIC_FILTER_LATENCY] = { "filter_latency_seconds",
+            "Time to filter a preview frame", METRIC_HISTOGRAM, 0, 1e-9,
+            BOUNDS(s_frame_bounds) },
+    [METRIC_FACES] = { "faces_per_frame",
+            "Faces masked per preview frame", METRIC_HISTOGRAM, 0, 1,
+            BOUNDS(s_face_bounds) },
+    [METRIC_DETECTIONS] = { "detections_total",
+            "Face detections received", METRIC_COUNTER, 0, 1, NULL, 0 },
+    [METRIC_DETECTION_RATE] = { "detection_rate",
+            "Face detections per second since the previous write", METRIC_RATE,
+            METRIC_DETECTIONS, 1, NULL, 0 },
+    [METRIC_FRAMES_UNFILTERED] = { "frames_unfiltered_total",
+            "Preview frames left unmasked while the face store was busy",
+            METRIC_COUNTER, 0, 1, NULL, 0 },
+    [METRIC_FRAMES_DROPPED] = { "frames_dropped_total",
+            "Frames dropped by the stream queue", METRIC_COUNTER, 0, 1, NULL, 0 },
+    [METRIC_STREAM_QUEUE] = { "stream_queue_frames",
+            "Frames waiting for the stream transport", METRIC_GAUGE, 0, 1,
+            NULL, 0 },
+    [METRIC_CAPTURE_LATENCY] = { "capture_latency_seconds",
+            "Time from the capture request to the stored photo",
+            METRIC_HISTOGRAM, 0, 1e-9, BOUNDS(s_capture_bounds) },
+    [METRIC_BYTES_WRITTEN] = { "bytes_written_total",
+            "Bytes of the stream and the photos written", METRIC_COUNTER, 0, 1,
+            NULL, 0 },
+};
+
+static metric_s s_metrics[METRIC_NUMBER];
+
+/* Counters at the previous write, for the rates. */
+static unsigned long long s_previous[METRIC_NUMBER];
+static unsigned long long s_previous_ns = 0;
+
+static unsigned long long _now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * @brief Clears all the metrics, the rates start from now.
+ * @details Called before the pipeline threads start.
+ */
+void metrics_reset(void)
+{
+    for (int i = 0; i < METRIC_NUMBER; i++) {
+        __atomic_store_n(&s_metrics[i].value, 0, __ATOMIC_RELAXED);
+        for (int j = 0; j < METRIC_BUCKETS; j++)
+            __atomic_store_n(&s_metrics[i].buckets[j], 0, __ATOMIC_RELAXED);
+        s_previous[i] = 0;
+    }
+    s_previous_ns = _now_ns();
+}
+
+/**
+ * @brief Adds to a counter.
+ *
+ * @param id     The counter
+ * @param value  The increment
+ */
+void metrics_add(metric_e id, unsigned long long value)
+{
+    __atomic_add_fetch(&s_metrics[id].value, value, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Sets a gauge.
+ *
+ * @param id     The gauge
+ * @param value  The current value
+ */
+void metrics_set(metric_e id, unsigned long long value)
+{
+    __atomic_store_n(&s_metrics[id].value, value, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Records a value into a histogram.
+ *
+ * @param id     The histogram
+ * @param value  The value, in the unit of the histogram
+ */
+void metrics_observe(metric_e id, unsigned long long value)
+{
+    const metric_def_s *def = &s_defs[id];
+    int bucket = 0;
+
+    while (bucket < def->bound_count && value > def->bounds[bucket])
+        bucket++;
+
+    __atomic_add_fetch(&s_metrics[id].buckets[bucket], 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&s_metrics[id].value, value, __ATOMIC_RELAXED);
+}
+
+/* Estimates a quantile of a histogram, interpolated within its bucket. */
+static double _quantile(const metric_def_s *def, const unsigned long long *buckets,
+                        unsigned long long count, double quantile)
+{
+    double rank = quantile * (double) count;
+    unsigned long long below = 0;
+
+    if (0 == count)
+        return 0.0;
+
+    for (int i = 0; i < def->bound_count; i++) {
+        if ((double) (below + buckets[i]) >= rank && buckets[i] > 0) {
+            double lower = (i > 0) ? (double) def->bounds[i - 1] : 0.0;
+            double upper = (double) def->bounds[i];
+            double within = (rank - (double) below) / (double) buckets[i];
+            return (lower + (upper - lower) * within) * def->scale;
+        }
+        below += buckets[i];
+    }
+
+    /* Beyond the last bound, its value is the best estimate. */
+    return (def->bound_count > 0)
+            ? (double) def->bounds[def->bound_count - 1] * def->scale : 0.0;
+}
+
+static void _write_prometheus(FILE *file, const metric_def_s *def,
+                              const unsigned long long *buckets,
+                              unsigned long long value, double rate)
+{
+    static const char *const types[] = {
+        [METRIC_COUNTER] = "counter",
+        [METRIC_GAUGE] = "gauge",
+        [METRIC_RATE] = "gauge",
+        [METRIC_HISTOGRAM] = "histogram",
+    };
+
+    fprintf(file, "# HELP facecamera_%s %s\n", def->name, def->help);
+    fprintf(file, "# TYPE facecamera_%s %s\n", def->name, types[def->type]);
+
+    switch (def->type) {
+    case METRIC_COUNTER:
+    case METRIC_GAUGE:
+        fprintf(file, "facecamera_%s %llu\n", def->name, value);
+        break;
+    case METRIC_RATE:
+        fprintf(file, "facecamera_%s %.3f\n", def->name, rate);
+        break;
+    case METRIC_HISTOGRAM: {
+        unsigned long long count = 0;
+        for (int i = 0; i < def->bound_count; i++) {
+            count += buckets[i];
+            fprintf(file, "facecamera_%s_bucket{le=\"%g\"} %llu\n", def->name,
+                    (double) def->bounds[i] * def->scale, count);
+        }
+        count += buckets[def->bound_count];
+        fprintf(file, "facecamera_%s_bucket{le=\"+Inf\"} %llu\n", def->name, count);
+        fprintf(file, "facecamera_%s_sum %.9g\n", def->name,
+                (double) value * def->scale);
+        fprintf(file, "facecamera_%s_count %llu\n", def->name, count);
+        break;
+    }
+    }
+}
+
+static void _write_json(FILE *file, const metric_def_s *def,
+                        const unsigned long long *buckets,
+                        unsigned long long value, double rate)
+{
+    fprintf(file, "\"%s\":", def->name);
+
+    switch (def->type) {
+    case METRIC_COUNTER:
+    case METRIC_GAUGE:
+        fprintf(file, "%llu", value);
+        break;
+    case METRIC_RATE:
+        fprintf(file, "%.3f", rate);
+        break;
+    case METRIC_HISTOGRAM: {
+        unsigned long long count = 0;
+        for (int i = 0; i <= def->bound_count; i++)
+            count += buckets[i];
+        fprintf(file, "{\"count\":%llu,\"sum\":%.9g,\"p50\":%.9g,\"p90\":%.9g,"
+                "\"p99\":%.9g}", count, (double) value * def->scale,
+                _quantile(def, buckets, count, 0.50),
+                _quantile(def, buckets, count, 0.90),
+                _quantile(def, buckets, count, 0.99));
+        break;
+    }
+    }
+}
+
+/**
+ * @brief Writes a snapshot of the metrics to a file.
+ * @details The file is written next to the given path and renamed over it,
+ *          so a collector never reads a partial file. The rates cover the
+ *          time since the previous write or metrics_reset().
+ *
+ * @param path    The file to write
+ * @param format  The format of the file
+ *
+ * @return 0 on success, otherwise a negative errno value
+ */
+int metrics_write(const char *path, metrics_format_e format)
+{
+    if (NULL == path)
+        return -EINVAL;
+
+    char *temp_path = (char *) malloc(strlen(path) + sizeof(".tmp"));
+    if (NULL == temp_path)
+        return -ENOMEM;
+    sprintf(temp_path, "%s.tmp", path);
+
+    FILE *file = fopen(temp_path, "w");
+    if (NULL == file) {
+        int error = -errno;
+        free(temp_path);
+        return error;
+    }
+
+    unsigned long long now = _now_ns();
+    double elapsed = (double) (now - s_previous_ns) / 1e9;
+    unsigned long long values[METRIC_NUMBER];
+
+    for (int i = 0; i < METRIC_NUMBER; i++)
+        values[i] = __atomic_load_n(&s_metrics[i].value, __ATOMIC_RELAXED);
+
+    if (METRICS_JSON == format)
+        fprintf(file, "{\"timestamp\":%lld,", (long long) time(NULL));
+
+    for (int i = 0; i < METRIC_NUMBER; i++) {
+        const metric_def_s *def = &s_defs[i];
+        unsigned long long buckets[METRIC_BUCKETS];
+        double rate = 0.0;
+
+        for (int j = 0; j <= def->bound_count; j++)
+            buckets[j] = __atomic_load_n(&s_metrics[i].buckets[j], __ATOMIC_RELAXED);
+        if (METRIC_RATE == def->type && elapsed > 0.0)
+            rate = (double) (values[def->source] - s_previous[def->source]) / elapsed;
+
+        if (METRICS_JSON == format) {
+            _write_json(file, def, buckets, values[i], rate);
+            fputs((i + 1 < METRIC_NUMBER) ? "," : "}\n", file);
+        } else {
+            _write_prometheus(file, def, buckets, values[i], rate);
+        }
+    }
+
+    memcpy(s_previous, values, sizeof(s_previous));
+    s_previous_ns = now;
+
+    int error = ferror(file) ? -EIO : 0;
+    if (0 != fclose(file) && 0 == error)
+        error = -errno;
+    if (0 == error && 0 != rename(temp_path, path))
+        error = -errno;
+    if (0 != error)
+        remove(temp_path);
+    free(temp_path);
+
+    return error;
+}
@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Flora License, Version 1.1 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://floralicense.org/license/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "motion.h"
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+
+/**
+ * @brief Releases the buffers, which are allocated again by the next
+ *        motion_update().
+ */
+void motion_release(motion_s *motion)
+{
+    free(motion->prev);
+    free(motion->cur);
+    motion->width = 0;
+    motion->height = 0;
+    motion->prev = NULL;
+    motion->cur = NULL;
+    motion->has_prev = false;
+}
+
+void motion_init(motion_s *motion)
+{
+    motion->width = 0;
+    motion->height = 0;
+    motion->prev = NULL;
+    motion->cur = NULL;
+    motion->has_prev = false;
+}
+
+void motion_deinit(motion_s *motion)
+{
+    motion_release(motion);
+}
+
+/**
+ * @brief Downscales the luma of a new frame, keeping the previous one.
+ * @details Every sample is the mean of four horizontally adjacent pixels of
+ *          every MOTION_SCALE-th row, which is enough to follow a face while
+ *          reading only a quarter of the Y plane. The buffers are allocated
+ *          when the geometry changes only.
+ *
+ * @param motion  The motion state
+ * @param frame   The unfiltered preview frame
+ *
+ * @return 0 on success, otherwise a negative errno value
+ */
+int motion_update(motion_s *motion, const frame_s *frame)
+{
+    int width = frame->width / MOTION_SCALE;
+    int height = frame->height / MOTION_SCALE;
+
+    if (width != motion->width || height != motion->height) {
+        motion_release(motion);
+        if (width <= 0 || height <= 0)
+            return -EINVAL;
+
+        motion->prev = (unsigned char *) malloc(width * height);
+        motion->cur = (unsigned char *) malloc(width * height);
+        if (NULL == motion->prev || NULL == motion->cur) {
+            motion_release(motion);
+            return -ENOMEM;
+        }
+        motion->width = width;
+        motion->height = height;
+    } else {
+        unsigned char *swap = motion->prev;
+        motion->prev = motion->cur;
+        motion->cur = swap;
+        motion->has_prev = true;
+    }
+
+    for (int j = 0; j < height; j++) {
+        const unsigned char *src = frame->y + (size_t) j * MOTION_SCALE * frame->width;
+        unsigned char *dst = motion->cur + j * width;
+
+        for (int i = 0; i < width; i++, src += MOTION_SCALE)
+            dst[i] = (src[0] + src[1] + src[2] + src[3] + 2) >> 2;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Sums the absolute differences between a block of the previous
+ *        frame and the block displaced by (dx, dy) in the current frame.
+ */
+static unsigned int _sad(const motion_s *motion, int x, int y, int w, int h,
+                         int step, int dx, int dy)
+{
+    unsigned int sad = 0;
+
+    for (int j = 0; j < h; j += step) {
+        const unsigned char *a = motion->prev + (y + j) * motion->width + x;
+        const unsigned char *b = motion->cur + (y + j + dy) * motion->width + x + dx;
+
+        for (int i = 0; i < w; i += step)
+            sad += abs(a[i] - b[i]);
+    }
+
+    return sad;
+}
+
+/**
+ * @brief Estimates how far a face moved between the last two frames.
+ * @details Full search of the best matching block within
+ *          +-MOTION_SEARCH_RANGE downscaled samples. Large faces are
+ *          subsampled to at most MOTION_BLOCK_SAMPLES per side, and a
+ *          displacement is only reported if it matches strictly better than
+ *          no motion at all.
+ *
+ * @param motion  The motion state
+ * @param face    The face position in the previous frame
+ * @param dx      The horizontal displacement in pixels
+ * @param dy      The vertical displacement in pixels
+ */
+void motion_estimate(const motion_s *motion, const face_s *face, int *dx,
+                     int *dy)
+{
+    *dx = 0;
+    *dy = 0;
+
+    if (!motion->has_prev)
+        return;
+
+    int x0 = face->x / MOTION_SCALE;
+    int y0 = face->y / MOTION_SCALE;
+    int x1 = (face->x + face->width) / MOTION_SCALE;
+    int y1 = (face->y + face->height) / MOTION_SCALE;
+
+    /* Keep room for the search around the block. */
+    if (x0 < MOTION_SEARCH_RANGE)
+        x0 = MOTION_SEARCH_RANGE;
+    if (y0 < MOTION_SEARCH_RANGE)
+        y0 = MOTION_SEARCH_RANGE;
+    if (x1 > motion->width - MOTION_SEARCH_RANGE)
+        x1 = motion->width - MOTION_SEARCH_RANGE;
+    if (y1 > motion->height - MOTION_SEARCH_RANGE)
+        y1 = motion->height - MOTION_SEARCH_RANGE;
+
+    int w = x1 - x0;
+    int h = y1 - y0;
+    if (w <= 0 || h <= 0)
+        return;
+
+    int side = (w > h) ? w : h;
+    int step = (side + MOTION_BLOCK_SAMPLES - 1) / MOTION_BLOCK_SAMPLES;
+    unsigned int best = _sad(motion, x0, y0, w, h, step, 0, 0);
+
+    for (int j = -MOTION_SEARCH_RANGE; j <= MOTION_SEARCH_RANGE; j++) {
+        for (int i = -MOTION_SEARCH_RANGE; i <= MOTION_SEARCH_RANGE; i++) {
+            if (0 == i && 0 == j)
+                continue;
+
+            unsigned int sad = _sad(motion, x0, y0, w, h, step, i, j);
+            if (sad < best) {
+                best = sad;
+                *dx = i * MOTION_SCALE;
+                *dy = j * MOTION_SCALE;
+            }
+        }
+    }
+}
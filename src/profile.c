@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Flora License, Version 1.1 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://floralicense.org/license/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "profile.h"
+#include <string.h>
+
+static const profile_s s_profiles[PROFILE_NUMBER] = {
+    [PROFILE_NORMAL] = {
+        .name = "normal",
+        .motion = true,
+        .detection_interval = 1,
+        .preview_max_width = 0,
+        .stream_queue_length = 0,
+    },
+    /* Drops the motion buffers and all but one stream buffer. */
+    [PROFILE_LOW_MEMORY] = {
+        .name = "low-memory",
+        .motion = false,
+        .detection_interval = 1,
+        .preview_max_width = 0,
+        .stream_queue_length = 1,
+    },
+    /* Fewer pixels, a third of the detections and no motion search. */
+    [PROFILE_LOW_BATTERY] = {
+        .name = "low-battery",
+        .motion = false,
+        .detection_interval = 3,
+        .preview_max_width = 320,
+        .stream_queue_length = 0,
+    },
+};
+
+const profile_s *profile_get(profile_e id)
+{
+    if ((int) id < 0 || id >= PROFILE_NUMBER)
+        return &s_profiles[PROFILE_NORMAL];
+
+    return &s_profiles[id];
+}
+
+/**
+ * @brief Returns the profile of the given name, NULL if there is none.
+ */
+const profile_s *profile_find(const char *name)
+{
+    for (int i = 0; NULL != name && i < PROFILE_NUMBER; i++) {
+        if (0 == strcmp(s_profiles[i].name, name))
+            return &s_profiles[i];
+    }
+
+    return NULL;
+}
+
+/* The lower of two limits where 0 means no limit. */
+static int _min_limit(int a, int b)
+{
+    if (0 == a)
+        return b;
+    if (0 == b)
+        return a;
+    return (a < b) ? a : b;
+}
+
+/**
+ * @brief Merges another profile into a profile, keeping the cheaper value of
+ *        every setting.
+ */
+void profile_combine(profile_s *profile, const profile_s *other)
+{
+    profile->motion = profile->motion && other->motion;
+    if (other->detection_interval > profile->detection_interval)
+        profile->detection_interval = other->detection_interval;
+    profile->preview_max_width = _min_limit(profile->preview_max_width,
+            other->preview_max_width);
+    profile->stream_queue_length = _min_limit(profile->stream_queue_length,
+            other->stream_queue_length);
+}
+
+/**
+ * @brief Applies the settings of a profile to a running pipeline.
+ * @details The profile lowers the configuration: the motion masks stay off
+ *          if the configuration disables them. The preview resolution is not
+ *          changed, see profile_get_max_width().
+ *
+ * @param profile  The profile
+ * @param config   The configuration the profile lowers
+ * @param filter   The filter
+ * @param stream   The stream of the filtered frames, may be NULL
+ */
+void profile_apply(const profile_s *profile, const config_s *config,
+                   facefilter_s *filter, stream_h stream)
+{
+    facefilter_set_motion(filter, config->motion && profile->motion);
+    facefilter_set_detection_interval(filter, profile->detection_interval);
+
+    if (NULL != stream)
+        stream_set_queue_length(stream, _min_limit(config->stream_queue_length,
+                profile->stream_queue_length));
+}
+
+/**
+ * @brief Returns the largest preview width allowed by the profile and the
+ *        configuration.
+ */
+int profile_get_max_width(const profile_s *profile, const config_s *config)
+{
+    return _min_limit(config->preview_max_width, profile->preview_max_width);
+}
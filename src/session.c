@@ -0,0 +1,636 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Flora License, Version 1.1 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://floralicense.org/license/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "session.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#define SESSION_MAGIC "FFSR"
+#define CHUNK_HEADER_SIZE 16
+#define FRAME_HEADER_SIZE 8
+#define FACE_RECORD_SIZE 24
+#define CAPTURE_HEADER_SIZE 5
+
+struct _session_recorder {
+    pthread_mutex_t lock;
+    FILE *file;
+    session_options_s options;
+    unsigned long long start_us;
+    unsigned int frame_counter;
+    unsigned char *row;
+    unsigned int row_size;
+};
+
+static unsigned long long _now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long) ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static void _put_u16(unsigned char *p, unsigned int v)
+{
+    p[0] = v & 0xff;
+    p[1] = (v >> 8) & 0xff;
+}
+
+static void _put_u32(unsigned char *p, unsigned int v)
+{
+    _put_u16(p, v & 0xffff);
+    _put_u16(p + 2, v >> 16);
+}
+
+static void _put_u64(unsigned char *p, unsigned long long v)
+{
+    _put_u32(p, (unsigned int) (v & 0xffffffffULL));
+    _put_u32(p + 4, (unsigned int) (v >> 32));
+}
+
+static unsigned int _get_u16(const unsigned char *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static unsigned int _get_u32(const unsigned char *p)
+{
+    return _get_u16(p) | ((unsigned int) _get_u16(p + 2) << 16);
+}
+
+static unsigned long long _get_u64(const unsigned char *p)
+{
+    return _get_u32(p) | ((unsigned long long) _get_u32(p + 4) << 32);
+}
+
+/**
+ * @brief Writes a chunk header. Must be called with the recorder lock held.
+ *
+ * @param recorder  The recorder handle
+ * @param tag       The four character chunk tag
+ * @param size      The size of the payload following the header
+ */
+static void _write_chunk_header(session_recorder_h recorder, const char *tag,
+                                unsigned int size)
+{
+    unsigned char header[CHUNK_HEADER_SIZE];
+
+    memcpy(header, tag, 4);
+    _put_u32(header + 4, size);
+    _put_u64(header + 8, _now_us() - recorder->start_us);
+    fwrite(header, 1, sizeof(header), recorder->file);
+}
+
+/**
+ * @brief Fills the options with the defaults: every frame at full resolution,
+ *        captured images are not stored.
+ *
+ * @param options  The options to fill
+ */
+void session_options_default(session_options_s *options)
+{
+    if (NULL == options)
+        return;
+
+    options->frame_interval = 1;
+    options->decimation = 1;
+    options->capture_data = false;
+}
+
+/**
+ * @brief Creates an idle session recorder.
+ * @details The recorder lives as long as the camera callbacks may use it,
+ *          recordings are started and stopped on it any number of times.
+ *
+ * @param recorder  The handle of the newly created recorder
+ *
+ * @return @c SESSION_ERROR_NONE on success, otherwise a negative error value
+ */
+int session_recorder_create(session_recorder_h *recorder)
+{
+    if (NULL == recorder)
+        return SESSION_ERROR_INVALID_PARAMETER;
+
+    session_recorder_h rec = (session_recorder_h) calloc(1, sizeof(*rec));
+    if (NULL == rec)
+        return SESSION_ERROR_OUT_OF_MEMORY;
+
+    pthread_mutex_init(&rec->lock, NULL);
+    session_options_default(&rec->options);
+    *recorder = rec;
+
+    return SESSION_ERROR_NONE;
+}
+
+/**
+ * @brief Starts recording the camera events to the given file.
+ *
+ * @param recorder  The recorder handle
+ * @param path      The path of the session file, it is truncated if it exists
+ * @param options   The recording options, @c NULL for the defaults
+ *
+ * @return @c SESSION_ERROR_NONE on success, otherwise a negative error value
+ */
+int session_recorder_start(session_recorder_h recorder, const char *path,
+                           const session_options_s *options)
+{
+    if (NULL == recorder || NULL == path)
+        return SESSION_ERROR_INVALID_PARAMETER;
+
+    pthread_mutex_lock(&recorder->lock);
+
+    if (NULL != recorder->file) {
+        pthread_mutex_unlock(&recorder->lock);
+        return SESSION_ERROR_INVALID_STATE;
+    }
+
+    if (NULL != options)
+        recorder->options = *options;
+    else
+        session_options_default(&recorder->options);
+
+    if (recorder->options.frame_interval < 1)
+        recorder->options.frame_interval = 1;
+    if (recorder->options.decimation != 2 && recorder->options.decimation != 4)
+        recorder->options.decimation = 1;
+
+    recorder->file = fopen(path, "wb");
+    if (NULL == recorder->file) {
+        pthread_mutex_unlock(&recorder->lock);
+        return SESSION_ERROR_IO;
+    }
+
+    unsigned char header[8];
+    memcpy(header, SESSION_MAGIC, 4);
+    _put_u32(header + 4, SESSION_FILE_VERSION);
+    fwrite(header, 1, sizeof(header), recorder->file);
+
+    recorder->start_us = _now_us();
+    recorder->frame_counter = 0;
+
+    pthread_mutex_unlock(&recorder->lock);
+
+    return SESSION_ERROR_NONE;
+}
+
+/**
+ * @brief Terminates the current recording and closes its file.
+ *
+ * @param recorder  The recorder handle
+ *
+ * @return @c SESSION_ERROR_NONE on success, otherwise a negative error value
+ */
+int session_recorder_stop(session_recorder_h recorder)
+{
+    if (NULL == recorder)
+        return SESSION_ERROR_INVALID_PARAMETER;
+
+    pthread_mutex_lock(&recorder->lock);
+
+    if (NULL == recorder->file) {
+        pthread_mutex_unlock(&recorder->lock);
+        return SESSION_ERROR_INVALID_STATE;
+    }
+
+    _write_chunk_header(recorder, "END ", 0);
+    int error = ferror(recorder->file);
+    if (0 != fclose(recorder->file))
+        error = 1;
+    recorder->file = NULL;
+
+    pthread_mutex_unlock(&recorder->lock);
+
+    return error ? SESSION_ERROR_IO : SESSION_ERROR_NONE;
+}
+
+/**
+ * @brief Checks whether a recording is in progress.
+ *
+ * @param recorder  The recorder handle
+ *
+ * @return @c true if the events are currently being recorded
+ */
+bool session_recorder_is_recording(session_recorder_h recorder)
+{
+    if (NULL == recorder)
+        return false;
+
+    pthread_mutex_lock(&recorder->lock);
+    bool recording = NULL != recorder->file;
+    pthread_mutex_unlock(&recorder->lock);
+
+    return recording;
+}
+
+/**
+ * @brief Stops the recording in progress, if any, and frees the recorder.
+ *
+ * @param recorder  The recorder handle
+ */
+void session_recorder_destroy(session_recorder_h recorder)
+{
+    if (NULL == recorder)
+        return;
+
+    if (session_recorder_is_recording(recorder))
+        session_recorder_stop(recorder);
+
+    pthread_mutex_destroy(&recorder->lock);
+    free(recorder->row);
+    free(recorder);
+}
+
+/**
+ * @brief Records a preview frame, honouring the frame interval and the
+ *        decimation of the recording options.
+ * @details Called from the camera preview callback before the frame is
+ *          modified, so the replayed frames match the camera output.
+ *
+ * @param recorder  The recorder handle
+ * @param frame     The preview frame
+ */
+void session_recorder_frame(session_recorder_h recorder, const frame_s *frame)
+{
+    if (NULL == recorder || NULL == frame || NULL == frame->y)
+        return;
+
+    pthread_mutex_lock(&recorder->lock);
+
+    if (NULL == recorder->file
+            || recorder->frame_counter++ % recorder->options.frame_interval != 0) {
+        pthread_mutex_unlock(&recorder->lock);
+        return;
+    }
+
+    int dec = recorder->options.decimation;
+    unsigned int w = frame->width / dec;
+    unsigned int h = frame->height / dec;
+    unsigned int planes = (1 == dec && NULL != frame->uv) ? 2 : 1;
+    unsigned int uv_size = (2 == planes) ? frame->uv_size : 0;
+
+    /* The replay refuses frames decimated to nothing, do not write them. */
+    if (0 == w || 0 == h
+            || frame->y_size < (unsigned int) (frame->width * frame->height)) {
+        pthread_mutex_unlock(&recorder->lock);
+        return;
+    }
+
+    _write_chunk_header(recorder, "FRME", FRAME_HEADER_SIZE + w * h + uv_size);
+
+    unsigned char header[FRAME_HEADER_SIZE] = { 0, };
+    _put_u16(header, frame->width);
+    _put_u16(header + 2, frame->height);
+    header[4] = dec;
+    header[5] = planes;
+    fwrite(header, 1, sizeof(header), recorder->file);
+
+    if (1 == dec) {
+        fwrite(frame->y, 1, w * h, recorder->file);
+    } else {
+        if (recorder->row_size < w) {
+            free(recorder->row);
+            recorder->row = (unsigned char *) malloc(w);
+            recorder->row_size = (NULL != recorder->row) ? w : 0;
+        }
+
+        for (unsigned int j = 0; j < h; j++) {
+            const unsigned char *src = frame->y + j * dec * frame->width;
+
+            if (NULL == recorder->row) {
+                /* Keep the chunk size consistent even without the scratch row. */
+                for (unsigned int i = 0; i < w; i++)
+                    fputc(src[i * dec], recorder->file);
+                continue;
+            }
+
+            for (unsigned int i = 0; i < w; i++)
+                recorder->row[i] = src[i * dec];
+            fwrite(recorder->row, 1, w, recorder->file);
+        }
+    }
+
+    if (2 == planes)
+        fwrite(frame->uv, 1, uv_size, recorder->file);
+
+    pthread_mutex_unlock(&recorder->lock);
+}
+
+/**
+ * @brief Records a face detection event.
+ *
+ * @param recorder  The recorder handle
+ * @param faces     The detected faces
+ * @param count     The number of detected faces, may be 0
+ */
+void session_recorder_faces(session_recorder_h recorder, const face_s *faces,
+                            int count)
+{
+    if (NULL == recorder || count < 0 || (count > 0 && NULL == faces))
+        return;
+
+    pthread_mutex_lock(&recorder->lock);
+
+    if (NULL == recorder->file) {
+        pthread_mutex_unlock(&recorder->lock);
+        return;
+    }
+
+    _write_chunk_header(recorder, "FACE", 4 + count * FACE_RECORD_SIZE);
+
+    unsigned char record[FACE_RECORD_SIZE];
+    _put_u32(record, count);
+    fwrite(record, 1, 4, recorder->file);
+
+    for (int i = 0; i < count; i++) {
+        _put_u32(record, faces[i].id);
+        _put_u32(record + 4, faces[i].score);
+        _put_u32(record + 8, faces[i].x);
+        _put_u32(record + 12, faces[i].y);
+        _put_u32(record + 16, faces[i].width);
+        _put_u32(record + 20, faces[i].height);
+        fwrite(record, 1, sizeof(record), recorder->file);
+    }
+
+    pthread_mutex_unlock(&recorder->lock);
+}
+
+/**
+ * @brief Records a capture event.
+ *
+ * @param recorder  The recorder handle
+ * @param data      The encoded image of the captured picture
+ * @param size      The size of the encoded image
+ */
+void session_recorder_capture(session_recorder_h recorder,
+                              const unsigned char *data, unsigned int size)
+{
+    if (NULL == recorder)
+        return;
+
+    pthread_mutex_lock(&recorder->lock);
+
+    if (NULL == recorder->file) {
+        pthread_mutex_unlock(&recorder->lock);
+        return;
+    }
+
+    bool has_data = recorder->options.capture_data && NULL != data;
+
+    _write_chunk_header(recorder, "CAPT",
+            CAPTURE_HEADER_SIZE + (has_data ? size : 0));
+
+    unsigned char header[CAPTURE_HEADER_SIZE];
+    _put_u32(header, size);
+    header[4] = has_data;
+    fwrite(header, 1, sizeof(header), recorder->file);
+
+    if (has_data)
+        fwrite(data, 1, size, recorder->file);
+
+    pthread_mutex_unlock(&recorder->lock);
+}
+
+/**
+ * @brief Grows the buffer to at least the given size.
+ *
+ * @return @c true on success, @c false if the memory could not be allocated
+ */
+static bool _reserve(unsigned char **buffer, unsigned int *capacity,
+                     unsigned int size)
+{
+    if (*capacity >= size)
+        return true;
+
+    unsigned char *grown = (unsigned char *) realloc(*buffer, size);
+    if (NULL == grown)
+        return false;
+
+    *buffer = grown;
+    *capacity = size;
+
+    return true;
+}
+
+/**
+ * @brief Sleeps until the given time of the monotonic clock.
+ */
+static void _sleep_until_us(unsigned long long deadline_us)
+{
+    unsigned long long now = _now_us();
+    if (deadline_us <= now)
+        return;
+
+    unsigned long long delta = deadline_us - now;
+    struct timespec ts = {
+        .tv_sec = delta / 1000000ULL,
+        .tv_nsec = (delta % 1000000ULL) * 1000,
+    };
+    nanosleep(&ts, NULL);
+}
+
+/**
+ * @brief Replays a recorded session on the calling thread.
+ * @details The events are delivered in the recorded order. Decimated frames
+ *          are scaled back to the recorded geometry, so the callbacks always
+ *          receive frames of the original size.
+ *
+ * @param path       The path of the session file
+ * @param speed      Whether to keep the recorded timing
+ * @param callbacks  The callbacks to invoke, any of them may be @c NULL
+ * @param user_data  The user data passed to the callbacks
+ *
+ * @return The number of replayed events, otherwise a negative error value
+ */
+int session_replay(const char *path, session_replay_speed_e speed,
+                   const session_callbacks_s *callbacks, void *user_data)
+{
+    if (NULL == path || NULL == callbacks)
+        return SESSION_ERROR_INVALID_PARAMETER;
+
+    FILE *file = fopen(path, "rb");
+    if (NULL == file)
+        return SESSION_ERROR_IO;
+
+    unsigned char header[CHUNK_HEADER_SIZE];
+    struct stat st;
+    if (0 != fstat(fileno(file), &st)) {
+        fclose(file);
+        return SESSION_ERROR_IO;
+    }
+    if (fread(header, 1, 8, file) != 8 || memcmp(header, SESSION_MAGIC, 4) != 0
+            || _get_u32(header + 4) != SESSION_FILE_VERSION) {
+        fclose(file);
+        return SESSION_ERROR_FORMAT;
+    }
+    /* What is left of the file, a chunk cannot claim more. */
+    unsigned long long remaining = (unsigned long long) st.st_size - 8;
+
+    unsigned char *payload = NULL;
+    unsigned int payload_capacity = 0;
+    unsigned char *y = NULL;
+    unsigned int y_capacity = 0;
+    face_s *faces = NULL;
+    int faces_capacity = 0;
+    int events = 0;
+    int result = SESSION_ERROR_NONE;
+    unsigned long long start_us = _now_us();
+
+    while (fread(header, 1, CHUNK_HEADER_SIZE, file) == CHUNK_HEADER_SIZE) {
+        if (NULL != callbacks->keep_going && !callbacks->keep_going(user_data))
+            break;
+
+
+        unsigned int size = _get_u32(header + 4);
+        unsigned long long timestamp_us = _get_u64(header + 8);
+
+        if (memcmp(header, "END ", 4) == 0)
+            break;
+
+        /* A damaged size must not make the payload buffer huge. */
+        remaining = (remaining > CHUNK_HEADER_SIZE) ? remaining - CHUNK_HEADER_SIZE : 0;
+        if (size > remaining) {
+            result = SESSION_ERROR_FORMAT;
+            break;
+        }
+        remaining -= size;
+
+        if (!_reserve(&payload, &payload_capacity, size)) {
+            result = SESSION_ERROR_OUT_OF_MEMORY;
+            break;
+        }
+        if (fread(payload, 1, size, file) != size) {
+            result = SESSION_ERROR_FORMAT;
+            break;
+        }
+
+        if (SESSION_REPLAY_REALTIME == speed)
+            _sleep_until_us(start_us + timestamp_us);
+
+        if (memcmp(header, "FRME", 4) == 0) {
+            if (size < FRAME_HEADER_SIZE) {
+                result = SESSION_ERROR_FORMAT;
+                break;
+            }
+
+            unsigned int width = _get_u16(payload);
+            unsigned int height = _get_u16(payload + 2);
+            unsigned int dec = payload[4];
+            unsigned int planes = payload[5];
+            unsigned int w = (dec > 0) ? width / dec : 0;
+            unsigned int h = (dec > 0) ? height / dec : 0;
+            const unsigned char *data = payload + FRAME_HEADER_SIZE;
+
+            /* A frame decimated to nothing has no pixel to scale up. */
+            if (0 == w || 0 == h || w * h > size - FRAME_HEADER_SIZE) {
+                result = SESSION_ERROR_FORMAT;
+                break;
+            }
+
+            frame_s frame = {
+                .width = width,
+                .height = height,
+                .y_size = width * height,
+                .timestamp_us = timestamp_us,
+            };
+
+            if (!_reserve(&y, &y_capacity, frame.y_size)) {
+                result = SESSION_ERROR_OUT_OF_MEMORY;
+                break;
+            }
+            frame.y = y;
+
+            if (1 == dec) {
+                memcpy(y, data, frame.y_size);
+            } else {
+                for (unsigned int j = 0; j < height; j++) {
+                    unsigned int sj = (j / dec < h) ? j / dec : h - 1;
+                    for (unsigned int i = 0; i < width; i++) {
+                        unsigned int si = (i / dec < w) ? i / dec : w - 1;
+                        y[j * width + i] = data[sj * w + si];
+                    }
+                }
+            }
+
+            if (2 == planes) {
+                frame.uv = payload + FRAME_HEADER_SIZE + w * h;
+                frame.uv_size = size - FRAME_HEADER_SIZE - w * h;
+            }
+
+            if (NULL != callbacks->preview)
+                callbacks->preview(&frame, user_data);
+        } else if (memcmp(header, "FACE", 4) == 0) {
+            int count = (size >= 4) ? (int) _get_u32(payload) : -1;
+
+            /* Divided, as a large count would wrap the product. */
+            if (count < 0 || (unsigned int) count > (size - 4) / FACE_RECORD_SIZE) {
+                result = SESSION_ERROR_FORMAT;
+                break;
+            }
+
+            if (count > faces_capacity) {
+                face_s *grown = (face_s *) realloc(faces, sizeof(face_s) * count);
+                if (NULL == grown) {
+                    result = SESSION_ERROR_OUT_OF_MEMORY;
+                    break;
+                }
+                faces = grown;
+                faces_capacity = count;
+            }
+
+            for (int i = 0; i < count; i++) {
+                const unsigned char *record = payload + 4 + i * FACE_RECORD_SIZE;
+                faces[i].id = (int) _get_u32(record);
+                faces[i].score = (int) _get_u32(record + 4);
+                faces[i].x = (int) _get_u32(record + 8);
+                faces[i].y = (int) _get_u32(record + 12);
+                faces[i].width = (int) _get_u32(record + 16);
+                faces[i].height = (int) _get_u32(record + 20);
+            }
+
+            if (NULL != callbacks->faces)
+                callbacks->faces(faces, count, user_data);
+        } else if (memcmp(header, "CAPT", 4) == 0) {
+            if (size < CAPTURE_HEADER_SIZE) {
+                result = SESSION_ERROR_FORMAT;
+                break;
+            }
+
+            unsigned int image_size = _get_u32(payload);
+            const unsigned char *image = payload[4] ? payload + CAPTURE_HEADER_SIZE : NULL;
+
+            /* Subtracted, as a large image size would wrap the sum. */
+            if (NULL != image && image_size > size - CAPTURE_HEADER_SIZE) {
+                result = SESSION_ERROR_FORMAT;
+                break;
+            }
+
+            if (NULL != callbacks->capture)
+                callbacks->capture(image, image_size, user_data);
+        }
+        /* Unknown chunks are skipped, newer recorders may add them. */
+
+        events++;
+    }
+
+    free(faces);
+    free(y);
+    free(payload);
+    fclose(file);
+
+    return (SESSION_ERROR_NONE == result) ? events : result;
+}
@@ -0,0 +1,415 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Flora License, Version 1.1 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://floralicense.org/license/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "shmring.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#define SHMRING_ALIGN 64
+
+struct _shmring {
+    int fd;
+    char *name;      /* Set for the writer, which unlinks the ring */
+    void *base;
+    size_t size;
+    shmring_header_s *header;
+    size_t stride;   /* Bytes from one slot to the next */
+    unsigned int next;    /* Next frame number to publish or read */
+    unsigned int skipped; /* Frames a reader missed */
+};
+
+static size_t _slot_stride(unsigned int slot_size)
+{
+    size_t stride = sizeof(shmring_slot_s) + slot_size;
+    return (stride + SHMRING_ALIGN - 1) & ~((size_t) SHMRING_ALIGN - 1);
+}
+
+static size_t _ring_size(unsigned int slot_count, unsigned int slot_size)
+{
+    size_t header = (sizeof(shmring_header_s) + SHMRING_ALIGN - 1)
+            & ~((size_t) SHMRING_ALIGN - 1);
+    return header + slot_count * _slot_stride(slot_size);
+}
+
+static shmring_slot_s *_slot(shmring_h ring, unsigned int number)
+{
+    size_t header = (sizeof(shmring_header_s) + SHMRING_ALIGN - 1)
+            & ~((size_t) SHMRING_ALIGN - 1);
+    unsigned int index = number % ring->header->slot_count;
+
+    return (shmring_slot_s *) ((char *) ring->base + header + index * ring->stride);
+}
+
+static int _futex_wait(unsigned int *word, unsigned int value, int timeout_ms)
+{
+    struct timespec timeout;
+
+    if (timeout_ms >= 0) {
+        timeout.tv_sec = timeout_ms / 1000;
+        timeout.tv_nsec = (timeout_ms % 1000) * 1000000L;
+    }
+
+    /* Not FUTEX_PRIVATE_FLAG, the word is shared between processes. */
+    if (syscall(SYS_futex, word, FUTEX_WAIT, value,
+            (timeout_ms >= 0) ? &timeout : NULL, NULL, 0) != 0)
+        return -errno;
+
+    return 0;
+}
+
+static void _futex_wake(unsigned int *word)
+{
+    syscall(SYS_futex, word, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+static int _map(shmring_h ring, int prot)
+{
+    ring->base = mmap(NULL, ring->size, prot, MAP_SHARED, ring->fd, 0);
+    if (MAP_FAILED == ring->base)
+        return -errno;
+
+    ring->header = (shmring_header_s *) ring->base;
+
+    return 0;
+}
+
+/**
+ * @brief Creates a shared memory ring and publishes it under the given name.
+ *
+ * @param name        The POSIX shared memory name, e.g. "/facecamera"
+ * @param slot_count  The number of frames the ring holds
+ * @param slot_size   The largest Y and UV plane size of a frame in bytes
+ * @param ring        The handle of the newly created ring
+ *
+ * @return 0 on success, otherwise a negative errno value
+ */
+int shmring_create(const char *name, int slot_count, unsigned int slot_size,
+                   shmring_h *ring)
+{
+    if (NULL == name || NULL == ring || slot_count < 1 || 0 == slot_size)
+        return -EINVAL;
+
+    shmring_h r = (shmring_h) calloc(1, sizeof(*r));
+    if (NULL == r)
+        return -ENOMEM;
+
+    r->name = strdup(name);
+    r->size = _ring_size(slot_count, slot_size);
+    r->stride = _slot_stride(slot_size);
+    r->fd = shm_open(name, O_RDWR | O_CREAT | O_TRUNC, 0600);
+
+    int error = (NULL == r->name) ? -ENOMEM : 0;
+    if (0 == error && r->fd < 0)
+        error = -errno;
+    if (0 == error && ftruncate(r->fd, r->size) != 0)
+        error = -errno;
+    if (0 == error)
+        error = _map(r, PROT_READ | PROT_WRITE);
+
+    if (0 != error) {
+        if (r->fd >= 0) {
+            close(r->fd);
+            shm_unlink(name);
+        }
+        free(r->name);
+        free(r);
+        return error;
+    }
+
+    /* ftruncate() zeroed the ring, the magic tells the readers it is ready. */
+    r->header->version = SHMRING_VERSION;
+    r->header->slot_count = slot_count;
+    r->header->slot_size = slot_size;
+    __atomic_store_n(&r->header->magic, SHMRING_MAGIC, __ATOMIC_RELEASE);
+
+    *ring = r;
+
+    return 0;
+}
+
+/**
+ * @brief Unmaps and unlinks the ring. Readers keep their mapping until they
+ *        close it, but no frame is published anymore.
+ */
+void shmring_destroy(shmring_h ring)
+{
+    if (NULL == ring)
+        return;
+
+    munmap(ring->base, ring->size);
+    close(ring->fd);
+    shm_unlink(ring->name);
+    free(ring->name);
+    free(ring);
+}
+
+/**
+ * @brief Copies a frame and its faces into the next slot and wakes the
+ *        readers.
+ * @details Never blocks: the slot of the oldest frame is reused whether the
+ *          readers are done with it or not, they notice it on release.
+ *
+ * @param ring        The ring handle
+ * @param frame       The frame
+ * @param faces       The faces of the snapshot the frame was filtered with
+ * @param face_num    The number of faces
+ * @param generation  The face snapshot generation
+ * @param raw         Whether the faces are still visible in the frame
+ *
+ * @return 0 on success, otherwise a negative errno value
+ */
+int shmring_publish(shmring_h ring, const frame_s *frame, const face_s *faces,
+                    int face_num, unsigned int generation, bool raw)
+{
+    if (NULL == ring || NULL == ring->name || NULL == frame || NULL == frame->y)
+        return -EINVAL;
+
+    unsigned int uv_size = (NULL != frame->uv) ? frame->uv_size : 0;
+    if ((unsigned long long) frame->y_size + uv_size > ring->header->slot_size)
+        return -EMSGSIZE;
+
+    unsigned int number = ring->next;
+    shmring_slot_s *slot = _slot(ring, number);
+    unsigned char *data = (unsigned char *) (slot + 1);
+
+    if (face_num < 0 || NULL == faces)
+        face_num = 0;
+    else if (face_num > SHMRING_MAX_FACES)
+        face_num = SHMRING_MAX_FACES;
+
+    /*
+     * Odd while the slot is written, readers holding it see the change. The
+     * acquire side of the exchange keeps the writes below after the mark.
+     */
+    __atomic_exchange_n(&slot->sequence, 2 * number + 1, __ATOMIC_ACQ_REL);
+
+    slot->raw = raw;
+    slot->generation = generation;
+    slot->face_num = face_num;
+    slot->width = frame->width;
+    slot->height = frame->height;
+    slot->y_size = frame->y_size;
+    slot->uv_size = uv_size;
+    slot->timestamp_us = frame->timestamp_us;
+    if (face_num > 0)
+        memcpy(slot->faces, faces, face_num * sizeof(face_s));
+    memcpy(data, frame->y, frame->y_size);
+    if (uv_size > 0)
+        memcpy(data + frame->y_size, frame->uv, uv_size);
+
+    __atomic_store_n(&slot->sequence, 2 * number + 2, __ATOMIC_RELEASE);
+
+    ring->next = number + 1;
+    __atomic_store_n(&ring->header->published, ring->next, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ring->header->waiters, __ATOMIC_SEQ_CST) > 0)
+        _futex_wake(&ring->header->published);
+
+    return 0;
+}
+
+/**
+ * @brief Opens a ring created by another process for reading. The reader
+ *        starts with the next frame published.
+ *
+ * @param name    The POSIX shared memory name
+ * @param reader  The handle of the reader
+ *
+ * @return 0 on success, -EAGAIN if the ring is not initialized yet,
+ *         otherwise a negative errno value
+ */
+int shmring_open(const char *name, shmring_h *reader)
+{
+    if (NULL == name || NULL == reader)
+        return -EINVAL;
+
+    shmring_h r = (shmring_h) calloc(1, sizeof(*r));
+    if (NULL == r)
+        return -ENOMEM;
+
+    struct stat st;
+    int error = 0;
+
+    /* Read-write, as the readers register on the futex in the header. */
+    r->fd = shm_open(name, O_RDWR, 0);
+    if (r->fd < 0)
+        error = -errno;
+    else if (fstat(r->fd, &st) != 0)
+        error = -errno;
+    else if ((size_t) st.st_size < sizeof(shmring_header_s))
+        error = -EAGAIN;
+
+    if (0 == error) {
+        r->size = st.st_size;
+        error = _map(r, PROT_READ | PROT_WRITE);
+    }
+
+    if (0 == error) {
+        shmring_header_s *header = r->header;
+
+        if (__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) != SHMRING_MAGIC)
+            error = -EAGAIN;
+        else if (header->version != SHMRING_VERSION || 0 == header->slot_count
+                || _ring_size(header->slot_count, header->slot_size) > r->size)
+            error = -EPROTO;
+
+        if (0 != error)
+            munmap(r->base, r->size);
+    }
+
+    if (0 != error) {
+        if (r->fd >= 0)
+            close(r->fd);
+        free(r);
+        return error;
+    }
+
+    r->stride = _slot_stride(r->header->slot_size);
+    r->next = __atomic_load_n(&r->header->published, __ATOMIC_ACQUIRE);
+    *reader = r;
+
+    return 0;
+}
+
+void shmring_close(shmring_h reader)
+{
+    if (NULL == reader)
+        return;
+
+    munmap(reader->base, reader->size);
+    close(reader->fd);
+    free(reader);
+}
+
+/**
+ * @brief Waits for the next frame and returns it in place.
+ * @details A reader more than a ring behind skips to the newest frame. The
+ *          frame stays valid until the writer comes around to its slot, so
+ *          it has to be checked with shmring_release() once processed.
+ *
+ * @param reader      The reader handle
+ * @param timeout_ms  How long to wait, 0 to poll, negative to wait forever
+ * @param frame       The frame
+ *
+ * @return 0 on success, -EAGAIN if polling found no frame, -ETIMEDOUT,
+ *         otherwise a negative errno value
+ */
+int shmring_next(shmring_h reader, int timeout_ms, shmring_frame_s *frame)
+{
+    if (NULL == reader || NULL == frame)
+        return -EINVAL;
+
+    shmring_header_s *header = reader->header;
+
+    for (;;) {
+        unsigned int published = __atomic_load_n(&header->published,
+                __ATOMIC_ACQUIRE);
+
+        if (published == reader->next) {
+            if (0 == timeout_ms)
+                return -EAGAIN;
+
+            __atomic_add_fetch(&header->waiters, 1, __ATOMIC_SEQ_CST);
+            int error = _futex_wait(&header->published, published, timeout_ms);
+            __atomic_sub_fetch(&header->waiters, 1, __ATOMIC_SEQ_CST);
+
+            if (-ETIMEDOUT == error)
+                return error;
+            continue;
+        }
+
+        if (published - reader->next > header->slot_count) {
+            reader->skipped += published - 1 - reader->next;
+            reader->next = published - 1;
+        }
+
+        unsigned int number = reader->next;
+        shmring_slot_s *slot = _slot(reader, number);
+        unsigned int sequence = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+
+        if (sequence != 2 * number + 2) {
+            /* Overwritten since the counter was read, catch up. */
+            reader->skipped++;
+            reader->next = number + 1;
+            continue;
+        }
+
+        const unsigned char *data = (const unsigned char *) (slot + 1);
+
+        frame->frame.width = slot->width;
+        frame->frame.height = slot->height;
+        frame->frame.y = (unsigned char *) data;
+        frame->frame.uv = (slot->uv_size > 0) ? (unsigned char *) data + slot->y_size : NULL;
+        frame->frame.y_size = slot->y_size;
+        frame->frame.uv_size = slot->uv_size;
+        frame->frame.timestamp_us = slot->timestamp_us;
+        frame->faces = slot->faces;
+        frame->face_num = (slot->face_num > SHMRING_MAX_FACES)
+                ? SHMRING_MAX_FACES : (int) slot->face_num;
+        frame->generation = slot->generation;
+        frame->raw = slot->raw;
+        frame->number = number;
+        frame->sequence = sequence;
+
+        reader->next = number + 1;
+
+        /* The metadata may be torn if the writer came around meanwhile. */
+        if (0 != shmring_release(reader, frame)) {
+            reader->skipped++;
+            continue;
+        }
+
+        return 0;
+    }
+}
+
+/**
+ * @brief Checks that a frame returned by shmring_next() was not overwritten
+ *        while it was processed.
+ *
+ * @return 0 if everything read from the frame is valid, -ESTALE otherwise
+ */
+int shmring_release(shmring_h reader, const shmring_frame_s *frame)
+{
+    if (NULL == reader || NULL == frame)
+        return -EINVAL;
+
+    /*
+     * A read that does not modify: as a release operation it stays after
+     * the reads of the frame, and it sees the latest sequence of the slot.
+     */
+    shmring_slot_s *slot = _slot(reader, frame->number);
+    if (__atomic_fetch_add(&slot->sequence, 0, __ATOMIC_RELEASE) != frame->sequence)
+        return -ESTALE;
+
+    return 0;
+}
+
+/**
+ * @brief Returns the number of frames the reader missed as it fell behind.
+ */
+unsigned int shmring_get_skipped(shmring_h reader)
+{
+    return (NULL != reader) ? reader->skipped : 0;
+}
@@ -0,0 +1,522 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Flora License, Version 1.1 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://floralicense.org/license/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "stream.h"
+#include "trace.h"
+#include "metrics.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+typedef struct _stream_slot {
+    frame_s frame;
+    unsigned int generation;
+    unsigned char *buffer;
+    unsigned int capacity;
+} stream_slot_s;
+
+struct _stream {
+    const stream_transport_s *transport;
+    void *context;
+    stream_drop_policy_e policy;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_t thread;
+    bool stop;
+    stream_slot_s *slots;
+    int slot_count; /* Allocated slots */
+    int length;     /* Slots in use, up to slot_count */
+    int new_length; /* Applied when the sender is not sending */
+    int head;   /* Next slot to send */
+    int count;  /* Queued slots */
+    bool sending; /* The sender owns the slot at head */
+    stream_stats_s stats;
+};
+
+static void _put_u32(unsigned char *p, unsigned int v)
+{
+    p[0] = v & 0xff;
+    p[1] = (v >> 8) & 0xff;
+    p[2] = (v >> 16) & 0xff;
+    p[3] = (v >> 24) & 0xff;
+}
+
+static int _write_all(int fd, const unsigned char *data, size_t size)
+{
+    while (size > 0) {
+        ssize_t written = send(fd, data, size, MSG_NOSIGNAL);
+        if (written < 0) {
+            if (EINTR == errno)
+                continue;
+            return -errno;
+        }
+        data += written;
+        size -= written;
+    }
+
+    return 0;
+}
+
+static int _file_open(void **context, const char *target)
+{
+    FILE *file = fopen(target, "wb");
+    if (NULL == file)
+        return -errno;
+
+    *context = file;
+
+    return 0;
+}
+
+static int _file_send(void *context, const unsigned char *header,
+                      const frame_s *frame)
+{
+    FILE *file = (FILE *) context;
+
+    fwrite(header, 1, STREAM_FRAME_HEADER_SIZE, file);
+    fwrite(frame->y, 1, frame->y_size, file);
+    if (frame->uv_size > 0)
+        fwrite(frame->uv, 1, frame->uv_size, file);
+
+    return ferror(file) ? -EIO : 0;
+}
+
+static void _file_close(void *context)
+{
+    fclose((FILE *) context);
+}
+
+/* Appends the frames to a file, used to check the stream in tests. */
+const stream_transport_s stream_transport_file = {
+    .name = "file",
+    .open = _file_open,
+    .send = _file_send,
+    .close = _file_close,
+};
+
+static int _unix_open(void **context, const char *target)
+{
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+
+    if (strlen(target) >= sizeof(addr.sun_path))
+        return -ENAMETOOLONG;
+    strcpy(addr.sun_path, target);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -errno;
+
+    if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+        int error = -errno;
+        close(fd);
+        return error;
+    }
+
+    *context = (void *) (long) fd;
+
+    return 0;
+}
+
+static int _unix_send(void *context, const unsigned char *header,
+                      const frame_s *frame)
+{
+    int fd = (int) (long) context;
+    int error = _write_all(fd, header, STREAM_FRAME_HEADER_SIZE);
+
+    if (0 == error)
+        error = _write_all(fd, frame->y, frame->y_size);
+    if (0 == error && frame->uv_size > 0)
+        error = _write_all(fd, frame->uv, frame->uv_size);
+
+    return error;
+}
+
+static void _unix_close(void *context)
+{
+    close((int) (long) context);
+}
+
+/* Sends the frames to a local consumer listening on a unix socket. */
+const stream_transport_s stream_transport_unix = {
+    .name = "unix",
+    .open = _unix_open,
+    .send = _unix_send,
+    .close = _unix_close,
+};
+
+/* Reverses the order of a run of slots, the lock is held. */
+static void _reverse(stream_slot_s *slots, int from, int to)
+{
+    for (to--; from < to; from++, to--) {
+        stream_slot_s tmp = slots[from];
+        slots[from] = slots[to];
+        slots[to] = tmp;
+    }
+}
+
+/**
+ * @brief Applies a new queue length. Must be called with the lock held and
+ *        no send in progress.
+ * @details The oldest frames are dropped to fit, the queued frames are moved
+ *          to the first slots and the buffers of the slots no longer used are
+ *          released.
+ */
+static void _resize(stream_h stream)
+{
+    int length = stream->new_length;
+
+    if (length == stream->length)
+        return;
+
+    while (stream->count > length) {
+        stream->head = (stream->head + 1) % stream->length;
+        stream->count--;
+        stream->stats.dropped++;
+        metrics_add(METRIC_FRAMES_DROPPED, 1);
+    }
+
+    /* Rotate the ring so that it starts at the first slot. */
+    _reverse(stream->slots, 0, stream->head);
+    _reverse(stream->slots, stream->head, stream->length);
+    _reverse(stream->slots, 0, stream->length);
+    stream->head = 0;
+
+    for (int i = length; i < stream->slot_count; i++) {
+        free(stream->slots[i].buffer);
+        stream->slots[i].buffer = NULL;
+        stream->slots[i].capacity = 0;
+    }
+    stream->length = length;
+}
+
+static void *_sender_thread(void *user_data)
+{
+    stream_h stream = (stream_h) user_data;
+    unsigned char header[STREAM_FRAME_HEADER_SIZE];
+
+    trace_set_thread_name("stream sender");
+    pthread_mutex_lock(&stream->lock);
+
+    for (;;) {
+        while (0 == stream->count && !stream->stop)
+            pthread_cond_wait(&stream->cond, &stream->lock);
+        if (0 == stream->count && stream->stop)
+            break;
+
+        /* The slot at head stays ours until the send is done. */
+        stream_slot_s *slot = &stream->slots[stream->head];
+        stream->sending = true;
+        pthread_mutex_unlock(&stream->lock);
+
+        const frame_s *frame = &slot->frame;
+        memcpy(header, "FFRM", 4);
+        _put_u32(header + 4, frame->width);
+        _put_u32(header + 8, frame->height);
+        _put_u32(header + 12, slot->generation);
+        _put_u32(header + 16, (unsigned int) (frame->timestamp_us & 0xffffffffULL));
+        _put_u32(header + 20, (unsigned int) (frame->timestamp_us >> 32));
+        _put_u32(header + 24, frame->y_size);
+        _put_u32(header + 28, frame->uv_size);
+
+        TRACE_BEGIN("stream send");
+        int error = stream->transport->send(stream->context, header, frame);
+        TRACE_END("stream send");
+
+        pthread_mutex_lock(&stream->lock);
+        stream->sending = false;
+        stream->head = (stream->head + 1) % stream->length;
+        stream->count--;
+        if (0 == error) {
+            stream->stats.sent++;
+            metrics_add(METRIC_BYTES_WRITTEN, STREAM_FRAME_HEADER_SIZE
+                    + frame->y_size + frame->uv_size);
+        } else {
+            stream->stats.errors++;
+        }
+        _resize(stream);
+        metrics_set(METRIC_STREAM_QUEUE, stream->count);
+    }
+
+    pthread_mutex_unlock(&stream->lock);
+
+    return NULL;
+}
+
+/**
+ * @brief Creates a stream and starts its sender thread.
+ *
+ * @param transport     The transport delivering the frames
+ * @param target        The transport specific destination (a path for the
+ *                      built-in transports)
+ * @param queue_length  The number of frames that can wait for the transport
+ * @param policy        What to drop when the queue is full
+ * @param stream        The handle of the newly created stream
+ *
+ * @return 0 on success, otherwise a negative errno value
+ */
+int stream_create(const stream_transport_s *transport, const char *target,
+                  int queue_length, stream_drop_policy_e policy,
+                  stream_h *stream)
+{
+    if (NULL == transport || NULL == target || NULL == stream || queue_length < 1)
+        return -EINVAL;
+
+    stream_h s = (stream_h) calloc(1, sizeof(*s));
+    if (NULL == s)
+        return -ENOMEM;
+
+    s->slots = (stream_slot_s *) calloc(queue_length, sizeof(stream_slot_s));
+    if (NULL == s->slots) {
+        free(s);
+        return -ENOMEM;
+    }
+
+    s->transport = transport;
+    s->policy = policy;
+    s->slot_count = queue_length;
+    s->length = queue_length;
+    s->new_length = queue_length;
+    pthread_mutex_init(&s->lock, NULL);
+    pthread_cond_init(&s->cond, NULL);
+
+    int error = transport->open(&s->context, target);
+    if (0 == error) {
+        error = -pthread_create(&s->thread, NULL, _sender_thread, s);
+        if (0 != error)
+            transport->close(s->context);
+    }
+
+    if (0 != error) {
+        pthread_cond_destroy(&s->cond);
+        pthread_mutex_destroy(&s->lock);
+        free(s->slots);
+        free(s);
+        return error;
+    }
+
+    *stream = s;
+
+    return 0;
+}
+
+/**
+ * @brief Creates a stream from a "file:<path>" or "unix:<path>" URI.
+ */
+int stream_create_from_uri(const char *uri, int queue_length,
+                           stream_drop_policy_e policy, stream_h *stream)
+{
+    static const stream_transport_s *transports[] = {
+        &stream_transport_file,
+        &stream_transport_unix,
+    };
+
+    if (NULL == uri)
+        return -EINVAL;
+
+    for (unsigned int i = 0; i < sizeof(transports) / sizeof(transports[0]); i++) {
+        size_t len = strlen(transports[i]->name);
+        if (strncmp(uri, transports[i]->name, len) == 0 && ':' == uri[len])
+            return stream_create(transports[i], uri + len + 1, queue_length,
+                    policy, stream);
+    }
+
+    return -EPROTONOSUPPORT;
+}
+
+/**
+ * @brief Sends the queued frames, stops the sender and closes the transport.
+ *
+ * @param stream  The stream handle
+ */
+void stream_destroy(stream_h stream)
+{
+    if (NULL == stream)
+        return;
+
+    pthread_mutex_lock(&stream->lock);
+    stream->stop = true;
+    pthread_cond_signal(&stream->cond);
+    pthread_mutex_unlock(&stream->lock);
+
+    pthread_join(stream->thread, NULL);
+    stream->transport->close(stream->context);
+
+    for (int i = 0; i < stream->slot_count; i++)
+        free(stream->slots[i].buffer);
+    free(stream->slots);
+    pthread_cond_destroy(&stream->cond);
+    pthread_mutex_destroy(&stream->lock);
+    free(stream);
+}
+
+/**
+ * @brief Queues a copy of a filtered frame.
+ * @details Only the preview filter calls this, after it has masked the faces
+ *          of the snapshot identified by the generation. The slot buffers
+ *          grow to the frame size once and are reused afterwards.
+ *
+ * @param stream      The stream handle
+ * @param frame       The filtered frame
+ * @param generation  The face snapshot generation the frame was filtered with
+ *
+ * @return 0 if the frame was queued, -EAGAIN if it was dropped, otherwise a
+ *         negative errno value
+ */
+int stream_push(stream_h stream, const frame_s *frame, unsigned int generation)
+{
+    if (NULL == stream || NULL == frame || NULL == frame->y)
+        return -EINVAL;
+
+    unsigned int uv_size = (NULL != frame->uv) ? frame->uv_size : 0;
+    unsigned int size = frame->y_size + uv_size;
+
+    pthread_mutex_lock(&stream->lock);
+
+    if (stream->count == stream->length) {
+        /* The slot at head may be in the middle of a send. */
+        if (STREAM_DROP_NEWEST == stream->policy
+                || (stream->sending && 1 == stream->length)) {
+            stream->stats.dropped++;
+            metrics_add(METRIC_FRAMES_DROPPED, 1);
+            pthread_mutex_unlock(&stream->lock);
+            return -EAGAIN;
+        }
+
+        /* Drop the oldest frame not being sent. */
+        int victim = stream->sending ? (stream->head + 1) % stream->length : stream->head;
+        for (int i = victim; i != (stream->head + stream->count - 1) % stream->length;
+                i = (i + 1) % stream->length) {
+            int next = (i + 1) % stream->length;
+            stream_slot_s tmp = stream->slots[i];
+            stream->slots[i] = stream->slots[next];
+            stream->slots[next] = tmp;
+        }
+        stream->count--;
+        stream->stats.dropped++;
+        metrics_add(METRIC_FRAMES_DROPPED, 1);
+    }
+
+    stream_slot_s *slot = &stream->slots[(stream->head + stream->count) % stream->length];
+
+    if (slot->capacity < size) {
+        unsigned char *buffer = (unsigned char *) realloc(slot->buffer, size);
+        if (NULL == buffer) {
+            stream->stats.dropped++;
+            metrics_add(METRIC_FRAMES_DROPPED, 1);
+            pthread_mutex_unlock(&stream->lock);
+            return -ENOMEM;
+        }
+        slot->buffer = buffer;
+        slot->capacity = size;
+    }
+
+    memcpy(slot->buffer, frame->y, frame->y_size);
+    if (uv_size > 0)
+        memcpy(slot->buffer + frame->y_size, frame->uv, uv_size);
+
+    slot->frame = *frame;
+    slot->frame.y = slot->buffer;
+    slot->frame.uv = (uv_size > 0) ? slot->buffer + frame->y_size : NULL;
+    slot->frame.uv_size = uv_size;
+    slot->generation = generation;
+
+    stream->count++;
+    stream->stats.pushed++;
+    metrics_set(METRIC_STREAM_QUEUE, stream->count);
+    pthread_cond_signal(&stream->cond);
+    pthread_mutex_unlock(&stream->lock);
+
+    return 0;
+}
+
+/**
+ * @brief Changes the number of frames waiting for the transport.
+ * @details Shrinking the queue drops the oldest frames and releases the
+ *          buffers of the slots no longer used, growing it allocates them
+ *          again as the frames come. While a frame is being sent, the change
+ *          is applied after the send.
+ *
+ * @param stream        The stream handle
+ * @param queue_length  The new length, up to the length the stream was
+ *                      created with
+ *
+ * @return 0 on success, otherwise a negative errno value
+ */
+int stream_set_queue_length(stream_h stream, int queue_length)
+{
+    if (NULL == stream || queue_length < 1)
+        return -EINVAL;
+
+    pthread_mutex_lock(&stream->lock);
+    if (queue_length > stream->slot_count) {
+        pthread_mutex_unlock(&stream->lock);
+        return -EINVAL;
+    }
+    stream->new_length = queue_length;
+    if (!stream->sending)
+        _resize(stream);
+    pthread_mutex_unlock(&stream->lock);
+
+    return 0;
+}
+
+/**
+ * @brief Returns the memory held by the frame buffers of the queue in bytes.
+ */
+size_t stream_get_memory(stream_h stream)
+{
+    size_t size = 0;
+
+    if (NULL == stream)
+        return 0;
+
+    pthread_mutex_lock(&stream->lock);
+    for (int i = 0; i < stream->slot_count; i++)
+        size += stream->slots[i].capacity;
+    pthread_mutex_unlock(&stream->lock);
+
+    return size;
+}
+
+/**
+ * @brief Accounts a frame that was not streamed because it could not be
+ *        filtered with the current face snapshot.
+ */
+void stream_refuse_unfiltered(stream_h stream)
+{
+    if (NULL == stream)
+        return;
+
+    pthread_mutex_lock(&stream->lock);
+    stream->stats.unfiltered++;
+    pthread_mutex_unlock(&stream->lock);
+}
+
+void stream_get_stats(stream_h stream, stream_stats_s *stats)
+{
+    if (NULL == stream || NULL == stats)
+        return;
+
+    pthread_mutex_lock(&stream->lock);
+    *stats = stream->stats;
+    pthread_mutex_unlock(&stream->lock);
+}
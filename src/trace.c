@@ -0,0 +1,362 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Flora License, Version 1.1 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://floralicense.org/license/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "trace.h"
+#include "hal.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef enum {
+    SLOT_FREE,
+    SLOT_ACTIVE, /* Owned by a running thread */
+    SLOT_EXITED, /* The thread exited, the events are kept until the restart */
+    SLOT_BUSY,   /* Being released */
+} slot_state_e;
+
+typedef struct _trace_record {
+    const char *name;
+    unsigned long long ts_ns;
+    int phase;
+} trace_record_s;
+
+typedef struct _trace_thread {
+    int state;
+    unsigned int epoch;       /* Trace the events belong to */
+    const char *name;
+    unsigned long long count; /* Events recorded, published after the event */
+    trace_record_s *records;  /* Ring of TRACE_EVENTS events */
+} trace_thread_s;
+
+int trace_enabled = 0;
+
+static trace_thread_s s_threads[TRACE_THREADS];
+static unsigned int s_epoch = 0;
+static unsigned long long s_start_ns = 0;
+static unsigned long s_lost = 0;
+
+static pthread_once_t s_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t s_key;
+static __thread trace_thread_s *t_thread = NULL;
+static __thread const char *t_name = NULL;
+
+static unsigned long long _now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Keeps the events of an exiting thread for the next trace_write(). */
+static void _thread_exit(void *data)
+{
+    trace_thread_s *thread = (trace_thread_s *) data;
+
+    __atomic_store_n(&thread->state, SLOT_EXITED, __ATOMIC_RELEASE);
+}
+
+static void _create_key(void)
+{
+    pthread_key_create(&s_key, _thread_exit);
+}
+
+/**
+ * @brief Takes a free ring for the calling thread.
+ *
+ * @return The ring, @c NULL if all of them are in use
+ */
+static trace_thread_s *_claim(void)
+{
+    pthread_once(&s_key_once, _create_key);
+
+    for (int i = 0; i < TRACE_THREADS; i++) {
+        trace_thread_s *thread = &s_threads[i];
+        int expected = SLOT_FREE;
+
+        if (!__atomic_compare_exchange_n(&thread->state, &expected, SLOT_ACTIVE,
+                false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            continue;
+
+        /* The ring of a former thread is reused. */
+        if (NULL == thread->records) {
+            thread->records = (trace_record_s *) calloc(TRACE_EVENTS,
+                    sizeof(trace_record_s));
+            if (NULL == thread->records) {
+                __atomic_store_n(&thread->state, SLOT_FREE, __ATOMIC_RELEASE);
+                return NULL;
+            }
+        }
+
+        __atomic_store_n(&thread->name, t_name, __ATOMIC_RELAXED);
+        __atomic_store_n(&thread->count, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&thread->epoch,
+                __atomic_load_n(&s_epoch, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+        pthread_setspecific(s_key, thread);
+
+        return thread;
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Starts a new trace, the events recorded so far are discarded.
+ */
+void trace_start(void)
+{
+    /* The rings of the exited threads are free again. */
+    for (int i = 0; i < TRACE_THREADS; i++) {
+        int expected = SLOT_EXITED;
+
+        __atomic_compare_exchange_n(&s_threads[i].state, &expected, SLOT_FREE,
+                false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED);
+    }
+
+    s_start_ns = _now_ns();
+    __atomic_store_n(&s_lost, 0, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&s_epoch, 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&trace_enabled, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Stops recording, the events are kept for trace_write().
+ */
+void trace_stop(void)
+{
+    __atomic_store_n(&trace_enabled, 0, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Records an event of the calling thread.
+ * @details Usually called through the TRACE_BEGIN(), TRACE_END() and
+ *          TRACE_INSTANT() macros, which skip the call while the trace is
+ *          stopped.
+ *
+ * @param phase  'B' for the beginning of a stage, 'E' for its end, 'i' for
+ *               an instant event
+ * @param name   The name of the stage or event
+ */
+void trace_event(char phase, const char *name)
+{
+    trace_thread_s *thread = t_thread;
+
+    if (NULL == thread) {
+        thread = _claim();
+        if (NULL == thread) {
+            __atomic_add_fetch(&s_lost, 1, __ATOMIC_RELAXED);
+            return;
+        }
+        t_thread = thread;
+    }
+
+    unsigned int epoch = __atomic_load_n(&s_epoch, __ATOMIC_ACQUIRE);
+    if (thread->epoch != epoch) {
+        __atomic_store_n(&thread->count, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&thread->epoch, epoch, __ATOMIC_RELEASE);
+    }
+
+    /*
+     * Only this thread writes the ring. A reader seeing a field of the new
+     * event also sees the count before it, so trace_write() can tell the
+     * overwritten events.
+     */
+    unsigned long long n = thread->count;
+    trace_record_s *record = &thread->records[n % TRACE_EVENTS];
+
+    __atomic_store_n(&record->name, name, __ATOMIC_RELEASE);
+    __atomic_store_n(&record->ts_ns, _now_ns(), __ATOMIC_RELEASE);
+    __atomic_store_n(&record->phase, (int) phase, __ATOMIC_RELEASE);
+    __atomic_store_n(&thread->count, n + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Names the calling thread in the trace.
+ *
+ * @param name  The name, a string literal
+ */
+void trace_set_thread_name(const char *name)
+{
+    t_name = name;
+    if (NULL != t_thread)
+        __atomic_store_n(&t_thread->name, name, __ATOMIC_RELAXED);
+}
+
+static void _write_string(FILE *file, const char *text)
+{
+    fputc('"', file);
+    for (; '\0' != *text; text++) {
+        if ('"' == *text || '\\' == *text)
+            fprintf(file, "\\%c", *text);
+        else if ((unsigned char) *text < 0x20)
+            fprintf(file, "\\u%04x", *text);
+        else
+            fputc(*text, file);
+    }
+    fputc('"', file);
+}
+
+/**
+ * @brief Copies the events of a ring that were not overwritten meanwhile.
+ *
+ * @return The number of events copied into @p copy
+ */
+static int _snapshot(trace_thread_s *thread, trace_record_s *copy)
+{
+    unsigned long long count = __atomic_load_n(&thread->count, __ATOMIC_ACQUIRE);
+    unsigned long long first = (count > TRACE_EVENTS) ? count - TRACE_EVENTS : 0;
+
+    for (unsigned long long i = first; i < count; i++) {
+        trace_record_s *record = &thread->records[i % TRACE_EVENTS];
+        trace_record_s *to = &copy[i - first];
+
+        to->name = __atomic_load_n(&record->name, __ATOMIC_ACQUIRE);
+        to->ts_ns = __atomic_load_n(&record->ts_ns, __ATOMIC_ACQUIRE);
+        to->phase = __atomic_load_n(&record->phase, __ATOMIC_ACQUIRE);
+    }
+
+    /* The thread may have overwritten the oldest events while copying. */
+    unsigned long long now = __atomic_load_n(&thread->count, __ATOMIC_ACQUIRE);
+    unsigned long long valid = (now >= TRACE_EVENTS) ? now - TRACE_EVENTS + 1 : 0;
+    int skip = (valid > first) ? (int) (valid - first) : 0;
+
+    if (skip >= (int) (count - first))
+        return 0;
+    for (int i = skip; i < (int) (count - first); i++)
+        copy[i - skip] = copy[i];
+
+    return (int) (count - first) - skip;
+}
+
+/**
+ * @brief Writes the events recorded so far as a Chrome trace event file.
+ * @details The threads keep recording meanwhile. Stages still running are
+ *          shown up to the end of the trace, stages whose beginning was
+ *          overwritten are left out.
+ *
+ * @param path  The file to write
+ *
+ * @return 0 on success, otherwise a negative errno value
+ */
+int trace_write(const char *path)
+{
+    if (NULL == path)
+        return -EINVAL;
+
+    trace_record_s *copy = (trace_record_s *) malloc(TRACE_EVENTS
+            * sizeof(trace_record_s));
+    if (NULL == copy)
+        return -ENOMEM;
+
+    FILE *file = fopen(path, "w");
+    if (NULL == file) {
+        int error = -errno;
+        free(copy);
+        return error;
+    }
+
+    unsigned int epoch = __atomic_load_n(&s_epoch, __ATOMIC_ACQUIRE);
+    int pid = (int) getpid();
+    const char *separator = "\n";
+    unsigned long events = 0;
+
+    fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+
+    for (int i = 0; i < TRACE_THREADS; i++) {
+        trace_thread_s *thread = &s_threads[i];
+        int state = __atomic_load_n(&thread->state, __ATOMIC_ACQUIRE);
+
+        if ((SLOT_ACTIVE != state && SLOT_EXITED != state)
+                || __atomic_load_n(&thread->epoch, __ATOMIC_ACQUIRE) != epoch)
+            continue;
+
+        const char *name = __atomic_load_n(&thread->name, __ATOMIC_RELAXED);
+        if (NULL != name) {
+            fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,"
+                    "\"tid\":%d,\"args\":{\"name\":", separator, pid, i + 1);
+            _write_string(file, name);
+            fprintf(file, "}}");
+            separator = ",\n";
+        }
+
+        int count = _snapshot(thread, copy);
+        int depth = 0;
+
+        for (int j = 0; j < count; j++) {
+            const trace_record_s *record = &copy[j];
+
+            if ('E' == record->phase) {
+                if (0 == depth)
+                    continue;
+                depth--;
+            } else if ('B' == record->phase) {
+                depth++;
+            }
+
+            fprintf(file, "%s{\"name\":", separator);
+            _write_string(file, record->name);
+            fprintf(file, ",\"ph\":\"%c\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f%s}",
+                    record->phase, pid, i + 1,
+                    (long long) (record->ts_ns - s_start_ns) / 1000.0,
+                    ('i' == record->phase) ? ",\"s\":\"t\"" : "");
+            separator = ",\n";
+            events++;
+        }
+    }
+
+    fprintf(file, "\n]}\n");
+    free(copy);
+
+    unsigned long lost = __atomic_load_n(&s_lost, __ATOMIC_RELAXED);
+    if (lost > 0)
+        hal_log(HAL_LOG_WARN, "trace: %lu events lost, more than %d threads",
+                lost, TRACE_THREADS);
+    hal_log(HAL_LOG_INFO, "trace: %lu events written to %s", events, path);
+
+    if (0 != fclose(file))
+        return -errno;
+
+    return 0;
+}
+
+/**
+ * @brief Stops the trace and frees the rings of the threads that exited.
+ * @details The running threads keep their rings.
+ */
+void trace_release(void)
+{
+    static const int unowned[] = { SLOT_FREE, SLOT_EXITED };
+
+    trace_stop();
+
+    for (int i = 0; i < TRACE_THREADS; i++) {
+        trace_thread_s *thread = &s_threads[i];
+
+        for (int j = 0; j < 2; j++) {
+            int expected = unowned[j];
+
+            if (__atomic_compare_exchange_n(&thread->state, &expected, SLOT_BUSY,
+                    false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+                free(thread->records);
+                thread->records = NULL;
+                __atomic_store_n(&thread->state, SLOT_FREE, __ATOMIC_RELEASE);
+                break;
+            }
+        }
+    }
+}
@@ -17,6 +17,7 @@
 #include "main.h"
 #include "view.h"
 #include "data.h"
+#include "trace.h"
 
 Evas_Object *GLOBAL_DEBUG_BOX;
 
@@ -29,11 +30,13 @@ void _add_entry_text(const char *text)
 {
     Evas_Coord c_y;
 
+    TRACE_BEGIN("ui log");
     elm_entry_entry_append(GLOBAL_DEBUG_BOX, text);
     elm_entry_entry_append(GLOBAL_DEBUG_BOX, "<br>");
     elm_entry_cursor_end_set(GLOBAL_DEBUG_BOX);
     elm_entry_cursor_geometry_get(GLOBAL_DEBUG_BOX, NULL, &c_y, NULL, NULL);
     elm_scroller_region_show(GLOBAL_DEBUG_BOX, 0, c_y, 0, 0);
+    TRACE_END("ui log");
 }
 
 static struct view_info {
@@ -107,6 +110,23 @@ static void _btn_clear_cb(void *data, Evas_Object *object, void *event_info)
     elm_entry_entry_set(GLOBAL_DEBUG_BOX, "");
 }
 
+/**
+ * @brief Gives the log back to the previous view when a view is deleted.
+ * @remarks This function matches the Evas_Object_Event_Cb() signature defined
+ *          in the Evas_Legacy.h header file.
+ *
+ * @param data        The log entry of the previous view
+ * @param e           The canvas pointer on which the event occurred. This
+ *                    argument is not used in this case.
+ * @param obj         The log entry being deleted
+ * @param event_info  This argument is not used in this case.
+ */
+static void _entry_del_cb(void *data, Evas *e, Evas_Object *obj, void *event_info)
+{
+    if (GLOBAL_DEBUG_BOX == obj)
+        GLOBAL_DEBUG_BOX = (Evas_Object *) data;
+}
+
 /**
  * @brief Creates a new view.
  *
@@ -160,8 +180,11 @@ Evas_Object *_create_new_cd_display(char *name, void *callback)
     elm_box_pack_end(box, ebox);
     evas_object_show(ebox);
 
-    /* Create a message box */
+    /* Create a message box, the log of the view until it is popped */
+    Evas_Object *previous_entry = GLOBAL_DEBUG_BOX;
     GLOBAL_DEBUG_BOX = elm_entry_add(ebox);
+    evas_object_event_callback_add(GLOBAL_DEBUG_BOX, EVAS_CALLBACK_DEL,
+            _entry_del_cb, previous_entry);
     elm_entry_editable_set(GLOBAL_DEBUG_BOX, EINA_FALSE);
     elm_entry_scrollable_set(GLOBAL_DEBUG_BOX, EINA_TRUE);
     elm_scroller_policy_set(GLOBAL_DEBUG_BOX, ELM_SCROLLER_POLICY_OFF,
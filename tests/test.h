@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Flora License, Version 1.1 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://floralicense.org/license/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#if !defined(_TEST_H)
+#define _TEST_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*
+ * Minimal checks for the unit tests: a failed check is reported with its
+ * location and the test goes on, the exit status is 1 if any check failed.
+ */
+
+static int s_test_failures;
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            fprintf(stderr, "%s:%d: FAIL %s\n", __FILE__, __LINE__, #condition); \
+            s_test_failures++; \
+        } \
+    } while (0)
+
+#define CHECK_EQUAL(actual, expected) \
+    do { \
+        long long _actual = (long long) (actual); \
+        long long _expected = (long long) (expected); \
+        if (_actual != _expected) { \
+            fprintf(stderr, "%s:%d: FAIL %s is %lld, expected %lld\n", __FILE__, \
+                    __LINE__, #actual, _actual, _expected); \
+            s_test_failures++; \
+        } \
+    } while (0)
+
+/* Prints the outcome, to be returned from main(). */
+static inline int test_result(const char *name)
+{
+    printf("%s %s\n", (0 == s_test_failures) ? "PASS" : "FAIL", name);
+
+    return (0 == s_test_failures) ? 0 : 1;
+}
+
+/**
+ * @brief Creates an empty temporary file.
+ *
+ * @param path  The buffer receiving the path, at least 64 bytes
+ *
+ * @return 0 on success, otherwise -1
+ */
+static inline int test_temp_file(char *path)
+{
+    const char *directory = getenv("TMPDIR");
+
+    snprintf(path, 64, "%s/facecamera-test-XXXXXX",
+            (NULL != directory && strlen(directory) < 32) ? directory : "/tmp");
+    int fd = mkstemp(path);
+    if (fd < 0)
+        return -1;
+    close(fd);
+
+    return 0;
+}
+
+#endif
@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Flora License, Version 1.1 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://floralicense.org/license/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Unit tests of the deferred logging: the messages recorded into a binary
+ * log decode to the text snprintf() makes of the same arguments, and the
+ * formats that cannot be deferred are left to the direct log.
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "binlog.h"
+#include "hal.h"
+#include "test.h"
+
+#define MAXIMUM_MESSAGES 16
+#define TEXT_SIZE 512
+
+typedef struct _messages {
+    char texts[MAXIMUM_MESSAGES][TEXT_SIZE];
+    int priorities[MAXIMUM_MESSAGES];
+    int count;
+} messages_s;
+
+static messages_s s_expected;
+
+/*
+ * Records a message and, if it was deferred, the text snprintf() makes of
+ * it. The format must be a string literal, like for hal_log().
+ */
+static bool _record(int priority, const char *fmt, ...)
+{
+    va_list ap;
+    va_list text_ap;
+
+    va_start(ap, fmt);
+    va_copy(text_ap, ap);
+    bool deferred = binlog_vrecord(priority, fmt, ap);
+    if (deferred && s_expected.count < MAXIMUM_MESSAGES) {
+        vsnprintf(s_expected.texts[s_expected.count], TEXT_SIZE, fmt, text_ap);
+        s_expected.priorities[s_expected.count++] = priority;
+    }
+    va_end(text_ap);
+    va_end(ap);
+
+    return deferred;
+}
+
+static void _message_cb(const binlog_message_s *message, void *user_data)
+{
+    messages_s *decoded = (messages_s *) user_data;
+
+    if (decoded->count < MAXIMUM_MESSAGES) {
+        snprintf(decoded->texts[decoded->count], TEXT_SIZE, "%s", message->text);
+        decoded->priorities[decoded->count++] = message->priority;
+    }
+}
+
+static void _test_round_trip(void)
+{
+    static messages_s decoded;
+    char path[64];
+    char long_string[BINLOG_STRING_MAX + 64];
+    char kept[BINLOG_STRING_MAX + 1];
+    long double ld = 1.5L;
+    int written = 0;
+
+    for (size_t i = 0; i < sizeof(long_string) - 1; i++)
+        long_string[i] = 'a' + i % 26;
+    long_string[sizeof(long_string) - 1] = '\0';
+    memcpy(kept, long_string, BINLOG_STRING_MAX);
+    kept[BINLOG_STRING_MAX] = '\0';
+
+    CHECK_EQUAL(test_temp_file(path), 0);
+    CHECK_EQUAL(binlog_start(path), 0);
+
+    CHECK(_record(HAL_LOG_INFO, "[%*d] [%-*.*s] [%.*f]", 6, -42, 10, 3,
+            "truncated", 2, 3.14159));
+    CHECK(_record(HAL_LOG_WARN, "100%% of %d%%", 7));
+    CHECK(_record(HAL_LOG_DEBUG, "%zu bytes, %lld ns, %ld, %hd, %hhu, %c",
+            (size_t) 1 << 40, -1234567890123LL, -7L, (short) -3,
+            (unsigned char) 250, 'x'));
+    CHECK(_record(HAL_LOG_ERROR, "%jd %td %#x %o %e %g %s", (intmax_t) -5,
+            (ptrdiff_t) 9, 255u, 8u, 1e-10, 0.5, (const char *) NULL));
+    CHECK(_record(HAL_LOG_INFO, "long <%s> %d", long_string, 1));
+    CHECK(_record(HAL_LOG_INFO, "no arguments"));
+
+    /* Left to the direct log, nothing is recorded. */
+    CHECK(!_record(HAL_LOG_INFO, "%d%n", 1, &written));
+    CHECK(!_record(HAL_LOG_INFO, "%Lf", ld));
+    CHECK(!_record(HAL_LOG_INFO, "%d %d %d %d %d %d %d %d %d %d %d %d %d",
+            1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13));
+
+    binlog_stop();
+
+    /* The strings are kept up to BINLOG_STRING_MAX bytes. */
+    snprintf(s_expected.texts[4], TEXT_SIZE, "long <%s> %d", kept, 1);
+
+    CHECK_EQUAL(binlog_decode(path, _message_cb, &decoded), s_expected.count);
+    CHECK_EQUAL(decoded.count, s_expected.count);
+    for (int i = 0; i < decoded.count && i < s_expected.count; i++) {
+        if (0 != strcmp(decoded.texts[i], s_expected.texts[i])) {
+            fprintf(stderr, "%s:%d: FAIL message %d is \"%s\", expected \"%s\"\n",
+                    __FILE__, __LINE__, i, decoded.texts[i], s_expected.texts[i]);
+            s_test_failures++;
+        }
+        CHECK_EQUAL(decoded.priorities[i], s_expected.priorities[i]);
+    }
+    unlink(path);
+}
+
+int main(void)
+{
+    _test_round_trip();
+
+    return test_result("binlog");
+}
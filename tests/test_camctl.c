@@ -0,0 +1,232 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Flora License, Version 1.1 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://floralicense.org/license/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Unit tests of the command coalescing of the camera control, against the
+ * Linux camera: the command thread is held in the state change of a first
+ * command while fixed sequences are submitted, so what is cancelled, dropped
+ * and queued does not depend on the timing of the command thread.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include "camctl.h"
+#include "hal_linux.h"
+#include "test.h"
+
+#define MAXIMUM_COMPLETIONS 16
+
+typedef struct _completion {
+    camctl_command_e command;
+    int error;
+    camctl_state_e state;
+} completion_s;
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    bool hold;   /* The next state change waits for the release */
+    bool held;   /* The command thread is waiting */
+    completion_s completions[MAXIMUM_COMPLETIONS];
+    int completion_num;
+} s_test = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+};
+
+static void _preview_cb(frame_s *frame, void *user_data)
+{
+    (void) frame;
+    (void) user_data;
+}
+
+static void _faces_cb(face_s *faces, int count, void *user_data)
+{
+    (void) faces;
+    (void) count;
+    (void) user_data;
+}
+
+static void _state_changed_cb(camctl_state_e state, void *user_data)
+{
+    (void) state;
+    (void) user_data;
+    pthread_mutex_lock(&s_test.lock);
+    if (s_test.hold) {
+        s_test.held = true;
+        pthread_cond_broadcast(&s_test.cond);
+        while (s_test.hold)
+            pthread_cond_wait(&s_test.cond, &s_test.lock);
+        s_test.held = false;
+    }
+    pthread_mutex_unlock(&s_test.lock);
+}
+
+static void _completed_cb(camctl_command_e command, int error,
+                          camctl_state_e state, void *user_data)
+{
+    (void) user_data;
+    pthread_mutex_lock(&s_test.lock);
+    if (s_test.completion_num < MAXIMUM_COMPLETIONS)
+        s_test.completions[s_test.completion_num++] = (completion_s) {
+                command, error, state };
+    pthread_mutex_unlock(&s_test.lock);
+}
+
+/* Submits a command and holds the command thread in its state change. */
+static void _hold(camctl_h ctl, camctl_command_e command)
+{
+    pthread_mutex_lock(&s_test.lock);
+    s_test.hold = true;
+    s_test.completion_num = 0;
+    pthread_mutex_unlock(&s_test.lock);
+
+    CHECK_EQUAL(camctl_submit(ctl, command), 0);
+
+    pthread_mutex_lock(&s_test.lock);
+    while (!s_test.held)
+        pthread_cond_wait(&s_test.cond, &s_test.lock);
+    pthread_mutex_unlock(&s_test.lock);
+}
+
+/* Lets the queued commands run and checks all the completions, in order. */
+static void _release(camctl_h ctl, const completion_s *expected, int count)
+{
+    pthread_mutex_lock(&s_test.lock);
+    s_test.hold = false;
+    pthread_cond_broadcast(&s_test.cond);
+    pthread_mutex_unlock(&s_test.lock);
+
+    camctl_sync(ctl);
+    hal_linux_dispatch_flush();
+
+    pthread_mutex_lock(&s_test.lock);
+    CHECK_EQUAL(s_test.completion_num, count);
+    for (int i = 0; i < count && i < s_test.completion_num; i++) {
+        const completion_s *completion = &s_test.completions[i];
+
+        if (completion->command != expected[i].command
+                || completion->error != expected[i].error
+                || completion->state != expected[i].state) {
+            fprintf(stderr, "%s:%d: FAIL completion %d is %s %d %d, expected "
+                    "%s %d %d\n", __FILE__, __LINE__, i,
+                    camctl_command_name(completion->command), completion->error,
+                    completion->state, camctl_command_name(expected[i].command),
+                    expected[i].error, expected[i].state);
+            s_test_failures++;
+        }
+    }
+    pthread_mutex_unlock(&s_test.lock);
+}
+
+static void _submit(camctl_h ctl, camctl_command_e command,
+                    camctl_state_e pending)
+{
+    CHECK_EQUAL(camctl_submit(ctl, command), 0);
+    CHECK_EQUAL(camctl_get_pending_state(ctl), pending);
+}
+
+/*
+ * With the preview being started: stop/start and start/stop of the face
+ * detection cancel each other, a second start is dropped and the resolution
+ * changes are all executed.
+ */
+static void _test_starting(camctl_h ctl)
+{
+    static const completion_s expected[] = {
+        { CAMCTL_STOP_PREVIEW, 0, CAMCTL_STATE_PREVIEW },
+        { CAMCTL_START_PREVIEW, 0, CAMCTL_STATE_PREVIEW },
+        { CAMCTL_START_PREVIEW, 0, CAMCTL_STATE_PREVIEW },
+        { CAMCTL_START_FACE_DETECTION, 0, CAMCTL_STATE_PREVIEW },
+        { CAMCTL_STOP_FACE_DETECTION, 0, CAMCTL_STATE_PREVIEW },
+        { CAMCTL_START_PREVIEW, 0, CAMCTL_STATE_PREVIEW },
+        { CAMCTL_CHANGE_RESOLUTION, 0, CAMCTL_STATE_PREVIEW },
+        { CAMCTL_CHANGE_RESOLUTION, 0, CAMCTL_STATE_PREVIEW },
+    };
+
+    _hold(ctl, CAMCTL_START_PREVIEW);
+    CHECK_EQUAL(camctl_get_pending_state(ctl), CAMCTL_STATE_PREVIEW);
+    _submit(ctl, CAMCTL_STOP_PREVIEW, CAMCTL_STATE_STOPPED);
+    _submit(ctl, CAMCTL_START_PREVIEW, CAMCTL_STATE_PREVIEW);
+    _submit(ctl, CAMCTL_START_PREVIEW, CAMCTL_STATE_PREVIEW);
+    _submit(ctl, CAMCTL_START_FACE_DETECTION, CAMCTL_STATE_FACE_DETECTION);
+    _submit(ctl, CAMCTL_STOP_FACE_DETECTION, CAMCTL_STATE_PREVIEW);
+    CHECK_EQUAL(camctl_set_preview_resolution(ctl, 320, 240), 0);
+    CHECK_EQUAL(camctl_set_preview_resolution(ctl, 640, 480), 0);
+    CHECK_EQUAL(camctl_get_pending_state(ctl), CAMCTL_STATE_PREVIEW);
+    _release(ctl, expected, sizeof(expected) / sizeof(expected[0]));
+
+    CHECK_EQUAL(camctl_get_state(ctl), CAMCTL_STATE_PREVIEW);
+}
+
+/*
+ * With the preview being stopped: the face detection is refused, start/stop
+ * cancel each other, and a restart is neither dropped nor cancelled.
+ */
+static void _test_stopping(camctl_h ctl)
+{
+    static const completion_s expected[] = {
+        { CAMCTL_START_FACE_DETECTION, -EINVAL, CAMCTL_STATE_STOPPED },
+        { CAMCTL_START_PREVIEW, 0, CAMCTL_STATE_STOPPED },
+        { CAMCTL_STOP_PREVIEW, 0, CAMCTL_STATE_STOPPED },
+        { CAMCTL_STOP_PREVIEW, 0, CAMCTL_STATE_STOPPED },
+        { CAMCTL_START_PREVIEW, 0, CAMCTL_STATE_PREVIEW },
+        { CAMCTL_STOP_PREVIEW, 0, CAMCTL_STATE_STOPPED },
+        { CAMCTL_RESTART_PREVIEW, 0, CAMCTL_STATE_PREVIEW },
+        { CAMCTL_STOP_PREVIEW, 0, CAMCTL_STATE_STOPPED },
+    };
+
+    _hold(ctl, CAMCTL_STOP_PREVIEW);
+    CHECK_EQUAL(camctl_get_pending_state(ctl), CAMCTL_STATE_STOPPED);
+    _submit(ctl, CAMCTL_START_FACE_DETECTION, CAMCTL_STATE_STOPPED);
+    _submit(ctl, CAMCTL_START_PREVIEW, CAMCTL_STATE_PREVIEW);
+    _submit(ctl, CAMCTL_STOP_PREVIEW, CAMCTL_STATE_STOPPED);
+    _submit(ctl, CAMCTL_STOP_PREVIEW, CAMCTL_STATE_STOPPED);
+    _submit(ctl, CAMCTL_RESTART_PREVIEW, CAMCTL_STATE_PREVIEW);
+    _submit(ctl, CAMCTL_START_PREVIEW, CAMCTL_STATE_PREVIEW);
+    _submit(ctl, CAMCTL_STOP_PREVIEW, CAMCTL_STATE_STOPPED);
+    _release(ctl, expected, sizeof(expected) / sizeof(expected[0]));
+
+    CHECK_EQUAL(camctl_get_state(ctl), CAMCTL_STATE_STOPPED);
+}
+
+int main(void)
+{
+    hal_camera_h camera = NULL;
+    camctl_h ctl = NULL;
+    camctl_callbacks_s callbacks = {
+        .preview = _preview_cb,
+        .faces = _faces_cb,
+        .state_changed = _state_changed_cb,
+        .completed = _completed_cb,
+    };
+
+    hal_set_log_priority(HAL_LOG_WARN);
+    CHECK_EQUAL(hal_camera_create(HAL_CAMERA_DEVICE_BACK, &camera), 0);
+    if (NULL != camera)
+        CHECK_EQUAL(camctl_create(camera, &callbacks, NULL, &ctl), 0);
+
+    if (NULL != ctl) {
+        _test_starting(ctl);
+        _test_stopping(ctl);
+        camctl_destroy(ctl);
+    }
+    if (NULL != camera)
+        hal_camera_destroy(camera);
+
+    return test_result("camctl");
+}
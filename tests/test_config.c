@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Flora License, Version 1.1 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://floralicense.org/license/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Unit tests of the configuration parser: the values of every key type,
+ * the comments and spacing, and the lines that must keep the defaults.
+ */
+
+#include "config.h"
+#include "facefilter.h"
+#include "test.h"
+#include <errno.h>
+
+/* Loads the text as a configuration file over the defaults. */
+static int _load(const char *text, config_s *config)
+{
+    char path[64];
+
+    config_default(config);
+    if (0 != test_temp_file(path))
+        return -EIO;
+
+    FILE *file = fopen(path, "w");
+    int error = (NULL != file) ? 0 : -errno;
+    if (NULL != file) {
+        fputs(text, file);
+        fclose(file);
+        error = config_load(path, config);
+    }
+    unlink(path);
+
+    return error;
+}
+
+static void _test_values(void)
+{
+    config_s config;
+
+    CHECK_EQUAL(_load("# Device settings\n"
+            "filter.max_faces = 3\n"
+            "  filter.motion\t=\tfalse  \r\n"
+            "\n"
+            "camera.device = back\n"
+            "stream.uri = file:/tmp/out.ffs\n"
+            "log.level = warn\n"
+            "metrics.format = json\n"
+            "filter.zones = 0 0 100 200; 900 900 100 100\n"
+            "preview.max_height = 480", &config), 0);
+    CHECK_EQUAL(config.max_faces, 3);
+    CHECK(!config.motion);
+    CHECK_EQUAL(config.camera_device, HAL_CAMERA_DEVICE_BACK);
+    CHECK(0 == strcmp(config.stream_uri, "file:/tmp/out.ffs"));
+    CHECK_EQUAL(config.log_level, HAL_LOG_WARN);
+    CHECK_EQUAL(config.metrics_format, METRICS_JSON);
+    CHECK_EQUAL(config.zone_num, 2);
+    CHECK_EQUAL(config.zones[0].height, 200);
+    CHECK_EQUAL(config.zones[1].x, 900);
+    /* The last line has no newline. */
+    CHECK_EQUAL(config.preview_max_height, 480);
+}
+
+static void _test_invalid(void)
+{
+    config_s defaults;
+    config_s config;
+
+    config_default(&defaults);
+    CHECK_EQUAL(_load("filter.max_faces = 0\n"
+            "camera.image_quality = 101\n"
+            "filter.motion = maybe\n"
+            "camera.device = side\n"
+            "storage.path_length = 12abc\n"
+            "filter.zones = 0 0 100\n"
+            "no.such.key = 1\n"
+            "missing equals\n", &config), 0);
+    CHECK_EQUAL(config.max_faces, defaults.max_faces);
+    CHECK_EQUAL(config.image_quality, defaults.image_quality);
+    CHECK_EQUAL(config.motion, defaults.motion);
+    CHECK_EQUAL(config.camera_device, defaults.camera_device);
+    CHECK_EQUAL(config.path_length, defaults.path_length);
+    CHECK_EQUAL(config.zone_num, 0);
+
+    /* Zones past the frame size or more of them than the filter takes. */
+    CHECK_EQUAL(_load("filter.zones = 0 0 1001 10\n", &config), 0);
+    CHECK_EQUAL(config.zone_num, 0);
+    char text[256] = "filter.zones = ";
+    for (int i = 0; i <= MAXIMUM_ZONE_NUMBER; i++)
+        strcat(text, "0 0 10 10;");
+    strcat(text, "\n");
+    CHECK_EQUAL(_load(text, &config), 0);
+    CHECK_EQUAL(config.zone_num, 0);
+
+    /* A longer string than the setting holds is not cut silently. */
+    char uri[CONFIG_STRING_MAX + 32];
+    memset(uri, 'a', sizeof(uri));
+    memcpy(uri, "stream.uri = ", 13);
+    uri[sizeof(uri) - 1] = '\0';
+    CHECK_EQUAL(_load(uri, &config), 0);
+    CHECK(0 == strcmp(config.stream_uri, defaults.stream_uri));
+}
+
+static void _test_files(void)
+{
+    config_s config;
+
+    CHECK_EQUAL(config_load("/nonexistent/facecamera.conf", &config), -ENOENT);
+    CHECK_EQUAL(config_load(NULL, &config), -EINVAL);
+    CHECK_EQUAL(_load("", &config), 0);
+    CHECK_EQUAL(config.max_faces, MAXIMUM_FACE_NUMBER);
+}
+
+int main(void)
+{
+    _test_values();
+    _test_invalid();
+    _test_files();
+
+    return test_result("config");
+}
@@ -0,0 +1,347 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Flora License, Version 1.1 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://floralicense.org/license/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Unit tests of the mask geometry of the preview filter: the clipping and
+ * chroma alignment of the faces and zones, and their merge into disjoint
+ * spans, checked through the spans the filter stores and the frames it
+ * masks.
+ */
+
+#include "facefilter.h"
+#include "metrics.h"
+#include "shmring.h"
+#include "test.h"
+
+#define WIDTH 64
+#define HEIGHT 48
+
+static void _filter_open(facefilter_s *filter, int width, int height)
+{
+    facefilter_init(filter);
+    facefilter_set_motion(filter, false);
+    facefilter_set_geometry(filter, width, height);
+    facefilter_set_running(filter, true);
+}
+
+/* Checks the span of a single face. */
+static void _check_face(int width, int height, face_s face, int x, int y,
+                        int span_width, int span_height)
+{
+    facefilter_s filter;
+
+    _filter_open(&filter, width, height);
+    facefilter_faces_detected(&filter, &face, 1);
+    CHECK_EQUAL(filter.span_num, 1);
+    CHECK_EQUAL(filter.visible_num, 1);
+    if (1 == filter.span_num) {
+        CHECK_EQUAL(filter.spans[0].offset, y * width + x);
+        CHECK_EQUAL(filter.spans[0].uv_offset, y / 2 * width + x);
+        CHECK_EQUAL(filter.spans[0].width, span_width);
+        CHECK_EQUAL(filter.spans[0].height, span_height);
+    }
+    facefilter_deinit(&filter);
+}
+
+static void _test_clip(void)
+{
+    /* Grown to even edges, so the box covers whole chroma samples. */
+    _check_face(WIDTH, HEIGHT, (face_s) { .x = 3, .y = 5, .width = 4, .height = 4 },
+            2, 4, 6, 6);
+    /* Negative coordinates and the right and bottom edges. */
+    _check_face(WIDTH, HEIGHT, (face_s) { .x = -5, .y = -3, .width = 20, .height = 20 },
+            0, 0, 16, 18);
+    _check_face(WIDTH, HEIGHT, (face_s) { .x = 50, .y = 40, .width = 30, .height = 30 },
+            50, 40, 14, 8);
+    /* An odd frame size leaves the last column and row out. */
+    _check_face(WIDTH + 1, HEIGHT + 1,
+            (face_s) { .x = 60, .y = 44, .width = 10, .height = 10 }, 60, 44, 4, 4);
+}
+
+static void _test_clip_outside(void)
+{
+    const face_s faces[] = {
+        { .x = WIDTH, .y = 0, .width = 10, .height = 10 },
+        { .x = -20, .y = -20, .width = 10, .height = 10 },
+        { .x = 10, .y = 10, .width = 0, .height = 10 },
+        { .x = 10, .y = 10, .width = 10, .height = -1 },
+        { .x = 0x7fffff00, .y = 0x7fffff00, .width = 0x7fffffff, .height = 1 },
+    };
+    facefilter_s filter;
+
+    _filter_open(&filter, WIDTH, HEIGHT);
+    facefilter_faces_detected(&filter, faces, sizeof(faces) / sizeof(faces[0]));
+    CHECK_EQUAL(filter.span_num, 0);
+    CHECK_EQUAL(filter.visible_num, 0);
+    facefilter_deinit(&filter);
+}
+
+static void _test_merge(void)
+{
+    facefilter_s filter;
+
+    /* Overlapping faces: one span per band of rows, none overlapping. */
+    const face_s overlapping[] = {
+        { .x = 0, .y = 0, .width = 20, .height = 20 },
+        { .x = 10, .y = 10, .width = 20, .height = 20 },
+    };
+    _filter_open(&filter, WIDTH, HEIGHT);
+    facefilter_faces_detected(&filter, overlapping, 2);
+    CHECK_EQUAL(filter.span_num, 3);
+    if (3 == filter.span_num) {
+        CHECK_EQUAL(filter.spans[0].offset, 0);
+        CHECK_EQUAL(filter.spans[0].width, 20);
+        CHECK_EQUAL(filter.spans[0].height, 10);
+        CHECK_EQUAL(filter.spans[1].offset, 10 * WIDTH);
+        CHECK_EQUAL(filter.spans[1].width, 30);
+        CHECK_EQUAL(filter.spans[1].height, 10);
+        CHECK_EQUAL(filter.spans[2].offset, 20 * WIDTH + 10);
+        CHECK_EQUAL(filter.spans[2].width, 20);
+        CHECK_EQUAL(filter.spans[2].height, 10);
+    }
+    facefilter_deinit(&filter);
+
+    /* Faces side by side and on top of each other become one span. */
+    const face_s adjacent[] = {
+        { .x = 0, .y = 0, .width = 10, .height = 10 },
+        { .x = 10, .y = 0, .width = 10, .height = 10 },
+        { .x = 0, .y = 10, .width = 20, .height = 10 },
+    };
+    _filter_open(&filter, WIDTH, HEIGHT);
+    facefilter_faces_detected(&filter, adjacent, 3);
+    CHECK_EQUAL(filter.span_num, 1);
+    CHECK_EQUAL(filter.spans[0].width, 20);
+    CHECK_EQUAL(filter.spans[0].height, 20);
+    facefilter_deinit(&filter);
+
+    /* A face inside a zone adds nothing. */
+    const zone_s zone = { .x = 0, .y = 0, .width = 500, .height = 500 };
+    const face_s inside = { .x = 4, .y = 4, .width = 8, .height = 8 };
+    _filter_open(&filter, WIDTH, HEIGHT);
+    CHECK_EQUAL(facefilter_set_zones(&filter, &zone, 1), 0);
+    facefilter_faces_detected(&filter, &inside, 1);
+    CHECK_EQUAL(filter.span_num, 1);
+    CHECK_EQUAL(filter.spans[0].width, WIDTH / 2);
+    CHECK_EQUAL(filter.spans[0].height, HEIGHT / 2);
+    CHECK_EQUAL(filter.visible_num, 1);
+    facefilter_deinit(&filter);
+}
+
+/* Marks an aligned and clipped box on the reference luma. */
+static void _mark(unsigned char *luma, int width, int height, long long left,
+                  long long top, long long right, long long bottom)
+{
+    if (right <= left || bottom <= top)
+        return;
+
+    left &= ~1LL;
+    top &= ~1LL;
+    right = (right + 1) & ~1LL;
+    bottom = (bottom + 1) & ~1LL;
+    for (long long y = (top < 0) ? 0 : top; y < bottom && y < (height & ~1); y++)
+        for (long long x = (left < 0) ? 0 : left; x < right && x < (width & ~1); x++)
+            luma[y * width + x] = 0;
+}
+
+/*
+ * Random faces and zones: the masked luma must be the union of the boxes,
+ * and the spans must be sorted, aligned and cover every pixel once.
+ */
+static void _test_union(void)
+{
+    static unsigned char y[WIDTH * HEIGHT];
+    static unsigned char uv[WIDTH * HEIGHT / 2];
+    static unsigned char reference[WIDTH * HEIGHT];
+
+    srand(1);
+    for (int iteration = 0; iteration < 2000 && 0 == s_test_failures; iteration++) {
+        int width = (rand() % 2) ? WIDTH : WIDTH - 1;
+        int height = HEIGHT;
+        zone_s zones[MAXIMUM_ZONE_NUMBER];
+        face_s faces[MAXIMUM_FACE_NUMBER];
+        int zone_num = rand() % (MAXIMUM_ZONE_NUMBER + 1);
+        int face_num = rand() % (MAXIMUM_FACE_NUMBER + 1);
+        facefilter_s filter;
+
+        memset(reference, 255, sizeof(reference));
+        for (int i = 0; i < zone_num; i++) {
+            zones[i].x = rand() % 1100 - 50;
+            zones[i].y = rand() % 1100 - 50;
+            zones[i].width = 1 + rand() % 600;
+            zones[i].height = 1 + rand() % 600;
+
+            /* The zone edges are scaled after being limited to the frame. */
+            long long edges[4] = { zones[i].x, zones[i].y,
+                    (long long) zones[i].x + zones[i].width,
+                    (long long) zones[i].y + zones[i].height };
+            for (int k = 0; k < 4; k++)
+                edges[k] = (edges[k] < 0) ? 0 : (edges[k] > ZONE_SCALE) ? ZONE_SCALE
+                        : edges[k];
+            _mark(reference, width, height, edges[0] * width / ZONE_SCALE,
+                    edges[1] * height / ZONE_SCALE, edges[2] * width / ZONE_SCALE,
+                    edges[3] * height / ZONE_SCALE);
+        }
+        for (int i = 0; i < face_num; i++) {
+            faces[i] = (face_s) { .id = i, .x = rand() % 80 - 10,
+                    .y = rand() % 60 - 10, .width = 1 + rand() % 40,
+                    .height = 1 + rand() % 40 };
+            _mark(reference, width, height, faces[i].x, faces[i].y,
+                    (long long) faces[i].x + faces[i].width,
+                    (long long) faces[i].y + faces[i].height);
+        }
+
+        _filter_open(&filter, width, height);
+        facefilter_set_zones(&filter, zones, zone_num);
+        if (face_num > 0)
+            facefilter_faces_detected(&filter, faces, face_num);
+
+        frame_s frame = { .width = width, .height = height, .y = y, .uv = uv,
+                .y_size = width * height, .uv_size = width * height / 2 };
+        memset(y, 255, sizeof(y));
+        memset(uv, 7, sizeof(uv));
+        facefilter_preview(&filter, &frame);
+        CHECK(0 == memcmp(y, reference, width * height));
+
+        long long area = 0;
+        long long marked = 0;
+        for (int i = 0; i < filter.span_num; i++) {
+            const face_span_s *span = &filter.spans[i];
+
+            CHECK(0 == i || span->offset > filter.spans[i - 1].offset);
+            CHECK(0 == (span->offset / width) % 2 && 0 == span->height % 2);
+            CHECK_EQUAL(uv[span->uv_offset], 128);
+            area += (long long) span->width * span->height;
+        }
+        for (int i = 0; i < width * height; i++)
+            marked += (0 == reference[i]);
+        CHECK_EQUAL(area, marked);
+        facefilter_deinit(&filter);
+    }
+}
+
+/* The raw export carries the unmasked frame and the faces in its geometry. */
+static void _test_raw_export(void)
+{
+    static unsigned char y[WIDTH * HEIGHT];
+    static unsigned char uv[WIDTH * HEIGHT / 2];
+    frame_s frame = { .width = WIDTH / 2, .height = HEIGHT / 2, .y = y,
+            .uv = uv, .y_size = WIDTH * HEIGHT / 4, .uv_size = WIDTH * HEIGHT / 8 };
+    face_s face = { .x = 8, .y = 8, .width = 16, .height = 16 };
+    shmring_h ring = NULL;
+    shmring_h reader = NULL;
+    facefilter_s filter;
+
+    CHECK_EQUAL(shmring_create("/facecamera-test", 2, sizeof(y) + sizeof(uv),
+            &ring), 0);
+    CHECK_EQUAL(shmring_open("/facecamera-test", &reader), 0);
+    if (NULL == ring || NULL == reader) {
+        shmring_close(reader);
+        shmring_destroy(ring);
+        return;
+    }
+
+    _filter_open(&filter, WIDTH, HEIGHT);
+    facefilter_set_export(&filter, ring, true);
+    facefilter_faces_detected(&filter, &face, 1);
+    memset(y, 255, sizeof(y));
+    facefilter_preview(&filter, &frame);
+
+    shmring_frame_s exported;
+    CHECK_EQUAL(shmring_next(reader, 0, &exported), 0);
+    CHECK(exported.raw);
+    CHECK_EQUAL(exported.face_num, 1);
+    if (1 == exported.face_num) {
+        CHECK_EQUAL(exported.faces[0].x, 4);
+        CHECK_EQUAL(exported.faces[0].y, 4);
+        CHECK_EQUAL(exported.faces[0].width, 8);
+        CHECK_EQUAL(exported.faces[0].height, 8);
+    }
+    CHECK_EQUAL(exported.frame.y[4 * WIDTH / 2 + 4], 255);
+    shmring_release(reader, &exported);
+    CHECK_EQUAL(y[4 * WIDTH / 2 + 4], 0);
+
+    facefilter_deinit(&filter);
+    shmring_close(reader);
+    shmring_destroy(ring);
+}
+
+/* Reads a counter of the metrics registry, -1 if it was not written. */
+static long long _read_counter(const char *name)
+{
+    char path[64];
+    char line[256];
+    long long value = -1;
+    size_t length = strlen(name);
+
+    if (0 != test_temp_file(path))
+        return -1;
+    if (0 == metrics_write(path, METRICS_PROMETHEUS)) {
+        FILE *file = fopen(path, "r");
+        while (NULL != file && NULL != fgets(line, sizeof(line), file)) {
+            if (0 == strncmp(line, "facecamera_", 11)
+                    && 0 == strncmp(line + 11, name, length)
+                    && ' ' == line[11 + length])
+                value = atoll(line + 12 + length);
+        }
+        if (NULL != file)
+            fclose(file);
+    }
+    unlink(path);
+
+    return value;
+}
+
+/* A filter with the metrics off, like the benchmark ones, counts nothing. */
+static void _test_metrics(void)
+{
+    static unsigned char y[WIDTH * HEIGHT];
+    static unsigned char uv[WIDTH * HEIGHT / 2];
+    frame_s frame = { .width = WIDTH, .height = HEIGHT, .y = y, .uv = uv,
+            .y_size = WIDTH * HEIGHT, .uv_size = WIDTH * HEIGHT / 2 };
+    face_s face = { .x = 8, .y = 8, .width = 16, .height = 16 };
+    facefilter_s filter;
+
+    metrics_reset();
+    for (int enabled = 0; enabled < 2; enabled++) {
+        _filter_open(&filter, WIDTH, HEIGHT);
+        facefilter_set_metrics(&filter, enabled);
+        facefilter_faces_detected(&filter, &face, 1);
+        facefilter_preview(&filter, &frame);
+        facefilter_deinit(&filter);
+
+        CHECK_EQUAL(_read_counter("preview_frames_total"), enabled);
+        CHECK_EQUAL(_read_counter("detections_total"), enabled);
+    }
+
+    /* Only the photos of the camera are counted as written. */
+    char path[64];
+    CHECK_EQUAL(test_temp_file(path), 0);
+    CHECK_EQUAL(facefilter_write_file(path, y, 16), 0);
+    unlink(path);
+    CHECK_EQUAL(_read_counter("bytes_written_total"), 0);
+}
+
+int main(void)
+{
+    _test_clip();
+    _test_clip_outside();
+    _test_merge();
+    _test_union();
+    _test_raw_export();
+    _test_metrics();
+
+    return test_result("facefilter");
+}
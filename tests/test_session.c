@@ -0,0 +1,293 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Flora License, Version 1.1 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://floralicense.org/license/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Unit tests of the session files: what the recorder writes is what the
+ * replay delivers, in order, for full and decimated frames, and damaged
+ * files are refused.
+ */
+
+#include "session.h"
+#include "test.h"
+
+#define WIDTH 16
+#define HEIGHT 8
+
+typedef struct _replayed {
+    char kinds[16]; /* 'P'review, 'F'aces and 'C'apture, in order */
+    int kind_num;
+    int frame_num;
+    frame_s frame;  /* The last frame, its planes copied */
+    unsigned char y[WIDTH * HEIGHT];
+    unsigned char uv[WIDTH * HEIGHT / 2];
+    face_s faces[4];
+    int face_num;
+    unsigned char capture[8];
+    unsigned int capture_size;
+    bool capture_data;
+} replayed_s;
+
+static void _add_kind(replayed_s *replayed, char kind)
+{
+    if (replayed->kind_num < (int) sizeof(replayed->kinds) - 1)
+        replayed->kinds[replayed->kind_num++] = kind;
+}
+
+static void _preview_cb(frame_s *frame, void *user_data)
+{
+    replayed_s *replayed = (replayed_s *) user_data;
+
+    _add_kind(replayed, 'P');
+    replayed->frame_num++;
+    replayed->frame = *frame;
+    if (frame->y_size == sizeof(replayed->y))
+        memcpy(replayed->y, frame->y, frame->y_size);
+    if (NULL != frame->uv && frame->uv_size == sizeof(replayed->uv))
+        memcpy(replayed->uv, frame->uv, frame->uv_size);
+}
+
+static void _faces_cb(face_s *faces, int count, void *user_data)
+{
+    replayed_s *replayed = (replayed_s *) user_data;
+
+    _add_kind(replayed, 'F');
+    replayed->face_num = count;
+    if (count > 0 && count <= 4)
+        memcpy(replayed->faces, faces, count * sizeof(face_s));
+}
+
+static void _capture_cb(const unsigned char *data, unsigned int size,
+                        void *user_data)
+{
+    replayed_s *replayed = (replayed_s *) user_data;
+
+    _add_kind(replayed, 'C');
+    replayed->capture_size = size;
+    replayed->capture_data = NULL != data;
+    if (NULL != data && size <= sizeof(replayed->capture))
+        memcpy(replayed->capture, data, size);
+}
+
+static const session_callbacks_s s_callbacks = {
+    .preview = _preview_cb,
+    .faces = _faces_cb,
+    .capture = _capture_cb,
+};
+
+static void _fill_frame(frame_s *frame, unsigned char *y, unsigned char *uv)
+{
+    for (int i = 0; i < WIDTH * HEIGHT; i++)
+        y[i] = (unsigned char) (i * 7);
+    for (int i = 0; i < WIDTH * HEIGHT / 2; i++)
+        uv[i] = (unsigned char) (255 - i);
+    *frame = (frame_s) { .width = WIDTH, .height = HEIGHT, .y = y, .uv = uv,
+            .y_size = WIDTH * HEIGHT, .uv_size = WIDTH * HEIGHT / 2 };
+}
+
+static void _test_round_trip(void)
+{
+    static unsigned char y[WIDTH * HEIGHT];
+    static unsigned char uv[WIDTH * HEIGHT / 2];
+    const face_s faces[2] = {
+        { .id = 1, .score = 90, .x = -4, .y = 2, .width = 6, .height = 5 },
+        { .id = 2, .score = 10, .x = 8, .y = 0, .width = 4, .height = 8 },
+    };
+    const unsigned char image[5] = { 0xff, 0xd8, 1, 2, 3 };
+    session_options_s options;
+    session_recorder_h recorder = NULL;
+    replayed_s replayed = { .kind_num = 0 };
+    frame_s frame;
+    char path[64];
+
+    if (0 != test_temp_file(path)) {
+        CHECK(!"temporary file");
+        return;
+    }
+    _fill_frame(&frame, y, uv);
+    session_options_default(&options);
+    options.capture_data = true;
+
+    CHECK_EQUAL(session_recorder_create(&recorder), SESSION_ERROR_NONE);
+    CHECK_EQUAL(session_recorder_start(recorder, path, &options), SESSION_ERROR_NONE);
+    CHECK(session_recorder_is_recording(recorder));
+    session_recorder_faces(recorder, faces, 2);
+    session_recorder_frame(recorder, &frame);
+    session_recorder_capture(recorder, image, sizeof(image));
+    session_recorder_faces(recorder, NULL, 0);
+    CHECK_EQUAL(session_recorder_stop(recorder), SESSION_ERROR_NONE);
+    /* Nothing is recorded once stopped. */
+    session_recorder_frame(recorder, &frame);
+    session_recorder_destroy(recorder);
+
+    CHECK_EQUAL(session_replay(path, SESSION_REPLAY_MAX_SPEED, &s_callbacks,
+            &replayed), 4);
+    CHECK(0 == strcmp(replayed.kinds, "FPCF"));
+    CHECK_EQUAL(replayed.frame_num, 1);
+    CHECK_EQUAL(replayed.frame.width, WIDTH);
+    CHECK_EQUAL(replayed.frame.height, HEIGHT);
+    CHECK(0 == memcmp(replayed.y, y, sizeof(y)));
+    CHECK(0 == memcmp(replayed.uv, uv, sizeof(uv)));
+    CHECK_EQUAL(replayed.face_num, 0);
+    CHECK_EQUAL(replayed.capture_size, sizeof(image));
+    CHECK(replayed.capture_data);
+    CHECK(0 == memcmp(replayed.capture, image, sizeof(image)));
+    unlink(path);
+}
+
+/* Checks the faces of a single detection survive the file as they are. */
+static void _test_faces(void)
+{
+    const face_s faces[2] = {
+        { .id = 1, .score = 90, .x = -4, .y = 2, .width = 6, .height = 5 },
+        { .id = 2, .score = 10, .x = 8, .y = 0, .width = 4, .height = 8 },
+    };
+    session_recorder_h recorder = NULL;
+    replayed_s replayed = { .kind_num = 0 };
+    char path[64];
+
+    if (0 != test_temp_file(path)) {
+        CHECK(!"temporary file");
+        return;
+    }
+    session_recorder_create(&recorder);
+    session_recorder_start(recorder, path, NULL);
+    session_recorder_faces(recorder, faces, 2);
+    session_recorder_destroy(recorder);
+
+    CHECK_EQUAL(session_replay(path, SESSION_REPLAY_MAX_SPEED, &s_callbacks,
+            &replayed), 1);
+    CHECK_EQUAL(replayed.face_num, 2);
+    CHECK(0 == memcmp(replayed.faces, faces, sizeof(faces)));
+    unlink(path);
+}
+
+static void _test_decimation(void)
+{
+    static unsigned char y[WIDTH * HEIGHT];
+    static unsigned char uv[WIDTH * HEIGHT / 2];
+    session_options_s options;
+    session_recorder_h recorder = NULL;
+    replayed_s replayed = { .kind_num = 0 };
+    frame_s frame;
+    char path[64];
+
+    if (0 != test_temp_file(path)) {
+        CHECK(!"temporary file");
+        return;
+    }
+    _fill_frame(&frame, y, uv);
+    session_options_default(&options);
+    options.decimation = 2;
+    options.frame_interval = 2;
+
+    session_recorder_create(&recorder);
+    session_recorder_start(recorder, path, &options);
+    for (int i = 0; i < 3; i++)
+        session_recorder_frame(recorder, &frame);
+    session_recorder_destroy(recorder);
+
+    /* Frames 0 and 2, scaled back up to the recorded size without chroma. */
+    CHECK_EQUAL(session_replay(path, SESSION_REPLAY_MAX_SPEED, &s_callbacks,
+            &replayed), 2);
+    CHECK_EQUAL(replayed.frame_num, 2);
+    CHECK_EQUAL(replayed.frame.width, WIDTH);
+    CHECK_EQUAL(replayed.frame.height, HEIGHT);
+    CHECK(NULL == replayed.frame.uv);
+    for (int j = 0; j < HEIGHT; j++)
+        for (int i = 0; i < WIDTH; i++)
+            CHECK_EQUAL(replayed.y[j * WIDTH + i], y[(j & ~1) * WIDTH + (i & ~1)]);
+    unlink(path);
+}
+
+static void _test_damaged(void)
+{
+    static unsigned char y[WIDTH * HEIGHT];
+    static unsigned char uv[WIDTH * HEIGHT / 2];
+    session_recorder_h recorder = NULL;
+    replayed_s replayed = { .kind_num = 0 };
+    frame_s frame;
+    char path[64];
+
+    CHECK_EQUAL(session_replay("/nonexistent.ffs", SESSION_REPLAY_MAX_SPEED,
+            &s_callbacks, &replayed), SESSION_ERROR_IO);
+    if (0 != test_temp_file(path)) {
+        CHECK(!"temporary file");
+        return;
+    }
+
+    /* Not a session file. */
+    FILE *file = fopen(path, "wb");
+    if (NULL != file) {
+        fputs("FFSX\1\0\0\0", file);
+        fclose(file);
+    }
+    CHECK_EQUAL(session_replay(path, SESSION_REPLAY_MAX_SPEED, &s_callbacks,
+            &replayed), SESSION_ERROR_FORMAT);
+
+    /* A frame cut short. */
+    _fill_frame(&frame, y, uv);
+    session_recorder_create(&recorder);
+    session_recorder_start(recorder, path, NULL);
+    session_recorder_frame(recorder, &frame);
+    session_recorder_destroy(recorder);
+    CHECK_EQUAL(truncate(path, 8 + 16 + 8 + WIDTH * HEIGHT / 2), 0);
+    CHECK_EQUAL(session_replay(path, SESSION_REPLAY_MAX_SPEED, &s_callbacks,
+            &replayed), SESSION_ERROR_FORMAT);
+    CHECK_EQUAL(replayed.frame_num, 0);
+
+    /* A capture claiming more data than its chunk, which wraps the sum. */
+    static const unsigned char capture[] = {
+        'F', 'F', 'S', 'R', 1, 0, 0, 0,
+        'C', 'A', 'P', 'T', 5, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0xff, 0xff, 0xff, 0xff, 1,
+    };
+    file = fopen(path, "wb");
+    if (NULL != file) {
+        fwrite(capture, 1, sizeof(capture), file);
+        fclose(file);
+    }
+    replayed = (replayed_s) { .kind_num = 0 };
+    CHECK_EQUAL(session_replay(path, SESSION_REPLAY_MAX_SPEED, &s_callbacks,
+            &replayed), SESSION_ERROR_FORMAT);
+    CHECK_EQUAL(replayed.kind_num, 0);
+
+    /* A chunk larger than the rest of the file. */
+    static const unsigned char huge[] = {
+        'F', 'F', 'S', 'R', 1, 0, 0, 0,
+        'F', 'R', 'M', 'E', 0xf0, 0xff, 0xff, 0xff, 0, 0, 0, 0, 0, 0, 0, 0,
+        16, 0, 8, 0, 1, 1, 0, 0,
+    };
+    file = fopen(path, "wb");
+    if (NULL != file) {
+        fwrite(huge, 1, sizeof(huge), file);
+        fclose(file);
+    }
+    replayed = (replayed_s) { .kind_num = 0 };
+    CHECK_EQUAL(session_replay(path, SESSION_REPLAY_MAX_SPEED, &s_callbacks,
+            &replayed), SESSION_ERROR_FORMAT);
+    CHECK_EQUAL(replayed.kind_num, 0);
+    unlink(path);
+}
+
+int main(void)
+{
+    _test_round_trip();
+    _test_faces();
+    _test_decimation();
+    _test_damaged();
+
+    return test_result("session");
+}
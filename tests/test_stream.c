@@ -0,0 +1,249 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Flora License, Version 1.1 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://floralicense.org/license/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Unit tests of the stream queue: a transport that blocks until the test
+ * releases it holds a frame in the middle of a send while more frames are
+ * pushed, so the frames delivered and dropped under each drop policy and a
+ * queue length change during a send are checked deterministically.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include "stream.h"
+#include "test.h"
+
+#define WIDTH 16
+#define HEIGHT 8
+#define FRAME_SIZE (WIDTH * HEIGHT * 3 / 2)
+
+typedef struct _blocking {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int entered;  /* Sends started */
+    int permits;  /* Sends allowed to complete */
+    unsigned int delivered[16]; /* Generations of the completed sends */
+    int delivered_num;
+} blocking_s;
+
+static blocking_s s_blocking = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+};
+
+static int _blocking_open(void **context, const char *target)
+{
+    (void) target;
+    *context = &s_blocking;
+
+    return 0;
+}
+
+/* Waits for a permit of the test, then records the frame generation. */
+static int _blocking_send(void *context, const unsigned char *header,
+                          const frame_s *frame)
+{
+    blocking_s *blocking = (blocking_s *) context;
+
+    (void) frame;
+    pthread_mutex_lock(&blocking->lock);
+    blocking->entered++;
+    pthread_cond_broadcast(&blocking->cond);
+    while (0 == blocking->permits)
+        pthread_cond_wait(&blocking->cond, &blocking->lock);
+    blocking->permits--;
+    if (blocking->delivered_num < 16)
+        blocking->delivered[blocking->delivered_num++] = header[12]
+                | header[13] << 8 | header[14] << 16 | (unsigned int) header[15] << 24;
+    pthread_mutex_unlock(&blocking->lock);
+
+    return 0;
+}
+
+static void _blocking_close(void *context)
+{
+    (void) context;
+}
+
+static const stream_transport_s s_transport_blocking = {
+    .name = "blocking",
+    .open = _blocking_open,
+    .send = _blocking_send,
+    .close = _blocking_close,
+};
+
+static void _blocking_reset(void)
+{
+    pthread_mutex_lock(&s_blocking.lock);
+    s_blocking.entered = 0;
+    s_blocking.permits = 0;
+    s_blocking.delivered_num = 0;
+    pthread_mutex_unlock(&s_blocking.lock);
+}
+
+static void _blocking_release(int permits)
+{
+    pthread_mutex_lock(&s_blocking.lock);
+    s_blocking.permits += permits;
+    pthread_cond_broadcast(&s_blocking.cond);
+    pthread_mutex_unlock(&s_blocking.lock);
+}
+
+/* Waits until the sender is blocked in the given send. */
+static void _blocking_wait(int entered)
+{
+    pthread_mutex_lock(&s_blocking.lock);
+    while (s_blocking.entered < entered)
+        pthread_cond_wait(&s_blocking.cond, &s_blocking.lock);
+    pthread_mutex_unlock(&s_blocking.lock);
+}
+
+static int _push(stream_h stream, unsigned int generation)
+{
+    static unsigned char planes[FRAME_SIZE];
+    frame_s frame = { .width = WIDTH, .height = HEIGHT, .y = planes,
+            .uv = planes + WIDTH * HEIGHT, .y_size = WIDTH * HEIGHT,
+            .uv_size = WIDTH * HEIGHT / 2 };
+
+    return stream_push(stream, &frame, generation);
+}
+
+static void _check_delivered(const unsigned int *expected, int count)
+{
+    CHECK_EQUAL(s_blocking.delivered_num, count);
+    for (int i = 0; i < count && i < s_blocking.delivered_num; i++)
+        CHECK_EQUAL(s_blocking.delivered[i], expected[i]);
+}
+
+/*
+ * Frame 1 is held in the send while 2, 3 and 4 are pushed into a queue of
+ * two: the oldest queued frames are replaced, never the one being sent.
+ */
+static void _test_drop_oldest(void)
+{
+    static const unsigned int expected[] = { 1, 4 };
+    stream_h stream = NULL;
+    stream_stats_s stats;
+
+    _blocking_reset();
+    CHECK_EQUAL(stream_create(&s_transport_blocking, "", 2, STREAM_DROP_OLDEST,
+            &stream), 0);
+    if (NULL == stream)
+        return;
+
+    CHECK_EQUAL(_push(stream, 1), 0);
+    _blocking_wait(1);
+    CHECK_EQUAL(_push(stream, 2), 0);
+    CHECK_EQUAL(_push(stream, 3), 0);
+    CHECK_EQUAL(_push(stream, 4), 0);
+    stream_refuse_unfiltered(stream);
+    stream_refuse_unfiltered(stream);
+
+    stream_get_stats(stream, &stats);
+    CHECK_EQUAL(stats.pushed, 4);
+    CHECK_EQUAL(stats.sent, 0);
+    CHECK_EQUAL(stats.dropped, 2);
+    CHECK_EQUAL(stats.unfiltered, 2);
+
+    _blocking_release(16);
+    stream_destroy(stream);
+    _check_delivered(expected, 2);
+}
+
+/* The same pushes keep the queued frames and discard the incoming ones. */
+static void _test_drop_newest(void)
+{
+    static const unsigned int expected[] = { 1, 2 };
+    stream_h stream = NULL;
+    stream_stats_s stats;
+
+    _blocking_reset();
+    CHECK_EQUAL(stream_create(&s_transport_blocking, "", 2, STREAM_DROP_NEWEST,
+            &stream), 0);
+    if (NULL == stream)
+        return;
+
+    CHECK_EQUAL(_push(stream, 1), 0);
+    _blocking_wait(1);
+    CHECK_EQUAL(_push(stream, 2), 0);
+    CHECK_EQUAL(_push(stream, 3), -EAGAIN);
+    CHECK_EQUAL(_push(stream, 4), -EAGAIN);
+    stream_refuse_unfiltered(stream);
+
+    stream_get_stats(stream, &stats);
+    CHECK_EQUAL(stats.pushed, 2);
+    CHECK_EQUAL(stats.dropped, 2);
+    CHECK_EQUAL(stats.unfiltered, 1);
+
+    _blocking_release(16);
+    stream_destroy(stream);
+    _check_delivered(expected, 2);
+}
+
+/*
+ * Shrinking the queue while a frame is sent is applied once the send is
+ * done: the oldest queued frame is dropped and the unused buffers released.
+ */
+static void _test_resize_while_sending(void)
+{
+    static const unsigned int expected[] = { 1, 3 };
+    stream_h stream = NULL;
+    stream_stats_s stats;
+
+    _blocking_reset();
+    CHECK_EQUAL(stream_create(&s_transport_blocking, "", 3, STREAM_DROP_OLDEST,
+            &stream), 0);
+    if (NULL == stream)
+        return;
+
+    CHECK_EQUAL(_push(stream, 1), 0);
+    _blocking_wait(1);
+    CHECK_EQUAL(_push(stream, 2), 0);
+    CHECK_EQUAL(_push(stream, 3), 0);
+    CHECK_EQUAL(stream_set_queue_length(stream, 4), -EINVAL);
+    CHECK_EQUAL(stream_set_queue_length(stream, 1), 0);
+
+    stream_get_stats(stream, &stats);
+    CHECK_EQUAL(stats.dropped, 0);
+    CHECK_EQUAL(stream_get_memory(stream), 3 * FRAME_SIZE);
+
+    /* Frame 1 done, the sender blocks in the send of frame 3. */
+    _blocking_release(1);
+    _blocking_wait(2);
+    stream_get_stats(stream, &stats);
+    CHECK_EQUAL(stats.sent, 1);
+    CHECK_EQUAL(stats.dropped, 1);
+    CHECK_EQUAL(stream_get_memory(stream), FRAME_SIZE);
+
+    /* The only slot is being sent. */
+    CHECK_EQUAL(_push(stream, 4), -EAGAIN);
+    stream_get_stats(stream, &stats);
+    CHECK_EQUAL(stats.dropped, 2);
+
+    _blocking_release(16);
+    stream_destroy(stream);
+    _check_delivered(expected, 2);
+}
+
+int main(void)
+{
+    _test_drop_oldest();
+    _test_drop_newest();
+    _test_resize_while_sending();
+
+    return test_result("stream");
+}